@@ -19,6 +19,7 @@ package main
 import (
 	"context"
 	"crypto"
+	"crypto/ecdsa"
 	"crypto/rand"
 	"crypto/x509"
 	"encoding/base64"
@@ -432,7 +433,8 @@ func atcaGenKey(ctx context.Context, dc dev.DevConn) error {
 	return err
 }
 
-func genCSR(ctx context.Context, csrTemplateFile string, subject string, slot int, dc dev.DevConn, outputFileName string) ([]byte, error) {
+// genCSR creates a CSR for the key in the slot. pubKey is the key's public part if known, otherwise it is read from the device.
+func genCSR(ctx context.Context, csrTemplateFile string, subject string, slot int, pubKey *ecdsa.PublicKey, dc dev.DevConn, outputFileName string) ([]byte, error) {
 	if csrTemplateFile == "" && subject == "" {
 		return nil, errors.Errorf("CSR template file or subject is required")
 	}
@@ -483,7 +485,12 @@ func genCSR(ctx context.Context, csrTemplateFile string, subject string, slot in
 			x509.ECDSA, x509.ECDSAWithSHA256, csrTemplate.PublicKeyAlgorithm,
 			csrTemplate.SignatureAlgorithm)
 	}
-	signer := atca.NewSigner(ctx, dc, slot)
+	var signer crypto.Signer
+	if pubKey != nil {
+		signer = atca.NewSignerWithPublicKey(ctx, dc, slot, pubKey)
+	} else {
+		signer = atca.NewSigner(ctx, dc, slot)
+	}
 	csrData, err := x509.CreateCertificateRequest(rand.Reader, csrTemplate, signer)
 	if err != nil {
 		return nil, errors.Annotatef(err, "failed to create new CSR")
@@ -512,15 +519,15 @@ func atcaGenCSR(ctx context.Context, dc dev.DevConn) error {
 	if _, _, err := atca.Connect(ctx, dc); err != nil {
 		return errors.Annotatef(err, "Connect")
 	}
-	pubKeyData, err := atca.GenKey(ctx, int(slot), *dryRun, dc)
+	pubKey, err := atca.GenKey(ctx, int(slot), *dryRun, dc)
 	if err != nil {
 		return errors.Trace(err)
 	}
-	if pubKeyData == nil { // dry run
+	if pubKey == nil { // dry run
 		return nil
 	}
 
-	csrData, err := genCSR(ctx, *flags.CSRTemplate, *flags.Subject, int(slot), dc, outputFileName)
+	csrData, err := genCSR(ctx, *flags.CSRTemplate, *flags.Subject, int(slot), pubKey, dc, outputFileName)
 	if err != nil {
 		return errors.Annotatef(err, "genCSR")
 	}
@@ -528,7 +535,8 @@ func atcaGenCSR(ctx context.Context, dc dev.DevConn) error {
 	return x509utils.WritePEM(csrData, "CERTIFICATE REQUEST", outputFileName)
 }
 
-func genCert(ctx context.Context, certTemplateFile string, subject string, validityDays int, slot int, caCert *x509.Certificate, caSigner crypto.Signer, dc dev.DevConn, outputFileName string) ([]byte, error) {
+// genCert creates a cert for the key in the slot. pubKey is the key's public part if known, otherwise it is read from the device.
+func genCert(ctx context.Context, certTemplateFile string, subject string, validityDays int, slot int, pubKey *ecdsa.PublicKey, caCert *x509.Certificate, caSigner crypto.Signer, dc dev.DevConn, outputFileName string) ([]byte, error) {
 	if certTemplateFile == "" && subject == "" {
 		return nil, errors.Errorf("cert template file or subject is required")
 	}
@@ -596,9 +604,12 @@ func genCert(ctx context.Context, certTemplateFile string, subject string, valid
 			x509.ECDSA, x509.ECDSAWithSHA256, certTemplate.PublicKeyAlgorithm,
 			certTemplate.SignatureAlgorithm)
 	}
-	pubKey, err := atca.GetPubKey(ctx, slot, dc)
-	if err != nil {
-		return nil, errors.Annotatef(err, "GetPubKey")
+	if pubKey == nil {
+		var err error
+		pubKey, err = atca.GetPubKey(ctx, slot, dc)
+		if err != nil {
+			return nil, errors.Annotatef(err, "GetPubKey")
+		}
 	}
 	certData, err := x509.CreateCertificate(rand.Reader, certTemplate, caCert, pubKey, caSigner)
 	if err != nil {
@@ -648,7 +659,7 @@ func atcaGenCert(ctx context.Context, dc dev.DevConn) error {
 		return nil
 	}
 
-	certData, err := genCert(ctx, *flags.CertTemplate, *flags.Subject, *flags.CertDays, int(slot), caCert, caSigner, dc, outputFileName)
+	certData, err := genCert(ctx, *flags.CertTemplate, *flags.Subject, *flags.CertDays, int(slot), pubKey, caCert, caSigner, dc, outputFileName)
 	if err != nil {
 		return errors.Annotatef(err, "genCert")
 	}
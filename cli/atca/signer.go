@@ -20,11 +20,11 @@ import (
 	"context"
 	"crypto"
 	"crypto/ecdsa"
-	"crypto/elliptic"
 	"encoding/asn1"
 	"encoding/base64"
 	"io"
 	"math/big"
+	"sync"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/dev"
@@ -36,32 +36,34 @@ type Signer struct {
 	ctx  context.Context
 	dc   dev.DevConn
 	slot int
+
+	// Public() is called more than once when creating a cert or CSR,
+	// the key is only retrieved from the device the first time.
+	pubKeyLock sync.Mutex
+	pubKey     *ecdsa.PublicKey
 }
 
 func NewSigner(ctx context.Context, dc dev.DevConn, slot int) crypto.Signer {
 	return &Signer{ctx: ctx, dc: dc, slot: slot}
 }
 
-func (s *Signer) Public() crypto.PublicKey {
-	pubk := &ecdsa.PublicKey{
-		Curve: elliptic.P256(),
-		X:     big.NewInt(0),
-		Y:     big.NewInt(0),
-	}
+// NewSignerWithPublicKey returns a signer for a slot with a known public key,
+// e.g. the one returned by GenKey, which saves a GetPubKey round trip.
+func NewSignerWithPublicKey(ctx context.Context, dc dev.DevConn, slot int, pubKey *ecdsa.PublicKey) crypto.Signer {
+	return &Signer{ctx: ctx, dc: dc, slot: slot, pubKey: pubKey}
+}
 
-	var r GetPubKeyResult
-	if err := s.dc.Call(s.ctx, "ATCA.GetPubKey", &GetPubKeyArgs{
-		Slot: int64(s.slot),
-	}, &r); err != nil {
-		return nil
+func (s *Signer) Public() crypto.PublicKey {
+	s.pubKeyLock.Lock()
+	defer s.pubKeyLock.Unlock()
+	if s.pubKey == nil {
+		pubKey, err := GetPubKey(s.ctx, s.slot, s.dc)
+		if err != nil {
+			return nil
+		}
+		s.pubKey = pubKey
 	}
-
-	keyData, _ := base64.StdEncoding.DecodeString(*r.Pubkey)
-
-	pubk.X.SetBytes(keyData[:PublicKeySize/2])
-	pubk.Y.SetBytes(keyData[PublicKeySize/2 : PublicKeySize])
-
-	return pubk
+	return s.pubKey
 }
 
 type ecdsaSignature struct {
@@ -29,6 +29,7 @@ import (
 	"path/filepath"
 	"sort"
 	"strings"
+	"sync"
 
 	"github.com/aws/aws-sdk-go/aws"
 	"github.com/aws/aws-sdk-go/aws/credentials"
@@ -68,6 +69,19 @@ var (
 	awsProfile    = ""
 )
 
+// Cloud-side state shared by devices provisioned in the same run (see fleet.Provision).
+var (
+	svcLock  sync.Mutex
+	svcCache = make(map[string]*iot.IoT)
+
+	mqttServerLock  sync.Mutex
+	mqttServerCache = make(map[*iot.IoT]string)
+
+	// Held while checking for and creating the default policy.
+	mosPolicyLock  sync.Mutex
+	mosPolicyReady = false
+)
+
 func init() {
 	flag.BoolVar(&awsGGEnable, "aws-enable-greengrass", false, "Enable AWS Greengrass support")
 	flag.StringVar(&awsMQTTServer, "aws-mqtt-server", "", "If not specified, calls DescribeEndpoint to get it from AWS")
@@ -84,7 +98,24 @@ func init() {
 	MustAsset(rsaCACert)
 }
 
+// getSvc returns the IoT service client, it is created once for the given region and credentials.
 func getSvc(region, keyID, key string) (*iot.IoT, error) {
+	// Held while creating, so the region and credentials are only looked up (or asked for) once.
+	svcLock.Lock()
+	defer svcLock.Unlock()
+	ck := fmt.Sprintf("%s|%s|%s", region, keyID, key)
+	if svc := svcCache[ck]; svc != nil {
+		return svc, nil
+	}
+	svc, err := newSvc(region, keyID, key)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	svcCache[ck] = svc
+	return svc, nil
+}
+
+func newSvc(region, keyID, key string) (*iot.IoT, error) {
 	sess, err := session.NewSession()
 	if err != nil {
 		return nil, errors.Trace(err)
@@ -232,27 +263,9 @@ func genCert(ctx context.Context, certType x509utils.CertType, useATCA bool, iot
 
 	if policy != awsIoTPolicyNone {
 		if policy == AWSIoTPolicyMOS {
-			policies, err := GetAWSIoTPolicyNames(region, keyID, key)
-			if err != nil {
+			if err := ensureMOSPolicy(iotSvc, region, keyID, key); err != nil {
 				return nil, nil, errors.Trace(err)
 			}
-			found := false
-			for _, p := range policies {
-				if p == AWSIoTPolicyMOS {
-					found = true
-					break
-				}
-			}
-			if !found {
-				ourutil.Reportf("Creating policy %q (%s)...", AWSIoTPolicy, awsIoTPolicyMOSDocument)
-				_, err := iotSvc.CreatePolicy(&iot.CreatePolicyInput{
-					PolicyName:     aws.String(AWSIoTPolicy),
-					PolicyDocument: aws.String(awsIoTPolicyMOSDocument),
-				})
-				if err != nil {
-					return nil, nil, errors.Annotatef(err, "failed to create policy")
-				}
-			}
 		}
 		ourutil.Reportf("Attaching policy %q to the certificate...", policy)
 		_, err := iotSvc.AttachPrincipalPolicy(&iot.AttachPrincipalPolicyInput{
@@ -334,6 +347,57 @@ func askForCreds() (*credentials.Credentials, error) {
 	return StoreCreds(ak, sak)
 }
 
+// ensureMOSPolicy creates the default policy if it does not exist yet.
+func ensureMOSPolicy(iotSvc *iot.IoT, region, keyID, key string) error {
+	mosPolicyLock.Lock()
+	defer mosPolicyLock.Unlock()
+	if mosPolicyReady {
+		return nil
+	}
+	policies, err := GetAWSIoTPolicyNames(region, keyID, key)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	found := false
+	for _, p := range policies {
+		if p == AWSIoTPolicyMOS {
+			found = true
+			break
+		}
+	}
+	if !found {
+		ourutil.Reportf("Creating policy %q (%s)...", AWSIoTPolicy, awsIoTPolicyMOSDocument)
+		_, err := iotSvc.CreatePolicy(&iot.CreatePolicyInput{
+			PolicyName:     aws.String(AWSIoTPolicy),
+			PolicyDocument: aws.String(awsIoTPolicyMOSDocument),
+		})
+		if err != nil {
+			return errors.Annotatef(err, "failed to create policy")
+		}
+	}
+	mosPolicyReady = true
+	return nil
+}
+
+// getMQTTServer returns the ATS data endpoint, it is only looked up once.
+func getMQTTServer(iotSvc *iot.IoT) (string, error) {
+	mqttServerLock.Lock()
+	defer mqttServerLock.Unlock()
+	if s, ok := mqttServerCache[iotSvc]; ok {
+		return s, nil
+	}
+	atsEPT := "iot:Data-ATS"
+	de, err := iotSvc.DescribeEndpoint(&iot.DescribeEndpointInput{
+		EndpointType: &atsEPT,
+	})
+	if err != nil {
+		return "", errors.Annotatef(err, "aws iot describe-endpoint failed!")
+	}
+	s := fmt.Sprintf("%s:8883", *de.EndpointAddress)
+	mqttServerCache[iotSvc] = s
+	return s, nil
+}
+
 func AWSIoTSetupFull(ctx context.Context, devConn dev.DevConn, region, policy, thing, keyID, key string) error {
 	iotSvc, err := getSvc(region, keyID, key)
 	if err != nil {
@@ -374,8 +438,9 @@ func AWSIoTSetupFull(ctx context.Context, devConn dev.DevConn, region, policy, t
 		certCN = devID
 	}
 
-	if thing == "" {
-		awsIoTThing = certCN
+	thingName := thing
+	if thingName == "" {
+		thingName = certCN
 	}
 
 	certType, useATCA, err := x509utils.PickCertType(devInfo)
@@ -386,7 +451,7 @@ func AWSIoTSetupFull(ctx context.Context, devConn dev.DevConn, region, policy, t
 	_, certPEMBytes, _, _, keyPEMBytes, err := x509utils.LoadCertAndKey(awsCertFile, awsKeyFile)
 
 	if certPEMBytes == nil {
-		certPEMBytes, keyPEMBytes, err = genCert(ctx, certType, useATCA, iotSvc, devConn, devConf, devInfo, certCN, awsIoTThing, region, policy, keyID, key)
+		certPEMBytes, keyPEMBytes, err = genCert(ctx, certType, useATCA, iotSvc, devConn, devConf, devInfo, certCN, thingName, region, policy, keyID, key)
 		if err != nil {
 			return errors.Annotatef(err, "failed to generate certificate")
 		}
@@ -441,14 +506,11 @@ func AWSIoTSetupFull(ctx context.Context, devConn dev.DevConn, region, policy, t
 
 	if awsMQTTServer == "" {
 		// Get the value of mqtt.server from aws
-		atsEPT := "iot:Data-ATS"
-		de, err := iotSvc.DescribeEndpoint(&iot.DescribeEndpointInput{
-			EndpointType: &atsEPT,
-		})
+		mqttServer, err := getMQTTServer(iotSvc)
 		if err != nil {
-			return errors.Annotatef(err, "aws iot describe-endpoint failed!")
+			return errors.Trace(err)
 		}
-		settings["mqtt.server"] = fmt.Sprintf("%s:8883", *de.EndpointAddress)
+		settings["mqtt.server"] = mqttServer
 	} else {
 		settings["mqtt.server"] = awsMQTTServer
 	}
@@ -24,6 +24,7 @@ import (
 	"encoding/json"
 	"fmt"
 	"strings"
+	"sync"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/atca"
@@ -66,7 +67,13 @@ type azureIoTHubInfo struct {
 	} `json:"properties"`
 }
 
-func AzureIoTSetup(ctx context.Context, devConn dev.DevConn) error {
+// Hub checks are performed once and shared by devices provisioned in the same run (see fleet.Provision).
+var (
+	hubOnce sync.Once
+	hubErr  error
+)
+
+func prepareHub() error {
 	// Perform Azure CLI sanity checks
 	if !azureIoTSkipCLICheck {
 		// Make sure that Azure CLI is installed and logged in.
@@ -120,6 +127,14 @@ func AzureIoTSetup(ctx context.Context, devConn dev.DevConn) error {
 	}
 
 	ourutil.Reportf("Using IoT hub %s (%s)", azureIoTHubName, azureIoTHubHostName)
+	return nil
+}
+
+func AzureIoTSetup(ctx context.Context, devConn dev.DevConn) error {
+	hubOnce.Do(func() { hubErr = prepareHub() })
+	if hubErr != nil {
+		return errors.Trace(hubErr)
+	}
 
 	ourutil.Reportf("Connecting to the device...")
 	devInfo, err := dev.GetInfo(ctx, devConn)
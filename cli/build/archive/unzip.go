@@ -22,25 +22,75 @@ import (
 	"io/ioutil"
 	"os"
 	"path/filepath"
+	"runtime"
 	"strings"
 
 	"github.com/juju/errors"
 )
 
-// UnzipInto unpacks a zipped stream into a directory skipping skipLevels top level directories
+// UnzipInto unpacks a zipped stream into a directory skipping skipLevels top level directories.
+// Files are decompressed in parallel, input must support concurrent ReadAt calls
+// (os.File and bytes.Reader do).
 func UnzipInto(input io.ReaderAt, size int64, dir string, skipLevels int) error {
 	zipReader, err := zip.NewReader(input, size)
 	if err != nil {
 		return errors.Trace(err)
 	}
 
+	// Create directories first, so their modes are not affected by files being created.
+	var files []*zip.File
 	for _, f := range zipReader.File {
-		if err := unzipFileInto(f, dir, skipLevels); err != nil {
-			return errors.Trace(err)
+		if f.FileInfo().IsDir() {
+			if err := unzipFileInto(f, dir, skipLevels); err != nil {
+				return errors.Trace(err)
+			}
+		} else {
+			files = append(files, f)
 		}
 	}
 
-	return nil
+	numWorkers := runtime.NumCPU()
+	if numWorkers > len(files) {
+		numWorkers = len(files)
+	}
+	fileCh := make(chan *zip.File)
+	errCh := make(chan error, numWorkers)
+	for i := 0; i < numWorkers; i++ {
+		go func() {
+			var err error
+			for f := range fileCh {
+				// Drain the channel after an error, the first error is returned.
+				if err == nil {
+					err = unzipFileInto(f, dir, skipLevels)
+				}
+			}
+			errCh <- err
+		}()
+	}
+	for _, f := range files {
+		fileCh <- f
+	}
+	close(fileCh)
+	for i := 0; i < numWorkers; i++ {
+		if e := <-errCh; e != nil && err == nil {
+			err = e
+		}
+	}
+	return errors.Trace(err)
+}
+
+// UnzipFileInto is UnzipInto for a zip file, which is read directly without loading it into memory.
+func UnzipFileInto(fname string, dir string, skipLevels int) error {
+	f, err := os.Open(fname)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	defer f.Close()
+	fi, err := f.Stat()
+	if err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(UnzipInto(f, fi.Size(), dir, skipLevels))
 }
 
 func unzipFileInto(file *zip.File, dir string, skipLevels int) error {
@@ -17,7 +17,9 @@
 package archive
 
 import (
+	"archive/zip"
 	"bytes"
+	"fmt"
 	"io/ioutil"
 	"os"
 	"path/filepath"
@@ -78,3 +80,47 @@ func TestUnzip(t *testing.T) {
 		t.Errorf("want %d files, got %d files", want, got)
 	}
 }
+
+func TestUnzipFileParallel(t *testing.T) {
+	tempDir, err := ioutil.TempDir("", "fwbuild-")
+	if err != nil {
+		t.Fatalf("cannot create temp dir: %s", err)
+	}
+	defer os.RemoveAll(tempDir)
+
+	contents := map[string]string{}
+	zipFile := filepath.Join(tempDir, "src.zip")
+	zf, err := os.Create(zipFile)
+	if err != nil {
+		t.Fatalf("cannot create zip: %s", err)
+	}
+	zw := zip.NewWriter(zf)
+	for i := 0; i < 100; i++ {
+		fn := fmt.Sprintf("src/d%d/f%d.c", i%7, i)
+		contents[fn] = strings.Repeat(fmt.Sprintf("/* file %d */\n", i), i)
+		w, err := zw.Create(fn)
+		if err != nil {
+			t.Fatalf("cannot add %s: %s", fn, err)
+		}
+		w.Write([]byte(contents[fn]))
+	}
+	zw.Close()
+	zf.Close()
+
+	outDir := filepath.Join(tempDir, "out")
+	if err := UnzipFileInto(zipFile, outDir, 0); err != nil {
+		t.Fatalf("cannot unzip: %s", err)
+	}
+	for fn, c := range contents {
+		body, err := ioutil.ReadFile(filepath.Join(outDir, fn))
+		if err != nil {
+			t.Errorf("%s: %s", fn, err)
+		} else if string(body) != c {
+			t.Errorf("contents for %q: want %q got %q", fn, c, string(body))
+		}
+	}
+
+	if err := UnzipFileInto(filepath.Join(tempDir, "nonexistent.zip"), outDir, 0); err == nil {
+		t.Errorf("expected an error for a missing file")
+	}
+}
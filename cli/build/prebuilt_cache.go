@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package build
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/common/paths"
+)
+
+// Prebuilt libs downloaded by all projects are kept in --prebuilt-libs-cache-dir:
+// the archives are stored by SHA-256 of their contents in objects/,
+// and index.json maps repo, version and platform to the hash and ETag of the archive.
+// Archives are verified against their hash every time they are used.
+
+type prebuiltCacheEntry struct {
+	SHA256  string    `json:"sha256"`
+	ETag    string    `json:"etag,omitempty"`
+	Size    int64     `json:"size"`
+	Fetched time.Time `json:"fetched"`
+}
+
+// Serializes index updates within the process. Concurrent updates by different
+// processes may lose an entry, which only means the archive will be fetched again.
+var prebuiltCacheLock sync.Mutex
+
+func prebuiltCacheKey(location, version, platform string) string {
+	return location + "@" + version + "/" + platform
+}
+
+func prebuiltCacheIndexFile() string {
+	return filepath.Join(paths.PrebuiltLibsCacheDir, "index.json")
+}
+
+func prebuiltCacheObjectFile(hash string) string {
+	return filepath.Join(paths.PrebuiltLibsCacheDir, "objects", hash[:2], hash)
+}
+
+func readPrebuiltCacheIndex() map[string]*prebuiltCacheEntry {
+	index := map[string]*prebuiltCacheEntry{}
+	if data, err := ioutil.ReadFile(prebuiltCacheIndexFile()); err == nil {
+		if err := json.Unmarshal(data, &index); err != nil {
+			glog.Warningf("invalid prebuilt libs cache index: %s", err)
+		}
+	}
+	return index
+}
+
+func writeFileAtomic(fname string, data []byte) error {
+	if err := os.MkdirAll(filepath.Dir(fname), 0755); err != nil {
+		return errors.Trace(err)
+	}
+	tmpFile := fmt.Sprintf("%s.%d.tmp", fname, os.Getpid())
+	if err := ioutil.WriteFile(tmpFile, data, 0644); err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(os.Rename(tmpFile, fname))
+}
+
+// getCachedPrebuilt returns the cache entry and the archive for the key,
+// or nil if the archive is not in the cache or fails verification.
+func getCachedPrebuilt(key string) (*prebuiltCacheEntry, []byte) {
+	if paths.PrebuiltLibsCacheDir == "" {
+		return nil, nil
+	}
+	prebuiltCacheLock.Lock()
+	e := readPrebuiltCacheIndex()[key]
+	prebuiltCacheLock.Unlock()
+	if e == nil || len(e.SHA256) < 2 {
+		return nil, nil
+	}
+	data, err := ioutil.ReadFile(prebuiltCacheObjectFile(e.SHA256))
+	if err != nil {
+		return nil, nil
+	}
+	h := sha256.Sum256(data)
+	if hex.EncodeToString(h[:]) != e.SHA256 {
+		glog.Errorf("%s: cached archive is corrupted, ignoring", key)
+		os.Remove(prebuiltCacheObjectFile(e.SHA256))
+		return nil, nil
+	}
+	return e, data
+}
+
+// putCachedPrebuilt stores the archive for the key.
+func putCachedPrebuilt(key string, data []byte, etag string) error {
+	if paths.PrebuiltLibsCacheDir == "" {
+		return nil
+	}
+	h := sha256.Sum256(data)
+	e := &prebuiltCacheEntry{
+		SHA256:  hex.EncodeToString(h[:]),
+		ETag:    etag,
+		Size:    int64(len(data)),
+		Fetched: time.Now(),
+	}
+	objFile := prebuiltCacheObjectFile(e.SHA256)
+	if _, err := os.Stat(objFile); err != nil {
+		if err := writeFileAtomic(objFile, data); err != nil {
+			return errors.Trace(err)
+		}
+	}
+	prebuiltCacheLock.Lock()
+	defer prebuiltCacheLock.Unlock()
+	index := readPrebuiltCacheIndex()
+	index[key] = e
+	indexData, err := json.MarshalIndent(index, "", "  ")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(writeFileAtomic(prebuiltCacheIndexFile(), indexData))
+}
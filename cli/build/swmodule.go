@@ -17,6 +17,7 @@
 package build
 
 import (
+	"context"
 	"encoding/hex"
 	"fmt"
 	"io"
@@ -25,6 +26,7 @@ import (
 	"os"
 	"path/filepath"
 	"regexp"
+	"runtime/trace"
 	"strings"
 	"sync"
 	"time"
@@ -210,6 +212,7 @@ func (m *SWModule) PrepareLocalDir(
 	if m.localPath != "" {
 		return m.localPath, nil
 	}
+	defer trace.StartRegion(context.Background(), "lib-fetch").End()
 
 	var err error
 	localPath, repoVersion, isDirty := "", "", false
@@ -277,29 +280,16 @@ func (m *SWModule) FetchPrebuiltBinary(platform, defaultVersion, tgt string) err
 				return errors.Annotatef(err, "%s: asset_api not specified and could not be guessed", libName)
 			}
 		}
-		var assetData []byte
-		switch assetAPIType {
-		case AssetAPIGitHub:
-			token := ""
-			if m.credentials != nil {
-				token = m.credentials.Pass
-			}
-			for i := 1; i <= 3; i++ {
-				assetData, err = fetchGitHubAsset(m.Location, repoHost, repoPath, version, assetName, token)
-				if err == nil || os.IsNotExist(errors.Cause(err)) {
-					break
-				}
-				// Sometimes asset downloads fail. GitHub doesn't like us, or rate limiting or whatever.
-				// Try a couple times.
-				glog.Errorf("GitHub asset %s download failed (attempt %d): %s", assetName, i, err)
-				time.Sleep(1 * time.Second)
-			}
-		case AssetAPIGitLab:
-			token := ""
-			if m.credentials != nil {
-				token = m.credentials.Pass
-			}
-			assetData, err = fetchGitLabAsset(repoHost, repoPath, version, assetName, token)
+		// Archives of a release version do not change, they are used from the cache as is.
+		// For "latest", we check with the server if the cached archive is still current.
+		cacheKey := prebuiltCacheKey(m.Location, version, platform)
+		cacheEntry, assetData := getCachedPrebuilt(cacheKey)
+		if assetData != nil && version == "latest" {
+			assetData, err = m.fetchAsset(assetAPIType, repoHost, repoPath, version, assetName, cacheKey, cacheEntry.ETag, assetData)
+		} else if assetData != nil {
+			glog.Infof("%s: using cached %s", libName, prebuiltCacheObjectFile(cacheEntry.SHA256))
+		} else {
+			assetData, err = m.fetchAsset(assetAPIType, repoHost, repoPath, version, assetName, cacheKey, "", nil)
 		}
 		if err != nil {
 			return errors.Annotatef(err, "%s: failed to download %s asset %s", libName, assetAPIType, assetName)
@@ -319,6 +309,44 @@ func (m *SWModule) FetchPrebuiltBinary(platform, defaultVersion, tgt string) err
 	return errors.Errorf("unable to fetch prebuilt binary for %q", name)
 }
 
+// fetchAsset downloads the asset and stores it in the prebuilt libs cache.
+// If etag is not empty and matches the current version of the asset, cachedData is returned.
+func (m *SWModule) fetchAsset(assetAPIType SWModuleAssetAPIType, repoHost, repoPath, version, assetName, cacheKey, etag string, cachedData []byte) ([]byte, error) {
+	token := ""
+	if m.credentials != nil {
+		token = m.credentials.Pass
+	}
+	var assetData []byte
+	var newETag string
+	var err error
+	switch assetAPIType {
+	case AssetAPIGitHub:
+		for i := 1; i <= 3; i++ {
+			assetData, newETag, err = fetchGitHubAsset(m.Location, repoHost, repoPath, version, assetName, token, etag)
+			if err == nil || os.IsNotExist(errors.Cause(err)) || errors.Cause(err) == errAssetNotModified {
+				break
+			}
+			// Sometimes asset downloads fail. GitHub doesn't like us, or rate limiting or whatever.
+			// Try a couple times.
+			glog.Errorf("GitHub asset %s download failed (attempt %d): %s", assetName, i, err)
+			time.Sleep(time.Duration(i) * time.Second)
+		}
+	case AssetAPIGitLab:
+		assetData, newETag, err = fetchGitLabAsset(repoHost, repoPath, version, assetName, token, etag)
+	}
+	if errors.Cause(err) == errAssetNotModified {
+		glog.Infof("%s has not changed", assetName)
+		return cachedData, nil
+	}
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if err := putCachedPrebuilt(cacheKey, assetData, newETag); err != nil {
+		glog.Warningf("failed to cache %s: %s", assetName, err)
+	}
+	return assetData, nil
+}
+
 func (m *SWModule) GetVersion(defaultVersion string) string {
 	version := m.Version
 	if version == "" {
@@ -526,7 +554,8 @@ func prepareLocalCopyGitLocked(
 	pullInterval time.Duration, cloneDepth int,
 	creds *Credentials,
 ) (string, bool, error) {
-	gitinst := mosgit.NewOurGit(BuildCredsToGitCreds(creds))
+	gitCreds := BuildCredsToGitCreds(creds)
+	gitinst := mosgit.NewOurGit(gitCreds)
 	// version is already converted from "" or "latest" to "master" here.
 
 	// Check if we should clone or pull git repo inside of targetDir.
@@ -572,10 +601,19 @@ func prepareLocalCopyGitLocked(
 	if cloneDepth > 0 {
 		cloneOpts.Ref = version
 	}
+	clone := func() error {
+		// Full clones borrow objects from the shared mirror of the repo.
+		if cloneDepth == 0 {
+			cloneOpts.ReferenceDir = mosgit.PrepareMirror(gitinst, gitCreds, origin)
+		}
+		release := mosgit.AcquireHost(origin)
+		defer release()
+		return gitinst.Clone(origin, targetDir, cloneOpts)
+	}
 
 	if !repoExists {
 		freportf(logWriter, "%s: Does not exist, cloning from %q...", name, origin)
-		err := gitinst.Clone(origin, targetDir, cloneOpts)
+		err := clone()
 		if err != nil {
 			return "", false, errors.Trace(err)
 		}
@@ -600,7 +638,7 @@ func prepareLocalCopyGitLocked(
 				if err = os.RemoveAll(targetDir); err != nil {
 					return "", false, errors.Annotatef(err, "%s: failed to delete %q", name, targetDir)
 				}
-				err := gitinst.Clone(origin, targetDir, cloneOpts)
+				err := clone()
 				if err != nil {
 					return "", false, errors.Trace(err)
 				}
@@ -661,7 +699,9 @@ func prepareLocalCopyGitLocked(
 	// If the desired mongoose-os version isn't a known branch, do git fetch
 	if !looksLikeSHA && !branchExists && !tagExists {
 		glog.V(2).Infof("%s: %s is neither a branch nor a tag, fetching...", name, version)
+		release := mosgit.AcquireHost(origin)
 		err = gitinst.Fetch(targetDir, version, ourgit.FetchOptions{Depth: 1})
+		release()
 		if err != nil {
 			return "", false, errors.Trace(err)
 		}
@@ -728,7 +768,9 @@ func prepareLocalCopyGitLocked(
 
 		if wantPull {
 			freportf(logWriter, "%s: Pulling...", name)
+			release := mosgit.AcquireHost(origin)
 			err = gitinst.Pull(targetDir, version)
+			release()
 			if err != nil {
 				return "", false, errors.Trace(err)
 			}
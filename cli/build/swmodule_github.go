@@ -30,16 +30,16 @@ import (
 	"github.com/mongoose-os/mos/cli/ourutil"
 )
 
-func fetchGitHubAsset(loc, host, repoPath, tag, assetName, token string) ([]byte, error) {
+func fetchGitHubAsset(loc, host, repoPath, tag, assetName, token, etag string) ([]byte, string, error) {
 	var apiURLPrefix string
 	if host == "github.com" {
 		// Try public URL first. Most of our repos (and therefore assets) are public.
 		// API access limits do not apply to public asset access.
 		if strings.HasPrefix(loc, "https://") {
 			assetURL := fmt.Sprintf("https://github.com/%s/releases/download/%s/%s", repoPath, tag, assetName)
-			data, err := fetchAssetFromURL(host, assetName, tag, assetURL, token)
-			if err == nil {
-				return data, nil
+			data, newETag, err := fetchAssetFromURL(host, assetName, tag, assetURL, token, etag)
+			if err == nil || errors.Cause(err) == errAssetNotModified {
+				return data, newETag, err
 			}
 		}
 		apiURLPrefix = "https://api.github.com"
@@ -54,16 +54,16 @@ func fetchGitHubAsset(loc, host, repoPath, tag, assetName, token string) ([]byte
 	}
 	resp, err := client.Do(req)
 	if err != nil {
-		return nil, errors.Annotatef(err, "failed to fetch %s", relMetaURL)
+		return nil, "", errors.Annotatef(err, "failed to fetch %s", relMetaURL)
 	}
 	defer resp.Body.Close()
 	assetURL := ""
 	if resp.StatusCode != http.StatusOK {
-		return nil, errors.Errorf("got %d status code when fetching %s (note: private repos may need --credentials)", resp.StatusCode, relMetaURL)
+		return nil, "", errors.Errorf("got %d status code when fetching %s (note: private repos may need --credentials)", resp.StatusCode, relMetaURL)
 	}
 	relMetaData, err := ioutil.ReadAll(resp.Body)
 	if err != nil {
-		return nil, errors.Trace(err)
+		return nil, "", errors.Trace(err)
 	}
 	glog.V(4).Infof("%s/%s/%s: Release metadata: %s", repoPath, tag, assetName, string(relMetaData))
 	var relMeta struct {
@@ -74,7 +74,7 @@ func fetchGitHubAsset(loc, host, repoPath, tag, assetName, token string) ([]byte
 		} `json:"assets"`
 	}
 	if err = json.Unmarshal(relMetaData, &relMeta); err != nil {
-		return nil, errors.Annotatef(err, "failed to parse GitHub release info")
+		return nil, "", errors.Annotatef(err, "failed to parse GitHub release info")
 	}
 	for _, a := range relMeta.Assets {
 		if a.Name == assetName {
@@ -83,13 +83,19 @@ func fetchGitHubAsset(loc, host, repoPath, tag, assetName, token string) ([]byte
 		}
 	}
 	if assetURL == "" {
-		return nil, errors.Annotatef(os.ErrNotExist, "%s: no asset %s found in release %s", repoPath, assetName, tag)
+		return nil, "", errors.Annotatef(os.ErrNotExist, "%s: no asset %s found in release %s", repoPath, assetName, tag)
 	}
 	glog.Infof("%s/%s/%s: Asset URL: %s", repoPath, tag, assetName, assetURL)
-	return fetchAssetFromURL(host, assetName, tag, assetURL, token)
+	return fetchAssetFromURL(host, assetName, tag, assetURL, token, etag)
 }
 
-func fetchAssetFromURL(host, assetName, tag, assetURL, token string) ([]byte, error) {
+// errAssetNotModified is returned by fetchAssetFromURL if the asset still has the given ETag.
+var errAssetNotModified = errors.New("asset not modified")
+
+// fetchAssetFromURL fetches the asset and returns its data and ETag.
+// If etag is not empty, the request is conditional and errAssetNotModified is returned
+// if the asset has not changed.
+func fetchAssetFromURL(host, assetName, tag, assetURL, token, etag string) ([]byte, string, error) {
 	ourutil.Reportf("Fetching %s (%s) from %s...", assetName, tag, assetURL)
 
 	client := &http.Client{}
@@ -99,18 +105,24 @@ func fetchAssetFromURL(host, assetName, tag, assetURL, token string) ([]byte, er
 		req.Header.Add("Authorization", fmt.Sprintf("token %s", token)) // GitHub
 		req.Header.Add("PRIVATE-TOKEN", token)                          // GitLab
 	}
+	if etag != "" {
+		req.Header.Add("If-None-Match", etag)
+	}
 	resp, err := client.Do(req)
 	if err != nil {
-		return nil, errors.Annotatef(err, "failed to fetch %s", assetURL)
+		return nil, "", errors.Annotatef(err, "failed to fetch %s", assetURL)
 	}
 	defer resp.Body.Close()
+	if resp.StatusCode == http.StatusNotModified && etag != "" {
+		return nil, etag, errAssetNotModified
+	}
 	if resp.StatusCode != http.StatusOK {
-		return nil, errors.Errorf("got %d status code when fetching %s", resp.StatusCode, assetURL)
+		return nil, "", errors.Errorf("got %d status code when fetching %s", resp.StatusCode, assetURL)
 	}
 	// Fetched the asset successfully
 	data, err := ioutil.ReadAll(resp.Body)
 	if err != nil {
-		return nil, errors.Trace(err)
+		return nil, "", errors.Trace(err)
 	}
-	return data, nil
+	return data, resp.Header.Get("ETag"), nil
 }
@@ -32,7 +32,7 @@ import (
 
 var mdLinkRegex = regexp.MustCompile(`\[([^\]]+)\]\(([^\)]+)\)`)
 
-func fetchGitLabAsset(host, repoPath, tag, assetName, token string) ([]byte, error) {
+func fetchGitLabAsset(host, repoPath, tag, assetName, token, etag string) ([]byte, string, error) {
 	apiURLPrefix := fmt.Sprintf("https://%s/api/v4/projects/%s", host, url.QueryEscape(repoPath))
 	relMetaURL := fmt.Sprintf("%s/releases/%s", apiURLPrefix, tag)
 	client := &http.Client{}
@@ -42,15 +42,15 @@ func fetchGitLabAsset(host, repoPath, tag, assetName, token string) ([]byte, err
 	}
 	resp, err := client.Do(req)
 	if err != nil {
-		return nil, errors.Annotatef(err, "failed to fetch %s", relMetaURL)
+		return nil, "", errors.Annotatef(err, "failed to fetch %s", relMetaURL)
 	}
 	defer resp.Body.Close()
 	if resp.StatusCode != http.StatusOK {
-		return nil, errors.Errorf("got %d status code when fetching %s (note: private repos may need --credentials)", resp.StatusCode, relMetaURL)
+		return nil, "", errors.Errorf("got %d status code when fetching %s (note: private repos may need --credentials)", resp.StatusCode, relMetaURL)
 	}
 	relMetaData, err := ioutil.ReadAll(resp.Body)
 	if err != nil {
-		return nil, errors.Trace(err)
+		return nil, "", errors.Trace(err)
 	}
 	glog.V(4).Infof("%s/%s/%s: Release metadata: %s", repoPath, tag, assetName, string(relMetaData))
 
@@ -67,7 +67,7 @@ func fetchGitLabAsset(host, repoPath, tag, assetName, token string) ([]byte, err
 		} `json:"assets"`
 	}
 	if err = json.Unmarshal(relMetaData, &relMeta); err != nil {
-		return nil, errors.Annotatef(err, "failed to parse GitLab release info")
+		return nil, "", errors.Annotatef(err, "failed to parse GitLab release info")
 	}
 
 	// GitLab releases are kind of a mess. There is no way to attach binary assets directly,
@@ -96,7 +96,7 @@ func fetchGitLabAsset(host, repoPath, tag, assetName, token string) ([]byte, err
 	}
 
 	if assetURL == "" {
-		return nil, errors.Annotatef(os.ErrNotExist, "%s: no asset %s found in release %s", repoPath, assetName, tag)
+		return nil, "", errors.Annotatef(os.ErrNotExist, "%s: no asset %s found in release %s", repoPath, assetName, tag)
 	}
 
 	if strings.HasPrefix(assetURL, "/") {
@@ -107,5 +107,5 @@ func fetchGitLabAsset(host, repoPath, tag, assetName, token string) ([]byte, err
 
 	// Probably won't work due to https://gitlab.com/gitlab-org/gitlab/-/issues/24155
 	// but hey, give it a go.
-	return fetchAssetFromURL(host, assetName, tag, assetURL, token)
+	return fetchAssetFromURL(host, assetName, tag, assetURL, token, etag)
 }
@@ -18,6 +18,8 @@ package main
 
 import (
 	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
 	"fmt"
 	"io"
 	"io/ioutil"
@@ -27,6 +29,7 @@ import (
 	"os/signal"
 	"path/filepath"
 	"runtime"
+	"runtime/trace"
 	"sort"
 	"strings"
 	"syscall"
@@ -37,6 +40,7 @@ import (
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/build"
 	moscommon "github.com/mongoose-os/mos/cli/common"
+	"github.com/mongoose-os/mos/cli/common/paths"
 	"github.com/mongoose-os/mos/cli/flags"
 	"github.com/mongoose-os/mos/cli/interpreter"
 	"github.com/mongoose-os/mos/cli/manifest_parser"
@@ -134,25 +138,48 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 		return errors.Trace(err)
 	}
 
+	var manifestCache *manifest_parser.ManifestCache
+	if !*flags.NoManifestCache {
+		manifestCache = &manifest_parser.ManifestCache{
+			File: moscommon.GetManifestCacheFilePath(buildDirAbs),
+			Key: fmt.Sprintf("%v %v %s",
+				bParams.CustomLibLocations, paths.LibsDirFlag, paths.GetDepsDir(appDir)),
+			MaxAge: bParams.LibsUpdateInterval,
+			RestoreLib: func(m *build.SWModule) {
+				m.SetCredentials(bParams.GetCredentialsForHost(m.GetHostName()))
+			},
+		}
+	}
+
 	manifest, fp, err := manifest_parser.ReadManifestFinal(
 		appDir, &bParams.ManifestAdjustments, logWriter, interp,
-		&manifest_parser.ReadManifestCallbacks{ComponentProvider: &compProvider},
+		&manifest_parser.ReadManifestCallbacks{ComponentProvider: &compProvider, Cache: manifestCache},
 		true /* requireArch */, bParams.PreferPrebuiltLibs, bParams.LibsUpdateInterval)
 	if err != nil {
 		return errors.Annotatef(err, "error parsing manifest")
 	}
 
-	// Write final manifest to build dir
-	manifestUpdated, err := ourio.WriteYAMLFileIfDifferent(moscommon.GetMosFinalFilePath(buildDirAbs), manifest, 0666)
+	// Compare with the state of the previous build. Changes that make can not track
+	// (flags, defines, etc.) require a clean rebuild, others are handled incrementally.
+	// The new state is saved once the build succeeds.
+	finalManifestFile := moscommon.GetMosFinalFilePath(buildDirAbs)
+	buildStateFile := moscommon.GetBuildStateFilePath(buildDirAbs)
+	newBuildState, changedSections, needClean, err := checkBuildState(buildStateFile, finalManifestFile, manifest)
 	if err != nil {
 		return errors.Trace(err)
 	}
-	// Force clean rebuild if manifest was updated
-	if manifestUpdated && !bParams.Clean {
-		freportf(logWriter, "== Manifest has changed, forcing a clean rebuild...")
+	if needClean && !bParams.Clean {
+		freportf(logWriter, "== Manifest has changed (%s), forcing a clean rebuild...", strings.Join(changedSections, ", "))
 		bParams2 := *bParams
 		bParams2.Clean = true
 		return buildLocal2(ctx, &bParams2)
+	} else if len(changedSections) > 0 {
+		freportf(logWriter, "== Manifest has changed (%s)", strings.Join(changedSections, ", "))
+	}
+
+	// Write final manifest to build dir
+	if _, err := ourio.WriteYAMLFileIfDifferent(finalManifestFile, manifest, 0666); err != nil {
+		return errors.Trace(err)
 	}
 
 	switch manifest.Type {
@@ -341,6 +368,12 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 			// path references continue to work (e.g. Git submodules are known to use
 			// abs. paths).
 			mp.addMountPoint(appMountPath, dockerAppPath)
+			if *flags.CompileCacheDir != "" {
+				// Build at the original path, so that paths relative to the app are the same
+				// for the sources and the working dir, and cache entries can be shared.
+				dockerAppPath = ourutil.GetPathForDocker(appMountPath)
+				mp.addMountPoint(appMountPath, dockerAppPath)
+			}
 			mp.addMountPoint(fp.MosDirEffective, dockerMgosPath)
 			mp.addMountPoint(fp.MosDirEffective, ourutil.GetPathForDocker(fp.MosDirEffective))
 
@@ -422,7 +455,20 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 
 		manifest.BuildVars["MGOS_PATH"] = dockerMgosPath
 
-		dockerRunArgs = append(dockerRunArgs, buildImage)
+		compileCacheDir, err := getCompileCacheDir(buildImage)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		compileCachePrelude := ""
+		if compileCacheDir != "" {
+			hostCacheDir := compileCacheDir
+			if isInDockerToolbox() {
+				hostCacheDir = ourutil.GetPathForDocker(hostCacheDir)
+			}
+			dockerRunArgs = append(dockerRunArgs,
+				"-v", fmt.Sprintf("%s:%s", hostCacheDir, ourutil.GetPathForDocker(compileCacheDir)))
+			compileCachePrelude = getCompileCacheShellPrelude(compileCacheDir, dockerAppPath)
+		}
 
 		makeArgs, err := getMakeArgs(
 			filepath.ToSlash(fmt.Sprintf("%s%s", dockerAppPath, appSubdir)),
@@ -436,11 +482,9 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 			return errors.Trace(err)
 		}
 
-		dockerRunArgs = append(dockerRunArgs,
-			"/bin/bash", "-c", "nice make '"+strings.Join(makeArgs, "' '")+"'",
-		)
+		shellCmd := compileCachePrelude + "nice make '" + strings.Join(makeArgs, "' '") + "'"
 
-		if err := runDockerBuild(dockerRunArgs, bParams.DryRun); err != nil {
+		if err := runDockerBuild(dockerRunArgs, buildImage, shellCmd, bParams.DryRun); err != nil {
 			return errors.Trace(err)
 		}
 		if bParams.DryRun {
@@ -469,7 +513,20 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 			return nil
 		}
 
+		sdkRevision := os.Getenv("MGOS_SDK_REVISION")
+		if sdkRevision == "" {
+			sdkRevision = os.Getenv("MIOT_SDK_REVISION")
+		}
+		compileCacheDir, err := getCompileCacheDir(sdkRevision)
+		if err != nil {
+			return errors.Trace(err)
+		}
+
 		cmd := exec.Command("make", makeArgs...)
+		if compileCacheDir != "" {
+			cmd = exec.Command("/bin/bash", "-c",
+				getCompileCacheShellPrelude(compileCacheDir, appPath)+"make '"+strings.Join(makeArgs, "' '")+"'")
+		}
 		err = runCmd(cmd, logWriter)
 		if err != nil {
 			return errors.Trace(err)
@@ -499,6 +556,10 @@ func buildLocal2(ctx context.Context, bParams *build.BuildParams) (err error) {
 		}
 	}
 
+	if err := saveBuildState(buildStateFile, newBuildState); err != nil {
+		return errors.Trace(err)
+	}
+
 	return nil
 }
 
@@ -629,14 +690,24 @@ func getPathsForDocker(p []string) []string {
 	return ret
 }
 
-func runDockerBuild(dockerRunArgs []string, dryRun bool) error {
-	containerName := fmt.Sprintf(
-		"mos_build_%s_%d", time.Now().Format("2006-01-02T15-04-05-00"), rand.Int(),
-	)
-
-	dockerArgs := append(
-		[]string{"run", "--name", containerName}, dockerRunArgs...,
-	)
+func runDockerBuild(dockerRunArgs []string, image, shellCmd string, dryRun bool) error {
+	defer trace.StartRegion(context.Background(), "docker-run").End()
+	var containerName string
+	var dockerArgs []string
+	if *flags.BuildDockerReuse {
+		var err error
+		containerName, err = getBuildContainer(dockerRunArgs, image, dryRun)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		dockerArgs = []string{"exec", "-i", containerName, "/bin/bash", "-c", shellCmd}
+	} else {
+		containerName = fmt.Sprintf(
+			"mos_build_%s_%d", time.Now().Format("2006-01-02T15-04-05-00"), rand.Int(),
+		)
+		dockerArgs = append([]string{"run", "--name", containerName}, dockerRunArgs...)
+		dockerArgs = append(dockerArgs, image, "/bin/bash", "-c", shellCmd)
+	}
 
 	freportf(logWriter, "Docker arguments: %s", strings.Join(dockerArgs, " "))
 
@@ -682,6 +753,65 @@ func runDockerBuild(dockerRunArgs []string, dryRun bool) error {
 	return nil
 }
 
+// getBuildContainer returns name of a running container started with the given args,
+// starting one if necessary. Containers are identified by a hash of the args and
+// the image ID, so builds with the same image and mounts share a container.
+func getBuildContainer(dockerRunArgs []string, image string, dryRun bool) (string, error) {
+	var runArgs []string
+	for _, a := range dockerRunArgs {
+		// The container outlives the build and is not attached.
+		if a != "--rm" && a != "-i" {
+			runArgs = append(runArgs, a)
+		}
+	}
+	imageID, err := getDockerImageID(image, dryRun)
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	h := sha256.Sum256([]byte(strings.Join(append(runArgs, image, imageID), "\x00")))
+	containerName := fmt.Sprintf("mos_build_%s", hex.EncodeToString(h[:8]))
+
+	out, err := exec.Command("docker", "inspect", "-f", "{{.State.Running}}", containerName).Output()
+	if err == nil && strings.TrimSpace(string(out)) == "true" {
+		glog.V(1).Infof("Reusing build container %s", containerName)
+		return containerName, nil
+	}
+
+	dockerArgs := append([]string{"run", "-d", "--name", containerName}, runArgs...)
+	dockerArgs = append(dockerArgs, image, "/bin/bash", "-c", "while sleep 3600; do :; done")
+	freportf(logWriter, "Docker arguments: %s", strings.Join(dockerArgs, " "))
+	if dryRun {
+		return containerName, nil
+	}
+	// Remove a stopped container left from before, if any.
+	exec.Command("docker", "rm", "-f", containerName).Run()
+	if err := runCmd(exec.Command("docker", dockerArgs...), logWriter); err != nil {
+		return "", errors.Annotatef(err, "failed to start build container")
+	}
+	return containerName, nil
+}
+
+// getDockerImageID returns ID of the given image, pulling the image if it's
+// not present locally (unless dryRun is set, in which case an empty ID is returned).
+func getDockerImageID(image string, dryRun bool) (string, error) {
+	inspect := func() (string, error) {
+		out, err := exec.Command("docker", "image", "inspect", "-f", "{{.Id}}", image).Output()
+		return strings.TrimSpace(string(out)), err
+	}
+	id, err := inspect()
+	if err == nil || dryRun {
+		return id, nil
+	}
+	if err := runCmd(exec.Command("docker", "pull", image), logWriter); err != nil {
+		return "", errors.Annotatef(err, "failed to pull %s", image)
+	}
+	id, err = inspect()
+	if err != nil {
+		return "", errors.Annotatef(err, "failed to get ID of %s", image)
+	}
+	return id, nil
+}
+
 // runCmd runs given command and redirects its output to the given log file.
 // if --verbose flag is set, then the output also goes to the stdout.
 func runCmd(cmd *exec.Cmd, logWriter io.Writer) error {
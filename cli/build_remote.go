@@ -19,6 +19,9 @@ package main
 import (
 	"archive/zip"
 	"bytes"
+	"crypto/md5"
+	"encoding/hex"
+	"encoding/json"
 	"fmt"
 	"io"
 	"io/ioutil"
@@ -26,6 +29,7 @@ import (
 	"net/http"
 	"os"
 	"path/filepath"
+	"sort"
 	"strings"
 
 	"github.com/juju/errors"
@@ -236,28 +240,128 @@ func buildRemote(bParams *build.BuildParams) error {
 		whitelist[ourfilepath.GetFirstPathComponent(v)] = true
 	}
 
-	transformers := make(map[string]fileTransformer)
+	fileList, err := getSourceFileList(appStagingDir, whitelist)
+	if err != nil {
+		return errors.Trace(err)
+	}
 
-	// create a zip out of the code dir
-	os.Chdir(appStagingDir)
-	src, err := zipUp(bParams, ".", whitelist, transformers)
+	buildCtxName := ""
+	if data, err := ioutil.ReadFile(moscommon.GetBuildCtxFilePath(buildDir)); err == nil && !bParams.Clean {
+		buildCtxName = string(data)
+	}
+
+	server, err := serverURL()
 	if err != nil {
 		return errors.Trace(err)
 	}
-	os.Chdir(appDir)
 
-	// prepare multipart body
-	body := &bytes.Buffer{}
-	mpw := multipart.NewWriter(body)
-	part, err := mpw.CreateFormFile(moscommon.FormSourcesZipName, "source.zip")
+	buildUser := "test"
+	buildPass := "test"
+	freportf(logWriterStderr, "Connecting to %s, user %s", server, buildUser)
+
+	// invoke the fwbuild API (replace "master" with "latest")
+	fwbuildVersion := version.GetMosVersion()
+
+	if fwbuildVersion == "master" {
+		fwbuildVersion = "latest"
+	}
+
+	apiURI := fmt.Sprintf("%s/api/fwbuild/%s", server, fwbuildVersion)
+
+	// Ask the remote builder which files it already has in the build context
+	// and upload only the rest. Older builders do not support that, send them a zip.
+	var body io.Reader
+	var contentType string
+	missing, err := getMissingFiles(apiURI, buildUser, buildPass, &moscommon.MissingFilesRequest{
+		App:      manifest.Name,
+		Platform: manifest.Platform,
+		BuildCtx: buildCtxName,
+	}, fileList)
+	if err == nil {
+		// Manifest is needed by the builder before it looks into the build context.
+		missing[fileList[moscommon.GetManifestFilePath("")]] = true
+		uploadFiles, uploadSize := map[string]string{}, int64(0)
+		for p, hash := range fileList {
+			if missing[hash] && uploadFiles[hash] == "" {
+				uploadFiles[hash] = filepath.Join(appStagingDir, filepath.FromSlash(p))
+				if fi, err := os.Stat(uploadFiles[hash]); err == nil {
+					uploadSize += fi.Size()
+				}
+			}
+		}
+		pr, pw := io.Pipe()
+		mpw := multipart.NewWriter(pw)
+		go func() {
+			pw.CloseWithError(writeIncrementalSources(mpw, bParams, buildDir, fileList, uploadFiles))
+		}()
+		body, contentType = pr, mpw.FormDataContentType()
+		freportf(logWriterStderr, "Uploading sources (%d of %d files, %d bytes)", len(uploadFiles), len(fileList), uploadSize)
+	} else {
+		glog.Infof("Incremental upload is not available: %s", err)
+		// create a zip out of the code dir, it is compressed as the request is sent
+		pr, pw := io.Pipe()
+		mpw := multipart.NewWriter(pw)
+		go func() {
+			pw.CloseWithError(writeZippedSources(mpw, bParams, buildDir, appStagingDir, whitelist))
+		}()
+		body, contentType = pr, mpw.FormDataContentType()
+		freportf(logWriterStderr, "Uploading sources (%d files)", len(fileList))
+	}
+
+	req, err := http.NewRequest("POST", apiURI+"/build", body)
 	if err != nil {
 		return errors.Trace(err)
 	}
+	req.Header.Set("Content-Type", contentType)
+	req.Header.Add("User-Agent", version.GetUserAgent())
+	req.SetBasicAuth(buildUser, buildPass)
 
-	if _, err := part.Write(src); err != nil {
+	client := &http.Client{}
+	resp, err := client.Do(req)
+	if err != nil {
 		return errors.Trace(err)
 	}
 
+	// handle response
+	respBody := &bytes.Buffer{}
+	respBody.ReadFrom(resp.Body)
+	resp.Body.Close()
+
+	switch resp.StatusCode {
+	case http.StatusOK, http.StatusTeapot:
+		// Build either succeeded or failed
+
+		// unzip build results
+		r := bytes.NewReader(respBody.Bytes())
+		if err = archive.UnzipInto(r, r.Size(), buildDir, 1 /* skipLevels */); err != nil {
+			return errors.Annotatef(err, "failed to unzip build results")
+		}
+
+		// Save local log
+		ioutil.WriteFile(moscommon.GetBuildLogLocalFilePath(buildDir), logBuf.Bytes(), 0666)
+
+		// print log in verbose mode or when build fails
+		if bParams.Verbose || resp.StatusCode != http.StatusOK {
+			log, err := os.Open(moscommon.GetBuildLogFilePath(buildDir))
+			if err != nil {
+				return errors.Trace(err)
+			}
+			io.Copy(os.Stdout, log)
+		}
+
+		if resp.StatusCode != http.StatusOK {
+			return errors.Errorf("build failed")
+		}
+		return nil
+
+	default:
+		// Unexpected response
+		return errors.Errorf("error response: %d: %s", resp.StatusCode, strings.TrimSpace(respBody.String()))
+	}
+}
+
+// writeBuildFormFields writes build parameters and the state of the previous build.
+func writeBuildFormFields(mpw *multipart.Writer, bParams *build.BuildParams, buildDir string) error {
 	if bParams.Clean {
 		if err := mpw.WriteField(moscommon.FormCleanName, "1"); err != nil {
 			return errors.Trace(err)
@@ -295,75 +399,160 @@ func buildRemote(bParams *build.BuildParams) error {
 		}
 	}
 
-	if err := mpw.Close(); err != nil {
-		return errors.Trace(err)
-	}
+	return nil
+}
 
-	server, err := serverURL()
+// getMissingFiles asks the remote builder which of the files in fileList it
+// does not have in the build context. Returns the set of missing hashes.
+func getMissingFiles(apiURI, user, pass string, mfReq *moscommon.MissingFilesRequest, fileList moscommon.SourceFileList) (map[string]bool, error) {
+	hashes := map[string]bool{}
+	for _, hash := range fileList {
+		if !hashes[hash] {
+			hashes[hash] = true
+			mfReq.Hashes = append(mfReq.Hashes, hash)
+		}
+	}
+	sort.Strings(mfReq.Hashes)
+	reqData, err := json.Marshal(mfReq)
 	if err != nil {
-		return errors.Trace(err)
+		return nil, errors.Trace(err)
 	}
-
-	buildUser := "test"
-	buildPass := "test"
-	freportf(logWriterStderr, "Connecting to %s, user %s", server, buildUser)
-
-	// invoke the fwbuild API (replace "master" with "latest")
-	fwbuildVersion := version.GetMosVersion()
-
-	if fwbuildVersion == "master" {
-		fwbuildVersion = "latest"
+	req, err := http.NewRequest("POST", fmt.Sprintf("%s/%s", apiURI, moscommon.MissingFilesAction), bytes.NewReader(reqData))
+	if err != nil {
+		return nil, errors.Trace(err)
 	}
-
-	uri := fmt.Sprintf("%s/api/fwbuild/%s/build", server, fwbuildVersion)
-
-	freportf(logWriterStderr, "Uploading sources (%d bytes)", len(body.Bytes()))
-	req, err := http.NewRequest("POST", uri, body)
-	req.Header.Set("Content-Type", mpw.FormDataContentType())
+	req.Header.Set("Content-Type", "application/json")
 	req.Header.Add("User-Agent", version.GetUserAgent())
-	req.SetBasicAuth(buildUser, buildPass)
+	req.SetBasicAuth(user, pass)
+	resp, err := http.DefaultClient.Do(req)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, errors.Errorf("error response: %d", resp.StatusCode)
+	}
+	var mfResp moscommon.MissingFilesResponse
+	if err := json.NewDecoder(resp.Body).Decode(&mfResp); err != nil {
+		return nil, errors.Annotatef(err, "invalid response")
+	}
+	missing := map[string]bool{}
+	for _, hash := range mfResp.Missing {
+		missing[hash] = true
+	}
+	return missing, nil
+}
 
-	client := &http.Client{}
-	resp, err := client.Do(req)
+// writeZippedSources writes the whitelisted files of dir as a zip file and build parameters, then closes mpw.
+func writeZippedSources(mpw *multipart.Writer, bParams *build.BuildParams, buildDir, dir string, whitelist map[string]bool) error {
+	part, err := mpw.CreateFormFile(moscommon.FormSourcesZipName, "source.zip")
 	if err != nil {
 		return errors.Trace(err)
 	}
+	if err := zipUp(bParams, dir, whitelist, map[string]fileTransformer{}, part); err != nil {
+		return errors.Trace(err)
+	}
+	if err := writeBuildFormFields(mpw, bParams, buildDir); err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(mpw.Close())
+}
 
-	// handle response
-	body.Reset()
-	body.ReadFrom(resp.Body)
-
-	switch resp.StatusCode {
-	case http.StatusOK, http.StatusTeapot:
-		// Build either succeeded or failed
+// writeIncrementalSources writes the file list, contents of the files in
+// uploadFiles (which maps hashes to local paths) and build parameters,
+// then closes mpw. Contents are streamed from disk as the request is sent.
+func writeIncrementalSources(
+	mpw *multipart.Writer, bParams *build.BuildParams, buildDir string,
+	fileList moscommon.SourceFileList, uploadFiles map[string]string,
+) error {
+	fileListData, err := json.Marshal(fileList)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := mpw.WriteField(moscommon.FormFileListName, string(fileListData)); err != nil {
+		return errors.Trace(err)
+	}
+	if err := writeBuildFormFields(mpw, bParams, buildDir); err != nil {
+		return errors.Trace(err)
+	}
+	hashes := []string{}
+	for hash := range uploadFiles {
+		hashes = append(hashes, hash)
+	}
+	sort.Strings(hashes)
+	for _, hash := range hashes {
+		if bParams.Verbose {
+			ourutil.Reportf("Uploading %s", uploadFiles[hash])
+		}
+		part, err := mpw.CreateFormFile(moscommon.FormSourceFileName, hash)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		f, err := os.Open(uploadFiles[hash])
+		if err != nil {
+			return errors.Trace(err)
+		}
+		_, err = io.Copy(part, f)
+		f.Close()
+		if err != nil {
+			return errors.Trace(err)
+		}
+	}
+	return errors.Trace(mpw.Close())
+}
 
-		// unzip build results
-		r := bytes.NewReader(body.Bytes())
-		if err = archive.UnzipInto(r, r.Size(), buildDir, 1 /* skipLevels */); err != nil {
-			return errors.Annotatef(err, "failed to unzip build results")
+// getSourceFileList returns whitelisted files under dir (see zipUp) with hashes of their contents.
+func getSourceFileList(dir string, whitelist map[string]bool) (moscommon.SourceFileList, error) {
+	fileList := moscommon.SourceFileList{}
+	err := walkWhitelisted(dir, whitelist, func(file, fileForwardSlash string) error {
+		h := md5.New()
+		f, err := os.Open(file)
+		if err != nil {
+			return errors.Trace(err)
 		}
+		defer f.Close()
+		if _, err := io.Copy(h, f); err != nil {
+			return errors.Trace(err)
+		}
+		fileList[fileForwardSlash] = hex.EncodeToString(h.Sum(nil))
+		return nil
+	})
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return fileList, nil
+}
 
-		// Save local log
-		ioutil.WriteFile(moscommon.GetBuildLogLocalFilePath(buildDir), logBuf.Bytes(), 0666)
+// walkWhitelisted calls cb for each file under dir whose top-level dir or
+// name is in the whitelist. cb also gets the path relative to dir, with forward slashes.
+func walkWhitelisted(dir string, whitelist map[string]bool, cb func(file, fileForwardSlash string) error) error {
+	return filepath.Walk(dir, func(file string, info os.FileInfo, err error) error {
+		if err != nil {
+			return errors.Trace(err)
+		}
+		relFile, err := filepath.Rel(dir, file)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		fileForwardSlash := relFile
+		if os.PathSeparator != rune('/') {
+			fileForwardSlash = strings.Replace(relFile, string(os.PathSeparator), "/", -1)
+		}
+		parts := strings.Split(relFile, string(os.PathSeparator))
 
-		// print log in verbose mode or when build fails
-		if bParams.Verbose || resp.StatusCode != http.StatusOK {
-			log, err := os.Open(moscommon.GetBuildLogFilePath(buildDir))
-			if err != nil {
-				return errors.Trace(err)
+		if _, ok := whitelist[parts[0]]; !ok {
+			glog.Infof("ignoring %q", file)
+			if info.IsDir() {
+				return filepath.SkipDir
+			} else {
+				return nil
 			}
-			io.Copy(os.Stdout, log)
 		}
-
-		if resp.StatusCode != http.StatusOK {
-			return errors.Errorf("build failed")
+		if info.IsDir() {
+			return nil
 		}
-		return nil
-
-	default:
-		// Unexpected response
-		return errors.Errorf("error response: %d: %s", resp.StatusCode, strings.TrimSpace(body.String()))
-	}
+		return cb(file, fileForwardSlash)
+	})
 }
 
 // copyExternalCode checks whether given path p is outside of appDir, and if
@@ -440,8 +629,8 @@ func copyExternalCodeAll(paths *[]string, appDir, appStagingDir string) error {
 	return nil
 }
 
-// zipUp takes the whitelisted files and directories under path and returns an
-// in-memory zip file. The whitelist map is applied to top-level dirs and files
+// zipUp takes the whitelisted files and directories under path and writes them
+// as a zip file to w. The whitelist map is applied to top-level dirs and files
 // only. If some file needs to be transformed before placing into a zip
 // archive, the appropriate transformer function should be placed at the
 // transformers map.
@@ -450,35 +639,17 @@ func zipUp(
 	dir string,
 	whitelist map[string]bool,
 	transformers map[string]fileTransformer,
-) ([]byte, error) {
-	data := &bytes.Buffer{}
-	z := zip.NewWriter(data)
-
-	err := filepath.Walk(dir, func(file string, info os.FileInfo, err error) error {
-		// Zip files should always contain forward slashes
-		fileForwardSlash := file
-		if os.PathSeparator != rune('/') {
-			fileForwardSlash = strings.Replace(file, string(os.PathSeparator), "/", -1)
-		}
-		parts := strings.Split(file, string(os.PathSeparator))
-
-		if _, ok := whitelist[parts[0]]; !ok {
-			glog.Infof("ignoring %q", file)
-			if info.IsDir() {
-				return filepath.SkipDir
-			} else {
-				return nil
-			}
-		}
-		if info.IsDir() {
-			return nil
-		}
+	w io.Writer,
+) error {
+	z := zip.NewWriter(w)
 
+	// Zip files should always contain forward slashes
+	err := walkWhitelisted(dir, whitelist, func(file, fileForwardSlash string) error {
 		if bParams.Verbose {
 			ourutil.Reportf("Zipping %s", file)
 		}
 
-		w, err := z.Create(fileForwardSlash)
+		zw, err := z.Create(fileForwardSlash)
 		if err != nil {
 			return errors.Trace(err)
 		}
@@ -501,18 +672,17 @@ func zipUp(
 		}
 		defer r.Close()
 
-		if _, err := io.Copy(w, r); err != nil {
+		if _, err := io.Copy(zw, r); err != nil {
 			return errors.Trace(err)
 		}
 
 		return nil
 	})
 	if err != nil {
-		return nil, errors.Trace(err)
+		return errors.Trace(err)
 	}
 
-	z.Close()
-	return data.Bytes(), nil
+	return errors.Trace(z.Close())
 }
 
 func identityTransformer(r io.ReadCloser) (io.ReadCloser, error) {
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package main
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"io/ioutil"
+	"os"
+	"sort"
+
+	"github.com/juju/errors"
+	yaml "gopkg.in/yaml.v2"
+
+	"github.com/mongoose-os/mos/cli/build"
+)
+
+// buildState holds fingerprints of the sections of the final manifest used for the last build.
+type buildState struct {
+	Sections map[string]string `json:"sections"`
+}
+
+type buildStateSection struct {
+	name string
+	// Whether a change requires a clean rebuild. Make does not track flags and some
+	// build vars, so objects built with old values would be reused otherwise.
+	// Changes to other sections are picked up by make dependencies.
+	needClean bool
+	get       func(m *build.FWAppManifest) interface{}
+}
+
+var buildStateSections = []buildStateSection{
+	{"platform", true, func(m *build.FWAppManifest) interface{} { return []string{m.Platform, m.ArchOld, m.Type, m.Name} }},
+	{"cflags", true, func(m *build.FWAppManifest) interface{} { return [][]string{m.CFlags, m.CXXFlags} }},
+	{"cdefs", true, func(m *build.FWAppManifest) interface{} { return m.CDefs }},
+	{"includes", true, func(m *build.FWAppManifest) interface{} { return m.Includes }},
+	{"build_vars", true, func(m *build.FWAppManifest) interface{} { return m.BuildVars }},
+	{"binary_libs", true, func(m *build.FWAppManifest) interface{} { return m.BinaryLibs }},
+	{"ffi_symbols", true, func(m *build.FWAppManifest) interface{} { return m.FFISymbols }},
+	{"modules", true, func(m *build.FWAppManifest) interface{} {
+		return []interface{}{m.Modules, m.MongooseOsVersion, m.ModulesVersion}
+	}},
+	{"sources", false, func(m *build.FWAppManifest) interface{} { return m.Sources }},
+	{"filesystem", false, func(m *build.FWAppManifest) interface{} { return []interface{}{m.Filesystem, m.FSFilters} }},
+	{"config_schema", false, func(m *build.FWAppManifest) interface{} { return m.ConfigSchema }},
+	{"libs", false, func(m *build.FWAppManifest) interface{} {
+		return []interface{}{m.Libs, m.LibsHandled, m.LibsVersion, m.InitDeps, m.InitAfter, m.InitBefore}
+	}},
+}
+
+func getBuildState(m *build.FWAppManifest) (*buildState, error) {
+	bs := &buildState{Sections: make(map[string]string)}
+	for _, s := range buildStateSections {
+		data, err := yaml.Marshal(s.get(m))
+		if err != nil {
+			return nil, errors.Annotatef(err, "%s", s.name)
+		}
+		h := sha256.Sum256(data)
+		bs.Sections[s.name] = hex.EncodeToString(h[:])
+	}
+	return bs, nil
+}
+
+// checkBuildState compares the state of the manifest with the one saved in fileName.
+// Returns the new state, names of the changed sections and whether a clean
+// rebuild is required. If there is no saved state, build dir is assumed to be
+// clean unless there is existing final manifest (i.e. built by an older version).
+func checkBuildState(fileName, finalManifestFileName string, m *build.FWAppManifest) (*buildState, []string, bool, error) {
+	bs, err := getBuildState(m)
+	if err != nil {
+		return nil, nil, false, errors.Trace(err)
+	}
+	var changed []string
+	needClean := false
+	var oldState buildState
+	if data, err := ioutil.ReadFile(fileName); err == nil && json.Unmarshal(data, &oldState) == nil {
+		for _, s := range buildStateSections {
+			if oldState.Sections[s.name] != bs.Sections[s.name] {
+				changed = append(changed, s.name)
+				needClean = needClean || s.needClean
+			}
+		}
+	} else if _, err := os.Stat(finalManifestFileName); err == nil {
+		needClean = true
+	}
+	sort.Strings(changed)
+	return bs, changed, needClean, nil
+}
+
+// saveBuildState saves the state to fileName. It must only be done once the build
+// has succeeded: if the state was saved before a forced clean rebuild and the build
+// was interrupted, the next build would reuse objects built with the old state.
+func saveBuildState(fileName string, bs *buildState) error {
+	data, err := json.MarshalIndent(bs, "", "  ")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(ioutil.WriteFile(fileName, data, 0666))
+}
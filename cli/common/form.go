@@ -25,3 +25,30 @@ const (
 	FormSourcesZipName         = "file"
 	FormBuildParamsName        = "build_params"
 )
+
+const (
+	// Incremental remote builds: the client sends the list of files with their
+	// hashes (SourceFileList as JSON) and only the contents the build context
+	// does not have yet, each as a separate file named after its hash.
+	FormFileListName   = "file_list"
+	FormSourceFileName = "src_file"
+
+	// Action of the remote builder which tells which of the hashes it does not have.
+	MissingFilesAction = "missing"
+)
+
+// SourceFileList maps paths of the uploaded sources (relative, with forward slashes)
+// to MD5 hex hashes of their contents.
+type SourceFileList map[string]string
+
+// MissingFilesRequest is sent to MissingFilesAction before an incremental upload.
+type MissingFilesRequest struct {
+	App      string   `json:"app"`
+	Platform string   `json:"platform"`
+	BuildCtx string   `json:"build_ctx"`
+	Hashes   []string `json:"hashes"`
+}
+
+type MissingFilesResponse struct {
+	Missing []string `json:"missing"`
+}
@@ -128,6 +128,14 @@ func GetMosFinalFilePath(buildDir string) string {
 	return filepath.Join(GetGeneratedFilesDir(buildDir), "mos_final.yml")
 }
 
+func GetBuildStateFilePath(buildDir string) string {
+	return filepath.Join(GetGeneratedFilesDir(buildDir), "build_state.json")
+}
+
+func GetManifestCacheFilePath(buildDir string) string {
+	return filepath.Join(GetGeneratedFilesDir(buildDir), "mos_resolved_cache.yml")
+}
+
 func GetDepsInitCFilePath(buildDir string) string {
 	return filepath.Join(GetGeneratedFilesDir(buildDir), "mgos_deps_init.c")
 }
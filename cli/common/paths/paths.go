@@ -34,14 +34,17 @@ var (
 
 	AppsDirTpl = fmt.Sprintf("~/.mos/apps-%s", dirTplMosVersion)
 
-	TmpDir         = ""
-	depsDirFlag    = ""
-	LibsDirFlag    = []string{}
-	AppsDir        = ""
-	modulesDirFlag = ""
-
-	StateFilepath = ""
-	AuthFilepath  = ""
+	TmpDir               = ""
+	depsDirFlag          = ""
+	LibsDirFlag          = []string{}
+	AppsDir              = ""
+	modulesDirFlag       = ""
+	GitCacheDir          = ""
+	PrebuiltLibsCacheDir = ""
+
+	StateFilepath       = ""
+	AuthFilepath        = ""
+	DaemonTokenFilepath = ""
 )
 
 func init() {
@@ -50,9 +53,12 @@ func init() {
 	flag.StringSliceVar(&LibsDirFlag, "libs-dir", []string{}, "Directory to find libs in. Can be used multiple times.")
 	flag.StringVar(&AppsDir, "apps-dir", AppsDirTpl, "Directory to store apps into")
 	flag.StringVar(&modulesDirFlag, "modules-dir", "", "Directory to store modules into")
+	flag.StringVar(&GitCacheDir, "git-cache-dir", "~/.mos/git-cache", "Directory to keep mirrors of lib and module repos in, shared by all projects. Empty - do not use mirrors.")
+	flag.StringVar(&PrebuiltLibsCacheDir, "prebuilt-libs-cache-dir", "~/.mos/prebuilt-libs-cache", "Directory to keep downloaded prebuilt libs in, shared by all projects. Empty - do not cache.")
 
 	flag.StringVar(&StateFilepath, "state-file", "~/.mos/state.json", "Where to store internal mos state")
 	flag.StringVar(&AuthFilepath, "auth-file", "~/.mos/auth.json", "Where to store license server auth key")
+	flag.StringVar(&DaemonTokenFilepath, "daemon-token-file", "~/.mos/daemon_token", "Where 'mos daemon' stores the token its clients must present")
 }
 
 // Init() should be called after all flags are parsed
@@ -85,6 +91,16 @@ func Init() error {
 		return errors.Trace(err)
 	}
 
+	GitCacheDir, err = NormalizePath(GitCacheDir, version.GetMosVersion())
+	if err != nil {
+		return errors.Trace(err)
+	}
+
+	PrebuiltLibsCacheDir, err = NormalizePath(PrebuiltLibsCacheDir, version.GetMosVersion())
+	if err != nil {
+		return errors.Trace(err)
+	}
+
 	StateFilepath, err = NormalizePath(StateFilepath, version.GetMosVersion())
 	if err != nil {
 		return errors.Trace(err)
@@ -95,6 +111,11 @@ func Init() error {
 		return errors.Trace(err)
 	}
 
+	DaemonTokenFilepath, err = NormalizePath(DaemonTokenFilepath, version.GetMosVersion())
+	if err != nil {
+		return errors.Trace(err)
+	}
+
 	if err := os.MkdirAll(TmpDir, 0777); err != nil {
 		return errors.Trace(err)
 	}
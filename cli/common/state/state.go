@@ -18,7 +18,10 @@ package state
 
 import (
 	"encoding/json"
+	"fmt"
 	"io/ioutil"
+	"sync"
+	"time"
 
 	"github.com/mongoose-os/mos/cli/common/paths"
 
@@ -28,6 +31,32 @@ import (
 type State struct {
 	Versions         map[string]*StateVersion `json:"versions"`
 	OldDirsConverted bool                     `json:"old_dirs_converted"`
+	// Flashing baud rates selected by auto-detection, per port.
+	ESPBaudRates map[string]uint `json:"esp_baud_rates,omitempty"`
+	// Devices last seen on serial ports, by SerialDevice.Key().
+	SerialDevices map[string]*SerialDevice `json:"serial_devices,omitempty"`
+}
+
+// SerialDevice is a device found on a serial port.
+type SerialDevice struct {
+	Port string `json:"port"`
+	// USB vendor and product ID and serial number of the port, if known.
+	VID    string `json:"vid,omitempty"`
+	PID    string `json:"pid,omitempty"`
+	Serial string `json:"serial,omitempty"`
+	// Reported by the firmware.
+	Arch     string    `json:"arch,omitempty"`
+	MAC      string    `json:"mac,omitempty"`
+	ID       string    `json:"id,omitempty"`
+	LastSeen time.Time `json:"last_seen"`
+}
+
+// Key identifies the USB adapter if it has a serial number, otherwise the port.
+func (sd *SerialDevice) Key() string {
+	if sd.Serial != "" {
+		return fmt.Sprintf("usb:%s:%s:%s", sd.VID, sd.PID, sd.Serial)
+	}
+	return "port:" + sd.Port
 }
 
 type StateVersion struct {
@@ -35,9 +64,17 @@ type StateVersion struct {
 
 var (
 	mosState State
+	lock     sync.Mutex
+	loaded   bool
 )
 
+// Init loads the state, it does nothing if the state has already been loaded.
 func Init() error {
+	lock.Lock()
+	defer lock.Unlock()
+	if loaded {
+		return nil
+	}
 	// Try to read state from file, and if it succeeds, unmarshal json from it;
 	// otherwise just leave state empty
 	if data, err := ioutil.ReadFile(paths.StateFilepath); err == nil {
@@ -50,6 +87,7 @@ func Init() error {
 		mosState.Versions = make(map[string]*StateVersion)
 	}
 
+	loaded = true
 	return nil
 }
 
@@ -58,14 +96,70 @@ func GetState() *State {
 }
 
 func GetStateForVersion(version string) *StateVersion {
+	lock.Lock()
+	defer lock.Unlock()
 	return mosState.Versions[version]
 }
 
 func SetStateForVersion(version string, stateVer *StateVersion) {
+	lock.Lock()
+	defer lock.Unlock()
 	mosState.Versions[version] = stateVer
 }
 
+// GetVersions returns the list of versions that have state.
+func GetVersions() []string {
+	lock.Lock()
+	defer lock.Unlock()
+	var res []string
+	for k := range mosState.Versions {
+		res = append(res, k)
+	}
+	return res
+}
+
+func GetESPBaudRate(port string) uint {
+	lock.Lock()
+	defer lock.Unlock()
+	return mosState.ESPBaudRates[port]
+}
+
+func SetESPBaudRate(port string, baudRate uint) {
+	lock.Lock()
+	defer lock.Unlock()
+	if mosState.ESPBaudRates == nil {
+		mosState.ESPBaudRates = make(map[string]uint)
+	}
+	mosState.ESPBaudRates[port] = baudRate
+}
+
+// GetSerialDevices returns copies of all the known serial devices.
+func GetSerialDevices() []SerialDevice {
+	lock.Lock()
+	defer lock.Unlock()
+	var res []SerialDevice
+	for _, sd := range mosState.SerialDevices {
+		res = append(res, *sd)
+	}
+	return res
+}
+
+func SetSerialDevice(sd SerialDevice) {
+	lock.Lock()
+	defer lock.Unlock()
+	if mosState.SerialDevices == nil {
+		mosState.SerialDevices = make(map[string]*SerialDevice)
+	}
+	mosState.SerialDevices[sd.Key()] = &sd
+}
+
 func SaveState() error {
+	lock.Lock()
+	defer lock.Unlock()
+	// Saving state that was never loaded would wipe it.
+	if !loaded {
+		return errors.Errorf("state is not loaded")
+	}
 	data, err := json.MarshalIndent(&mosState, "", "  ")
 	if err != nil {
 		return errors.Trace(err)
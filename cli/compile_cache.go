@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package main
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"regexp"
+	"strings"
+
+	"github.com/juju/errors"
+
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/ourutil"
+)
+
+// Compiled objects can be shared between builds of different apps, build
+// contexts, users and hosts (if the dir is on a shared volume) through a ccache
+// cache dir, see --compile-cache-dir. The cache is split by build image,
+// ccache itself keys objects by hash of the preprocessed source and compiler flags.
+
+var compileCacheNamespaceRe = regexp.MustCompile(`[^a-zA-Z0-9._-]+`)
+
+// getCompileCacheDir returns the cache dir to use for builds with the given image
+// (or SDK revision, when already running inside the build container).
+func getCompileCacheDir(image string) (string, error) {
+	if *flags.CompileCacheDir == "" {
+		return "", nil
+	}
+	cacheDir, err := filepath.Abs(filepath.Join(*flags.CompileCacheDir, compileCacheNamespaceRe.ReplaceAllString(image, "_")))
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	// The cache is shared by users, builds can run under different uids.
+	if err := os.MkdirAll(cacheDir, 0777); err != nil {
+		return "", errors.Annotatef(err, "failed to create compile cache dir")
+	}
+	return cacheDir, nil
+}
+
+func shellQuote(s string) string {
+	return "'" + strings.Replace(s, "'", `'\''`, -1) + "'"
+}
+
+// getCompileCacheShellPrelude returns shell commands which make compilers in
+// PATH go through ccache. Paths under baseDir are rewritten as relative, so
+// the same sources in different dirs share cache entries.
+func getCompileCacheShellPrelude(cacheDir, baseDir string) string {
+	return fmt.Sprintf(`if command -v ccache >/dev/null 2>&1; then `+
+		`d=$(mktemp -d); `+
+		`for c in $(compgen -c | grep -E '(^|-)(gcc|g\+\+|cc|c\+\+)$' | sort -u); do ln -s "$(command -v ccache)" "$d/$c"; done; `+
+		`export PATH="$d:$PATH" CCACHE_DIR=%s CCACHE_BASEDIR=%s CCACHE_NOHASHDIR=1 CCACHE_UMASK=000; `+
+		`else echo "ccache is not available in the build image, compile cache is not used"; fi; `,
+		shellQuote(ourutil.GetPathForDocker(cacheDir)), shellQuote(ourutil.GetPathForDocker(baseDir)))
+}
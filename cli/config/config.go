@@ -51,8 +51,8 @@ func Get(ctx context.Context, devConn dev.DevConn) error {
 		path = args[0]
 	}
 
-	// Get all config from the attached device
-	devConf, err := dev.GetConfigLevel(ctx, devConn, *flags.Level)
+	// Get the requested part of config from the attached device
+	devConf, err := dev.GetConfigPaths(ctx, devConn, *flags.Level, []string{path})
 	if err != nil {
 		return errors.Trace(err)
 	}
@@ -79,14 +79,18 @@ func SetWithArgs(
 		return errors.Errorf("at least one path.to.value=value pair should be given")
 	}
 
-	// Get all config from the attached device
-	ourutil.Reportf("Getting configuration...")
-	devConf, err := dev.GetConfigLevel(ctx, devConn, *flags.Level)
+	paramValues, err := moscommon.ParseParamValues(args)
 	if err != nil {
 		return errors.Trace(err)
 	}
 
-	paramValues, err := moscommon.ParseParamValues(args)
+	// Get the values being set from the attached device, to know their types
+	var paths []string
+	for path := range paramValues {
+		paths = append(paths, path)
+	}
+	ourutil.Reportf("Getting configuration...")
+	devConf, err := dev.GetConfigPaths(ctx, devConn, *flags.Level, paths)
 	if err != nil {
 		return errors.Trace(err)
 	}
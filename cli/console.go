@@ -23,7 +23,6 @@ import (
 	"fmt"
 	"io"
 	"io/ioutil"
-	"math"
 	"net"
 	"net/url"
 	"os"
@@ -54,6 +53,9 @@ var (
 	tsfSpecFlag        string
 	catchCoreDumpsFlag bool
 	hexdumpFlag        int
+	consoleFilterFlag  string
+	captureFlag        string
+	captureSizeFlag    int64
 )
 
 var (
@@ -76,6 +78,14 @@ func init() {
 	flag.IntVar(&hexdumpFlag, "hexdump", 0, "Output console as hexdump")
 	flag.Lookup("hexdump").NoOptDefVal = "16" // --hexdump -> --hexdump=16
 
+	flag.StringVar(&consoleFilterFlag, "console-filter", "",
+		"Only output console lines matching this regular expression")
+	flag.StringVar(&captureFlag, "capture", "",
+		"Also write console output to this file. Once it reaches half of --capture-size, "+
+			"it is moved to <file>.1 and a new one is started")
+	flag.Int64Var(&captureSizeFlag, "capture-size", 64*1024*1024,
+		"Maximum disk space taken by the console capture files, in bytes")
+
 	for _, f := range []string{"no-input", "timestamp"} {
 		hiddenFlags = append(hiddenFlags, f)
 	}
@@ -95,15 +105,12 @@ func FormatTimestamp(ts time.Time) string {
 	return tss
 }
 
-func printConsoleLine(out io.Writer, ts time.Time, line []byte) {
-	if tsfSpecFlag != "" && !ts.IsZero() {
-		fmt.Printf("%s", FormatTimestamp(ts))
-	}
+func printConsoleLine(out *consoleOutput, ts time.Time, line []byte) {
 	removeNonText(line, ' ')
-	out.Write(line)
+	out.printLine(ts, line)
 }
 
-func analyzeCoreDump(out io.Writer, cd []byte) error {
+func analyzeCoreDump(out *consoleOutput, cd []byte) error {
 	info, err := debug_core_dump.GetInfoFromCoreDump(cd)
 	cwd, _ := os.Getwd() // Mac docker cannot mount dirs from /tmp. Thus, create core in the CWD
 	tf, err := ioutil.TempFile(cwd, fmt.Sprintf("core-%s-%s-%s", info.App, info.Platform, time.Now().Format("20060102-150405.")))
@@ -123,6 +130,7 @@ func analyzeCoreDump(out io.Writer, cd []byte) error {
 	tf.Write([]byte(debug_core_dump.CoreDumpEnd))
 	tf.Close()
 	printConsoleLine(out, now, []byte("mos: analyzing core dump\n"))
+	out.Flush()
 	return debug_core_dump.DebugCoreDumpF(tfn, "", true)
 }
 
@@ -296,7 +304,11 @@ func console(ctx context.Context, devConn dev.DevConn) error {
 }
 
 func consoleReadWrite(ctx context.Context, r io.Reader, w io.Writer) error {
-	in, out := os.Stdin, os.Stdout
+	in := os.Stdin
+	out, err := newConsoleOutput(os.Stdout, consoleFilterFlag, captureFlag, captureSizeFlag)
+	if err != nil {
+		return errors.Trace(err)
+	}
 	cctx, cancel := context.WithCancel(ctx)
 	go func() { // Serial -> Stdout
 		var curLine []byte
@@ -304,10 +316,14 @@ func consoleReadWrite(ctx context.Context, r io.Reader, w io.Writer) error {
 		coreDumping := false
 		lastCDProgress := 0
 		cont := false
+		rbuf := make([]byte, 1500)
+		var hexLine []byte
 
 		for {
-			buf := make([]byte, 1500)
-			n, err := r.Read(buf)
+			// Everything printed for the previous read goes out in one write.
+			// This also means nothing is left unflushed while waiting for data.
+			out.Flush()
+			n, err := r.Read(rbuf)
 			if err != nil {
 				reportf("read err %s", err)
 				cancel()
@@ -317,35 +333,15 @@ func consoleReadWrite(ctx context.Context, r io.Reader, w io.Writer) error {
 				continue
 			}
 			now := time.Now()
-			buf = buf[:n]
+			buf := rbuf[:n]
 			if hexdumpFlag > 0 {
-				for off := 0; off < n; {
-					left := n - off
-					chunkSize := int(math.Min(float64(left), float64(hexdumpFlag)))
-					chunk := buf[off : off+chunkSize]
-					hexLine := fmt.Sprintf("%08x  ", off)
-					for i := 0; i < hexdumpFlag; i++ {
-						if i < chunkSize {
-							hexLine += fmt.Sprintf("%02x ", chunk[i])
-						} else {
-							hexLine += "   "
-						}
-						if i%8 == 7 {
-							hexLine += " "
-						}
-					}
-					hexLine += " |"
-					for i := 0; i < chunkSize; i++ {
-						c := chunk[i]
-						if !isNonText(c) && c != 0x0a && c != 0x0d && c != 0x1b {
-							hexLine += string(c)
-						} else {
-							hexLine += "."
-						}
+				for off := 0; off < n; off += hexdumpFlag {
+					end := off + hexdumpFlag
+					if end > n {
+						end = n
 					}
-					hexLine += "|\n"
-					printConsoleLine(out, now, []byte(hexLine))
-					off += chunkSize
+					hexLine = appendHexdumpLine(hexLine[:0], off, buf[off:end], hexdumpFlag)
+					printConsoleLine(out, now, hexLine)
 				}
 				continue
 			}
@@ -425,8 +421,8 @@ func consoleReadWrite(ctx context.Context, r io.Reader, w io.Writer) error {
 	}()
 	if w != nil && !noInputFlag {
 		go func() { // Stdin -> Serial
+			buf := make([]byte, 1)
 			for {
-				buf := make([]byte, 1)
 				n, err := in.Read(buf)
 				if n > 0 {
 					w.Write(buf[:n])
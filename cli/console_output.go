@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package main
+
+import (
+	"bufio"
+	"io"
+	"os"
+	"regexp"
+	"time"
+
+	"github.com/juju/errors"
+)
+
+// consoleOutput batches console output: it is written to the terminal (and
+// the capture file, if any) once per read from the device rather than once
+// per line. If a filter is set, only complete lines matching it are output.
+type consoleOutput struct {
+	w       *bufio.Writer
+	capture *captureFile
+	filter  *regexp.Regexp
+
+	// When filtering: the line being accumulated and its timestamp.
+	line   []byte
+	lineTS time.Time
+}
+
+func newConsoleOutput(out io.Writer, filter string, capture string, captureMaxSize int64) (*consoleOutput, error) {
+	co := &consoleOutput{w: bufio.NewWriterSize(out, 64*1024)}
+	if filter != "" {
+		re, err := regexp.Compile(filter)
+		if err != nil {
+			return nil, errors.Annotatef(err, "invalid console filter")
+		}
+		co.filter = re
+	}
+	if capture != "" {
+		cf, err := newCaptureFile(capture, captureMaxSize)
+		if err != nil {
+			return nil, errors.Trace(err)
+		}
+		co.capture = cf
+	}
+	return co, nil
+}
+
+// printLine outputs a piece of a line. If ts is not zero, the piece starts
+// a line and is prefixed with the timestamp.
+func (co *consoleOutput) printLine(ts time.Time, data []byte) {
+	if co.filter == nil {
+		co.writeLine(ts, data)
+		return
+	}
+	if len(co.line) == 0 {
+		co.lineTS = ts
+	}
+	co.line = append(co.line, data...)
+	if len(data) > 0 && data[len(data)-1] == '\n' {
+		if co.filter.Match(co.line) {
+			co.writeLine(co.lineTS, co.line)
+		}
+		co.line = co.line[:0]
+	}
+}
+
+func (co *consoleOutput) writeLine(ts time.Time, data []byte) {
+	if tsfSpecFlag != "" && !ts.IsZero() {
+		co.Write([]byte(FormatTimestamp(ts)))
+	}
+	co.Write(data)
+}
+
+func (co *consoleOutput) Write(data []byte) (int, error) {
+	if co.capture != nil {
+		if err := co.capture.Write(data); err != nil {
+			reportf("capture error: %s", err)
+			co.capture = nil
+		}
+	}
+	return co.w.Write(data)
+}
+
+// Flush writes out everything buffered so far.
+func (co *consoleOutput) Flush() {
+	co.w.Flush()
+	if co.capture != nil {
+		if err := co.capture.Flush(); err != nil {
+			reportf("capture error: %s", err)
+			co.capture = nil
+		}
+	}
+}
+
+// captureFile keeps the last maxSize bytes of output on disk: it writes to
+// the file until it reaches half of maxSize, then moves it to <name>.1 and
+// starts over, so the two files never take more than maxSize together.
+type captureFile struct {
+	name    string
+	maxSize int64
+	f       *os.File
+	w       *bufio.Writer
+	size    int64
+}
+
+func newCaptureFile(name string, maxSize int64) (*captureFile, error) {
+	if maxSize < 2 {
+		return nil, errors.Errorf("invalid capture size %d", maxSize)
+	}
+	cf := &captureFile{name: name, maxSize: maxSize}
+	if err := cf.open(); err != nil {
+		return nil, errors.Trace(err)
+	}
+	return cf, nil
+}
+
+func (cf *captureFile) open() error {
+	f, err := os.OpenFile(cf.name, os.O_WRONLY|os.O_CREATE|os.O_APPEND, 0644)
+	if err != nil {
+		return errors.Annotatef(err, "failed to open capture file")
+	}
+	st, err := f.Stat()
+	if err != nil {
+		f.Close()
+		return errors.Trace(err)
+	}
+	cf.f, cf.size = f, st.Size()
+	cf.w = bufio.NewWriterSize(f, 64*1024)
+	return nil
+}
+
+func (cf *captureFile) rotate() error {
+	if err := cf.Close(); err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.Rename(cf.name, cf.name+".1"); err != nil {
+		return errors.Annotatef(err, "failed to rotate capture file")
+	}
+	return errors.Trace(cf.open())
+}
+
+func (cf *captureFile) Write(data []byte) error {
+	for len(data) > 0 {
+		if cf.size >= cf.maxSize/2 {
+			if err := cf.rotate(); err != nil {
+				return errors.Trace(err)
+			}
+		}
+		n := int64(len(data))
+		if left := cf.maxSize/2 - cf.size; n > left {
+			n = left
+		}
+		if _, err := cf.w.Write(data[:n]); err != nil {
+			return errors.Trace(err)
+		}
+		cf.size += n
+		data = data[n:]
+	}
+	return nil
+}
+
+func (cf *captureFile) Flush() error {
+	return errors.Trace(cf.w.Flush())
+}
+
+func (cf *captureFile) Close() error {
+	err := cf.w.Flush()
+	if cerr := cf.f.Close(); err == nil {
+		err = cerr
+	}
+	return errors.Trace(err)
+}
+
+const hexDigits = "0123456789abcdef"
+
+// appendHexdumpLine appends a hexdump line for chunk, which is at most width
+// bytes long, at offset off.
+func appendHexdumpLine(line []byte, off int, chunk []byte, width int) []byte {
+	for shift := 28; shift >= 0; shift -= 4 {
+		line = append(line, hexDigits[(off>>uint(shift))&0xf])
+	}
+	line = append(line, ' ', ' ')
+	for i := 0; i < width; i++ {
+		if i < len(chunk) {
+			line = append(line, hexDigits[chunk[i]>>4], hexDigits[chunk[i]&0xf], ' ')
+		} else {
+			line = append(line, ' ', ' ', ' ')
+		}
+		if i%8 == 7 {
+			line = append(line, ' ')
+		}
+	}
+	line = append(line, ' ', '|')
+	for _, c := range chunk {
+		if !isNonText(c) && c != 0x0a && c != 0x0d && c != 0x1b {
+			line = append(line, c)
+		} else {
+			line = append(line, '.')
+		}
+	}
+	return append(line, '|', '\n')
+}
@@ -35,6 +35,15 @@ import (
 	"github.com/mongoose-os/mos/version"
 )
 
+// isHexExt returns true for extensions of Intel HEX and Motorola S-record files.
+func isHexExt(ext string) bool {
+	switch strings.ToLower(ext) {
+	case ".hex", ".ihex", ".srec", ".s19", ".s28", ".s37", ".mot":
+		return true
+	}
+	return false
+}
+
 func CreateFWBundle(ctx context.Context, devConn dev.DevConn) error {
 	if *flags.Output == "" {
 		return errors.Errorf("--output is required")
@@ -87,7 +96,7 @@ func CreateFWBundle(ctx context.Context, devConn dev.DevConn) error {
 			if err != nil {
 				return errors.Annotatef(err, "%s", ps)
 			}
-			if strings.HasSuffix(p.Src, ".hex") {
+			if ext := filepath.Ext(p.Src); isHexExt(ext) {
 				hpp, err := fwbundle.PartsFromHexFile(p.Src, p.Name, 255, 512)
 				if err != nil {
 					return errors.Annotatef(err, "%s", ps)
@@ -95,9 +104,9 @@ func CreateFWBundle(ctx context.Context, devConn dev.DevConn) error {
 				for ihp, hp := range hpp {
 					p1 := *p
 					if len(hpp) == 1 {
-						p1.Src = strings.Replace(p.Src, ".hex", ".bin", 1)
+						p1.Src = strings.TrimSuffix(p.Src, ext) + ".bin"
 					} else {
-						p1.Src = fmt.Sprintf("%s.%d.bin", strings.Replace(p.Src, ".hex", "", 1), ihp)
+						p1.Src = fmt.Sprintf("%s.%d.bin", strings.TrimSuffix(p.Src, ext), ihp)
 					}
 					p1.Addr = hp.Addr
 					p1.Name = hp.Name
@@ -0,0 +1,270 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package daemon
+
+import (
+	"context"
+	"crypto/rand"
+	"crypto/subtle"
+	"encoding/hex"
+	"io/ioutil"
+	"net"
+	"net/http"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/common/paths"
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/devutil"
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/ourutil"
+	"github.com/mongoose-os/mos/common/mgrpc"
+	"github.com/mongoose-os/mos/common/mgrpc/codec"
+	"github.com/mongoose-os/mos/common/mgrpc/frame"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
+)
+
+var (
+	idleTimeoutFlag = flag.Duration("daemon-idle-timeout", 5*time.Minute,
+		"Close device connections of the daemon that were not used for this long, 0 - never")
+	metricsAddrFlag = flag.String("daemon-metrics-addr", "",
+		"If set, serve RPC metrics in Prometheus format at http://<addr>/metrics")
+)
+
+// pooledConn is a device connection kept open by the daemon.
+type pooledConn struct {
+	port string
+	// Held while connecting, so concurrent requests for the same device share one connection.
+	lock     sync.Mutex
+	dc       *dev.MosDevConn
+	lastUsed time.Time
+}
+
+type daemon struct {
+	// Clients must present this as the frame key, see writeToken.
+	token string
+	lock  sync.Mutex
+	conns map[string]*pooledConn
+}
+
+// Daemon accepts RPC connections from other mos invocations (started with --daemon)
+// and forwards requests to devices over connections that are kept open between invocations.
+// This saves the cost of opening the port and re-establishing the session for every command.
+// Only serial ports and the port given with --port are served, and only to clients
+// that present the token from --daemon-token-file, which is readable by the current user only.
+func Daemon(ctx context.Context, _ dev.DevConn) error {
+	token, err := writeToken(paths.DaemonTokenFilepath)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	l, err := net.Listen("tcp", *flags.DaemonAddr)
+	if err != nil {
+		return errors.Annotatef(err, "failed to listen on %s", *flags.DaemonAddr)
+	}
+	defer l.Close()
+	ourutil.Reportf("Listening on %s", l.Addr())
+	d := &daemon{token: token, conns: make(map[string]*pooledConn)}
+	if *idleTimeoutFlag > 0 {
+		go d.closeIdle(ctx)
+	}
+	if *metricsAddrFlag != "" {
+		mux := http.NewServeMux()
+		mux.Handle("/metrics", stats.Handler())
+		go func() {
+			glog.Errorf("metrics server: %s", http.ListenAndServe(*metricsAddrFlag, mux))
+		}()
+	}
+	go func() {
+		<-ctx.Done()
+		l.Close()
+	}()
+	for {
+		conn, err := l.Accept()
+		if err != nil {
+			if ctx.Err() != nil {
+				return nil
+			}
+			return errors.Trace(err)
+		}
+		glog.V(1).Infof("New client %s", conn.RemoteAddr())
+		rpc := mgrpc.Serve(ctx, codec.TCP(conn))
+		rpc.AddHandler("*", func(_ mgrpc.MgRPC, f *frame.Frame) *frame.Frame {
+			return d.forward(ctx, f)
+		})
+	}
+}
+
+// writeToken generates a new random token and stores it in fname,
+// accessible to the current user only.
+func writeToken(fname string) (string, error) {
+	b := make([]byte, 16)
+	if _, err := rand.Read(b); err != nil {
+		return "", errors.Trace(err)
+	}
+	token := hex.EncodeToString(b)
+	if err := os.MkdirAll(filepath.Dir(fname), 0700); err != nil {
+		return "", errors.Trace(err)
+	}
+	// Write to a new file and rename it, so the token is never readable by others,
+	// even if fname existed with looser permissions.
+	tf, err := ioutil.TempFile(filepath.Dir(fname), "."+filepath.Base(fname)+".tmp*")
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	_, err = tf.WriteString(token)
+	if cerr := tf.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tf.Name(), fname)
+	}
+	if err != nil {
+		os.Remove(tf.Name())
+		return "", errors.Annotatef(err, "failed to write %s", fname)
+	}
+	return token, nil
+}
+
+// portAllowed returns true if the daemon may open the port on behalf of a client.
+// URLs could make the daemon connect anywhere, so only the one given to the daemon is allowed.
+func portAllowed(port string) bool {
+	return port == *flags.Port || !strings.Contains(port, "://") || strings.HasPrefix(port, "serial://")
+}
+
+// forward sends the request to the device specified by the frame destination
+// and returns the device's response.
+func (d *daemon) forward(ctx context.Context, f *frame.Frame) *frame.Frame {
+	resp := &frame.Response{ID: f.ID}
+	if subtle.ConstantTimeCompare([]byte(f.Key), []byte(d.token)) != 1 {
+		resp.Status = 403
+		resp.StatusMsg = "invalid daemon token"
+		return frame.NewResponseFrame("", f.Src, "", resp)
+	}
+	port := f.Dst
+	if port == "" {
+		port = *flags.Port
+	}
+	if !portAllowed(port) {
+		resp.Status = 403
+		resp.StatusMsg = "port not allowed: " + port
+		return frame.NewResponseFrame("", f.Src, "", resp)
+	}
+	pc, dc, err := d.getConn(ctx, port)
+	if err != nil {
+		resp.Status = 503
+		resp.StatusMsg = err.Error()
+		return frame.NewResponseFrame("", f.Src, "", resp)
+	}
+	cmd := frame.NewCommandFromFrame(f)
+	cmd.Auth = f.Auth
+	// Requests from different clients share the device connection, allocate a new ID to avoid clashes.
+	cmd.ID = 0
+	timeout := dc.GetTimeout()
+	if f.Timeout > 0 {
+		timeout = time.Duration(f.Timeout) * time.Second
+	}
+	cctx, cancel := context.WithTimeout(ctx, timeout)
+	defer cancel()
+	dresp, err := dc.RPC.Call(cctx, "", cmd, nil)
+	pc.touch()
+	if err != nil {
+		glog.Errorf("%s: %s: %s", pc.port, f.Method, err)
+		if !dc.IsConnected() {
+			pc.drop(dc)
+		}
+		resp.Status = 500
+		resp.StatusMsg = err.Error()
+		return frame.NewResponseFrame("", f.Src, "", resp)
+	}
+	dresp.ID = f.ID
+	return frame.NewResponseFrame("", f.Src, "", dresp)
+}
+
+// getConn returns a connection to the device on the given port, opening it if necessary.
+func (d *daemon) getConn(ctx context.Context, port string) (*pooledConn, *dev.MosDevConn, error) {
+	d.lock.Lock()
+	pc := d.conns[port]
+	if pc == nil {
+		pc = &pooledConn{port: port}
+		d.conns[port] = pc
+	}
+	d.lock.Unlock()
+	pc.lock.Lock()
+	defer pc.lock.Unlock()
+	if pc.dc == nil {
+		glog.Infof("Connecting to %s", port)
+		dc, err := devutil.CreateDevConn(ctx, port, func(junk []byte) {})
+		if err != nil {
+			return nil, nil, errors.Annotatef(err, "failed to connect to %s", port)
+		}
+		pc.dc = dc
+	}
+	pc.lastUsed = time.Now()
+	return pc, pc.dc, nil
+}
+
+func (pc *pooledConn) touch() {
+	pc.lock.Lock()
+	pc.lastUsed = time.Now()
+	pc.lock.Unlock()
+}
+
+// drop closes the connection if it is still dc, it will be re-established by the next request.
+func (pc *pooledConn) drop(dc *dev.MosDevConn) {
+	pc.lock.Lock()
+	defer pc.lock.Unlock()
+	if pc.dc == dc {
+		dc.Disconnect(context.Background())
+		pc.dc = nil
+	}
+}
+
+// closeIdle closes connections that have not been used for --daemon-idle-timeout,
+// so the port is released for other tools (flashers, serial consoles).
+func (d *daemon) closeIdle(ctx context.Context) {
+	ticker := time.NewTicker(*idleTimeoutFlag / 4)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ctx.Done():
+			return
+		case <-ticker.C:
+		}
+		d.lock.Lock()
+		var idle []*pooledConn
+		for _, pc := range d.conns {
+			idle = append(idle, pc)
+		}
+		d.lock.Unlock()
+		for _, pc := range idle {
+			pc.lock.Lock()
+			if pc.dc != nil && time.Since(pc.lastUsed) > *idleTimeoutFlag {
+				glog.Infof("Closing idle connection to %s", pc.port)
+				pc.dc.Disconnect(context.Background())
+				pc.dc = nil
+			}
+			pc.lock.Unlock()
+		}
+	}
+}
@@ -5,6 +5,7 @@ package datamap
 
 import (
 	"strings"
+	"sync"
 )
 
 // GetFailHandler, if specified, is called when DataMap.Get fails to get the
@@ -15,67 +16,179 @@ type GetFailHandler func(dm *DataMap, name string) (interface{}, bool)
 // set values by their JavaScript-like paths, e.g. "foo.bar.baz". It can also
 // have get-fail-handler, which is invoked if Get fails to find value at the
 // provided path. This way, clients can have some "phantom" values.
+//
+// Copies are cheap: a DataMap is a stack of layers, and a copy only gets a
+// new empty layer on top of the layers it shares with the original. So memory
+// grows with the number of values set, not with the number of copies.
 type DataMap struct {
-	data           map[string]interface{}
+	mtx            sync.Mutex
+	top            *layer
 	getFailHandler GetFailHandler
 }
 
+// Copying adds layers, once there are this many they are merged into one
+// to keep lookups fast.
+const maxLayers = 16
+
+// layer holds the values set on a DataMap since it was last copied. Once a
+// layer is shared by copies, it is never modified.
+type layer struct {
+	parent *layer
+	depth  int
+	// Values keyed by full path. No key is a prefix of another key in the
+	// same layer: setting "foo" drops "foo.bar", and setting "foo.bar" when
+	// "foo" is set modifies the value of "foo".
+	writes map[string]interface{}
+	// Number of keys in writes under each path prefix, e.g. "foo.bar.baz"
+	// counts for "foo" and "foo.bar".
+	prefixes map[string]int
+}
+
 // New creates new DataMap with the provided GetFailHandler.
 func New(getFailHandler GetFailHandler) *DataMap {
 	return &DataMap{
-		data:           make(map[string]interface{}),
+		top:            newLayer(nil),
 		getFailHandler: getFailHandler,
 	}
 }
 
-func (dm *DataMap) Copy() *DataMap {
-	ret := New(dm.getFailHandler)
-
-	ret.data = deepCopyMap(dm.data)
-
-	return ret
+func newLayer(parent *layer) *layer {
+	l := &layer{
+		parent:   parent,
+		depth:    1,
+		writes:   make(map[string]interface{}),
+		prefixes: make(map[string]int),
+	}
+	if parent != nil {
+		l.depth = parent.depth + 1
+	}
+	return l
 }
 
-func deepCopy(val interface{}) interface{} {
-	switch v := val.(type) {
-	case map[string]interface{}:
-		return deepCopyMap(v)
-	case []interface{}:
-		return deepCopySlice(v)
+// Copy returns a DataMap with the same contents, which can be modified
+// independently. It is safe to call Copy and Get concurrently.
+func (dm *DataMap) Copy() *DataMap {
+	dm.mtx.Lock()
+	defer dm.mtx.Unlock()
+
+	// Freeze the current top layer and put a new one on top of it, both for
+	// dm and for the copy. An empty layer does not need to be kept.
+	parent := dm.top
+	if len(parent.writes) == 0 {
+		parent = parent.parent
 	}
-	return val
-}
+	if parent != nil && parent.depth >= maxLayers {
+		parent = parent.flatten()
+	}
+	dm.top = newLayer(parent)
 
-func deepCopyMap(m map[string]interface{}) map[string]interface{} {
-	ret := map[string]interface{}{}
-	for k, v := range m {
-		ret[k] = deepCopy(v)
+	return &DataMap{
+		top:            newLayer(parent),
+		getFailHandler: dm.getFailHandler,
 	}
-	return ret
 }
 
-func deepCopySlice(in []interface{}) []interface{} {
-	ret := []interface{}{}
-	for _, v := range in {
-		ret = append(ret, deepCopy(v))
+// flatten returns a single layer with the same contents as l.
+func (l *layer) flatten() *layer {
+	var layers []*layer
+	for ; l != nil; l = l.parent {
+		layers = append(layers, l)
 	}
+	root := map[string]interface{}{}
+	for i := len(layers) - 1; i >= 0; i-- {
+		for k, v := range layers[i].writes {
+			root = setPath(root, k, v)
+		}
+	}
+	ret := newLayer(nil)
+	ret.writes = root
 	return ret
 }
 
 // Set sets new value at the provided name (path), like "foo.bar.baz". All
 // intermediary non-existing parts will be silently created.
+//
+// Maps are never modified in place, so that copies of this DataMap and values
+// previously returned by Get stay unchanged.
 func (dm *DataMap) Set(name string, value interface{}) {
-	// Note: we opted to use ${foo} instead of {{foo}}, because {{foo}} needs to
-	// be quoted in yaml, whereas ${foo} does not.
-	m, key := getMapKey(name, dm.data, true)
-	m[key] = value
+	dm.mtx.Lock()
+	defer dm.mtx.Unlock()
+	l := dm.top
+
+	// If a parent path is set in this layer, update its value.
+	for i := 0; i < len(name); i++ {
+		if name[i] != '.' {
+			continue
+		}
+		if v, ok := l.writes[name[:i]]; ok {
+			if m, ok := v.(map[string]interface{}); ok {
+				l.writes[name[:i]] = setPath(m, name[i+1:], value)
+			}
+			// Otherwise can't set a field of a non-map value.
+			return
+		}
+	}
+
+	// The new value replaces everything under it.
+	if l.prefixes[name] > 0 {
+		prefix := name + "."
+		for k := range l.writes {
+			if strings.HasPrefix(k, prefix) {
+				l.delete(k)
+			}
+		}
+	}
+	if _, ok := l.writes[name]; !ok {
+		for i := 0; i < len(name); i++ {
+			if name[i] == '.' {
+				l.prefixes[name[:i]]++
+			}
+		}
+	}
+	l.writes[name] = value
+}
+
+func (l *layer) delete(key string) {
+	delete(l.writes, key)
+	for i := 0; i < len(key); i++ {
+		if key[i] == '.' {
+			if l.prefixes[key[:i]]--; l.prefixes[key[:i]] == 0 {
+				delete(l.prefixes, key[:i])
+			}
+		}
+	}
+}
+
+// setPath returns a shallow copy of data with the value at path replaced.
+func setPath(data map[string]interface{}, path string, value interface{}) map[string]interface{} {
+	ret := make(map[string]interface{}, len(data)+1)
+	for k, v := range data {
+		ret[k] = v
+	}
+	i := strings.IndexByte(path, '.')
+	if i < 0 {
+		ret[path] = value
+		return ret
+	}
+	key, rest := path[:i], path[i+1:]
+	sub, ok := data[key].(map[string]interface{})
+	if _, exists := data[key]; exists && !ok {
+		// Can't set a field of a non-map value.
+		return ret
+	}
+	ret[key] = setPath(sub, rest, value)
+	return ret
 }
 
 // Get gets value at the provided name (path), like "foo.bar.baz". If value is
 // not found, returned bool is false.
 func (dm *DataMap) Get(name string) (interface{}, bool) {
-	m, key := getMapKey(name, dm.data, false)
-	if m == nil {
+	dm.mtx.Lock()
+	top := dm.top
+	dm.mtx.Unlock()
+
+	val, ok := getLayered(top, name)
+	if !ok {
 		// Non-existing var, resort to getFailHandler if it exists; otherwise
 		// return nil
 		if dm.getFailHandler != nil {
@@ -84,41 +197,82 @@ func (dm *DataMap) Get(name string) (interface{}, bool) {
 		return nil, false
 	}
 
-	return m[key], true
+	return val, true
 }
 
-// getMapKey is a helper function; it takes a path and returns a map and a key
-// to which the path corresponds.
-//
-// We can't take address of a map element in Go, so, this function cannot
-// handle empty paths. If empty path makes sense for the caller, then the
-// caller should have a special case for it.
-func getMapKey(
-	path string, data map[string]interface{}, addMissing bool,
-) (m map[string]interface{}, key string) {
-	parts := strings.SplitN(path, ".", 2)
-
-	val, ok := data[parts[0]]
-	if !ok {
-		if addMissing {
-			if len(parts) == 2 {
-				val = map[string]interface{}{}
-				data[parts[0]] = val
-			} else {
-				// We'll return data, parts[0] below
+func getLayered(top *layer, name string) (interface{}, bool) {
+	// Whether any of the layers above the one with the value has values
+	// under name, which then need to be merged into it.
+	overridden := false
+	for l := top; l != nil; l = l.parent {
+		if v, rest, ok := l.lookup(name); ok {
+			val, found := v, true
+			if rest != "" {
+				val, found = getPath(v, rest)
 			}
-		} else {
-			return nil, ""
+			if overridden {
+				return mergeOverrides(top, l, name, val, found)
+			}
+			return val, found
+		}
+		if l.prefixes[name] > 0 {
+			overridden = true
 		}
 	}
+	if overridden {
+		return mergeOverrides(top, nil, name, nil, false)
+	}
+	return nil, false
+}
+
+// lookup returns the value set in this layer at name or at a parent path of
+// name, and the rest of the path within that value.
+func (l *layer) lookup(name string) (interface{}, string, bool) {
+	for i := 0; i < len(name); i++ {
+		if name[i] == '.' {
+			if v, ok := l.writes[name[:i]]; ok {
+				return v, name[i+1:], true
+			}
+		}
+	}
+	v, ok := l.writes[name]
+	return v, "", ok
+}
 
-	if len(parts) == 1 {
-		return data, parts[0]
-	} else {
-		valMap, ok := val.(map[string]interface{})
+// mergeOverrides applies values set under name in the layers above base to
+// val, which is the value at name in base (or nil if base is nil).
+func mergeOverrides(top, base *layer, name string, val interface{}, found bool) (interface{}, bool) {
+	m, ok := val.(map[string]interface{})
+	if found && !ok {
+		return val, true
+	}
+	var layers []*layer
+	for l := top; l != base; l = l.parent {
+		layers = append(layers, l)
+	}
+	prefix := name + "."
+	for i := len(layers) - 1; i >= 0; i-- {
+		for k, v := range layers[i].writes {
+			if strings.HasPrefix(k, prefix) {
+				m = setPath(m, k[len(prefix):], v)
+			}
+		}
+	}
+	return m, true
+}
+
+// getPath returns the value at the given path within val.
+func getPath(val interface{}, path string) (interface{}, bool) {
+	for {
+		data, ok := val.(map[string]interface{})
 		if !ok {
-			return nil, ""
+			return nil, false
+		}
+		i := strings.IndexByte(path, '.')
+		if i < 0 {
+			val, ok = data[path]
+			return val, ok
 		}
-		return getMapKey(parts[1], valMap, addMissing)
+		val, path = data[path[:i]], path[i+1:]
 	}
 }
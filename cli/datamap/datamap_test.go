@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2017 Cesanta Software Limited
+// All rights reserved
+
+package datamap
+
+import (
+	"fmt"
+	"testing"
+)
+
+func expectGet(t *testing.T, dm *DataMap, name string, want interface{}) {
+	t.Helper()
+	val, ok := dm.Get(name)
+	if want == nil {
+		if ok {
+			t.Fatalf("%s: want no value, got %v", name, val)
+		}
+		return
+	}
+	if !ok {
+		t.Fatalf("%s: want %v, got no value", name, want)
+	}
+	if fmt.Sprint(val) != fmt.Sprint(want) {
+		t.Fatalf("%s: want %v, got %v", name, want, val)
+	}
+}
+
+func TestDataMapSetGet(t *testing.T) {
+	dm := New(nil)
+	dm.Set("foo", "foo_val")
+	dm.Set("bar.baz.boo", "boo_val")
+	dm.Set("bar.baz.qux", "qux_val")
+
+	expectGet(t, dm, "foo", "foo_val")
+	expectGet(t, dm, "bar.baz.boo", "boo_val")
+	expectGet(t, dm, "bar.baz", map[string]interface{}{"boo": "boo_val", "qux": "qux_val"})
+	expectGet(t, dm, "bar.baz.booo", nil)
+	expectGet(t, dm, "foo.bar", nil)
+
+	dm.Set("bar", map[string]interface{}{"x": "x_val"})
+	expectGet(t, dm, "bar.baz.boo", nil)
+	expectGet(t, dm, "bar.x", "x_val")
+	dm.Set("bar.y", "y_val")
+	expectGet(t, dm, "bar", map[string]interface{}{"x": "x_val", "y": "y_val"})
+}
+
+func TestDataMapCopy(t *testing.T) {
+	dm := New(nil)
+	m := map[string]interface{}{"platform": "esp32", "version": "1.0"}
+	dm.Set("mos", m)
+	dm.Set("foo", "foo_val")
+
+	dm2 := dm.Copy()
+	dm2.Set("mos.platform", "esp8266")
+	dm2.Set("foo", "foo_val2")
+	dm.Set("bar", "bar_val")
+
+	expectGet(t, dm, "mos.platform", "esp32")
+	expectGet(t, dm, "foo", "foo_val")
+	expectGet(t, dm, "bar", "bar_val")
+	expectGet(t, dm2, "mos.platform", "esp8266")
+	expectGet(t, dm2, "mos", map[string]interface{}{"platform": "esp8266", "version": "1.0"})
+	expectGet(t, dm2, "foo", "foo_val2")
+	expectGet(t, dm2, "bar", nil)
+	if m["platform"] != "esp32" {
+		t.Fatalf("value passed to Set was modified")
+	}
+
+	// A new value hides everything set under it in the lower layers.
+	dm3 := dm2.Copy()
+	dm3.Set("mos", map[string]interface{}{"arch": "x"})
+	expectGet(t, dm3, "mos.platform", nil)
+	expectGet(t, dm3, "mos.arch", "x")
+	expectGet(t, dm2, "mos.platform", "esp8266")
+
+	// Long chains of copies are merged.
+	for i := 0; i < 3*maxLayers; i++ {
+		dm3 = dm3.Copy()
+		dm3.Set(fmt.Sprintf("libs.l%d.path", i), fmt.Sprintf("p%d", i))
+	}
+	if dm3.top.depth > maxLayers+1 {
+		t.Fatalf("too many layers: %d", dm3.top.depth)
+	}
+	expectGet(t, dm3, "libs.l0.path", "p0")
+	expectGet(t, dm3, fmt.Sprintf("libs.l%d.path", 3*maxLayers-1), fmt.Sprintf("p%d", 3*maxLayers-1))
+	expectGet(t, dm3, "mos.arch", "x")
+	expectGet(t, dm3, "foo", "foo_val2")
+}
@@ -0,0 +1,359 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package debug_core_dump
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"regexp"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/ourutil"
+)
+
+const (
+	// Number of GDB containers to run at the same time in batch mode.
+	maxParallelSymbolizers = 4
+	// Marks the start of each core dump's output in the batch GDB run.
+	batchTraceMarker = "@@@ core dump "
+)
+
+// CoreDumpTrace is the result of symbolizing one core dump in batch mode.
+type CoreDumpTrace struct {
+	File string `json:"file"`
+	CoreDumpInfo
+	ELFFile string       `json:"elf_file,omitempty"`
+	Error   string       `json:"error,omitempty"`
+	Frames  []StackFrame `json:"frames,omitempty"`
+}
+
+type StackFrame struct {
+	Num      int    `json:"num"`
+	PC       string `json:"pc,omitempty"`
+	Function string `json:"function"`
+	File     string `json:"file,omitempty"`
+	Line     int    `json:"line,omitempty"`
+}
+
+// crlfStripReader drops CR and LF, core dump JSON is split into lines
+// at arbitrary places.
+type crlfStripReader struct {
+	r io.Reader
+}
+
+func (sr *crlfStripReader) Read(buf []byte) (int, error) {
+	for {
+		n, err := sr.r.Read(buf)
+		j := 0
+		for _, c := range buf[:n] {
+			if c != '\r' && c != '\n' {
+				buf[j] = c
+				j++
+			}
+		}
+		if j > 0 || err != nil {
+			return j, err
+		}
+	}
+}
+
+// readCoreDumpInfo reads the header of a core dump without reading all of
+// its (potentially large) contents.
+func readCoreDumpInfo(fname string) (CoreDumpInfo, error) {
+	f, err := os.Open(fname)
+	if err != nil {
+		return CoreDumpInfo{}, errors.Annotatef(err, "error reading file")
+	}
+	defer f.Close()
+	br := bufio.NewReader(f)
+	for {
+		line, err := br.ReadSlice('\n')
+		if bytes.Contains(line, []byte(CoreDumpStart)) {
+			break
+		}
+		if err == io.EOF {
+			// Not a dump saved by mos, fall back to the slow path.
+			return GetInfoFromCoreDumpFile(fname)
+		} else if err != nil && err != bufio.ErrBufferFull {
+			return CoreDumpInfo{}, errors.Annotatef(err, "error reading file")
+		}
+	}
+	var info CoreDumpInfo
+	dec := json.NewDecoder(&crlfStripReader{r: br})
+	if t, err := dec.Token(); err != nil || t != json.Delim('{') {
+		return info, errors.Errorf("core dump is not valid JSON object")
+	}
+	fields := map[string]*string{
+		"app":         &info.App,
+		"arch":        &info.Platform,
+		"version":     &info.Version,
+		"build_id":    &info.BuildID,
+		"build_image": &info.BuildImage,
+	}
+	// Header fields come first, stop as soon as we have them all.
+	for len(fields) > 0 && dec.More() {
+		t, err := dec.Token()
+		if err != nil {
+			return info, errors.Annotatef(err, "core dump is not valid JSON object")
+		}
+		key, _ := t.(string)
+		if p := fields[key]; p != nil {
+			if err := dec.Decode(p); err != nil {
+				return info, errors.Annotatef(err, "invalid %q", key)
+			}
+			delete(fields, key)
+		} else {
+			var skip json.RawMessage
+			if err := dec.Decode(&skip); err != nil {
+				return info, errors.Annotatef(err, "core dump is not valid JSON object")
+			}
+		}
+	}
+	return info, nil
+}
+
+// findELFFiles returns ELF files for the given build IDs. An ELF file is
+// matched by the build ID string embedded in the firmware.
+func findELFFiles(elfDir string, buildIDs []string) (map[string]string, error) {
+	res := map[string]string{}
+	if elfDir == "" {
+		return res, nil
+	}
+	err := filepath.Walk(elfDir, func(path string, fi os.FileInfo, err error) error {
+		if err != nil {
+			return errors.Trace(err)
+		}
+		if fi.IsDir() || !strings.HasSuffix(path, ".elf") || len(res) == len(buildIDs) {
+			return nil
+		}
+		data, err := ioutil.ReadFile(path)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		for _, bid := range buildIDs {
+			if _, found := res[bid]; !found && bid != "" && bytes.Contains(data, []byte(bid)) {
+				glog.V(1).Infof("%s: %s", bid, path)
+				res[bid] = path
+			}
+		}
+		return nil
+	})
+	return res, errors.Trace(err)
+}
+
+// DebugCoreDumpBatch symbolizes all the core dumps in dir and writes stack
+// traces to out as JSON. Dumps are grouped by build, and each group is
+// handled by a single GDB session that loads the ELF file only once.
+func DebugCoreDumpBatch(dir string, out io.Writer) error {
+	dir, err := filepath.Abs(dir)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	fis, err := ioutil.ReadDir(dir)
+	if err != nil {
+		return errors.Annotatef(err, "failed to list %s", dir)
+	}
+	var traces []*CoreDumpTrace
+	for _, fi := range fis {
+		if fi.Mode().IsRegular() {
+			traces = append(traces, &CoreDumpTrace{File: fi.Name()})
+		}
+	}
+
+	// Parse headers.
+	var wg sync.WaitGroup
+	work := make(chan *CoreDumpTrace)
+	for i := 0; i < runtime.NumCPU(); i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for t := range work {
+				info, err := readCoreDumpInfo(filepath.Join(dir, t.File))
+				if err != nil {
+					t.Error = err.Error()
+					continue
+				}
+				t.CoreDumpInfo = info
+			}
+		}()
+	}
+	for _, t := range traces {
+		work <- t
+	}
+	close(work)
+	wg.Wait()
+
+	// Group by build.
+	groups := map[string][]*CoreDumpTrace{}
+	var buildIDs []string
+	for _, t := range traces {
+		if t.Error != "" {
+			continue
+		}
+		key := fmt.Sprintf("%s/%s/%s", t.App, t.Platform, t.BuildID)
+		if groups[key] == nil {
+			buildIDs = append(buildIDs, t.BuildID)
+		}
+		groups[key] = append(groups[key], t)
+	}
+	ourutil.Reportf("%d core dumps, %d builds", len(traces), len(groups))
+	elfFiles, err := findELFFiles(fwELFDir, buildIDs)
+	if err != nil {
+		return errors.Annotatef(err, "failed to find ELF files")
+	}
+
+	sem := make(chan struct{}, maxParallelSymbolizers)
+	for _, g := range groups {
+		wg.Add(1)
+		go func(g []*CoreDumpTrace) {
+			defer wg.Done()
+			sem <- struct{}{}
+			defer func() { <-sem }()
+			info := g[0].CoreDumpInfo
+			elfFile := elfFiles[info.BuildID]
+			if elfFile == "" {
+				elfFile = getFwELFFile(info.App, info.Platform, info.Version, info.BuildID)
+			}
+			if err := symbolizeGroup(dir, elfFile, g); err != nil {
+				for _, t := range g {
+					t.Error = err.Error()
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+
+	data, err := json.MarshalIndent(traces, "", "  ")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	_, err = fmt.Fprintf(out, "%s\n", data)
+	return errors.Trace(err)
+}
+
+// symbolizeGroup runs one GDB session for core dumps of the same build.
+func symbolizeGroup(dir, elfFile string, traces []*CoreDumpTrace) error {
+	info := traces[0].CoreDumpInfo
+	if elfFile == "" {
+		return errors.Errorf("no ELF file for %s/%s %s", info.App, info.Platform, info.BuildID)
+	}
+	elfFile, err := filepath.Abs(elfFile)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	dp, ok := debugParams[strings.ToLower(info.Platform)]
+	if !ok {
+		return errors.Errorf("don't know how to handle %q", info.Platform)
+	}
+	dockerImage := info.BuildImage
+	if dockerImage == "" {
+		dockerImage = dp.image
+	}
+
+	// One GDB command file per dump: an error in one of them, e.g. a broken
+	// dump, does not stop the others.
+	scriptDir, err := ioutil.TempDir("", "mos-core-dumps-")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	defer os.RemoveAll(scriptDir)
+	serveCore := append([]string{*flags.GDBServerCmd}, dp.extraServeCoreArgs...)
+	gdbCmd := []string{"$MGOS_TARGET_GDB", "-batch", "-nx"}
+	for _, arg := range dp.extraGDBArgs {
+		gdbCmd = append(gdbCmd, shellQuote(arg))
+	}
+	for i, t := range traces {
+		t.ELFFile = elfFile
+		script := fmt.Sprintf(""+
+			"echo \\n%s%d\\n\n"+
+			"shell %s /fw.elf %s > /dev/null 2>&1 & echo $! > /tmp/serve_core.pid; sleep 1\n"+
+			"target remote 127.0.0.1:1234\n"+
+			"bt\n"+
+			"disconnect\n"+
+			"shell kill $(cat /tmp/serve_core.pid)\n",
+			batchTraceMarker, i, strings.Join(serveCore, " "), shellQuote(filepath.ToSlash(filepath.Join("/cores", t.File))))
+		sname := fmt.Sprintf("%d.gdb", i)
+		if err := ioutil.WriteFile(filepath.Join(scriptDir, sname), []byte(script), 0644); err != nil {
+			return errors.Trace(err)
+		}
+		gdbCmd = append(gdbCmd, "-x", "/scripts/"+sname)
+	}
+	gdbCmd = append(gdbCmd, "/fw.elf")
+
+	cmd := []string{"run", "--rm",
+		"-v", fmt.Sprintf("%s:/fw.elf", ourutil.GetPathForDocker(elfFile)),
+		"-v", fmt.Sprintf("%s:/cores:ro", ourutil.GetPathForDocker(dir)),
+		"-v", fmt.Sprintf("%s:/scripts:ro", ourutil.GetPathForDocker(scriptDir)),
+	}
+	if mosSrcPath := getMosSrcPath(); mosSrcPath != "" {
+		cmd = append(cmd, "-v", fmt.Sprintf("%s:/mongoose-os", ourutil.GetPathForDocker(mosSrcPath)))
+	}
+	cmd = append(cmd, dockerImage, "bash", "-c", strings.Join(gdbCmd, " "))
+	output, err := ourutil.GetCommandOutput("docker", cmd...)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	parseBatchTraces(output, traces)
+	return nil
+}
+
+var gdbFrameRegexp = regexp.MustCompile(`^#(\d+)\s+(?:(0x[0-9a-fA-F]+) in )?(\S+) \(.*\)(?: at (.+):(\d+))?`)
+
+// parseBatchTraces splits GDB output into traces of the individual dumps.
+func parseBatchTraces(output string, traces []*CoreDumpTrace) {
+	var cur *CoreDumpTrace
+	for _, line := range strings.Split(output, "\n") {
+		line = strings.TrimRight(line, "\r")
+		if strings.HasPrefix(line, batchTraceMarker) {
+			cur = nil
+			if i, err := strconv.Atoi(line[len(batchTraceMarker):]); err == nil && i < len(traces) {
+				cur = traces[i]
+			}
+			continue
+		}
+		m := gdbFrameRegexp.FindStringSubmatch(line)
+		if cur == nil || m == nil {
+			continue
+		}
+		f := StackFrame{PC: m[2], Function: m[3], File: m[4]}
+		f.Num, _ = strconv.Atoi(m[1])
+		f.Line, _ = strconv.Atoi(m[5])
+		cur.Frames = append(cur.Frames, f)
+	}
+	for _, t := range traces {
+		if len(t.Frames) == 0 && t.Error == "" {
+			t.Error = "no stack trace"
+		}
+	}
+}
+
+func shellQuote(s string) string {
+	return "'" + strings.Replace(s, "'", `'\''`, -1) + "'"
+}
@@ -85,11 +85,15 @@ var (
 
 	mosSrcPath = ""
 	fwELFFile  = ""
+	fwELFDir   = ""
+	batchDir   = ""
 )
 
 func init() {
 	flag.StringVar(&mosSrcPath, "mos-src-path", "", "Path to mos fw sources")
 	flag.StringVar(&fwELFFile, "fw-elf-file", "", "Path to teh firmware ELF file")
+	flag.StringVar(&fwELFDir, "fw-elf-dir", "", "Directory with firmware ELF files, matched to core dumps by build ID")
+	flag.StringVar(&batchDir, "batch", "", "Symbolize all core dumps in this directory and output stack traces as JSON")
 }
 
 func getMosSrcPath() string {
@@ -300,6 +304,9 @@ func findLatestCoreFile() string {
 }
 
 func DebugCoreDump(ctx context.Context, _ dev.DevConn) error {
+	if batchDir != "" {
+		return DebugCoreDumpBatch(batchDir, os.Stdout)
+	}
 	args := flag.Args()
 	var coreFile, elfFile string
 	if len(args) >= 2 {
@@ -28,6 +28,8 @@ type Client struct {
 	Port      string
 	Reconnect bool
 	Timeout   time.Duration
+	// PSK, if set, is sent as the pre-shared key with every request.
+	PSK string
 }
 
 func (c *Client) RegisterFlags(fs *flag.FlagSet) {
@@ -18,6 +18,8 @@ package dev
 
 import (
 	"context"
+	"sort"
+	"strings"
 	"time"
 
 	"github.com/juju/errors"
@@ -66,6 +68,90 @@ type DevConn interface {
 	Disconnect(context.Context) error
 }
 
+// BatchDevConn is implemented by connections that can pipeline requests.
+type BatchDevConn interface {
+	CallBatch(ctx context.Context, method string, args []interface{}, resps []interface{}, window int) error
+}
+
+// CallBatch invokes method once for each of args, keeping up to window requests in flight
+// if the connection supports it, and sequentially otherwise.
+// resps, if not nil, must be of the same length as args.
+func CallBatch(ctx context.Context, dc DevConn, method string, args []interface{}, resps []interface{}, window int) error {
+	if bdc, ok := dc.(BatchDevConn); ok && window != 1 {
+		return errors.Trace(bdc.CallBatch(ctx, method, args, resps, window))
+	}
+	for i, a := range args {
+		var resp interface{}
+		if resps != nil {
+			resp = resps[i]
+		}
+		if err := dc.Call(ctx, method, a, resp); err != nil {
+			return errors.Annotatef(err, "request %d", i)
+		}
+	}
+	return nil
+}
+
+// PendingCall is a request that has been sent but may not have completed yet.
+type PendingCall interface {
+	// Wait waits for the call to complete and unmarshals the response
+	// into resp given to CallAsync.
+	Wait() error
+}
+
+// AsyncDevConn is implemented by connections that can send a request
+// without waiting for the response to the previous one.
+type AsyncDevConn interface {
+	CallAsync(ctx context.Context, method string, args interface{}, resp interface{}) PendingCall
+	// CallWindow returns the number of requests that can be in flight,
+	// given the desired window.
+	CallWindow(window int) int
+}
+
+// BlobDevConn is implemented by connections that can carry raw binary attachments
+// with requests and responses, without base64 encoding (see frame.Frame.Blob).
+type BlobDevConn interface {
+	// BinaryFrames returns true if binary attachments can be sent over the connection now.
+	BinaryFrames() bool
+	// CallAsyncBlob is like CallAsync, with blob attached to the request.
+	// The attachment of the response, if any, is stored in respBlob.
+	CallAsyncBlob(ctx context.Context, method string, args interface{}, blob []byte, resp interface{}, respBlob *[]byte) PendingCall
+}
+
+// GetBlobDevConn returns the connection as BlobDevConn if it can currently carry
+// binary attachments, nil otherwise.
+func GetBlobDevConn(dc DevConn) BlobDevConn {
+	if bdc, ok := dc.(BlobDevConn); ok && bdc.BinaryFrames() {
+		return bdc
+	}
+	return nil
+}
+
+type completedCall struct {
+	err error
+}
+
+func (cc completedCall) Wait() error {
+	return cc.err
+}
+
+// CallAsync sends the request without waiting for the response if the connection
+// supports it, otherwise the call is performed synchronously.
+func CallAsync(ctx context.Context, dc DevConn, method string, args interface{}, resp interface{}) PendingCall {
+	if adc, ok := dc.(AsyncDevConn); ok {
+		return adc.CallAsync(ctx, method, args, resp)
+	}
+	return completedCall{err: dc.Call(ctx, method, args, resp)}
+}
+
+// CallWindow returns the number of requests that can be in flight on the connection.
+func CallWindow(dc DevConn, window int) int {
+	if adc, ok := dc.(AsyncDevConn); ok {
+		return adc.CallWindow(window)
+	}
+	return 1
+}
+
 const confOpAttempts = 3
 
 func SetConfig(ctx context.Context, dc DevConn, devConf *DevConf, setArgTmpl *ConfigSetArg) (bool, error) {
@@ -125,6 +211,78 @@ func GetConfig(ctx context.Context, dc DevConn) (*DevConf, error) {
 	return GetConfigLevel(ctx, dc, -1)
 }
 
+type configGetKeyArg struct {
+	Key   string `json:"key"`
+	Level *int   `json:"level,omitempty"`
+}
+
+// GetConfigPaths fetches only the parts of config at the given paths, using the key
+// argument of Config.Get. Requests for all the paths are sent as one batch.
+// Firmware that does not support the key argument returns the whole config,
+// in which case it is used as is. Empty path means the whole config.
+func GetConfigPaths(ctx context.Context, dc DevConn, level int, paths []string) (*DevConf, error) {
+	if len(paths) == 0 {
+		return GetConfigLevel(ctx, dc, level)
+	}
+	// Fetch shorter paths first, values for nested paths are then already there.
+	paths = append([]string(nil), paths...)
+	sort.Strings(paths)
+	var args []interface{}
+	for i, p := range paths {
+		if p == "" {
+			return GetConfigLevel(ctx, dc, level)
+		}
+		if i > 0 && strings.HasPrefix(p, args[len(args)-1].(configGetKeyArg).Key+".") {
+			continue
+		}
+		arg := configGetKeyArg{Key: p}
+		if level >= 0 {
+			arg.Level = &level
+		}
+		args = append(args, arg)
+	}
+	vals := make([]interface{}, len(args))
+	resps := make([]interface{}, len(args))
+	for i := range vals {
+		resps[i] = &vals[i]
+	}
+	attempts := confOpAttempts
+	for {
+		ctx2, cancel := context.WithTimeout(ctx, dc.GetTimeout())
+		defer cancel()
+		if err := CallBatch(ctx2, dc, "Config.Get", args, resps, 0); err != nil {
+			attempts -= 1
+			if attempts > 0 {
+				glog.Warningf("Error: %s", err)
+				continue
+			}
+			return nil, errors.Trace(err)
+		}
+		break
+	}
+	devConf := &DevConf{data: make(map[string]interface{})}
+	for i, a := range args {
+		if isWholeConfig(vals[i]) {
+			glog.V(1).Infof("Config.Get does not support key, got the whole config")
+			return &DevConf{data: vals[i].(map[string]interface{})}, nil
+		}
+		setMapKey(devConf.data, a.(configGetKeyArg).Key, vals[i])
+	}
+	return devConf, nil
+}
+
+// isWholeConfig returns true if v is the whole config, which firmware that ignores
+// the key argument of Config.Get returns regardless of whether the key exists.
+// The device section is always present at the top level of the config and nowhere below.
+func isWholeConfig(v interface{}) bool {
+	m, ok := v.(map[string]interface{})
+	if !ok {
+		return false
+	}
+	_, ok = m["device"].(map[string]interface{})
+	return ok
+}
+
 func GetInfo(ctx context.Context, dc DevConn) (*GetInfoResult, error) {
 	var r GetInfoResult
 	attempts := confOpAttempts
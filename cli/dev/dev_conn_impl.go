@@ -120,6 +120,7 @@ func (dc *MosDevConn) ConnectWithOpts(ctx context.Context, reconnect bool, tlsCo
 		mgrpc.TlsConfig(tlsConfig),
 		mgrpc.CompatArgs(*mgrpcCompatArgsFlag),
 		mgrpc.CodecOptions(dc.codecOpts),
+		mgrpc.SendPSK(dc.c.PSK),
 	}
 
 	dc.RPC, err = mgrpc.New(ctx, dc.ConnectAddr, opts...)
@@ -139,7 +140,7 @@ func isJSON(s string) bool {
 	return json.Unmarshal([]byte(s), &js) == nil
 }
 
-func (dc *MosDevConn) CallRaw(ctx context.Context, method string, args interface{}) (json.RawMessage, error) {
+func makeCommand(method string, args interface{}) (*frame.Command, error) {
 	argsJSON, ok := args.(string)
 	if !ok {
 		if args != nil {
@@ -161,6 +162,14 @@ func (dc *MosDevConn) CallRaw(ctx context.Context, method string, args interface
 	if argsJSON != "" {
 		cmd.Args.UnmarshalJSON([]byte(argsJSON))
 	}
+	return cmd, nil
+}
+
+func (dc *MosDevConn) CallRaw(ctx context.Context, method string, args interface{}) (json.RawMessage, error) {
+	cmd, err := makeCommand(method, args)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
 
 	resp, err := dc.RPC.Call(ctx, dc.Dest, cmd, rpccreds.GetRPCCreds)
 	if err != nil {
@@ -194,3 +203,83 @@ func (dc *MosDevConn) Call(ctx context.Context, method string, args interface{},
 	}
 	return nil
 }
+
+// CallBatch invokes method once for each of args, keeping up to window requests in flight.
+// Responses are unmarshaled into the corresponding elements of resps, nil elements are skipped.
+func (dc *MosDevConn) CallBatch(ctx context.Context, method string, args []interface{}, resps []interface{}, window int) error {
+	cmds := make([]*frame.Command, len(args))
+	for i, a := range args {
+		cmd, err := makeCommand(method, a)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		cmds[i] = cmd
+	}
+	frs, err := dc.RPC.CallBatch(ctx, dc.Dest, cmds, window, rpccreds.GetRPCCreds)
+	for i, resp := range frs {
+		if resp == nil {
+			continue
+		}
+		if resp.Status != 0 {
+			return errors.Errorf("request %d: remote error %d: %s", i, resp.Status, resp.StatusMsg)
+		}
+		if resps != nil && resps[i] != nil {
+			if err := json.Unmarshal(resp.Response, resps[i]); err != nil {
+				return errors.Annotatef(err, "request %d", i)
+			}
+		}
+	}
+	return errors.Trace(err)
+}
+
+type mosPendingCall struct {
+	pc       *mgrpc.PendingCall
+	resp     interface{}
+	respBlob *[]byte
+	err      error
+}
+
+func (mpc *mosPendingCall) Wait() error {
+	if mpc.err != nil {
+		return mpc.err
+	}
+	resp, err := mpc.pc.Wait()
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if resp.Status != 0 {
+		return errors.Errorf("remote error %d: %s", resp.Status, resp.StatusMsg)
+	}
+	if mpc.respBlob != nil {
+		*mpc.respBlob = resp.Blob
+	}
+	if mpc.resp != nil {
+		return json.Unmarshal(resp.Response, mpc.resp)
+	}
+	return nil
+}
+
+func (dc *MosDevConn) CallAsync(ctx context.Context, method string, args interface{}, resp interface{}) PendingCall {
+	cmd, err := makeCommand(method, args)
+	if err != nil {
+		return &mosPendingCall{err: errors.Trace(err)}
+	}
+	return &mosPendingCall{pc: dc.RPC.CallAsync(ctx, dc.Dest, cmd, rpccreds.GetRPCCreds), resp: resp}
+}
+
+func (dc *MosDevConn) BinaryFrames() bool {
+	return dc.RPC.BinaryFrames()
+}
+
+func (dc *MosDevConn) CallAsyncBlob(ctx context.Context, method string, args interface{}, blob []byte, resp interface{}, respBlob *[]byte) PendingCall {
+	cmd, err := makeCommand(method, args)
+	if err != nil {
+		return &mosPendingCall{err: errors.Trace(err)}
+	}
+	cmd.Blob = blob
+	return &mosPendingCall{pc: dc.RPC.CallAsync(ctx, dc.Dest, cmd, rpccreds.GetRPCCreds), resp: resp, respBlob: respBlob}
+}
+
+func (dc *MosDevConn) CallWindow(window int) int {
+	return dc.RPC.CallWindow(window)
+}
@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package dev
+
+import (
+	"context"
+	"encoding/json"
+	"testing"
+	"time"
+
+	"github.com/juju/errors"
+)
+
+const testConfigJSON = `{"device": {"id": "esp32_123456"}, "wifi": {"ap": {"enable": true, "ssid": "Mongoose"}}}`
+
+// fakeConfigConn serves Config.Get, with or without support for the key argument.
+type fakeConfigConn struct {
+	supportsKey bool
+}
+
+func (fc *fakeConfigConn) Call(ctx context.Context, method string, args interface{}, resp interface{}) error {
+	var config map[string]interface{}
+	json.Unmarshal([]byte(testConfigJSON), &config)
+	var res interface{} = config
+	if arg, ok := args.(configGetKeyArg); ok && fc.supportsKey {
+		m, key := getMapKey(arg.Key, config)
+		if m == nil {
+			return errors.Errorf("invalid config key")
+		}
+		res = m[key]
+	}
+	data, _ := json.Marshal(res)
+	return json.Unmarshal(data, resp)
+}
+
+func (fc *fakeConfigConn) GetTimeout() time.Duration           { return time.Second }
+func (fc *fakeConfigConn) Connect(context.Context, bool) error { return nil }
+func (fc *fakeConfigConn) Disconnect(context.Context) error    { return nil }
+
+func TestGetConfigPaths(t *testing.T) {
+	ctx := context.Background()
+	for _, supportsKey := range []bool{false, true} {
+		dc := &fakeConfigConn{supportsKey: supportsKey}
+		devConf, err := GetConfigPaths(ctx, dc, -1, []string{"wifi.ap.ssid", "device"})
+		if err != nil {
+			t.Fatalf("%t: %s", supportsKey, err)
+		}
+		if v, err := devConf.Get("wifi.ap.ssid"); err != nil || v != "Mongoose" {
+			t.Errorf("%t: wifi.ap.ssid: %q %v", supportsKey, v, err)
+		}
+		if v, err := devConf.Get("device.id"); err != nil || v != "esp32_123456" {
+			t.Errorf("%t: device.id: %q %v", supportsKey, v, err)
+		}
+		if !supportsKey {
+			// Old firmware returns the whole config for keys that don't exist as well.
+			devConf, err = GetConfigPaths(ctx, dc, -1, []string{"no.such"})
+			if err != nil {
+				t.Fatalf("%t: %s", supportsKey, err)
+			}
+			if v, err := devConf.Get("no.such"); err == nil {
+				t.Errorf("%t: no.such: expected an error, got %q", supportsKey, v)
+			}
+		}
+	}
+}
@@ -19,15 +19,18 @@ package devutil
 import (
 	"context"
 	"crypto/tls"
+	"io/ioutil"
 	"runtime"
 	"strings"
 	"time"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/common/mgrpc/codec"
+	"github.com/mongoose-os/mos/cli/common/paths"
 	"github.com/mongoose-os/mos/cli/dev"
 	"github.com/mongoose-os/mos/cli/flags"
 	"github.com/mongoose-os/mos/cli/watson"
+	glog "k8s.io/klog/v2"
 )
 
 func createDevConnWithJunkHandler(ctx context.Context, junkHandler func(junk []byte)) (dev.DevConn, error) {
@@ -35,6 +38,17 @@ func createDevConnWithJunkHandler(ctx context.Context, junkHandler func(junk []b
 	if err != nil {
 		return nil, errors.Trace(err)
 	}
+	devConn, err := CreateDevConn(ctx, port, junkHandler)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return devConn, nil
+}
+
+// CreateDevConn creates a connection to the device at the given port,
+// other connection parameters are taken from flags.
+func CreateDevConn(ctx context.Context, port string, junkHandler func(junk []byte)) (*dev.MosDevConn, error) {
+	var err error
 	c := dev.Client{Port: port, Timeout: *flags.Timeout, Reconnect: *flags.Reconnect}
 	prefix := "serial://"
 	if strings.Index(port, "://") > 0 {
@@ -62,7 +76,13 @@ func createDevConnWithJunkHandler(ctx context.Context, junkHandler func(junk []b
 		GCP: codec.GCPCodecOptions{
 			CreateTopic: *flags.GCPRPCCreateTopic,
 		},
-		MQTT: codec.MQTTCodecOptions{},
+		Compression: codec.CompressionOptions{
+			Threshold:   *flags.CompressThreshold,
+			NoNegotiate: *flags.CompressNoNegotiate,
+		},
+		MQTT: codec.MQTTCodecOptions{
+			PublishWindow: *flags.MQTTPublishWindow,
+		},
 		Serial: codec.SerialCodecOptions{
 			BaudRate:             uint(*flags.BaudRate),
 			HardwareFlowControl:  *flags.HWFC,
@@ -96,5 +116,34 @@ func createDevConnWithJunkHandler(ctx context.Context, junkHandler func(junk []b
 }
 
 func CreateDevConnFromFlags(ctx context.Context) (dev.DevConn, error) {
+	if *flags.Daemon {
+		devConn, err := createDaemonDevConn(ctx)
+		if err == nil {
+			return devConn, nil
+		}
+		glog.Warningf("mos daemon is not available (%s), connecting directly", err)
+	}
 	return createDevConnWithJunkHandler(ctx, func(junk []byte) {})
 }
+
+// createDaemonDevConn connects to a running "mos daemon", which forwards requests
+// to the device over a connection it keeps open.
+func createDaemonDevConn(ctx context.Context) (dev.DevConn, error) {
+	port, err := GetPort()
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	token, err := ioutil.ReadFile(paths.DaemonTokenFilepath)
+	if err != nil {
+		return nil, errors.Annotatef(err, "failed to read daemon token")
+	}
+	c := dev.Client{Port: port, Timeout: *flags.Timeout, PSK: strings.TrimSpace(string(token))}
+	devConn, err := c.CreateDevConn(ctx, "tcp://"+*flags.DaemonAddr, false /* reconnect */)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	// Daemon uses destination to pick the device.
+	devConn.Dest = port
+	glog.V(1).Infof("Using mos daemon at %s for %s", *flags.DaemonAddr, port)
+	return devConn, nil
+}
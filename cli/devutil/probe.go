@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package devutil
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/common/state"
+	"github.com/mongoose-os/mos/cli/dev"
+)
+
+var probeTimeoutFlag = flag.Duration("port-probe-timeout", 3*time.Second,
+	"How long to wait for a device to respond when probing serial ports")
+
+// ProbePorts identifies devices on the given serial ports by asking the firmware for Sys.GetInfo.
+// Ports are probed concurrently. Ports with no responding firmware are still returned,
+// with only the USB information filled in. Results are remembered in the mos state.
+func ProbePorts(ctx context.Context, ports []string) []state.SerialDevice {
+	res := make([]state.SerialDevice, len(ports))
+	var wg sync.WaitGroup
+	for i, port := range ports {
+		wg.Add(1)
+		go func(sd *state.SerialDevice, port string) {
+			defer wg.Done()
+			*sd = probePort(ctx, port)
+		}(&res[i], port)
+	}
+	wg.Wait()
+	if err := state.Init(); err == nil {
+		for _, sd := range res {
+			if sd.Arch != "" {
+				state.SetSerialDevice(sd)
+			}
+		}
+		if err := state.SaveState(); err != nil {
+			glog.Warningf("failed to save state: %s", err)
+		}
+	}
+	return res
+}
+
+func probePort(ctx context.Context, port string) state.SerialDevice {
+	sd := state.SerialDevice{Port: port, LastSeen: time.Now()}
+	sd.VID, sd.PID, sd.Serial = getUSBInfo(port)
+	ctx, cancel := context.WithTimeout(ctx, *probeTimeoutFlag)
+	defer cancel()
+	dc, err := CreateDevConn(ctx, port, func(junk []byte) {})
+	if err != nil {
+		glog.V(1).Infof("%s: %s", port, err)
+		return sd
+	}
+	defer dc.Disconnect(ctx)
+	var info dev.GetInfoResult
+	var id struct {
+		ID string `json:"id"`
+	}
+	if err := dc.Call(ctx, "Sys.GetInfo", nil, &info); err != nil {
+		glog.V(1).Infof("%s: %s", port, err)
+		return sd
+	}
+	if info.Arch != nil {
+		sd.Arch = *info.Arch
+	}
+	if info.Mac != nil {
+		sd.MAC = *info.Mac
+	}
+	if err := dc.Call(ctx, "Config.Get", map[string]string{"key": "device"}, &id); err == nil {
+		sd.ID = id.ID
+	}
+	return sd
+}
+
+// matchDevice returns true if the device matches spec "mac:MAC" or "id:ID".
+func matchDevice(sd *state.SerialDevice, spec string) bool {
+	parts := strings.SplitN(spec, ":", 2)
+	switch parts[0] {
+	case "mac":
+		normMAC := func(s string) string {
+			return strings.ToUpper(strings.NewReplacer(":", "", "-", "").Replace(s))
+		}
+		return sd.MAC != "" && normMAC(sd.MAC) == normMAC(parts[1])
+	case "id":
+		return sd.ID != "" && sd.ID == parts[1]
+	}
+	return false
+}
+
+// isDeviceSpec returns true if port selects a device by identity rather than a port.
+func isDeviceSpec(port string) bool {
+	return strings.HasPrefix(port, "mac:") || strings.HasPrefix(port, "id:")
+}
+
+// FindPort returns the serial port of the device matching spec ("mac:MAC" or "id:ID").
+// Devices remembered on USB adapters with serial numbers are found without probing,
+// even if the adapter has moved to a different port. Otherwise, all ports are probed.
+func FindPort(ctx context.Context, spec string) (string, error) {
+	ports := EnumerateSerialPorts()
+	if err := state.Init(); err == nil {
+		known := map[string]state.SerialDevice{}
+		for _, sd := range state.GetSerialDevices() {
+			if sd.Serial != "" && matchDevice(&sd, spec) {
+				known[sd.Key()] = sd
+			}
+		}
+		for _, port := range ports {
+			cur := state.SerialDevice{Port: port}
+			cur.VID, cur.PID, cur.Serial = getUSBInfo(port)
+			if _, ok := known[cur.Key()]; ok && cur.Serial != "" {
+				glog.Infof("%s: %s (remembered)", spec, port)
+				return port, nil
+			}
+		}
+	}
+	for _, sd := range ProbePorts(ctx, ports) {
+		if matchDevice(&sd, spec) {
+			return sd.Port, nil
+		}
+	}
+	return "", errors.Errorf("no device matching %q found on %d ports", spec, len(ports))
+}
+
+// FormatSerialDevice returns a one-line description of the device.
+func FormatSerialDevice(sd *state.SerialDevice) string {
+	usb := "-"
+	if sd.VID != "" {
+		usb = fmt.Sprintf("%s:%s", sd.VID, sd.PID)
+		if sd.Serial != "" {
+			usb += " " + sd.Serial
+		}
+	}
+	if sd.Arch == "" {
+		return fmt.Sprintf("%s\t%s\t(no response)", sd.Port, usb)
+	}
+	return fmt.Sprintf("%s\t%s\t%s\t%s\t%s", sd.Port, usb, sd.Arch, sd.MAC, sd.ID)
+}
@@ -17,6 +17,11 @@
 package devutil
 
 import (
+	"context"
+	"path/filepath"
+	"sort"
+	"strings"
+
 	"github.com/juju/errors"
 
 	"github.com/mongoose-os/mos/cli/flags"
@@ -26,6 +31,17 @@ import (
 var defaultPort string
 
 func GetPort() (string, error) {
+	if isDeviceSpec(*flags.Port) {
+		if defaultPort == "" {
+			port, err := FindPort(context.Background(), *flags.Port)
+			if err != nil {
+				return "", errors.Trace(err)
+			}
+			ourutil.Reportf("Using port %s", port)
+			defaultPort = port
+		}
+		return defaultPort, nil
+	}
 	if *flags.Port != "auto" {
 		return *flags.Port, nil
 	}
@@ -38,3 +54,43 @@ func GetPort() (string, error) {
 	}
 	return defaultPort, nil
 }
+
+// GetPorts returns the list of ports specified by --port.
+// In addition to a single port, --port can be a comma-separated list of ports
+// and/or glob patterns (e.g. /dev/ttyUSB*).
+func GetPorts() ([]string, error) {
+	if !strings.ContainsAny(*flags.Port, ",*?[") {
+		port, err := GetPort()
+		if err != nil {
+			return nil, errors.Trace(err)
+		}
+		return []string{port}, nil
+	}
+	var ports []string
+	seen := map[string]bool{}
+	for _, p := range strings.Split(*flags.Port, ",") {
+		p = strings.TrimSpace(p)
+		if p == "" {
+			continue
+		}
+		matches := []string{p}
+		if strings.ContainsAny(p, "*?[") {
+			var err error
+			matches, err = filepath.Glob(p)
+			if err != nil {
+				return nil, errors.Annotatef(err, "invalid port pattern %q", p)
+			}
+			sort.Strings(matches)
+		}
+		for _, m := range matches {
+			if !seen[m] {
+				ports = append(ports, m)
+				seen[m] = true
+			}
+		}
+	}
+	if len(ports) == 0 {
+		return nil, errors.Errorf("no ports match %q", *flags.Port)
+	}
+	return ports, nil
+}
@@ -35,3 +35,9 @@ func EnumerateSerialPorts() []string {
 	sort.Strings(filteredList)
 	return filteredList
 }
+
+// getUSBInfo returns the USB vendor and product ID and serial number of the port's adapter.
+// Not implemented on this platform, devices are only identified by port.
+func getUSBInfo(port string) (vid, pid, serial string) {
+	return "", "", ""
+}
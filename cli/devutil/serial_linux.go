@@ -17,8 +17,10 @@
 package devutil
 
 import (
+	"io/ioutil"
 	"path/filepath"
 	"sort"
+	"strings"
 )
 
 func EnumerateSerialPorts() []string {
@@ -29,3 +31,22 @@ func EnumerateSerialPorts() []string {
 	sort.Strings(list2)
 	return append(list1, list2...)
 }
+
+// getUSBInfo returns the USB vendor and product ID and serial number of the port's adapter.
+func getUSBInfo(port string) (vid, pid, serial string) {
+	dev, err := filepath.EvalSymlinks(filepath.Join("/sys/class/tty", filepath.Base(port), "device"))
+	if err != nil {
+		return "", "", ""
+	}
+	// The USB device is a few levels up from the tty device (interface, port for usb-serial).
+	for d := dev; d != "/" && d != "."; d = filepath.Dir(d) {
+		readAttr := func(name string) string {
+			data, _ := ioutil.ReadFile(filepath.Join(d, name))
+			return strings.TrimSpace(string(data))
+		}
+		if vid = readAttr("idVendor"); vid != "" {
+			return vid, readAttr("idProduct"), readAttr("serial")
+		}
+	}
+	return "", "", ""
+}
@@ -82,3 +82,9 @@ func getDefaultPort() string {
 	}
 	return filteredPorts[0]
 }
+
+// getUSBInfo returns the USB vendor and product ID and serial number of the port's adapter.
+// Not implemented on this platform, devices are only identified by port.
+func getUSBInfo(port string) (vid, pid, serial string) {
+	return "", "", ""
+}
@@ -0,0 +1,351 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"encoding/base64"
+	"encoding/json"
+	"path"
+	"sort"
+	"strings"
+	"sync"
+
+	"github.com/juju/errors"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/fs"
+	"github.com/mongoose-os/mos/common/mgrpc"
+	"github.com/mongoose-os/mos/common/mgrpc/frame"
+)
+
+// OTA states, as reported by OTA.Status.
+const (
+	otaStateIdle     = 0
+	otaStateProgress = 1
+)
+
+// Device emulates the FS, Config, OTA and Sys services of a device in memory.
+// It is safe to serve multiple connections with one device.
+type Device struct {
+	lock   sync.Mutex
+	files  map[string][]byte
+	config map[string]interface{}
+	// Firmware received with OTA.Write.
+	otaState int
+	otaData  []byte
+	// Last firmware committed with OTA.End.
+	firmware []byte
+}
+
+func NewDevice(deviceID string) *Device {
+	return &Device{
+		files: make(map[string][]byte),
+		config: map[string]interface{}{
+			"device": map[string]interface{}{"id": deviceID},
+			"debug":  map[string]interface{}{"level": 2},
+		},
+	}
+}
+
+type handlerFunc func(params json.RawMessage) (interface{}, error)
+
+func (d *Device) methods() map[string]handlerFunc {
+	return map[string]handlerFunc{
+		"Sys.GetInfo":  d.sysGetInfo,
+		"Sys.Reboot":   d.ok,
+		"Config.Get":   d.configGet,
+		"Config.Set":   d.configSet,
+		"Config.Save":  d.ok,
+		"FS.List":      d.fsList,
+		"FS.ListExt":   d.fsListExt,
+		"FS.Get":       d.fsGet,
+		"FS.Put":       d.fsPut,
+		"FS.Remove":    d.fsRemove,
+		"OTA.Status":   d.otaStatus,
+		"OTA.Begin":    d.otaBegin,
+		"OTA.Write":    d.otaWrite,
+		"OTA.End":      d.otaEnd,
+		"RPC.List":     d.rpcList,
+		"RPC.Describe": d.ok,
+	}
+}
+
+// addHandlers registers the device's services with rpc.
+func (d *Device) addHandlers(rpc mgrpc.MgRPC) {
+	for method, fn := range d.methods() {
+		fn := fn
+		rpc.AddHandler(method, func(_ mgrpc.MgRPC, f *frame.Frame) *frame.Frame {
+			params := f.Params
+			if len(params) == 0 {
+				params = f.DeprecatedArgs
+			}
+			resp := &frame.Response{ID: f.ID}
+			res, err := fn(params)
+			if err != nil {
+				resp.Status = 500
+				resp.StatusMsg = err.Error()
+			} else if res != nil {
+				resp.Response, _ = json.Marshal(res)
+			}
+			return frame.NewResponseFrame(f.Dst, f.Src, "", resp)
+		})
+	}
+}
+
+func unmarshalParams(params json.RawMessage, v interface{}) error {
+	if len(params) == 0 {
+		return nil
+	}
+	return errors.Annotatef(json.Unmarshal(params, v), "invalid args")
+}
+
+func (d *Device) ok(params json.RawMessage) (interface{}, error) {
+	return nil, nil
+}
+
+func (d *Device) rpcList(params json.RawMessage) (interface{}, error) {
+	var res []string
+	for m := range d.methods() {
+		res = append(res, m)
+	}
+	sort.Strings(res)
+	return res, nil
+}
+
+func (d *Device) sysGetInfo(params json.RawMessage) (interface{}, error) {
+	app, arch, fwID, fwVersion, mac := "emulator", "emulator", "20200101-000000", "1.0", "000000000000"
+	return &dev.GetInfoResult{App: &app, Arch: &arch, Fw_id: &fwID, Fw_version: &fwVersion, Mac: &mac}, nil
+}
+
+// getConfigKey returns the config subtree at a dotted key path.
+func getConfigKey(c map[string]interface{}, key string) (interface{}, bool) {
+	var v interface{} = c
+	for _, k := range strings.Split(key, ".") {
+		m, ok := v.(map[string]interface{})
+		if !ok {
+			return nil, false
+		}
+		if v, ok = m[k]; !ok {
+			return nil, false
+		}
+	}
+	return v, true
+}
+
+// mergeConfig merges src into dst, recursively.
+func mergeConfig(dst, src map[string]interface{}) {
+	for k, v := range src {
+		sm, ok1 := v.(map[string]interface{})
+		dm, ok2 := dst[k].(map[string]interface{})
+		if ok1 && ok2 {
+			mergeConfig(dm, sm)
+		} else {
+			dst[k] = v
+		}
+	}
+}
+
+func (d *Device) configGet(params json.RawMessage) (interface{}, error) {
+	var args struct {
+		Key string `json:"key"`
+	}
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if args.Key == "" {
+		return d.config, nil
+	}
+	v, ok := getConfigKey(d.config, args.Key)
+	if !ok {
+		return nil, errors.NotFoundf("config key %q", args.Key)
+	}
+	return v, nil
+}
+
+func (d *Device) configSet(params json.RawMessage) (interface{}, error) {
+	var args struct {
+		Config map[string]interface{} `json:"config"`
+	}
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	mergeConfig(d.config, args.Config)
+	return nil, nil
+}
+
+func (d *Device) fsListExt(params json.RawMessage) (interface{}, error) {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	res := []fs.ListExtResult{}
+	for name, data := range d.files {
+		name, size := name, int64(len(data))
+		res = append(res, fs.ListExtResult{Name: &name, Size: &size})
+	}
+	sort.Slice(res, func(i, j int) bool { return *res[i].Name < *res[j].Name })
+	return res, nil
+}
+
+func (d *Device) fsList(params json.RawMessage) (interface{}, error) {
+	files, _ := d.fsListExt(params)
+	res := []string{}
+	for _, f := range files.([]fs.ListExtResult) {
+		res = append(res, *f.Name)
+	}
+	return res, nil
+}
+
+func (d *Device) fsGet(params json.RawMessage) (interface{}, error) {
+	var args fs.GetArgs
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	if args.Filename == nil {
+		return nil, errors.Errorf("filename is required")
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	data, ok := d.files[path.Base(*args.Filename)]
+	if !ok {
+		return nil, errors.NotFoundf("%s", *args.Filename)
+	}
+	start := args.Offset
+	if start > int64(len(data)) {
+		start = int64(len(data))
+	}
+	end := int64(len(data))
+	if args.Len > 0 && start+args.Len < end {
+		end = start + args.Len
+	}
+	b64 := base64.StdEncoding.EncodeToString(data[start:end])
+	left := int64(len(data)) - end
+	return &fs.GetResult{Data: &b64, Left: &left}, nil
+}
+
+func (d *Device) fsPut(params json.RawMessage) (interface{}, error) {
+	var args fs.PutArgs
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	data, err := base64.StdEncoding.DecodeString(args.Data)
+	if err != nil {
+		return nil, errors.Annotatef(err, "invalid data")
+	}
+	name := path.Base(args.Filename)
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	f := d.files[name]
+	if !args.Append {
+		f = nil
+	}
+	// Retransmitted chunks overwrite what was received before.
+	if args.Offset < 0 || args.Offset > len(f) {
+		return nil, errors.Errorf("%s: offset %d is beyond the end of file (%d)", name, args.Offset, len(f))
+	}
+	d.files[name] = append(f[:args.Offset], data...)
+	return nil, nil
+}
+
+func (d *Device) fsRemove(params json.RawMessage) (interface{}, error) {
+	var args fs.RemoveArgs
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	if args.Filename == nil {
+		return nil, errors.Errorf("filename is required")
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	delete(d.files, path.Base(*args.Filename))
+	return nil, nil
+}
+
+func (d *Device) otaStatus(params json.RawMessage) (interface{}, error) {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	return map[string]int{"state": d.otaState}, nil
+}
+
+func (d *Device) otaBegin(params json.RawMessage) (interface{}, error) {
+	var args struct {
+		Size int `json:"size"`
+	}
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if d.otaState != otaStateIdle {
+		return nil, errors.Errorf("update is already in progress")
+	}
+	d.otaState = otaStateProgress
+	d.otaData = make([]byte, 0, args.Size)
+	return nil, nil
+}
+
+func (d *Device) otaWrite(params json.RawMessage) (interface{}, error) {
+	var args struct {
+		Offset int    `json:"offset"`
+		Data   string `json:"data"`
+	}
+	if err := unmarshalParams(params, &args); err != nil {
+		return nil, errors.Trace(err)
+	}
+	data, err := base64.StdEncoding.DecodeString(args.Data)
+	if err != nil {
+		return nil, errors.Annotatef(err, "invalid data")
+	}
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if d.otaState != otaStateProgress {
+		return nil, errors.Errorf("update is not in progress")
+	}
+	if args.Offset < 0 || args.Offset > len(d.otaData) {
+		return nil, errors.Errorf("offset %d is beyond the received data (%d)", args.Offset, len(d.otaData))
+	}
+	d.otaData = append(d.otaData[:args.Offset], data...)
+	return nil, nil
+}
+
+func (d *Device) otaEnd(params json.RawMessage) (interface{}, error) {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if d.otaState != otaStateProgress {
+		return nil, errors.Errorf("update is not in progress")
+	}
+	d.otaState = otaStateIdle
+	d.firmware, d.otaData = d.otaData, nil
+	return nil, nil
+}
+
+// Firmware returns the firmware received by the last completed update.
+func (d *Device) Firmware() []byte {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	return d.firmware
+}
+
+// File returns contents of the device file.
+func (d *Device) File(name string) ([]byte, bool) {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	data, ok := d.files[name]
+	return data, ok
+}
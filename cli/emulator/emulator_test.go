@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"bytes"
+	"context"
+	"fmt"
+	"math/rand"
+	"net"
+	"testing"
+	"time"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/fs"
+)
+
+func startEmulator(tb testing.TB, opts LinkOptions) (*Device, *dev.MosDevConn, func()) {
+	ctx, cancel := context.WithCancel(context.Background())
+	l, err := net.Listen("tcp", "127.0.0.1:0")
+	if err != nil {
+		tb.Fatal(err)
+	}
+	d := NewDevice("test")
+	go Serve(ctx, l, d, opts)
+	c := &dev.Client{Timeout: 10 * time.Second}
+	dc, err := c.CreateDevConn(ctx, "tcp://"+l.Addr().String(), false /* reconnect */)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return d, dc, func() {
+		dc.RPC.Disconnect(context.Background())
+		cancel()
+	}
+}
+
+func TestFSPutGet(t *testing.T) {
+	d, dc, stop := startEmulator(t, LinkOptions{Latency: time.Millisecond})
+	defer stop()
+	ctx := context.Background()
+	data := make([]byte, 10000)
+	rand.Read(data)
+	if err := fs.PutData(ctx, dc, bytes.NewReader(data), "test.bin"); err != nil {
+		t.Fatalf("put: %s", err)
+	}
+	if got, _ := d.File("test.bin"); !bytes.Equal(got, data) {
+		t.Fatalf("device file mismatch")
+	}
+	got, err := fs.GetFile(ctx, dc, "test.bin")
+	if err != nil {
+		t.Fatalf("get: %s", err)
+	}
+	if !bytes.Equal([]byte(got), data) {
+		t.Fatalf("got file mismatch")
+	}
+}
+
+// BenchmarkFSPut measures end to end upload throughput for a few link configurations.
+func BenchmarkFSPut(b *testing.B) {
+	data := make([]byte, 64*1024)
+	rand.Read(data)
+	for _, opts := range []LinkOptions{
+		{},
+		{BaudRate: 921600},
+		{BaudRate: 921600, Latency: 5 * time.Millisecond},
+	} {
+		b.Run(fmt.Sprintf("baud=%d,latency=%s", opts.BaudRate, opts.Latency), func(b *testing.B) {
+			_, dc, stop := startEmulator(b, opts)
+			defer stop()
+			b.SetBytes(int64(len(data)))
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if err := fs.PutData(context.Background(), dc, bytes.NewReader(data), "bench.bin"); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
@@ -0,0 +1,658 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"bytes"
+	"compress/zlib"
+	"context"
+	"crypto/md5"
+	"encoding/binary"
+	"hash"
+	"io"
+	"io/ioutil"
+	"math/bits"
+	"net"
+	"sync"
+	"time"
+
+	"github.com/cesanta/go-serial/serial"
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/flash/common"
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	"github.com/mongoose-os/mos/cli/flash/esp/rom_client"
+	"github.com/mongoose-os/mos/cli/flash/esp32"
+	"github.com/mongoose-os/mos/cli/flash/esp8266"
+)
+
+// ROM loader commands, see rom_client.
+const (
+	romCmdMemWriteStart  = 0x05
+	romCmdMemWriteFinish = 0x06
+	romCmdMemWriteBlock  = 0x07
+	romCmdSync           = 0x08
+	romCmdWriteReg       = 0x09
+	romCmdReadReg        = 0x0a
+)
+
+// Flasher stub commands and the number of arguments they take, see flasher.FlasherClient.
+const (
+	stubCmdFlashWrite      = 0x01
+	stubCmdFlashRead       = 0x02
+	stubCmdFlashDigest     = 0x03
+	stubCmdFlashReadChipID = 0x04
+	stubCmdFlashEraseChip  = 0x05
+	stubCmdFlashBootFW     = 0x06
+	stubCmdEcho            = 0x08
+	stubCmdReadReg         = 0x09
+	stubCmdWriteReg        = 0x0a
+)
+
+var stubCmdNumArgs = map[byte]int{
+	stubCmdFlashWrite:      3,
+	stubCmdFlashRead:       4,
+	stubCmdFlashDigest:     3,
+	stubCmdFlashReadChipID: 0,
+	stubCmdFlashEraseChip:  0,
+	stubCmdFlashBootFW:     0,
+	stubCmdEcho:            1,
+	stubCmdReadReg:         1,
+	stubCmdWriteReg:        2,
+}
+
+const (
+	espFlashSectorSize = 4096
+	// Max size of a write data block, flasher.BUF_SIZE.
+	espWriteBlockSize = 4096
+	// Manufacturer ID reported for the emulated flash chip.
+	espFlashMfg = 0xef
+	// Stub status codes, anything other than 0 is an error.
+	stubStatusOK    = 0x00
+	stubStatusError = 0x01
+)
+
+// ESPDevice emulates an ESP8266 or ESP32 chip as seen by "mos flash" over the UART:
+// the ROM loader and the flasher stub, with flash kept in memory.
+// Flash contents persist across connections, each connection starts in the ROM loader,
+// as if the chip was reset into it.
+type ESPDevice struct {
+	ct             esp.ChipType
+	stubParamsAddr uint32
+	lock           sync.Mutex
+	flash          []byte
+	regs           map[uint32]uint32
+	// eFuse controller, for chips that have one.
+	fuses esp.RegReaderWriter
+}
+
+// NewESPDevice returns a device with erased flash of the given size, which must be a power of two.
+func NewESPDevice(ct esp.ChipType, flashSize int) (*ESPDevice, error) {
+	if flashSize < espFlashSectorSize || flashSize&(flashSize-1) != 0 {
+		return nil, errors.Errorf("invalid flash size %d", flashSize)
+	}
+	d := &ESPDevice{
+		ct:    ct,
+		flash: bytes.Repeat([]byte{0xff}, flashSize),
+		regs:  make(map[uint32]uint32),
+	}
+	var stubJSON []byte
+	switch ct {
+	case esp.ChipESP8266:
+		stubJSON = esp8266.MustAsset("data/stub_flasher.json")
+	case esp.ChipESP32:
+		stubJSON = esp32.MustAsset("data/stub_flasher.json")
+		d.fuses = esp32.NewFakeFuseController()
+	default:
+		return nil, errors.Errorf("unknown chip type %d", ct)
+	}
+	// Stub parameters (ROM and flasher baud rates) are written here before running it.
+	stub, err := rom_client.ParseStub(stubJSON)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	d.stubParamsAddr = stub.ParamsStart
+	return d, nil
+}
+
+// Flash returns a copy of the flash contents.
+func (d *ESPDevice) Flash() []byte {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	return append([]byte(nil), d.flash...)
+}
+
+func (d *ESPDevice) readReg(reg uint32) uint32 {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if d.fuses != nil {
+		if v, err := d.fuses.ReadReg(reg); err == nil {
+			return v
+		}
+	}
+	return d.regs[reg]
+}
+
+func (d *ESPDevice) writeReg(reg, value uint32) {
+	d.lock.Lock()
+	defer d.lock.Unlock()
+	if d.fuses != nil && d.fuses.WriteReg(reg, value) == nil {
+		return
+	}
+	d.regs[reg] = value
+}
+
+func (d *ESPDevice) flashRange(addr, length uint32) bool {
+	return uint64(addr)+uint64(length) <= uint64(len(d.flash))
+}
+
+// Connect returns a serial port connected to the device over a link with the given options.
+// Baud rate of the link is that of the ROM loader, until the flasher stub switches it;
+// baud rate set on the port is ignored, the link always runs at the device's rate.
+func (d *ESPDevice) Connect(opts LinkOptions) serial.Serial {
+	c := newESPConn(d, opts)
+	go c.run()
+	return &espSerial{c: c}
+}
+
+// ServeESP accepts connections on l and serves the device over them until ctx is done.
+// Each connection is a separate session with the ROM loader.
+func ServeESP(ctx context.Context, l net.Listener, d *ESPDevice, opts LinkOptions) error {
+	go func() {
+		<-ctx.Done()
+		l.Close()
+	}()
+	for {
+		conn, err := l.Accept()
+		if err != nil {
+			if ctx.Err() != nil {
+				return nil
+			}
+			return errors.Trace(err)
+		}
+		glog.V(1).Infof("New ESP client %s", conn.RemoteAddr())
+		c := newESPConn(d, opts)
+		go c.run()
+		go func() {
+			io.Copy(c.rx, conn)
+			c.rx.Close()
+		}()
+		go func() {
+			io.Copy(conn, c.tx)
+			conn.Close()
+		}()
+	}
+}
+
+// espConn is a session with the device, from reset until disconnection.
+type espConn struct {
+	d *ESPDevice
+	// Device's receive and transmit directions of the UART.
+	rx, tx *uartPipe
+	srw    *common.SLIPReaderWriter
+	buf    []byte
+	stub   bool
+	booted bool
+	// Stub parameters, if written.
+	params []uint32
+	// Current memory write, see romCmdMemWriteStart.
+	memAddr, memBlockSize uint32
+}
+
+type readerWriter struct {
+	io.Reader
+	io.Writer
+}
+
+func newESPConn(d *ESPDevice, opts LinkOptions) *espConn {
+	c := &espConn{
+		d:   d,
+		rx:  newUARTPipe(opts),
+		tx:  newUARTPipe(opts),
+		buf: make([]byte, 4*espWriteBlockSize),
+	}
+	c.srw = common.NewSLIPReaderWriter(readerWriter{c.rx, c.tx})
+	return c
+}
+
+func (c *espConn) run() {
+	defer c.tx.Close()
+	for {
+		var err error
+		switch {
+		case c.booted:
+			// Firmware is "running", it does not talk to us.
+			_, err = c.rx.Read(c.buf)
+		case c.stub:
+			err = c.handleStubCmd()
+		default:
+			err = c.handleROMCmd()
+		}
+		if err != nil {
+			glog.V(1).Infof("ESP session ended: %s", err)
+			return
+		}
+	}
+}
+
+// readFrame reads a SLIP frame, skipping junk that can't be decoded.
+func (c *espConn) readFrame() ([]byte, error) {
+	for {
+		n, err := c.srw.Read(c.buf)
+		if err == nil {
+			return c.buf[:n], nil
+		}
+		if errors.Cause(err) == io.EOF {
+			return nil, err
+		}
+		glog.V(3).Infof("Invalid frame: %s", err)
+	}
+}
+
+func (c *espConn) romResponse(cmd byte, value uint32, ok bool) error {
+	statusLen := 2
+	if c.d.ct == esp.ChipESP32 {
+		statusLen = 4
+	}
+	status := make([]byte, statusLen)
+	if !ok {
+		status[0], status[1] = 1, 5
+	}
+	resp := bytes.NewBuffer([]byte{0x01, cmd})
+	binary.Write(resp, binary.LittleEndian, uint16(len(status)))
+	binary.Write(resp, binary.LittleEndian, value)
+	resp.Write(status)
+	_, err := c.srw.Write(resp.Bytes())
+	return err
+}
+
+func romChecksum(data []byte) uint8 {
+	cs := uint8(0xef)
+	for _, b := range data {
+		cs ^= b
+	}
+	return cs
+}
+
+func (c *espConn) handleROMCmd() error {
+	req, err := c.readFrame()
+	if err != nil {
+		return err
+	}
+	if len(req) < 8 || req[0] != 0x00 {
+		// The ROM ignores junk.
+		return nil
+	}
+	cmd, csum, data := req[1], req[4], req[8:]
+	if int(binary.LittleEndian.Uint16(req[2:4])) != len(data) {
+		return c.romResponse(cmd, 0, false)
+	}
+	arg := func(i int) uint32 {
+		return binary.LittleEndian.Uint32(data[i*4:])
+	}
+	switch cmd {
+	case romCmdSync:
+		for i := 0; i < 8; i++ {
+			if err := c.romResponse(cmd, 0, true); err != nil {
+				return err
+			}
+		}
+		return nil
+	case romCmdReadReg:
+		if len(data) < 4 {
+			break
+		}
+		return c.romResponse(cmd, c.d.readReg(arg(0)), true)
+	case romCmdWriteReg:
+		if len(data) < 8 {
+			break
+		}
+		c.d.writeReg(arg(0), arg(1))
+		return c.romResponse(cmd, 0, true)
+	case romCmdMemWriteStart:
+		if len(data) < 16 {
+			break
+		}
+		c.memBlockSize, c.memAddr = arg(2), arg(3)
+		return c.romResponse(cmd, 0, true)
+	case romCmdMemWriteBlock:
+		if len(data) < 16 {
+			break
+		}
+		block := data[16:]
+		if int(arg(0)) != len(block) || romChecksum(block) != csum {
+			break
+		}
+		c.memWrite(c.memAddr+arg(1)*c.memBlockSize, block)
+		return c.romResponse(cmd, 0, true)
+	case romCmdMemWriteFinish:
+		if len(data) < 8 {
+			break
+		}
+		if err := c.romResponse(cmd, 0, true); err != nil {
+			return err
+		}
+		if arg(0) == 0 {
+			return c.runStub()
+		}
+		return nil
+	}
+	return c.romResponse(cmd, 0, false)
+}
+
+// memWrite stores data written to RAM. Only stub parameters are of interest, the rest is discarded.
+func (c *espConn) memWrite(addr uint32, data []byte) {
+	if addr != c.d.stubParamsAddr {
+		return
+	}
+	c.params = nil
+	for i := 0; i+4 <= len(data); i += 4 {
+		c.params = append(c.params, binary.LittleEndian.Uint32(data[i:]))
+	}
+}
+
+// runStub "starts" the flasher stub, which switches to the flashing baud rate, if it was given,
+// and reports the previous UART clock divider.
+func (c *espConn) runStub() error {
+	c.stub = true
+	romBaudRate := uint32(115200)
+	if len(c.params) >= 2 {
+		if c.params[0] > 0 {
+			romBaudRate = c.params[0]
+		}
+		if c.params[1] > 0 {
+			glog.V(1).Infof("Stub switching to %d", c.params[1])
+			c.rx.setBaudRate(int(c.params[1]))
+			c.tx.setBaudRate(int(c.params[1]))
+		}
+	}
+	// UART clock is 80 MHz on ESP32, with the divider in 1/16ths, and 52 MHz on ESP8266 in the ROM.
+	div := 52000000 / romBaudRate
+	if c.d.ct == esp.ChipESP32 {
+		div = 80000000 * 16 / romBaudRate
+	}
+	var b [4]byte
+	binary.LittleEndian.PutUint32(b[:], div)
+	_, err := c.srw.Write(b[:])
+	return err
+}
+
+func (c *espConn) sendStatus(status byte) error {
+	_, err := c.srw.Write([]byte{status})
+	return err
+}
+
+func (c *espConn) handleStubCmd() error {
+	req, err := c.readFrame()
+	if err != nil {
+		return err
+	}
+	if len(req) != 1 {
+		// Empty packets are used to abort writes, there's nothing to abort.
+		return nil
+	}
+	cmd := req[0]
+	numArgs, ok := stubCmdNumArgs[cmd]
+	if !ok {
+		return c.sendStatus(stubStatusError)
+	}
+	var args []uint32
+	if numArgs > 0 {
+		req, err = c.readFrame()
+		if err != nil {
+			return err
+		}
+		if len(req) != numArgs*4 {
+			return c.sendStatus(stubStatusError)
+		}
+		for i := 0; i < numArgs; i++ {
+			args = append(args, binary.LittleEndian.Uint32(req[i*4:]))
+		}
+	}
+	var status byte
+	switch cmd {
+	case stubCmdFlashWrite:
+		status, err = c.flashWrite(args[0], args[1], args[2] != 0)
+	case stubCmdFlashRead:
+		status, err = c.flashRead(args[0], args[1], args[2], args[3])
+	case stubCmdFlashDigest:
+		status, err = c.flashDigest(args[0], args[1], args[2])
+	case stubCmdFlashReadChipID:
+		sizeExp := byte(bits.Len(uint(len(c.d.flash))) - 1)
+		_, err = c.srw.Write([]byte{espFlashMfg, 0x40, sizeExp, 0})
+	case stubCmdFlashEraseChip:
+		c.d.lock.Lock()
+		for i := range c.d.flash {
+			c.d.flash[i] = 0xff
+		}
+		c.d.lock.Unlock()
+	case stubCmdFlashBootFW:
+		c.booted = true
+	case stubCmdEcho:
+		_, err = c.srw.Write(req)
+	case stubCmdReadReg:
+		var b [4]byte
+		binary.LittleEndian.PutUint32(b[:], c.d.readReg(args[0]))
+		_, err = c.srw.Write(b[:])
+	case stubCmdWriteReg:
+		c.d.writeReg(args[0], args[1])
+	}
+	if err != nil {
+		return err
+	}
+	return c.sendStatus(status)
+}
+
+func microsSince(t time.Time) uint32 {
+	return uint32(time.Since(t) / time.Microsecond)
+}
+
+func (c *espConn) sendWriteProgress(numWritten int, digest hash.Hash) error {
+	b := bytes.NewBuffer(nil)
+	binary.Write(b, binary.LittleEndian, uint32(numWritten))
+	binary.Write(b, binary.LittleEndian, uint32(0)) // Data is processed as soon as it arrives.
+	b.Write(digest.Sum(nil))
+	_, err := c.srw.Write(b.Bytes())
+	return err
+}
+
+// flashWrite receives data blocks and writes them to flash, reporting progress after each block.
+// As with real flash, writing can only clear bits, so regions that were not erased get corrupted.
+func (c *espConn) flashWrite(addr, length uint32, erase bool) (byte, error) {
+	if !c.d.flashRange(addr, length) {
+		return stubStatusError, nil
+	}
+	start := time.Now()
+	var waitTime, decompTime, writeTime, eraseTime uint32
+	if erase {
+		eraseEnd := (addr + length + espFlashSectorSize - 1) / espFlashSectorSize * espFlashSectorSize
+		if eraseEnd > uint32(len(c.d.flash)) {
+			eraseEnd = uint32(len(c.d.flash))
+		}
+		c.d.lock.Lock()
+		for i := addr / espFlashSectorSize * espFlashSectorSize; i < eraseEnd; i++ {
+			c.d.flash[i] = 0xff
+		}
+		c.d.lock.Unlock()
+		eraseTime = microsSince(start)
+	}
+	digest := md5.New()
+	numWritten := 0
+	for {
+		if err := c.sendWriteProgress(numWritten, digest); err != nil {
+			return 0, err
+		}
+		if numWritten == int(length) {
+			break
+		}
+		ws := time.Now()
+		frame, err := c.readFrame()
+		if err != nil {
+			return 0, err
+		}
+		waitTime += microsSince(ws)
+		if len(frame) == 0 {
+			glog.V(1).Infof("Write aborted @ %d", numWritten)
+			return stubStatusError, nil
+		}
+		ds := time.Now()
+		block := frame[1:]
+		if frame[0] == 0x01 {
+			zr, err := zlib.NewReader(bytes.NewReader(block))
+			if err == nil {
+				block, err = ioutil.ReadAll(io.LimitReader(zr, espWriteBlockSize+1))
+			}
+			if err != nil {
+				glog.V(1).Infof("Invalid compressed block @ %d: %s", numWritten, err)
+				return stubStatusError, nil
+			}
+		}
+		decompTime += microsSince(ds)
+		if len(block) > espWriteBlockSize || numWritten+len(block) > int(length) {
+			return stubStatusError, nil
+		}
+		wts := time.Now()
+		c.d.lock.Lock()
+		dst := c.d.flash[int(addr)+numWritten:]
+		for i, b := range block {
+			dst[i] &= b
+		}
+		c.d.lock.Unlock()
+		digest.Write(block)
+		numWritten += len(block)
+		writeTime += microsSince(wts)
+	}
+	b := bytes.NewBuffer(nil)
+	for _, v := range []uint32{waitTime, decompTime, writeTime, eraseTime, microsSince(start)} {
+		binary.Write(b, binary.LittleEndian, v)
+	}
+	b.Write(digest.Sum(nil))
+	_, err := c.srw.Write(b.Bytes())
+	return stubStatusOK, err
+}
+
+// flashRead sends data in blocks, keeping up to maxInFlight bytes unacknowledged.
+func (c *espConn) flashRead(addr, length, blockSize, maxInFlight uint32) (byte, error) {
+	if !c.d.flashRange(addr, length) || blockSize == 0 {
+		return stubStatusError, nil
+	}
+	c.d.lock.Lock()
+	data := append([]byte(nil), c.d.flash[addr:addr+length]...)
+	c.d.lock.Unlock()
+	numSent, numAcked := uint32(0), uint32(0)
+	for numAcked < length {
+		if numSent < length && numSent-numAcked < maxInFlight {
+			n := length - numSent
+			if n > blockSize {
+				n = blockSize
+			}
+			if _, err := c.srw.Write(data[numSent : numSent+n]); err != nil {
+				return 0, err
+			}
+			numSent += n
+			continue
+		}
+		ack, err := c.readFrame()
+		if err != nil {
+			return 0, err
+		}
+		if len(ack) != 4 {
+			return stubStatusError, nil
+		}
+		numAcked = binary.LittleEndian.Uint32(ack)
+	}
+	digest := md5.Sum(data)
+	_, err := c.srw.Write(digest[:])
+	return stubStatusOK, err
+}
+
+// flashDigest sends digests of each block of the region, if blockSize is not 0, followed by the digest of the whole region.
+func (c *espConn) flashDigest(addr, length, blockSize uint32) (byte, error) {
+	if !c.d.flashRange(addr, length) {
+		return stubStatusError, nil
+	}
+	c.d.lock.Lock()
+	data := append([]byte(nil), c.d.flash[addr:addr+length]...)
+	c.d.lock.Unlock()
+	if blockSize > 0 {
+		for offset := uint32(0); offset < length; offset += blockSize {
+			end := offset + blockSize
+			if end > length {
+				end = length
+			}
+			d := md5.Sum(data[offset:end])
+			if _, err := c.srw.Write(d[:]); err != nil {
+				return 0, err
+			}
+		}
+	}
+	d := md5.Sum(data)
+	_, err := c.srw.Write(d[:])
+	return stubStatusOK, err
+}
+
+// espSerial is the host end of a connection to the device.
+type espSerial struct {
+	c           *espConn
+	readTimeout time.Duration
+}
+
+func (s *espSerial) Read(b []byte) (int, error) {
+	return s.c.tx.read(b, s.readTimeout)
+}
+
+func (s *espSerial) Write(b []byte) (int, error) {
+	return s.c.rx.Write(b)
+}
+
+func (s *espSerial) Close() error {
+	s.c.rx.Close()
+	s.c.tx.Close()
+	return nil
+}
+
+func (s *espSerial) SetReadTimeout(timeout time.Duration) error {
+	s.readTimeout = timeout
+	return nil
+}
+
+func (s *espSerial) SetBaudRate(baudRate uint) error {
+	return nil
+}
+
+func (s *espSerial) SetDTR(dtr bool) error {
+	return nil
+}
+
+func (s *espSerial) SetRTS(rts bool) error {
+	return nil
+}
+
+func (s *espSerial) SetRTSDTR(rts, dtr bool) error {
+	return nil
+}
+
+func (s *espSerial) SetBreak(brk bool) error {
+	return nil
+}
+
+// Flush discards data sent by the device that has not been read yet.
+func (s *espSerial) Flush() error {
+	s.c.tx.discard()
+	return nil
+}
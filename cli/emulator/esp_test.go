@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"bytes"
+	"crypto/md5"
+	"math/rand"
+	"testing"
+
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	"github.com/mongoose-os/mos/cli/flash/esp/flasher"
+	"github.com/mongoose-os/mos/cli/flash/esp/rom_client"
+)
+
+func connectESP(tb testing.TB, d *ESPDevice, opts LinkOptions, baudRate uint) *flasher.FlasherClient {
+	s := d.Connect(opts)
+	rc, err := rom_client.NewROMClient(d.ct, s, s, false)
+	if err != nil {
+		tb.Fatalf("ROM: %s", err)
+	}
+	fc, err := flasher.NewFlasherClient(d.ct, rc, espROMBaudRate, baudRate)
+	if err != nil {
+		tb.Fatalf("flasher: %s", err)
+	}
+	return fc
+}
+
+func TestESPFlash(t *testing.T) {
+	d, err := NewESPDevice(esp.ChipESP32, 1048576)
+	if err != nil {
+		t.Fatal(err)
+	}
+	fc := connectESP(t, d, LinkOptions{BaudRate: espROMBaudRate}, 921600)
+	defer fc.Disconnect()
+	if id, err := fc.GetFlashChipID(); err != nil || id != 0xef4014 {
+		t.Errorf("chip id: %06x %v", id, err)
+	}
+	data := make([]byte, 20000)
+	rand.Read(data[:10000]) // The rest compresses well.
+	for i, compress := range []bool{false, true} {
+		addr := uint32(0x10000 * (i + 1))
+		if _, err := fc.Write(addr, data, true /* erase */, compress); err != nil {
+			t.Fatalf("write (compress %t): %s", compress, err)
+		}
+		if got := d.Flash()[addr : addr+uint32(len(data))]; !bytes.Equal(got, data) {
+			t.Errorf("flash contents mismatch (compress %t)", compress)
+		}
+		rd := make([]byte, len(data))
+		if err := fc.Read(addr, rd); err != nil || !bytes.Equal(rd, data) {
+			t.Errorf("read (compress %t): %v", compress, err)
+		}
+		digests, err := fc.Digest(addr, uint32(len(data)), 4096)
+		if err != nil {
+			t.Fatalf("digest: %s", err)
+		}
+		if len(digests) != 6 {
+			t.Fatalf("expected 6 digests, got %d", len(digests))
+		}
+		if exp := md5.Sum(data[4096:8192]); !bytes.Equal(digests[1], exp[:]) {
+			t.Errorf("block digest mismatch")
+		}
+		if exp := md5.Sum(data); !bytes.Equal(digests[5], exp[:]) {
+			t.Errorf("digest mismatch")
+		}
+	}
+	// Without erase, bits can only be cleared.
+	if _, err := fc.Write(0x10000, make([]byte, 4096), false /* erase */, false); err != nil {
+		t.Fatalf("write: %s", err)
+	}
+	if got := d.Flash()[0x10000:0x11000]; !bytes.Equal(got, make([]byte, 4096)) {
+		t.Errorf("flash contents mismatch after write without erase")
+	}
+}
+
+func BenchmarkESPFlashWrite(b *testing.B) {
+	d, err := NewESPDevice(esp.ChipESP8266, 4194304)
+	if err != nil {
+		b.Fatal(err)
+	}
+	fc := connectESP(b, d, LinkOptions{BaudRate: espROMBaudRate}, 921600)
+	defer fc.Disconnect()
+	data := make([]byte, 262144)
+	rand.Read(data[:len(data)/2])
+	b.SetBytes(int64(len(data)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := fc.Write(0, data, true /* erase */, true); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"io"
+	"net"
+	"time"
+)
+
+// LinkOptions describe the emulated link between mos and the device.
+type LinkOptions struct {
+	// Baud rate of the link, 0 - unlimited. Each byte takes 10 bits, as on a UART with 8N1 framing.
+	BaudRate int
+	// Delay added to data in each direction.
+	Latency time.Duration
+}
+
+func (lo *LinkOptions) txTime(n int) time.Duration {
+	if lo.BaudRate <= 0 {
+		return 0
+	}
+	return time.Duration(n) * 10 * time.Second / time.Duration(lo.BaudRate)
+}
+
+type linkChunk struct {
+	data []byte
+	at   time.Time
+}
+
+// shapeLink copies data from src to dst as if it was sent over a link with the given options.
+// Data is pipelined: latency delays each chunk but does not limit the throughput.
+// dst is closed when src is exhausted.
+func shapeLink(dst io.WriteCloser, src io.Reader, opts LinkOptions) {
+	q := make(chan linkChunk, 64)
+	go func() {
+		defer close(q)
+		var busyUntil time.Time
+		for {
+			buf := make([]byte, 4096)
+			n, err := src.Read(buf)
+			if n > 0 {
+				now := time.Now()
+				if busyUntil.Before(now) {
+					busyUntil = now
+				}
+				busyUntil = busyUntil.Add(opts.txTime(n))
+				q <- linkChunk{data: buf[:n], at: busyUntil.Add(opts.Latency)}
+			}
+			if err != nil {
+				return
+			}
+		}
+	}()
+	for c := range q {
+		if d := time.Until(c.at); d > 0 {
+			time.Sleep(d)
+		}
+		if _, err := dst.Write(c.data); err != nil {
+			break
+		}
+	}
+	dst.Close()
+	for range q {
+	}
+}
+
+// shapeConn returns a connection whose traffic to and from conn is shaped according to opts.
+func shapeConn(conn net.Conn, opts LinkOptions) net.Conn {
+	if opts.BaudRate <= 0 && opts.Latency <= 0 {
+		return conn
+	}
+	ours, theirs := net.Pipe()
+	go shapeLink(theirs, conn, opts)
+	go shapeLink(conn, theirs, opts)
+	return ours
+}
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"context"
+	"net"
+	"strings"
+	"time"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	"github.com/mongoose-os/mos/cli/ourutil"
+	"github.com/mongoose-os/mos/common/mgrpc"
+	"github.com/mongoose-os/mos/common/mgrpc/codec"
+)
+
+var (
+	addrFlag     = flag.String("emulator-addr", "127.0.0.1:1992", "Address for the device emulator to listen on")
+	baudRateFlag = flag.Int("emulator-baud-rate", 0, "Emulate a link of this baud rate, 0 - unlimited")
+	latencyFlag  = flag.Duration("emulator-latency", 0, "Emulated link latency, in each direction")
+
+	espAddrFlag      = flag.String("emulator-esp-addr", "127.0.0.1:1991", "Address to emulate an ESP chip in flashing mode on, empty to disable")
+	espChipFlag      = flag.String("emulator-esp-chip", "esp32", "Type of the emulated ESP chip: esp32 or esp8266")
+	espFlashSizeFlag = flag.Int("emulator-esp-flash-size", 4194304, "Flash size of the emulated ESP chip")
+)
+
+// Baud rate of the ROM loader, the flasher stub switches to the flashing baud rate.
+const espROMBaudRate = 115200
+
+// Serve accepts connections on l and serves the device over them until ctx is done.
+func Serve(ctx context.Context, l net.Listener, d *Device, opts LinkOptions) error {
+	go func() {
+		<-ctx.Done()
+		l.Close()
+	}()
+	for {
+		conn, err := l.Accept()
+		if err != nil {
+			if ctx.Err() != nil {
+				return nil
+			}
+			return errors.Trace(err)
+		}
+		glog.V(1).Infof("New client %s", conn.RemoteAddr())
+		rpc := mgrpc.Serve(ctx, codec.TCP(shapeConn(conn, opts)))
+		d.addHandlers(rpc)
+	}
+}
+
+// Emulator runs an in-memory device that can be used instead of real hardware
+// to measure RPC, file system and OTA throughput, e.g.:
+//
+//	mos emulator --emulator-baud-rate 115200 --emulator-latency 5ms &
+//	mos --port tcp://127.0.0.1:1992 put big_file.bin
+//
+// The link is shaped to resemble a UART of the given speed.
+//
+// An ESP chip in flashing mode is emulated as well, to measure flashing throughput:
+//
+//	mos flash --platform esp32 --port tcp://127.0.0.1:1991 fw.zip
+//
+// Its link runs at the ROM loader's baud rate until the flasher switches it.
+func Emulator(ctx context.Context, _ dev.DevConn) error {
+	l, err := net.Listen("tcp", *addrFlag)
+	if err != nil {
+		return errors.Annotatef(err, "failed to listen on %s", *addrFlag)
+	}
+	opts := LinkOptions{BaudRate: *baudRateFlag, Latency: *latencyFlag}
+	ourutil.Reportf("Emulating a device at tcp://%s (baud rate %d, latency %s)", l.Addr(), opts.BaudRate, opts.Latency.Round(time.Microsecond))
+	if *espAddrFlag != "" {
+		var ct esp.ChipType
+		switch strings.ToLower(*espChipFlag) {
+		case "esp32":
+			ct = esp.ChipESP32
+		case "esp8266":
+			ct = esp.ChipESP8266
+		default:
+			return errors.Errorf("unknown ESP chip type %q", *espChipFlag)
+		}
+		d, err := NewESPDevice(ct, *espFlashSizeFlag)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		el, err := net.Listen("tcp", *espAddrFlag)
+		if err != nil {
+			return errors.Annotatef(err, "failed to listen on %s", *espAddrFlag)
+		}
+		espOpts := LinkOptions{BaudRate: espROMBaudRate, Latency: *latencyFlag}
+		ourutil.Reportf("Emulating %s in flashing mode at tcp://%s", ct, el.Addr())
+		go func() {
+			if err := ServeESP(ctx, el, d, espOpts); err != nil {
+				glog.Errorf("ESP emulator failed: %s", err)
+			}
+		}()
+	}
+	return Serve(ctx, l, NewDevice("emulator"), opts)
+}
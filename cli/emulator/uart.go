@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package emulator
+
+import (
+	"io"
+	"sync"
+	"time"
+)
+
+// uartPipe is one direction of an emulated UART: written data can be read
+// after the time it takes to transmit it at the current baud rate, plus latency.
+type uartPipe struct {
+	lock      sync.Mutex
+	opts      LinkOptions
+	chunks    []linkChunk
+	busyUntil time.Time
+	// Closed and replaced when new data is written or the pipe is closed.
+	notify chan struct{}
+	closed bool
+}
+
+func newUARTPipe(opts LinkOptions) *uartPipe {
+	return &uartPipe{opts: opts, notify: make(chan struct{})}
+}
+
+func (p *uartPipe) setBaudRate(baudRate int) {
+	p.lock.Lock()
+	p.opts.BaudRate = baudRate
+	p.lock.Unlock()
+}
+
+func (p *uartPipe) wake() {
+	close(p.notify)
+	p.notify = make(chan struct{})
+}
+
+func (p *uartPipe) Write(b []byte) (int, error) {
+	p.lock.Lock()
+	defer p.lock.Unlock()
+	if p.closed {
+		return 0, io.ErrClosedPipe
+	}
+	now := time.Now()
+	if p.busyUntil.Before(now) {
+		p.busyUntil = now
+	}
+	p.busyUntil = p.busyUntil.Add(p.opts.txTime(len(b)))
+	data := make([]byte, len(b))
+	copy(data, b)
+	p.chunks = append(p.chunks, linkChunk{data: data, at: p.busyUntil.Add(p.opts.Latency)})
+	p.wake()
+	return len(b), nil
+}
+
+// read returns data that has arrived, waiting for it for up to timeout (0 - forever).
+// io.EOF is returned on timeout, same as serial ports do, and when the pipe is closed.
+func (p *uartPipe) read(b []byte, timeout time.Duration) (int, error) {
+	var deadline time.Time
+	if timeout > 0 {
+		deadline = time.Now().Add(timeout)
+	}
+	for {
+		p.lock.Lock()
+		now := time.Now()
+		n := 0
+		for len(p.chunks) > 0 && n < len(b) && !p.chunks[0].at.After(now) {
+			c := &p.chunks[0]
+			nc := copy(b[n:], c.data)
+			n += nc
+			if c.data = c.data[nc:]; len(c.data) == 0 {
+				p.chunks = p.chunks[1:]
+			}
+		}
+		if n > 0 || p.closed {
+			p.lock.Unlock()
+			if n == 0 {
+				return 0, io.EOF
+			}
+			return n, nil
+		}
+		var wait <-chan time.Time
+		if len(p.chunks) > 0 {
+			wait = time.After(p.chunks[0].at.Sub(now))
+		}
+		var expired <-chan time.Time
+		if !deadline.IsZero() {
+			if now.After(deadline) {
+				p.lock.Unlock()
+				return 0, io.EOF
+			}
+			expired = time.After(deadline.Sub(now))
+		}
+		notify := p.notify
+		p.lock.Unlock()
+		select {
+		case <-notify:
+		case <-wait:
+		case <-expired:
+		}
+	}
+}
+
+// Read waits for data forever, it is used by the emulated device.
+func (p *uartPipe) Read(b []byte) (int, error) {
+	return p.read(b, 0)
+}
+
+// discard drops all the data in the pipe, including data in transit.
+func (p *uartPipe) discard() {
+	p.lock.Lock()
+	p.chunks = nil
+	p.lock.Unlock()
+}
+
+func (p *uartPipe) Close() error {
+	p.lock.Lock()
+	defer p.lock.Unlock()
+	if !p.closed {
+		p.closed = true
+		p.wake()
+	}
+	return nil
+}
@@ -21,6 +21,9 @@ package main
 import (
 	"context"
 	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/dev"
@@ -36,6 +39,10 @@ func init() {
 	flag.Uint32Var(&esp32FlashAddress, "esp32-flash-address", 0, "")
 }
 
+// esp32EncryptImage encrypts the input image with the key from --esp32-encryption-key-file.
+// If the key file is a directory, the image is encrypted with each of the keys in it
+// (e.g. per-device keys) and the output is a directory with an image per key,
+// named after the key file.
 func esp32EncryptImage(ctx context.Context, devConn dev.DevConn) error {
 	if len(flag.Args()) != 3 {
 		return errors.Errorf("input and output images are required")
@@ -46,7 +53,34 @@ func esp32EncryptImage(ctx context.Context, devConn dev.DevConn) error {
 	if err != nil {
 		return errors.Annotatef(err, "failed to read input file")
 	}
-	key, err := ioutil.ReadFile(espFlashOpts.ESP32EncryptionKeyFile)
+	keyFile := espFlashOpts.ESP32EncryptionKeyFile
+	if fi, err := os.Stat(keyFile); err != nil || !fi.IsDir() {
+		return errors.Trace(esp32EncryptImageWithKey(inData, keyFile, outFile))
+	}
+	keyFiles, err := ioutil.ReadDir(keyFile)
+	if err != nil {
+		return errors.Annotatef(err, "failed to list keys")
+	}
+	if err := os.MkdirAll(outFile, 0755); err != nil {
+		return errors.Annotatef(err, "failed to create output dir")
+	}
+	n := 0
+	for _, kfi := range keyFiles {
+		if kfi.IsDir() || strings.HasPrefix(kfi.Name(), ".") {
+			continue
+		}
+		name := strings.TrimSuffix(kfi.Name(), filepath.Ext(kfi.Name())) + filepath.Ext(inFile)
+		if err := esp32EncryptImageWithKey(inData, filepath.Join(keyFile, kfi.Name()), filepath.Join(outFile, name)); err != nil {
+			return errors.Annotatef(err, "%s", kfi.Name())
+		}
+		n++
+	}
+	reportf("Wrote %d images to %s", n, outFile)
+	return nil
+}
+
+func esp32EncryptImageWithKey(inData []byte, keyFile, outFile string) error {
+	key, err := ioutil.ReadFile(keyFile)
 	if err != nil {
 		return errors.Annotatef(err, "failed to read encryption key")
 	}
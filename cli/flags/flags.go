@@ -33,7 +33,9 @@ var (
 	// --arch was deprecated at 2017/08/15 and should eventually be removed.
 	archOld = flag.String("arch", "", "Deprecated, please use --platform instead")
 	Port    = flag.String("port", "auto", "Serial port where the device is connected. "+
-		"If set to 'auto', ports on the system will be enumerated and the first will be used.")
+		"If set to 'auto', ports on the system will be enumerated and the first will be used. "+
+		"For flash, can be a comma-separated list of ports or glob patterns to flash multiple devices at once. "+
+		"mac:MAC or id:DEVICE_ID selects the serial port of the device with that MAC address or device ID.")
 	BaudRate    = flag.Int("baud-rate", 115200, "Serial port speed")
 	Board       = flag.String("board", "", "Board name.")
 	BuildInfo   = flag.String("build-info", "", "")
@@ -53,6 +55,7 @@ var (
 
 	ChunkSize      = flag.Int("chunk-size", 512, "Chunk size for operations")
 	FsOpAttempts   = flag.Int("fs-op-attempts", 3, "Chunk size for operations")
+	BinaryData     = flag.Bool("binary-data", true, "Send FS and OTA data as raw binary attachments if the device connection has negotiated binary frames")
 	PID            = flag.String("pid", "mos", "")
 	UID            = flag.String("uid", "", "")
 	CertFile       = flag.String("cert-file", "", "Certificate file name")
@@ -63,6 +66,8 @@ var (
 	Timeout        = flag.Duration("timeout", 20*time.Second, "Timeout for the device connection and call operation")
 	Reconnect      = flag.Bool("reconnect", false, "Enable reconnection")
 	HWFC           = flag.Bool("hw-flow-control", false, "Enable hardware flow control (CTS/RTS)")
+	Daemon         = flag.Bool("daemon", false, "Send device requests through a running 'mos daemon' instead of connecting directly")
+	DaemonAddr     = flag.String("daemon-addr", "127.0.0.1:1993", "Local address of the 'mos daemon'")
 
 	LicenseServer    = flag.String("license-server", "https://license.mongoose-os.com", "License server address")
 	LicenseServerKey = flag.String("license-server-key", "", "License server key")
@@ -70,6 +75,17 @@ var (
 	InvertedControlLines = flag.Bool("inverted-control-lines", false, "DTR and RTS control lines use inverted polarity")
 	SetControlLines      = flag.Bool("set-control-lines", true, "Set RTS and DTR explicitly when in console/RPC mode")
 
+	Stats             = flag.Bool("stats", false, "Print RPC call and traffic statistics when done")
+	StartupTrace      = flag.Bool("startup-trace", false, "Print time spent in each phase of startup when done")
+	CPUProfile        = flag.String("cpuprofile", "", "Write CPU profile to this file, view with \"go tool pprof\"")
+	MemProfile        = flag.String("memprofile", "", "Write heap profile to this file when done")
+	Trace             = flag.String("trace", "", "Write execution trace to this file, view with \"go tool trace\"")
+	CompressThreshold = flag.Int("compress-threshold", 0, "Compress frames larger than this many bytes sent over cloud connections (GCP, HTTP, MQTT, Watson) "+
+		"once the other side is known to support it, 0 - never")
+	CompressNoNegotiate = flag.Bool("compress-no-negotiate", false, "With --compress-threshold, compress frames right away instead of waiting for the other side "+
+		"to show it supports compression. GCP and MQTT devices only show it by sending a compressed frame first")
+	MQTTPublishWindow = flag.Int("mqtt-publish-window", 0, "Maximum number of MQTT publishes in flight, 0 - wait for each one to complete")
+
 	AzureConnectionString = flag.String("azure-connection-string", "", "Azure connection string")
 
 	GCPProject        = flag.String("gcp-project", "", "Google IoT project ID")
@@ -120,6 +136,7 @@ var (
 	LibsExtra          = flag.StringArray("lib-extra", []string{}, "Extra libs to add to the app being built. Value should be a YAML string. Can be used multiple times.")
 	SaveBuildStat      = flag.Bool("save-build-stat", true, "save build statistics")
 	PreferPrebuiltLibs = flag.Bool("prefer-prebuilt-libs", false, "if both sources and prebuilt binary of a lib exists, use the binary")
+	NoManifestCache    = flag.Bool("no-manifest-cache", false, "do not reuse libs resolved by the previous build even if manifests have not changed")
 
 	DepsVersions       = flag.String("deps-versions", "", "If specified, this file will be consulted for all libs and modules versions")
 	StrictDepsVersions = flag.Bool("strict-deps-versions", true, "If set, then --deps-versions will be in strict mode: missing deps will be disallowed")
@@ -136,8 +153,17 @@ var (
 			"For build to work, volumes will need to be provided externally via --build-docker-extra, "+
 			"e.g. --build-docker-extra=--volumes-from=outer",
 	)
+	BuildDockerReuse = flag.Bool(
+		"build-docker-reuse", false,
+		"if set, build containers are kept running and reused by subsequent builds with the same image and mounts, "+
+			"instead of starting a new container every time. Containers are named mos_build_<hash>, "+
+			"remove them with docker rm -f when no longer needed.",
+	)
 	BuildImage       = flag.String("build-image", "", "Override the Docker image used for build.")
 	BuildParalellism = flag.Int("build-parallelism", 0, "build parallelism. default is to use number of CPUs.")
+	CompileCacheDir  = flag.String("compile-cache-dir", "",
+		"if set, compiled objects are cached in this dir (in ccache format) and shared between builds "+
+			"of all apps using the same build image. Requires ccache in the build image.")
 )
 
 func Platform() string {
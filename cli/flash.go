@@ -31,6 +31,7 @@ import (
 	flag "github.com/spf13/pflag"
 	glog "k8s.io/klog/v2"
 
+	"github.com/mongoose-os/mos/cli/common/paths"
 	"github.com/mongoose-os/mos/cli/dev"
 	"github.com/mongoose-os/mos/cli/devutil"
 	"github.com/mongoose-os/mos/cli/flags"
@@ -58,15 +59,27 @@ func init() {
 	// CC3200
 	flag.IntVar(&cc3200FlashOpts.FormatSLFSSize, "cc3200-format-slfs-size", 1048576,
 		"Format SLFS for this flash size (bytes)")
+	flag.IntVar(&cc3200FlashOpts.StatusWindow, "cc3200-status-window", 1,
+		"Check write status once per this many chunks instead of after every chunk. "+
+			"Saves a round trip per chunk, but a failed write is only detected at the end of the window.")
 	// CC3220
 	flag.StringVar(&cc3220FlashOpts.BPIBinary, "cc3220-bpi-binary", "",
 		"Path to BuildProgrammingImage binary. If not set will try looking in the default TI dir.")
+	flag.IntVar(&cc3220FlashOpts.StatusWindow, "cc3220-status-window", 1,
+		"Check write status once per this many chunks instead of after every chunk. "+
+			"Saves a round trip per chunk, but a failed write is only detected at the end of the window.")
+	flag.StringVar(&cc3220FlashOpts.UCFCacheDir, "cc3220-ucf-cache-dir", "~/.mos/cc3220-ucf-cache",
+		"Directory to keep generated UCF images in, so re-flashing the same firmware to the same device "+
+			"does not need to run BuildProgrammingImage again. Set to empty to disable.")
 
 	// ESP8266, ESP32
 	flag.UintVar(&espFlashOpts.ROMBaudRate, "esp-rom-baud-rate", 115200,
 		"Data port speed when talking to ROM loader")
 	flag.UintVar(&espFlashOpts.FlasherBaudRate, "esp-baud-rate", 921600,
 		"Data port speed during flashing. 0 - don't change (== --esp-rom-baud-rate)")
+	flag.BoolVar(&espFlashOpts.AutoBaudRate, "esp-auto-baud-rate", false,
+		"Find the fastest baud rate that works reliably and use it for flashing. "+
+			"Selected rate is remembered for the port. Overrides --esp-baud-rate.")
 	flag.StringVar(&espFlashOpts.DataPort, "esp-data-port", "",
 		"If specified, this port will be used to send data during flashing. "+
 			"If not set, --port is used.")
@@ -80,9 +93,24 @@ func init() {
 		"Erase entire chip before flashing")
 	flag.BoolVar(&espFlashOpts.EnableCompression, "esp-enable-compression", true,
 		"Compress data while writing to flash. Usually makes flashing faster.")
+	flag.IntVar(&espFlashOpts.WriteWindow, "esp-write-window", 0,
+		"Max amount of data in flight to the flasher during writes, in bytes. 0 - use default.")
+	flag.BoolVar(&espFlashOpts.AdaptiveWriteWindow, "esp-adaptive-write-window", false,
+		"Start with --esp-write-window and increase it, up to the default, while the flasher keeps up with incoming data.")
+	flag.IntVar(&espFlashOpts.ReadWindow, "esp-flash-read-window", 0,
+		"Max amount of data the flasher sends during reads before waiting for acknowledgement, in bytes. "+
+			"0 - acknowledge every block, which is slower but works around slow USB serial drivers (Mac).")
+	flag.StringVar(&espFlashOpts.JSONStatsFile, "json-stats", "",
+		"If set, per-image flash write stats are saved to this file in JSON format.")
 	flag.BoolVar(&espFlashOpts.MinimizeWrites, "esp-minimize-writes", true,
 		"Minimize the number of blocks to write by comparing current contents "+
 			"with the images being written")
+	flag.StringVar(&espFlashOpts.DigestCacheDir, "esp-digest-cache-dir", "~/.mos/flash-digests",
+		"Directory to store digests of the data written to devices, to speed up --esp-minimize-writes "+
+			"when re-flashing the same device. Set to empty to disable.")
+	flag.BoolVar(&espFlashOpts.VerifyReadBack, "esp-verify-read-back", true,
+		"After writing, verify flash contents by reading back digests of all images. "+
+			"If disabled, digests checked by the flasher while writing are used as verification.")
 	flag.BoolVar(&espFlashOpts.BootFirmware, "esp-boot-after-flashing", true,
 		"Boot the firmware after flashing")
 	flag.StringVar(&espFlashOpts.ESP32EncryptionKeyFile, "esp32-encryption-key-file", "",
@@ -98,6 +126,8 @@ func init() {
 	flag.StringVar(&stm32FlashOpts.STFlashPath, "stm32-stflash-path", "st-flash",
 		"Path to the st-flash utility (from the https://github.com/texane/stlink package). "+
 			"If set to empty, will not attempt to use ST-Flash.")
+	flag.BoolVar(&stm32FlashOpts.MinimizeWrites, "stm32-minimize-writes", true,
+		"When using st-flash, read current flash contents and only write blocks that differ.")
 	if runtime.GOOS == "windows" {
 		// STM32 Windows driver _sometimes_ removes .bin file quite unhurriedly,
 		// and flasher prints an error even if flashing itself was successfull
@@ -164,16 +194,26 @@ func flash(ctx context.Context, devConn dev.DevConn) error {
 	}
 
 	port := ""
+	var ports []string
 	if fw.Platform != "stm32" && fw.Platform != "rs14100" {
-		port, err = devutil.GetPort()
+		ports, err = devutil.GetPorts()
 		if err != nil {
 			return errors.Trace(err)
 		}
+		port = ports[0]
+	}
+	platform := strings.ToLower(fw.Platform)
+	if len(ports) > 1 && platform != "esp32" && platform != "esp8266" {
+		return errors.Errorf("flashing multiple devices is not supported for %s", fw.Platform)
 	}
 
 	espFlashOpts.InvertedControlLines = *flags.InvertedControlLines
+	espFlashOpts.DigestCacheDir, err = paths.NormalizePath(espFlashOpts.DigestCacheDir, version.GetMosVersion())
+	if err != nil {
+		return errors.Trace(err)
+	}
 
-	switch strings.ToLower(fw.Platform) {
+	switch platform {
 	case "cc3200":
 		cc3200FlashOpts.Port = port
 		cc3200FlashOpts.KeepFS = *flags.KeepFS
@@ -181,15 +221,23 @@ func flash(ctx context.Context, devConn dev.DevConn) error {
 	case "cc3220":
 		cc3220FlashOpts.Port = port
 		cc3220FlashOpts.KeepFS = *flags.KeepFS
+		cc3220FlashOpts.UCFCacheDir, err = paths.NormalizePath(cc3220FlashOpts.UCFCacheDir, version.GetMosVersion())
+		if err != nil {
+			return errors.Trace(err)
+		}
 		err = cc3220.Flash(fw, &cc3220FlashOpts)
-	case "esp32":
-		espFlashOpts.ControlPort = port
-		espFlashOpts.KeepFS = *flags.KeepFS
-		err = espFlasher.Flash(esp.ChipESP32, fw, &espFlashOpts)
-	case "esp8266":
+	case "esp32", "esp8266":
+		ct := esp.ChipESP32
+		if platform == "esp8266" {
+			ct = esp.ChipESP8266
+		}
 		espFlashOpts.ControlPort = port
 		espFlashOpts.KeepFS = *flags.KeepFS
-		err = espFlasher.Flash(esp.ChipESP8266, fw, &espFlashOpts)
+		if len(ports) > 1 {
+			err = espFlasher.FlashMulti(ct, fw, &espFlashOpts, ports)
+		} else {
+			err = espFlasher.Flash(ct, fw, &espFlashOpts)
+		}
 	case "stm32":
 		// Ideally we'd like to find mounted directory corresponding to the selected port.
 		// But for now, we'll just find mountpoints that sort of look like STLink...
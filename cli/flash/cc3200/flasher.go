@@ -20,6 +20,7 @@ type FlashOpts struct {
 	Port           string
 	FormatSLFSSize int
 	KeepFS         bool
+	StatusWindow   int
 }
 
 const (
@@ -116,6 +117,7 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	if err != nil {
 		return errors.Annotatef(err, "failed to connect to boot loader")
 	}
+	rc.SetStatusWindow(opts.StatusWindow)
 
 	vi, err := rc.GetVersionInfo()
 	if err != nil {
@@ -20,6 +20,16 @@ type FlashOpts struct {
 	FormatSLFSSize int
 	BPIBinary      string
 	KeepFS         bool
+	StatusWindow   int
+	// Generated UCF images are kept here and reused when flashing the same bundle
+	// to the same device again. Empty - do not cache.
+	UCFCacheDir string
+}
+
+type ucfImageResult struct {
+	fn  string
+	fs  int
+	err error
 }
 
 const (
@@ -35,15 +45,6 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 		return errors.Errorf("--keep-fs is not supportef for CC3220")
 	}
 
-	if opts.BPIBinary == "" {
-		bpib, err := findBPIBinary()
-		if err != nil {
-			return errors.Annotatef(err, "path to BuildProgrammingImage is not specified and it could not be found in the usual places. Make sure UniFlash 4.x is installed.")
-		}
-		common.Reportf("Found BPI binary: %s", bpib)
-		opts.BPIBinary = bpib
-	}
-
 	dc, err := NewCC3220DeviceControl(opts.Port)
 	if err != nil {
 		common.Reportf(
@@ -71,6 +72,7 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	if err != nil {
 		return errors.Annotatef(err, "failed to connect to boot loader")
 	}
+	rc.SetStatusWindow(opts.StatusWindow)
 
 	if err := rc.SwitchToNWPLoader(); err != nil {
 		return errors.Annotatef(err, "failed to connect to switch to NWP boot loader")
@@ -82,6 +84,23 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	}
 	common.Reportf("  MAC: %s", mac)
 
+	flashSize := 4 * 1024 * 1024 // TODO(rojer): detect
+
+	// Image generation only needs the MAC, let it run while the boot loader is being patched.
+	common.Reportf("Generating UCF image for %s (flash size: %d)", mac, flashSize)
+	imgCh := make(chan ucfImageResult, 1)
+	go func() {
+		var r ucfImageResult
+		r.fn, r.fs, r.err = getUCFImage(fw, opts.BPIBinary, mac, flashSize, opts.UCFCacheDir)
+		imgCh <- r
+	}()
+	// Make sure the builder is done with the bundle's temp dir before we return.
+	defer func() {
+		if imgCh != nil {
+			<-imgCh
+		}
+	}()
+
 	// Upload programming code patches first.
 	common.Reportf("Applying boot loader patches...")
 	ramPatch := MustAsset("data/BTL_ram.ptc")
@@ -102,13 +121,12 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	}
 	common.Reportf("  Flash patch applied")
 
-	flashSize := 4 * 1024 * 1024 // TODO(rojer): detect
-
-	common.Reportf("Generating UCF image for %s (flash size: %d)", mac, flashSize)
-	imgfn, imgfs, err := buildUCFImageFromFirmwareBundle(fw, opts.BPIBinary, mac, flashSize)
-	if err != nil {
-		return errors.Annotatef(err, "failed to create UCF image")
+	img := <-imgCh
+	imgCh = nil
+	if img.err != nil {
+		return errors.Annotatef(img.err, "failed to create UCF image")
 	}
+	imgfn, imgfs := img.fn, img.fs
 
 	common.Reportf("Uploading UCF image (%d bytes)", imgfs)
 
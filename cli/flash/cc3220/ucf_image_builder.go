@@ -6,7 +6,11 @@
 package cc3220
 
 import (
+	"crypto/sha256"
+	"encoding/hex"
 	"encoding/xml"
+	"fmt"
+	"io"
 	"io/ioutil"
 	"os"
 	"path/filepath"
@@ -357,6 +361,97 @@ func buildUCFImageFromFirmwareBundle(fw *fwbundle.FirmwareBundle, bpiBinary stri
 	return ucfn, int(fi.Size()), nil
 }
 
+// ucfImageCacheKey returns a digest of everything the generated image depends on:
+// the image builder binary, contents and attributes of the bundle parts that go
+// into the image, device MAC and storage capacity.
+func ucfImageCacheKey(fw *fwbundle.FirmwareBundle, bpiBinary string, mac cc32xx.MACAddress, storageCapacity int) (string, error) {
+	h := sha256.New()
+	bfi, err := os.Stat(bpiBinary)
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	fmt.Fprintf(h, "%q %d %d\n", bpiBinary, bfi.Size(), bfi.ModTime().UnixNano())
+	fmt.Fprintf(h, "%s %d\n", mac, storageCapacity)
+	var names []string
+	for name, p := range fw.Parts {
+		// Parts of other types are skipped by the builder.
+		if isKnownPartType(p.Type) {
+			names = append(names, name)
+		}
+	}
+	sort.Strings(names)
+	for _, name := range names {
+		p := fw.Parts[name]
+		fmt.Fprintf(h, "%q %q %d %q %q\n", p.Name, p.Type, p.CC32XXFileAllocSize, p.CC32XXFileSignature, p.CC32XXSigningCert)
+		r, err := p.GetDataReader()
+		if err != nil {
+			return "", errors.Annotatef(err, "%s: failed to get data", p.Name)
+		}
+		_, err = io.Copy(h, r)
+		r.Close()
+		if err != nil {
+			return "", errors.Annotatef(err, "%s: failed to read data", p.Name)
+		}
+	}
+	return hex.EncodeToString(h.Sum(nil)), nil
+}
+
+// getUCFImage returns a UCF image for the bundle, taking it from cacheDir if the same image
+// has been built before. Freshly built images are added to the cache.
+// If bpiBinary is empty, it is looked up in the default locations.
+func getUCFImage(fw *fwbundle.FirmwareBundle, bpiBinary string, mac cc32xx.MACAddress, storageCapacity int, cacheDir string) (string, int, error) {
+	if bpiBinary == "" {
+		bpib, err := findBPIBinary()
+		if err != nil {
+			return "", -1, errors.Annotatef(err, "path to BuildProgrammingImage is not specified and it could not be found in the usual places. Make sure UniFlash 4.x is installed.")
+		}
+		glog.Infof("Found BPI binary: %s", bpib)
+		bpiBinary = bpib
+	}
+	cachedfn := ""
+	if cacheDir != "" {
+		key, err := ucfImageCacheKey(fw, bpiBinary, mac, storageCapacity)
+		if err != nil {
+			return "", -1, errors.Trace(err)
+		}
+		cachedfn = filepath.Join(cacheDir, key+".ucf")
+		if fi, err := os.Stat(cachedfn); err == nil {
+			ourutil.Reportf("  Using cached UCF image %s", cachedfn)
+			return cachedfn, int(fi.Size()), nil
+		}
+	}
+	ucfn, ucfs, err := buildUCFImageFromFirmwareBundle(fw, bpiBinary, mac, storageCapacity)
+	if err != nil || cachedfn == "" {
+		return ucfn, ucfs, err
+	}
+	// Failing to cache is not fatal, the image is still there.
+	if err := addToUCFCache(ucfn, cachedfn); err != nil {
+		glog.Warningf("Failed to cache UCF image: %s", err)
+		return ucfn, ucfs, nil
+	}
+	return cachedfn, ucfs, nil
+}
+
+func addToUCFCache(ucfn, cachedfn string) error {
+	data, err := ioutil.ReadFile(ucfn)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.MkdirAll(filepath.Dir(cachedfn), 0755); err != nil {
+		return errors.Trace(err)
+	}
+	// Write to a temp file first so a concurrent flash never sees a partial image.
+	tmpfn := fmt.Sprintf("%s.%d.tmp", cachedfn, os.Getpid())
+	if err := ioutil.WriteFile(tmpfn, data, 0644); err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.Rename(tmpfn, cachedfn); err != nil {
+		os.Remove(tmpfn)
+		return errors.Trace(err)
+	}
+	return nil
+}
+
 func systemFileIdFromString(s string) (systemFileId, error) {
 	switch s {
 	case string(sfiIPConfig):
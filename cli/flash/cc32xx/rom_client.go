@@ -122,10 +122,22 @@ const (
 type ROMClient struct {
 	s  serial.Serial
 	ct ChipType
+	// Buffers reused between packets, so uploading does not allocate per chunk.
+	txBuf []byte
+	rxBuf []byte
+	// Write status is checked once per this many chunks.
+	statusWindow int
+	// Block sizes reported by GetStorageInfo, reset when the loader changes.
+	blockSizes map[StorageID]int
 }
 
 func NewROMClient(s serial.Serial, dc DeviceControl) (*ROMClient, error) {
-	rc := &ROMClient{s: s}
+	rc := &ROMClient{
+		s:            s,
+		txBuf:        make([]byte, 0, 3+1+12+fileUploadBlockSize),
+		statusWindow: 1,
+		blockSizes:   make(map[StorageID]int),
+	}
 	common.Reportf("Connecting to boot loader..")
 	err := rc.connect(dc)
 	if err != nil {
@@ -148,6 +160,16 @@ func NewROMClient(s serial.Serial, dc DeviceControl) (*ROMClient, error) {
 	return rc, nil
 }
 
+// SetStatusWindow sets the number of chunks written by RawStorageWrite and UploadFile
+// between status checks. Every chunk is still acknowledged by the loader,
+// but a failed chunk is only detected at the end of the window.
+func (rc *ROMClient) SetStatusWindow(n int) {
+	if n < 1 {
+		n = 1
+	}
+	rc.statusWindow = n
+}
+
 func (rc *ROMClient) SwitchToNWPLoader() error {
 	common.Reportf("Switching to NWP...")
 	if err := rc.SwitchUARTtoAppsMCU(); err != nil {
@@ -175,21 +197,26 @@ func checksum(data []byte) (result uint8) {
 	return
 }
 
-func (rc *ROMClient) sendPacket(payload []byte) error {
-	buf := bytes.NewBuffer(nil)
-	binary.Write(buf, binary.BigEndian, uint16(len(payload)+2))
-	binary.Write(buf, binary.BigEndian, checksum(payload))
-	buf.Write(payload)
-	glog.V(4).Infof("=> (%d) %s", len(buf.Bytes()), common.LimitStr(buf.Bytes(), 64))
-	n, err := rc.s.Write(buf.Bytes())
-	if err != nil || n != len(buf.Bytes()) {
+// sendPacket fills in the header of pkt, for which the first 3 bytes are reserved,
+// sends it and waits for ACK.
+func (rc *ROMClient) sendPacket(pkt []byte) error {
+	payload := pkt[3:]
+	binary.BigEndian.PutUint16(pkt, uint16(len(payload)+2))
+	pkt[2] = checksum(payload)
+	glog.V(4).Infof("=> (%d) %s", len(pkt), common.LimitStr(pkt, 64))
+	n, err := rc.s.Write(pkt)
+	if err != nil || n != len(pkt) {
 		return errors.Annotatef(err, "failed to write command packet")
 	}
 	return rc.recvACK()
 }
 
+// readN reads exactly toRead bytes. The returned slice is only valid until the next read.
 func (rc *ROMClient) readN(toRead int) ([]byte, error) {
-	buf := make([]byte, toRead)
+	if cap(rc.rxBuf) < toRead {
+		rc.rxBuf = make([]byte, toRead)
+	}
+	buf := rc.rxBuf[:toRead]
 	nr := 0
 	for nr < toRead {
 		n, err := rc.s.Read(buf[nr:toRead])
@@ -225,7 +252,7 @@ func (rc *ROMClient) recvPacket() (*bytes.Buffer, error) {
 		return nil, errors.Errorf("checksum mismatch: want 0x%02x, got 0x%02x", csum, gotCsum)
 	}
 	rc.sendACK()
-	return bytes.NewBuffer(packet), nil
+	return bytes.NewBuffer(append([]byte(nil), packet...)), nil
 }
 
 func (rc *ROMClient) sendACK() error {
@@ -248,9 +275,10 @@ func (rc *ROMClient) recvACK() error {
 
 func (rc *ROMClient) sendCommand(cmd loaderCmd, args []byte) error {
 	glog.V(2).Infof("=> {cmd:%s args(%d):%s}", cmd, len(args), common.LimitStr(args, 32))
-	payload := []byte{byte(cmd)}
-	payload = append(payload, args...)
-	return rc.sendPacket(payload)
+	pkt := append(rc.txBuf[:0], 0, 0, 0, byte(cmd))
+	pkt = append(pkt, args...)
+	rc.txBuf = pkt
+	return rc.sendPacket(pkt)
 }
 
 func (rc *ROMClient) connect(dc DeviceControl) error {
@@ -335,10 +363,19 @@ func (rc *ROMClient) GetStatus() (romStatus, error) {
 }
 
 func (rc *ROMClient) commandWithStatus(cmd loaderCmd, args []byte) error {
+	return rc.chunkCommand(cmd, args, true)
+}
+
+// chunkCommand sends the command and, if checkStatus is set, verifies that it succeeded.
+// Status is also checked if the ACK was not received or was corrupted.
+func (rc *ROMClient) chunkCommand(cmd loaderCmd, args []byte, checkStatus bool) error {
 	err := rc.sendCommand(cmd, args)
 	if errors.Cause(err) == io.EOF {
 		return errors.Annotatef(err, "%s: failed to send", cmd)
 	}
+	if err == nil && !checkStatus {
+		return nil
+	}
 	status, err := rc.GetStatus()
 	if err != nil {
 		return errors.Annotatef(err, "%s: failed to get status", cmd)
@@ -403,7 +440,23 @@ func (rc *ROMClient) GetStorageInfo(sid StorageID) (*StorageInfo, error) {
 	return si, nil
 }
 
+func (rc *ROMClient) getBlockSize(sid StorageID) (int, error) {
+	if bs, ok := rc.blockSizes[sid]; ok {
+		return bs, nil
+	}
+	si, err := rc.GetStorageInfo(sid)
+	if err != nil {
+		return 0, errors.Annotatef(err, "failed to get storage info")
+	}
+	if si.BlockSize == 0 {
+		return 0, errors.Errorf("%s: invalid block size", sid)
+	}
+	rc.blockSizes[sid] = int(si.BlockSize)
+	return int(si.BlockSize), nil
+}
+
 func (rc *ROMClient) ExecuteFromRAM() error {
+	rc.blockSizes = make(map[StorageID]int)
 	if err := rc.sendCommand(cmdExecuteFromRAM, nil); err != nil {
 		return errors.Trace(err)
 	}
@@ -415,6 +468,7 @@ func (rc *ROMClient) SwitchUARTtoAppsMCU() error {
 	delay := uartSwitchDelay
 	buf := bytes.NewBuffer(nil)
 	binary.Write(buf, binary.BigEndian, uint32(delay))
+	rc.blockSizes = make(map[StorageID]int)
 	if err := rc.sendCommand(cmdSwitchUARTtoAppsMCU, buf.Bytes()); err != nil {
 		return errors.Annotatef(err, "failed to switch UART to apps CPU")
 	}
@@ -496,25 +550,29 @@ func (rc *ROMClient) FormatSLFS(size int) error {
 }
 
 func (rc *ROMClient) RawStorageWrite(sid StorageID, offset int, data []byte) error {
-	for numWritten := 0; numWritten < len(data); {
+	args := make([]byte, 12, 12+rawWriteSize)
+	windowStart := offset
+	for numWritten, n := 0, 1; numWritten < len(data); n++ {
 		remaining := data[numWritten:]
 		writeSize := rawWriteSize
 		if writeSize > len(remaining) {
 			writeSize = len(remaining)
 		}
 		toWrite := remaining[:writeSize]
-		buf := bytes.NewBuffer(nil)
-		binary.Write(buf, binary.BigEndian, uint32(sid))
-		binary.Write(buf, binary.BigEndian, uint32(offset))
-		binary.Write(buf, binary.BigEndian, uint32(len(toWrite)))
-		buf.Write(toWrite)
+		binary.BigEndian.PutUint32(args[0:], uint32(sid))
+		binary.BigEndian.PutUint32(args[4:], uint32(offset))
+		binary.BigEndian.PutUint32(args[8:], uint32(len(toWrite)))
+		args = append(args[:12], toWrite...)
 		glog.V(3).Infof("Raw write to %s: %d @ %d", sid, len(toWrite), offset)
-		err := rc.commandWithStatus(cmdRawStorageWrite, buf.Bytes())
-		if err != nil {
-			return errors.Annotatef(err, "%s write failed: %d @ %d", sid, len(toWrite), offset)
+		checkStatus := n%rc.statusWindow == 0 || writeSize == len(remaining)
+		if err := rc.chunkCommand(cmdRawStorageWrite, args, checkStatus); err != nil {
+			return errors.Annotatef(err, "%s write failed: %d @ %d", sid, offset+writeSize-windowStart, windowStart)
 		}
 		numWritten += writeSize
 		offset += writeSize
+		if checkStatus {
+			windowStart = offset
+		}
 	}
 	return nil
 }
@@ -533,11 +591,10 @@ func (rc *ROMClient) RawStorageEraseBlocks(sid StorageID, startBlock int, numBlo
 }
 
 func (rc *ROMClient) RawStorageEraseBytes(sid StorageID, offset int, numBytes int) error {
-	si, err := rc.GetStorageInfo(sid)
+	bs, err := rc.getBlockSize(sid)
 	if err != nil {
-		return errors.Annotatef(err, "failed to get storage info")
+		return errors.Trace(err)
 	}
-	bs := int(si.BlockSize)
 	startBlock := offset / bs
 	endBlock := (offset + numBytes + bs - 1) / bs
 	numBlocks := endBlock - startBlock
@@ -612,18 +669,23 @@ func (rc *ROMClient) UploadFile(fi *SLFSFileInfo) error {
 	glog.V(2).Infof("token: 0x%08x", token)
 
 	rc.s.SetReadTimeout(1 * time.Second)
-	for offset := 0; offset < len(fi.Data); {
+	args := make([]byte, 4, 4+fileUploadBlockSize)
+	windowStart := 0
+	for offset, n := 0, 1; offset < len(fi.Data); n++ {
 		end := offset + fileUploadBlockSize
 		if end > len(fi.Data) {
 			end = len(fi.Data)
 		}
-		buf.Reset()
-		binary.Write(buf, binary.BigEndian, uint32(offset))
-		buf.Write(fi.Data[offset:end])
-		if err := rc.commandWithStatus(cmdUploadChunk, buf.Bytes()); err != nil {
-			return errors.Annotatef(err, "%s: write failed @ %d", fi.Name, offset)
+		binary.BigEndian.PutUint32(args, uint32(offset))
+		args = append(args[:4], fi.Data[offset:end]...)
+		checkStatus := n%rc.statusWindow == 0 || end == len(fi.Data)
+		if err := rc.chunkCommand(cmdUploadChunk, args, checkStatus); err != nil {
+			return errors.Annotatef(err, "%s: write failed @ %d-%d", fi.Name, windowStart, end)
 		}
 		offset = end
+		if checkStatus {
+			windowStart = offset
+		}
 	}
 
 	buf.Reset()
@@ -647,6 +709,7 @@ func (rc *ROMClient) UploadImageFile(fname string) error {
 		return errors.Annotatef(err, "failed to read image file")
 	}
 	rc.s.SetReadTimeout(25 * time.Second)
+	args := make([]byte, 8, 8+imageWriteSize)
 	for numWritten := 0; numWritten < len(data); {
 		remaining := data[numWritten:]
 		writeSize := imageWriteSize
@@ -654,17 +717,16 @@ func (rc *ROMClient) UploadImageFile(fname string) error {
 			writeSize = len(remaining)
 		}
 		toWrite := remaining[:writeSize]
-		buf := bytes.NewBuffer(nil)
-		binary.Write(buf, binary.BigEndian, uint16(0)) // KeySize
-		binary.Write(buf, binary.BigEndian, uint16(writeSize))
-		binary.Write(buf, binary.BigEndian, uint32(0)) // Flags
-		buf.Write(toWrite)
+		binary.BigEndian.PutUint16(args[0:], 0) // KeySize
+		binary.BigEndian.PutUint16(args[2:], uint16(writeSize))
+		binary.BigEndian.PutUint32(args[4:], 0) // Flags
+		args = append(args[:8], toWrite...)
 		glog.V(3).Infof("Image write: %d @ %d", len(toWrite), numWritten)
 		if writeSize == len(remaining) {
 			// This is the last write, it will trigger image extraction and will take a while.
 			common.Reportf("Upload finished, image is being extracted...")
 		}
-		err := rc.sendCommand(cmdUploadImage, buf.Bytes())
+		err := rc.sendCommand(cmdUploadImage, args)
 		if err != nil {
 			if writeSize == len(remaining) {
 				// Extracting image can take a long time, but we cannot set read timeout more than 25 seconds.
@@ -680,11 +742,8 @@ func (rc *ROMClient) UploadImageFile(fname string) error {
 		if err != nil {
 			return errors.Annotatef(err, "failed to read ACK")
 		}
-		var e0 int16
-		var e1 uint16
-		buf = bytes.NewBuffer(extStatus)
-		binary.Read(buf, binary.BigEndian, &e0)
-		binary.Read(buf, binary.BigEndian, &e1)
+		e0 := int16(binary.BigEndian.Uint16(extStatus[0:]))
+		e1 := binary.BigEndian.Uint16(extStatus[2:])
 		if e0 < 0 {
 			return errors.Errorf("image programming error @ %d: e0 = %d, e1 = %d", numWritten, e0, e1)
 		}
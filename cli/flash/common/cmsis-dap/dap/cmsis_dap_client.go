@@ -54,6 +54,8 @@ type dapClient struct {
 	d             hid.Device
 	di            *hid.DeviceInfo
 	maxPacketSize int
+	// Number of packets the probe can buffer, this many commands can be in flight.
+	packetCount int
 }
 
 func NewClient(ctx context.Context, vid, pid uint16, serial string, intf, epIn, epOut int) (DAPClient, error) {
@@ -74,6 +76,7 @@ func NewClient(ctx context.Context, vid, pid uint16, serial string, intf, epIn,
 				di:            di,
 				d:             d,
 				maxPacketSize: 8, // Start with a conservative guess
+				packetCount:   1,
 			}
 			resp, err := dapc.GetInfo(ctx, 0xff)
 			if err != nil {
@@ -85,7 +88,10 @@ func NewClient(ctx context.Context, vid, pid uint16, serial string, intf, epIn,
 			binary.Read(resp, binary.LittleEndian, &rl)
 			binary.Read(resp, binary.LittleEndian, &mps)
 			dapc.maxPacketSize = int(mps)
-			glog.V(2).Infof("max packet size: %d", dapc.maxPacketSize)
+			if resp, err := dapc.GetInfo(ctx, 0xfe); err == nil && len(resp.Bytes()) >= 2 && resp.Bytes()[1] > 0 {
+				dapc.packetCount = int(resp.Bytes()[1])
+			}
+			glog.V(2).Infof("max packet size: %d, packet count: %d", dapc.maxPacketSize, dapc.packetCount)
 			return dapc, nil
 		}
 	}
@@ -107,6 +113,15 @@ func (dapc *dapClient) exec(ctx context.Context, args *bytes.Buffer) (*bytes.Buf
 	if err := dapc.d.Write(args.Bytes()); err != nil {
 		return nil, errors.Annotatef(err, "device write failed")
 	}
+	resp, err := dapc.readResp(ctx, args.Bytes()[1])
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return bytes.NewBuffer(resp), nil
+}
+
+// readResp reads response to the command, without the command byte.
+func (dapc *dapClient) readResp(ctx context.Context, cmd uint8) ([]byte, error) {
 	select {
 	case <-ctx.Done():
 		return nil, errors.Annotatef(ctx.Err(), "DAP exec")
@@ -115,12 +130,47 @@ func (dapc *dapClient) exec(ctx context.Context, args *bytes.Buffer) (*bytes.Buf
 			return nil, errors.Annotatef(dapc.d.ReadError(), "device read failed")
 		}
 		glog.V(4).Infof("<=  %s", hex.EncodeToString(resp))
-		cmd := args.Bytes()[1]
-		if resp[0] != cmd {
-			return nil, errors.Errorf("Response to wrong command (want 0x%02x, got 0x%02x)", cmd, resp[0])
+		if len(resp) == 0 || resp[0] != cmd {
+			return nil, errors.Errorf("Response to wrong command (want 0x%02x, got %s)", cmd, hex.EncodeToString(resp))
+		}
+		return resp[1:], nil
+	}
+}
+
+// execPipelined sends the commands (each including the HID report number),
+// keeping up to packetCount of them in flight, and calls handle with each
+// response in order.
+func (dapc *dapClient) execPipelined(ctx context.Context, cmds [][]byte, handle func(i int, resp []byte) error) error {
+	sent, done := 0, 0
+	var err error
+	for done < len(cmds) && err == nil {
+		for sent < len(cmds) && sent-done < dapc.packetCount {
+			glog.V(4).Infof(" => %s", hex.EncodeToString(cmds[sent][1:]))
+			if len(cmds[sent]) > dapc.maxPacketSize {
+				err = errors.Errorf("packet too long (max %d, got %d)", dapc.maxPacketSize, len(cmds[sent]))
+				break
+			}
+			if err = dapc.d.Write(cmds[sent]); err != nil {
+				err = errors.Annotatef(err, "device write failed")
+				break
+			}
+			sent++
 		}
-		return bytes.NewBuffer(resp[1:]), nil
+		if err != nil || done == sent {
+			break
+		}
+		var resp []byte
+		if resp, err = dapc.readResp(ctx, cmds[done][1]); err == nil {
+			err = handle(done, resp)
+		}
+		done++
 	}
+	// Collect responses still in flight, so they are not taken for responses
+	// to the next commands.
+	for ; done < sent && ctx.Err() == nil; done++ {
+		dapc.readResp(ctx, cmds[done][1])
+	}
+	return err
 }
 
 func (dapc *dapClient) execCheckStatus(ctx context.Context, args *bytes.Buffer) error {
@@ -211,9 +261,9 @@ func (dapc *dapClient) TransferConfigure(ctx context.Context, idleCycles uint8,
 }
 
 func (dapc *dapClient) doTransfer(ctx context.Context, dapIndex uint8, reqs []TransferRequest) (TransferStatus, []uint32, error) {
-	args := newCmd(cmdTransfer)
-	binary.Write(args, binary.LittleEndian, dapIndex)
-	binary.Write(args, binary.LittleEndian, uint8(len(reqs)))
+	args := make([]byte, 4, 4+5*len(reqs))
+	args[1], args[2], args[3] = cmdTransfer, dapIndex, uint8(len(reqs))
+	numReads := 0
 	for i, req := range reqs {
 		if req.Reg&3 != 0 {
 			return 0, nil, errors.Errorf("treq %d invalid reg 0x%x", i, req.Reg)
@@ -227,6 +277,7 @@ func (dapc *dapClient) doTransfer(ctx context.Context, dapIndex uint8, reqs []Tr
 		case OpRead:
 			treq |= 1 << 1
 			haveData = false
+			numReads++
 		case OpReadMatch:
 			treq |= 1<<1 | 1<<4
 		case OpWrite:
@@ -234,37 +285,36 @@ func (dapc *dapClient) doTransfer(ctx context.Context, dapIndex uint8, reqs []Tr
 		case OpWriteMatch:
 			treq |= 1 << 5
 		}
-		binary.Write(args, binary.LittleEndian, treq)
+		args = append(args, treq)
 		if haveData {
-			binary.Write(args, binary.LittleEndian, req.Data)
+			args = append(args, uint8(req.Data), uint8(req.Data>>8), uint8(req.Data>>16), uint8(req.Data>>24))
 		}
 	}
-	resp, err := dapc.exec(ctx, args)
+	respBuf, err := dapc.exec(ctx, bytes.NewBuffer(args))
 	if err != nil {
 		return 0, nil, errors.Trace(err)
 	}
-	var tc uint8
-	var st TransferStatus
-	var data []uint32
-	if binary.Read(resp, binary.LittleEndian, &tc) != nil ||
-		binary.Read(resp, binary.LittleEndian, &st) != nil {
-		return st, nil, errors.Errorf("response is too short")
+	resp := respBuf.Bytes()
+	if len(resp) < 2 {
+		return 0, nil, errors.Errorf("response is too short")
 	}
+	tc, st := resp[0], TransferStatus(resp[1])
 	if !st.Ok() {
 		return st, nil, errors.Errorf("transfer failed (tc %d/%d st 0x%02x)", tc, len(reqs), st)
 	}
 	if int(tc) != len(reqs) {
 		return st, nil, errors.Errorf("not all transfers completed %d", st)
 	}
-	for _, req := range reqs {
-		if req.Op != OpRead {
-			continue
-		}
-		var d uint32
-		if binary.Read(resp, binary.LittleEndian, &d) != nil {
-			return st, nil, errors.Errorf("response is too short")
+	resp = resp[2:]
+	if len(resp) < 4*numReads {
+		return st, nil, errors.Errorf("response is too short")
+	}
+	var data []uint32
+	if numReads > 0 {
+		data = make([]uint32, numReads)
+		for i := range data {
+			data[i] = binary.LittleEndian.Uint32(resp[4*i:])
 		}
-		data = append(data, d)
 	}
 	return st, data, nil
 }
@@ -290,77 +340,101 @@ func (dapc *dapClient) TransferBlockRead(ctx context.Context, dapIndex uint8, ap
 	if length > dapc.GetTransferBlockMaxSize() {
 		return nil, errors.Errorf("request too big (max %d, got %d)", dapc.GetTransferBlockMaxSize(), length)
 	}
-	args := newCmd(cmdTransferBlock)
-	binary.Write(args, binary.LittleEndian, dapIndex)
-	binary.Write(args, binary.LittleEndian, uint16(length))
-	if reg&3 != 0 {
-		return nil, errors.Errorf("invalid reg 0x%x", reg)
-	}
-	treq := uint8(reg&0xc) | 2 /* read */
-	if ap {
-		treq |= 1 << 0
-	}
-	binary.Write(args, binary.LittleEndian, treq)
-	resp, err := dapc.exec(ctx, args)
+	res, err := dapc.TransferBlocks(ctx, dapIndex, []BlockOp{{AP: ap, Reg: reg, Length: length}})
 	if err != nil {
 		return nil, errors.Trace(err)
 	}
-	var tc uint16
-	var st TransferStatus
-	if binary.Read(resp, binary.LittleEndian, &tc) != nil ||
-		binary.Read(resp, binary.LittleEndian, &st) != nil {
-		return nil, errors.Errorf("response is too short")
-	}
-	if !st.Ok() {
-		return nil, errors.Errorf("transfer failed (tc %d/%d st 0x%02x)", tc, length, st)
-	}
-	if int(tc) != length {
-		return nil, errors.Errorf("not all transfers completed %d", st)
-	}
-	var res []uint32
-	for i := 0; i < length; i++ {
-		var w uint32
-		if binary.Read(resp, binary.LittleEndian, &w) != nil {
-			return nil, errors.Errorf("response is too short")
-		}
-		res = append(res, w)
-	}
-	return res, nil
+	return res[0], nil
 }
 
 func (dapc *dapClient) TransferBlockWrite(ctx context.Context, dapIndex uint8, ap bool, reg uint8, data []uint32) error {
 	glog.V(3).Infof("TransferBlockWrite(%d, %t, 0x%x, %d)", dapIndex, ap, reg, len(data))
-	args := newCmd(cmdTransferBlock)
-	binary.Write(args, binary.LittleEndian, dapIndex)
-	binary.Write(args, binary.LittleEndian, uint16(len(data)))
-	if reg&3 != 0 {
-		return errors.Errorf("invalid reg 0x%x", reg)
+	if len(data) > dapc.GetTransferBlockMaxSize() {
+		return errors.Errorf("request too big (max %d, got %d)", dapc.GetTransferBlockMaxSize(), len(data))
 	}
-	treq := uint8(reg & 0xc)
-	if ap {
-		treq |= 1 << 0
-	}
-	binary.Write(args, binary.LittleEndian, treq)
-	for _, value := range data {
-		binary.Write(args, binary.LittleEndian, value)
+	_, err := dapc.TransferBlocks(ctx, dapIndex, []BlockOp{{Write: true, AP: ap, Reg: reg, Data: data}})
+	return errors.Trace(err)
+}
+
+// blockChunk is a single DAP_TransferBlock command, a part of a BlockOp.
+type blockChunk struct {
+	op     int
+	offset int
+	length int
+}
+
+func (dapc *dapClient) TransferBlocks(ctx context.Context, dapIndex uint8, ops []BlockOp) ([][]uint32, error) {
+	glog.V(3).Infof("TransferBlocks(%d, %d ops)", dapIndex, len(ops))
+	maxChunkSize := dapc.GetTransferBlockMaxSize()
+	res := make([][]uint32, len(ops))
+	var chunks []blockChunk
+	var cmds [][]byte
+	for i, op := range ops {
+		if op.Reg&3 != 0 {
+			return nil, errors.Errorf("invalid reg 0x%x", op.Reg)
+		}
+		treq := uint8(op.Reg & 0xc)
+		if op.AP {
+			treq |= 1 << 0
+		}
+		length := op.Length
+		if op.Write {
+			length = len(op.Data)
+		} else {
+			treq |= 1 << 1
+			res[i] = make([]uint32, length)
+		}
+		for off := 0; off < length; off += maxChunkSize {
+			cl := length - off
+			if cl > maxChunkSize {
+				cl = maxChunkSize
+			}
+			hdr := []byte{0 /* HID report number */, cmdTransferBlock, dapIndex, uint8(cl), uint8(cl >> 8), treq}
+			cmdLen := len(hdr)
+			if op.Write {
+				cmdLen += 4 * cl
+			}
+			c := make([]byte, cmdLen)
+			copy(c, hdr)
+			if op.Write {
+				for j, v := range op.Data[off : off+cl] {
+					binary.LittleEndian.PutUint32(c[len(hdr)+4*j:], v)
+				}
+			}
+			cmds = append(cmds, c)
+			chunks = append(chunks, blockChunk{op: i, offset: off, length: cl})
+		}
 	}
-	resp, err := dapc.exec(ctx, args)
+	err := dapc.execPipelined(ctx, cmds, func(i int, resp []byte) error {
+		ch := chunks[i]
+		if len(resp) < 3 {
+			return errors.Errorf("response is too short")
+		}
+		tc := int(binary.LittleEndian.Uint16(resp))
+		st := TransferStatus(resp[2])
+		if !st.Ok() {
+			return errors.Errorf("transfer failed (tc %d/%d st 0x%02x)", tc, ch.length, st)
+		}
+		if tc != ch.length {
+			return errors.Errorf("not all transfers completed %d", st)
+		}
+		if ops[ch.op].Write {
+			return nil
+		}
+		data := resp[3:]
+		if len(data) < 4*ch.length {
+			return errors.Errorf("response is too short")
+		}
+		out := res[ch.op][ch.offset : ch.offset+ch.length]
+		for j := range out {
+			out[j] = binary.LittleEndian.Uint32(data[4*j:])
+		}
+		return nil
+	})
 	if err != nil {
-		return errors.Trace(err)
-	}
-	var tc uint16
-	var st TransferStatus
-	if binary.Read(resp, binary.LittleEndian, &tc) != nil ||
-		binary.Read(resp, binary.LittleEndian, &st) != nil {
-		return errors.Errorf("response is too short")
-	}
-	if !st.Ok() {
-		return errors.Errorf("transfer failed (tc %d/%d st 0x%02x)", tc, len(data), st)
-	}
-	if int(tc) != len(data) {
-		return errors.Errorf("not all transfers completed %d", st)
+		return nil, errors.Trace(err)
 	}
-	return nil
+	return res, nil
 }
 
 func (dapc *dapClient) Delay(ctx context.Context, delay time.Duration) error {
@@ -39,6 +39,11 @@ type DAPClient interface {
 	GetTransferBlockMaxSize() int
 	TransferBlockRead(ctx context.Context, dapIndex uint8, ap bool, reg uint8, length int) ([]uint32, error)
 	TransferBlockWrite(ctx context.Context, dapIndex uint8, ap bool, reg uint8, data []uint32) error
+	// TransferBlocks performs a sequence of block transfers of any size.
+	// They are split into packets and sent without waiting for the previous
+	// ones to complete, as many as the probe can buffer. Returns data read by
+	// each of the ops (nil for writes).
+	TransferBlocks(ctx context.Context, dapIndex uint8, ops []BlockOp) ([][]uint32, error)
 	Delay(ctx context.Context, delay time.Duration) error
 	ResetTarget(ctx context.Context) error
 	SWJClock(ctx context.Context, clockHz uint32) error
@@ -79,6 +84,15 @@ type TransferRequest struct {
 	Data uint32
 }
 
+// BlockOp is a block read of Length words or a block write of Data.
+type BlockOp struct {
+	Write  bool
+	AP     bool
+	Reg    uint8
+	Length int
+	Data   []uint32
+}
+
 type TransferStatus uint8
 
 const (
@@ -45,6 +45,9 @@ type DPClient interface {
 	ReadAPRegMulti(ctx context.Context, apSel, apReg uint8, length int) ([]uint32, error)
 	WriteAPReg(ctx context.Context, apSel, apReg uint8, value uint32) error
 	WriteAPRegMulti(ctx context.Context, apSel, apReg uint8, values []uint32) error
+	// TransferAPBlocks performs a sequence of block transfers to registers of
+	// the same AP bank, pipelined. See dap.DAPClient.TransferBlocks.
+	TransferAPBlocks(ctx context.Context, apSel uint8, ops []dap.BlockOp) ([][]uint32, error)
 }
 
 func NewDPClient(dapc dap.DAPClient) DPClient {
@@ -68,21 +71,11 @@ func (dpc *dpClient) ReadReg(ctx context.Context, reg uint8, ap bool) (uint32, e
 }
 
 func (dpc *dpClient) ReadRegMulti(ctx context.Context, reg uint8, ap bool, length int) ([]uint32, error) {
-	maxChunkSize := dpc.dapc.GetTransferBlockMaxSize()
-	var res []uint32
-	for length > 0 {
-		chunkSize := length
-		if chunkSize > maxChunkSize {
-			chunkSize = maxChunkSize
-		}
-		chunk, err := dpc.dapc.TransferBlockRead(ctx, 0, ap, reg, chunkSize)
-		if err != nil {
-			return nil, errors.Trace(err)
-		}
-		res = append(res, chunk...)
-		length -= chunkSize
+	res, err := dpc.dapc.TransferBlocks(ctx, 0, []dap.BlockOp{{AP: ap, Reg: reg, Length: length}})
+	if err != nil {
+		return nil, errors.Trace(err)
 	}
-	return res, nil
+	return res[0], nil
 }
 
 func (dpc *dpClient) ReadDPReg(ctx context.Context, reg DPReg) (uint32, error) {
@@ -99,19 +92,8 @@ func (dpc *dpClient) WriteReg(ctx context.Context, reg uint8, ap bool, value uin
 }
 
 func (dpc *dpClient) WriteRegMulti(ctx context.Context, reg uint8, ap bool, values []uint32) error {
-	offset := 0
-	maxChunkSize := dpc.dapc.GetTransferBlockMaxSize()
-	for offset < len(values) {
-		chunk := values[offset:]
-		if len(chunk) > maxChunkSize {
-			chunk = chunk[:maxChunkSize]
-		}
-		if err := dpc.dapc.TransferBlockWrite(ctx, 0, ap, reg, chunk); err != nil {
-			return errors.Trace(err)
-		}
-		offset += len(chunk)
-	}
-	return nil
+	_, err := dpc.dapc.TransferBlocks(ctx, 0, []dap.BlockOp{{Write: true, AP: ap, Reg: reg, Data: values}})
+	return errors.Trace(err)
 }
 
 func (dpc *dpClient) WriteDPReg(ctx context.Context, reg DPReg, value uint32) error {
@@ -257,6 +239,26 @@ func (dpc *dpClient) WriteAPRegMulti(ctx context.Context, apSel, apReg uint8, va
 	return dpc.WriteRegMulti(ctx, apReg, true /* ap */, values)
 }
 
+func (dpc *dpClient) TransferAPBlocks(ctx context.Context, apSel uint8, ops []dap.BlockOp) ([][]uint32, error) {
+	if len(ops) == 0 {
+		return nil, nil
+	}
+	apBank := ops[0].Reg / 16
+	apOps := make([]dap.BlockOp, len(ops))
+	for i, op := range ops {
+		if op.Reg/16 != apBank {
+			return nil, errors.Errorf("AP regs 0x%x and 0x%x are in different banks", ops[0].Reg, op.Reg)
+		}
+		op.AP = true
+		op.Reg = op.Reg % 16
+		apOps[i] = op
+	}
+	if err := dpc.selectAP(ctx, apSel, apBank); err != nil {
+		return nil, errors.Trace(err)
+	}
+	return dpc.dapc.TransferBlocks(ctx, 0, apOps)
+}
+
 type DPIDRValue uint32
 
 type DPDesigner uint16
@@ -24,6 +24,7 @@ import (
 	glog "k8s.io/klog/v2"
 
 	"github.com/mongoose-os/mos/cli/flash/common"
+	"github.com/mongoose-os/mos/cli/flash/common/cmsis-dap/dap"
 	"github.com/mongoose-os/mos/cli/flash/common/cmsis-dap/dp"
 )
 
@@ -92,29 +93,40 @@ func (mapc *memAPClient) ReadTargetReg(ctx context.Context, addr uint32) (uint32
 	return value, errors.Trace(err)
 }
 
-func (mapc *memAPClient) ReadTargetMem(ctx context.Context, addr uint32, length int) ([]uint32, error) {
-	glog.V(4).Infof("ReadTargetMem(0x%08x, %d)", addr, length)
-	if addr%4 != 0 {
-		return nil, errors.Errorf("addr must be word-aligned, got 0x%x", addr)
-	}
-	var res []uint32
+// memOps returns block ops to access length words of memory at addr: for
+// every run of words within the autoincrement range, a TAR write followed
+// by op on DRW.
+func memOps(addr uint32, length int, op func(offset, length int) dap.BlockOp) []dap.BlockOp {
+	var ops []dap.BlockOp
 	for i := 0; i < length; {
-		if err := mapc.WriteReg(ctx, TAR, addr); err != nil {
-			return nil, errors.Trace(err)
-		}
 		// Autoincrement only works on lower 10 bits.
 		cl := int((0x400 - addr&0x3ff) / 4)
 		if cl > length-i {
 			cl = length - i
 		}
-		values, err := mapc.dpc.ReadAPRegMulti(ctx, mapc.apSel, uint8(DRW), cl)
-		if err != nil {
-			return nil, errors.Trace(err)
-		}
-		res = append(res, values...)
+		ops = append(ops, dap.BlockOp{Write: true, Reg: uint8(TAR), Data: []uint32{addr}}, op(i, cl))
 		addr += uint32(cl * 4)
 		i += cl
 	}
+	return ops
+}
+
+func (mapc *memAPClient) ReadTargetMem(ctx context.Context, addr uint32, length int) ([]uint32, error) {
+	glog.V(4).Infof("ReadTargetMem(0x%08x, %d)", addr, length)
+	if addr%4 != 0 {
+		return nil, errors.Errorf("addr must be word-aligned, got 0x%x", addr)
+	}
+	ops := memOps(addr, length, func(offset, length int) dap.BlockOp {
+		return dap.BlockOp{Reg: uint8(DRW), Length: length}
+	})
+	opsRes, err := mapc.dpc.TransferAPBlocks(ctx, mapc.apSel, ops)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	res := make([]uint32, 0, length)
+	for _, values := range opsRes {
+		res = append(res, values...)
+	}
 	return res, nil
 }
 
@@ -131,22 +143,11 @@ func (mapc *memAPClient) WriteTargetMem(ctx context.Context, addr uint32, data [
 	if addr%4 != 0 {
 		return errors.Errorf("addr must be word-aligned, got 0x%x", addr)
 	}
-	for i := 0; i < len(data); {
-		if err := mapc.WriteReg(ctx, TAR, addr); err != nil {
-			return errors.Trace(err)
-		}
-		// Autoincrement only works on lower 10 bits.
-		cl := int((0x400 - addr&0x3ff) / 4)
-		if cl > len(data)-i {
-			cl = len(data) - i
-		}
-		if err := mapc.dpc.WriteAPRegMulti(ctx, mapc.apSel, uint8(DRW), data[i:i+cl]); err != nil {
-			return errors.Trace(err)
-		}
-		addr += uint32(cl * 4)
-		i += cl
-	}
-	return nil
+	ops := memOps(addr, len(data), func(offset, length int) dap.BlockOp {
+		return dap.BlockOp{Write: true, Reg: uint8(DRW), Data: data[offset : offset+length]}
+	})
+	_, err := mapc.dpc.TransferAPBlocks(ctx, mapc.apSel, ops)
+	return errors.Trace(err)
 }
 
 func (r MemAPReg) String() string {
@@ -71,6 +71,9 @@ func (cm4d *cm4Debug) ResetRun(ctx context.Context) error {
 
 func (cm4d *cm4Debug) WaitHalt(ctx context.Context) error {
 	for {
+		if err := ctx.Err(); err != nil {
+			return errors.Annotatef(err, "timed out waiting for halt")
+		}
 		dhcsr, err := cm4d.tmrw.ReadTargetReg(ctx, regDHCSR)
 		if err != nil {
 			return errors.Annotatef(err, "failed to get DHCSR")
@@ -184,5 +187,8 @@ func (cm4d *cm4Debug) Run(ctx context.Context, waitHalt bool) error {
 	if err := cm4d.tmrw.WriteTargetReg(ctx, regDHCSR, regDHCSRKey|1); err != nil {
 		return errors.Annotatef(err, "failed to set DHCSR")
 	}
+	if !waitHalt {
+		return nil
+	}
 	return errors.Trace(cm4d.WaitHalt(ctx))
 }
@@ -17,6 +17,7 @@
 package common
 
 import (
+	"bytes"
 	"io"
 
 	"github.com/juju/errors"
@@ -31,78 +32,122 @@ const (
 	slipEscapeEscape         = 0xDD
 )
 
+// Size of the receive buffer. Received data is decoded from the buffer, so a single read
+// from the port usually returns a few frames at a time.
+const slipReadBufSize = 16384
+
 type SLIPReaderWriter struct {
 	rw io.ReadWriter
+	// Received bytes not yet decoded, rbuf[rpos:rend].
+	rbuf       []byte
+	rpos, rend int
+	// Frames are encoded here before sending.
+	wbuf []byte
 }
 
 func NewSLIPReaderWriter(rw io.ReadWriter) *SLIPReaderWriter {
-	return &SLIPReaderWriter{rw: rw}
+	return &SLIPReaderWriter{rw: rw, rbuf: make([]byte, slipReadBufSize)}
+}
+
+// Reset discards received data that has not been returned by Read yet.
+// It should be used when the port is flushed or read from directly.
+func (srw *SLIPReaderWriter) Reset() {
+	srw.rpos, srw.rend = 0, 0
 }
 
+// Read reads one frame, which must start at the beginning of the pending data.
 func (srw *SLIPReaderWriter) Read(buf []byte) (int, error) {
 	n := 0
 	start := true
 	esc := false
 	for {
-		b := []byte{0}
-		bn, err := srw.rw.Read(b)
-		if err != nil || bn != 1 {
-			return n, errors.Annotatef(err, "error reading")
-		}
-		if start {
-			if b[0] != slipFrameDelimiter {
-				return 0, errors.Errorf("invalid SLIP starting byte: 0x%02x", b[0])
+		if srw.rpos == srw.rend {
+			bn, err := srw.rw.Read(srw.rbuf)
+			if bn < 0 {
+				bn = 0
+			}
+			srw.rpos, srw.rend = 0, bn
+			if bn == 0 {
+				return n, errors.Annotatef(err, "error reading")
 			}
-			start = false
-			continue
 		}
-		if !esc {
-			switch b[0] {
-			case slipFrameDelimiter:
-				glog.V(4).Infof("<= (%d) %s", n, LimitStr(buf[:n], 32))
-				return n, nil
-			case slipEscape:
-				esc = true
-			default:
-				if n >= len(buf) {
-					return n, errors.Errorf("frame buffer overflow (%d)", len(buf))
+		data := srw.rbuf[srw.rpos:srw.rend]
+		if start || esc {
+			b := data[0]
+			srw.rpos++
+			if start {
+				if b != slipFrameDelimiter {
+					return 0, errors.Errorf("invalid SLIP starting byte: 0x%02x", b)
 				}
-				buf[n] = b[0]
-				n += 1
+				start = false
+				continue
 			}
-		} else {
 			if n >= len(buf) {
 				return n, errors.Errorf("frame buffer overflow (%d)", len(buf))
 			}
-			switch b[0] {
+			switch b {
 			case slipEscapeFrameDelimiter:
 				buf[n] = slipFrameDelimiter
 			case slipEscapeEscape:
 				buf[n] = slipEscape
 			default:
-				return n, errors.Errorf("invalid SLIP escape sequence: %d", b[0])
+				return n, errors.Errorf("invalid SLIP escape sequence: %d", b)
 			}
-			n += 1
+			n++
 			esc = false
+			continue
+		}
+		// Copy everything up to the next special byte in one go.
+		i := bytes.IndexByte(data, slipFrameDelimiter)
+		if i < 0 {
+			i = len(data)
+		}
+		if j := bytes.IndexByte(data[:i], slipEscape); j >= 0 {
+			i = j
 		}
+		if n+i > len(buf) {
+			return n, errors.Errorf("frame buffer overflow (%d)", len(buf))
+		}
+		n += copy(buf[n:], data[:i])
+		srw.rpos += i
+		if i == len(data) {
+			continue
+		}
+		srw.rpos++
+		if data[i] == slipEscape {
+			esc = true
+			continue
+		}
+		glog.V(4).Infof("<= (%d) %s", n, LimitStr(buf[:n], 32))
+		return n, nil
 	}
 }
 
+// Write sends data as a single frame with one write to the port.
+// It returns the number of bytes sent on the wire, including framing and escapes.
 func (srw *SLIPReaderWriter) Write(data []byte) (int, error) {
-	frame := []byte{slipFrameDelimiter}
-	for _, b := range data {
-		switch b {
-		case slipFrameDelimiter:
-			frame = append(frame, slipEscape)
-			frame = append(frame, slipEscapeFrameDelimiter)
-		case slipEscape:
-			frame = append(frame, slipEscape)
-			frame = append(frame, slipEscapeEscape)
-		default:
-			frame = append(frame, b)
+	glog.V(4).Infof("=> (%d) %s", len(data), LimitStr(data, 32))
+	frame := append(srw.wbuf[:0], slipFrameDelimiter)
+	for len(data) > 0 {
+		i := bytes.IndexByte(data, slipFrameDelimiter)
+		if i < 0 {
+			i = len(data)
 		}
+		if j := bytes.IndexByte(data[:i], slipEscape); j >= 0 {
+			i = j
+		}
+		frame = append(frame, data[:i]...)
+		if i == len(data) {
+			break
+		}
+		if data[i] == slipFrameDelimiter {
+			frame = append(frame, slipEscape, slipEscapeFrameDelimiter)
+		} else {
+			frame = append(frame, slipEscape, slipEscapeEscape)
+		}
+		data = data[i+1:]
 	}
 	frame = append(frame, slipFrameDelimiter)
-	glog.V(4).Infof("=> (%d) %s", len(data), LimitStr(data, 32))
+	srw.wbuf = frame
 	return srw.rw.Write(frame)
 }
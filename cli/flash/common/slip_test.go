@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package common
+
+import (
+	"bytes"
+	"math/rand"
+	"testing"
+)
+
+// BenchmarkSLIPReaderWriter encodes and decodes flash write sized frames
+// of random data, which has the usual share of bytes that need escaping.
+func BenchmarkSLIPReaderWriter(b *testing.B) {
+	data := make([]byte, 16*1024)
+	rand.New(rand.NewSource(1)).Read(data)
+	var port bytes.Buffer
+	srw := NewSLIPReaderWriter(&port)
+	rbuf := make([]byte, 2*len(data))
+	b.SetBytes(int64(len(data)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := srw.Write(data); err != nil {
+			b.Fatal(err)
+		}
+		n, err := srw.Read(rbuf)
+		if err != nil {
+			b.Fatal(err)
+		}
+		if n != len(data) {
+			b.Fatalf("read %d bytes, want %d", n, len(data))
+		}
+	}
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package common
+
+import (
+	"io"
+	"net"
+	"strings"
+	"time"
+
+	"github.com/cesanta/go-serial/serial"
+	"github.com/juju/errors"
+)
+
+const tcpSerialPrefix = "tcp://"
+
+// OpenSerial opens a serial port. Ports of the form tcp://host:port are raw TCP connections,
+// e.g. to the device emulator or a serial-to-network bridge. Control lines and baud rate
+// cannot be changed on those, the other end decides.
+func OpenSerial(opts serial.OpenOptions) (serial.Serial, error) {
+	if !strings.HasPrefix(opts.PortName, tcpSerialPrefix) {
+		return serial.Open(opts)
+	}
+	addr := strings.TrimPrefix(opts.PortName, tcpSerialPrefix)
+	conn, err := net.Dial("tcp", addr)
+	if err != nil {
+		return nil, errors.Annotatef(err, "failed to connect to %s", addr)
+	}
+	return &tcpSerial{conn: conn}, nil
+}
+
+type tcpSerial struct {
+	conn        net.Conn
+	readTimeout time.Duration
+}
+
+// Read returns io.EOF on timeout, same as serial ports do.
+func (ts *tcpSerial) Read(b []byte) (int, error) {
+	if ts.readTimeout > 0 {
+		ts.conn.SetReadDeadline(time.Now().Add(ts.readTimeout))
+	} else {
+		ts.conn.SetReadDeadline(time.Time{})
+	}
+	n, err := ts.conn.Read(b)
+	if ne, ok := err.(net.Error); ok && ne.Timeout() {
+		err = io.EOF
+	}
+	return n, err
+}
+
+func (ts *tcpSerial) Write(b []byte) (int, error) {
+	return ts.conn.Write(b)
+}
+
+func (ts *tcpSerial) Close() error {
+	return ts.conn.Close()
+}
+
+func (ts *tcpSerial) SetReadTimeout(timeout time.Duration) error {
+	ts.readTimeout = timeout
+	return nil
+}
+
+func (ts *tcpSerial) SetBaudRate(baudRate uint) error {
+	return nil
+}
+
+func (ts *tcpSerial) SetDTR(dtr bool) error {
+	return nil
+}
+
+func (ts *tcpSerial) SetRTS(rts bool) error {
+	return nil
+}
+
+func (ts *tcpSerial) SetRTSDTR(rts, dtr bool) error {
+	return nil
+}
+
+func (ts *tcpSerial) SetBreak(brk bool) error {
+	return nil
+}
+
+// Flush discards data that has been received but not read yet.
+func (ts *tcpSerial) Flush() error {
+	buf := make([]byte, 4096)
+	for {
+		ts.conn.SetReadDeadline(time.Now().Add(time.Millisecond))
+		if n, err := ts.conn.Read(buf); n == 0 || err != nil {
+			return nil
+		}
+	}
+}
@@ -30,6 +30,7 @@ type FlashOpts struct {
 	DataPort               string
 	ROMBaudRate            uint
 	FlasherBaudRate        uint
+	AutoBaudRate           bool
 	InvertedControlLines   bool
 	FlashParams            string
 	EraseChip              bool
@@ -39,6 +40,12 @@ type FlashOpts struct {
 	ESP32EncryptionKeyFile string
 	ESP32FlashCryptConf    uint32
 	KeepFS                 bool
+	DigestCacheDir         string
+	VerifyReadBack         bool
+	WriteWindow            int
+	AdaptiveWriteWindow    bool
+	ReadWindow             int
+	JSONStatsFile          string
 }
 
 type RegReaderWriter interface {
@@ -47,6 +54,12 @@ type RegReaderWriter interface {
 	Disconnect()
 }
 
+// RegBulkReader is implemented by clients that can read many registers in one go,
+// faster than doing it one ReadReg at a time.
+type RegBulkReader interface {
+	ReadRegs(regs []uint32) ([]uint32, error)
+}
+
 func (ct ChipType) String() string {
 	switch ct {
 	case ChipESP8266:
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package flasher
+
+import (
+	"strings"
+
+	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/common/state"
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	glog "k8s.io/klog/v2"
+)
+
+const (
+	// Amount of flash read back when testing the link.
+	linkTestSize = 16384
+	// Switch to lower baud rate after this many digest mismatches in a row.
+	maxDigestMismatches = 2
+)
+
+// Baud rates to try when auto-detecting, in ascending order.
+var autoBaudRates = []uint{230400, 460800, 921600, 1500000, 2000000, 3000000}
+
+// linkTest checks that the link is stable at the current speed:
+// the flasher must respond to sync and read back flash with matching digest.
+func (r *cfResult) linkTest() error {
+	if err := r.fc.Sync(); err != nil {
+		return errors.Trace(err)
+	}
+	data := make([]byte, linkTestSize)
+	return errors.Trace(r.fc.Read(0, data))
+}
+
+func (r *cfResult) connectAndTest(ct esp.ChipType, opts *esp.FlashOpts, baudRate uint) error {
+	if _, err := r.connect(ct, opts, baudRate); err != nil {
+		return errors.Trace(err)
+	}
+	if err := r.linkTest(); err != nil {
+		r.rc.Disconnect()
+		return errors.Annotatef(err, "link test failed @ %d", baudRate)
+	}
+	return nil
+}
+
+// connectAutoBaudRate connects to the flasher at the fastest baud rate that works.
+// Baud rate that was selected previously for the port is tried first,
+// if there isn't one or it no longer works, increasing rates are probed.
+func (r *cfResult) connectAutoBaudRate(ct esp.ChipType, opts *esp.FlashOpts) error {
+	port := opts.ControlPort
+	if baudRate := state.GetESPBaudRate(port); baudRate > 0 {
+		err := r.connectAndTest(ct, opts, baudRate)
+		if err == nil {
+			r.Reportf("Using baud rate %d", baudRate)
+			return nil
+		}
+		glog.Warningf("%s: previously selected baud rate %d does not work (%s), probing", port, baudRate, err)
+	}
+	r.Reportf("Probing baud rates...")
+	var bestBaudRate uint
+	connected := false
+	for _, baudRate := range autoBaudRates {
+		if connected {
+			r.rc.Disconnect()
+			connected = false
+		}
+		if err := r.connectAndTest(ct, opts, baudRate); err != nil {
+			glog.Infof("%s", err)
+			break
+		}
+		connected = true
+		bestBaudRate = baudRate
+	}
+	if !connected {
+		if _, err := r.connect(ct, opts, bestBaudRate); err != nil {
+			return errors.Trace(err)
+		}
+	}
+	r.Reportf("Selected baud rate %d", bestBaudRate)
+	saveBaudRate(port, bestBaudRate)
+	return nil
+}
+
+// lowerBaudRate reconnects to the flasher at the next lower baud rate.
+func (r *cfResult) lowerBaudRate(ct esp.ChipType, opts *esp.FlashOpts) error {
+	var newBaudRate uint
+	for _, baudRate := range autoBaudRates {
+		if baudRate < r.baudRate {
+			newBaudRate = baudRate
+		}
+	}
+	if r.baudRate == 0 || newBaudRate == 0 {
+		return errors.Errorf("already at the lowest baud rate")
+	}
+	r.Reportf("Too many errors, switching to %d...", newBaudRate)
+	fcache := r.fc.frameCache
+	r.rc.Disconnect()
+	if _, err := r.connect(ct, opts, newBaudRate); err != nil {
+		return errors.Trace(err)
+	}
+	r.fc.frameCache = fcache
+	saveBaudRate(opts.ControlPort, newBaudRate)
+	return nil
+}
+
+func saveBaudRate(port string, baudRate uint) {
+	state.SetESPBaudRate(port, baudRate)
+	if err := state.SaveState(); err != nil {
+		glog.Warningf("failed to save state: %s", err)
+	}
+}
+
+func isDigestMismatch(err error) bool {
+	return strings.Contains(err.Error(), "digest mismatch")
+}
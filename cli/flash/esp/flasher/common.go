@@ -18,6 +18,7 @@ package flasher
 
 import (
 	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/flash/common"
 	"github.com/mongoose-os/mos/cli/flash/esp"
 	"github.com/mongoose-os/mos/cli/flash/esp/rom_client"
 	glog "k8s.io/klog/v2"
@@ -32,6 +33,20 @@ type cfResult struct {
 	rc          *rom_client.ROMClient
 	fc          *FlasherClient
 	flashParams flashParams
+	// Current flasher baud rate, 0 means ROM baud rate.
+	baudRate uint
+	// If set, progress messages are prefixed with it
+	// (used when flashing multiple devices at once).
+	reportPrefix string
+	// Stats of write operations performed.
+	writeStats []*WriteStats
+}
+
+func (r *cfResult) Reportf(f string, args ...interface{}) {
+	if r.reportPrefix != "" {
+		f = r.reportPrefix + f
+	}
+	common.Reportf(f, args...)
 }
 
 func ConnectToFlasherClient(ct esp.ChipType, opts *esp.FlashOpts) (*cfResult, error) {
@@ -52,32 +67,20 @@ func ConnectToFlasherClient(ct esp.ChipType, opts *esp.FlashOpts) (*cfResult, er
 			r.rc.Disconnect()
 		}
 	}()
-	flasherBaudRate := opts.FlasherBaudRate
-	for {
-		r.rc, err = rom_client.ConnectToROM(ct, opts)
-		if err != nil {
-			return nil, errors.Annotatef(
-				err,
-				"Failed to talk to bootloader.\nSee "+
-					"https://github.com/espressif/esptool/wiki/ESP8266-Boot-Mode-Selection\n"+
-					"for wiring instructions or pull GPIO0 low and reset.",
-			)
-		}
-		ownROMClient = true
-
-		r.fc, err = NewFlasherClient(ct, r.rc, opts.ROMBaudRate, flasherBaudRate)
-		if err == nil {
-			break
-		}
-		if flasherBaudRate != 0 {
-			glog.Errorf("failed to run flasher @ %d, falling back to ROM baud rate...", flasherBaudRate)
-			r.rc.Disconnect()
-			ownROMClient = false
-			flasherBaudRate = 0
-		} else {
-			return nil, errors.Annotatef(err, "failed to run flasher")
+	if opts.AutoBaudRate {
+		err = r.connectAutoBaudRate(ct, opts)
+	} else {
+		var romOK bool
+		romOK, err = r.connect(ct, opts, opts.FlasherBaudRate)
+		if err != nil && romOK && opts.FlasherBaudRate != 0 {
+			glog.Errorf("failed to run flasher @ %d, falling back to ROM baud rate...", opts.FlasherBaudRate)
+			_, err = r.connect(ct, opts, 0)
 		}
 	}
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	ownROMClient = true
 	if r.flashParams.Size() <= 0 || r.flashParams.Mode() == "" {
 		mfg, flashSize, err := detectFlashSize(r.fc)
 		if err != nil {
@@ -102,6 +105,30 @@ func ConnectToFlasherClient(ct esp.ChipType, opts *esp.FlashOpts) (*cfResult, er
 	return r, nil
 }
 
+// connect talks to the ROM loader and starts the flasher at the given baud rate.
+// romOK is set if ROM loader connection succeeded, even if starting the flasher did not.
+func (r *cfResult) connect(ct esp.ChipType, opts *esp.FlashOpts, baudRate uint) (romOK bool, err error) {
+	r.rc, err = rom_client.ConnectToROM(ct, opts)
+	if err != nil {
+		return false, errors.Annotatef(
+			err,
+			"Failed to talk to bootloader.\nSee "+
+				"https://github.com/espressif/esptool/wiki/ESP8266-Boot-Mode-Selection\n"+
+				"for wiring instructions or pull GPIO0 low and reset.",
+		)
+	}
+	r.fc, err = NewFlasherClient(ct, r.rc, opts.ROMBaudRate, baudRate)
+	if err != nil {
+		r.rc.Disconnect()
+		return true, errors.Annotatef(err, "failed to run flasher")
+	}
+	r.fc.writeWindow = opts.WriteWindow
+	r.fc.adaptiveWriteWindow = opts.AdaptiveWriteWindow
+	r.fc.readWindow = opts.ReadWindow
+	r.baudRate = baudRate
+	return true, nil
+}
+
 func detectFlashSize(fc *FlasherClient) (int, int, error) {
 	chipID, err := fc.GetFlashChipID()
 	if err != nil {
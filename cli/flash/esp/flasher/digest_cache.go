@@ -0,0 +1,221 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package flasher
+
+import (
+	"crypto/md5"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
+
+	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	"github.com/mongoose-os/mos/cli/flash/esp32"
+	glog "k8s.io/klog/v2"
+)
+
+type digest [md5.Size]byte
+
+func (d digest) String() string {
+	return hex.EncodeToString(d[:])
+}
+
+func parseDigest(s string) (digest, error) {
+	var d digest
+	b, err := hex.DecodeString(s)
+	if err != nil || len(b) != md5.Size {
+		return d, errors.Errorf("invalid digest %q", s)
+	}
+	copy(d[:], b)
+	return d, nil
+}
+
+func bytesToDigest(b []byte) (digest, error) {
+	var d digest
+	if len(b) != md5.Size {
+		return d, errors.Errorf("invalid digest length %d", len(b))
+	}
+	copy(d[:], b)
+	return d, nil
+}
+
+// sectorDigests computes MD5 digests of each flash sector of data.
+// The last sector may be partial.
+func sectorDigests(data []byte) []digest {
+	res := make([]digest, 0, (len(data)+flashSectorSize-1)/flashSectorSize)
+	for offset := 0; offset < len(data); offset += flashSectorSize {
+		end := offset + flashSectorSize
+		if end > len(data) {
+			end = len(data)
+		}
+		res = append(res, md5.Sum(data[offset:end]))
+	}
+	return res
+}
+
+// Contents of a flash region as last written by us.
+type digestCacheEntry struct {
+	digest  digest
+	sectors []digest
+}
+
+type digestCacheEntryJSON struct {
+	Digest  string   `json:"digest"`
+	Sectors []string `json:"sectors"`
+}
+
+// digestCache remembers per-sector digests of images written to a particular device.
+// Entries are only trusted if a sample of sectors on the device still matches,
+// so changes made to flash outside of mos are detected (see checkCachedSectors).
+type digestCache struct {
+	fileName string
+	entries  map[string]*digestCacheEntry
+}
+
+func digestCacheKey(addr uint32, length int) string {
+	return fmt.Sprintf("0x%x:%d", addr, length)
+}
+
+// getDeviceID returns identifier of the device that is used as the digest cache key.
+func getDeviceID(ct esp.ChipType, cfr *cfResult, fusesByName map[string]*esp32.Fuse) (string, error) {
+	chipID, err := cfr.fc.GetFlashChipID()
+	if err != nil {
+		return "", errors.Annotatef(err, "failed to get flash chip id")
+	}
+	var mac string
+	switch ct {
+	case esp.ChipESP32:
+		if fusesByName == nil {
+			return "", errors.Errorf("no eFuse data")
+		}
+		mac = strings.Replace(fusesByName[esp32.MACAddressFuseName].MACAddressString(), ":", "", -1)
+	case esp.ChipESP8266:
+		// There is no easy way to get MAC on ESP8266, use raw eFuse contents instead.
+		for _, reg := range []uint32{0x3ff00050, 0x3ff00054, 0x3ff00058, 0x3ff0005c} {
+			v, err := cfr.fc.ReadReg(reg)
+			if err != nil {
+				return "", errors.Annotatef(err, "failed to read eFuse")
+			}
+			mac += fmt.Sprintf("%08x", v)
+		}
+	default:
+		return "", errors.Errorf("unknown chip type %d", ct)
+	}
+	return fmt.Sprintf("%s-%s-%06x", strings.ToLower(ct.String()), mac, chipID), nil
+}
+
+func loadDigestCache(dir, deviceID string) *digestCache {
+	dc := &digestCache{
+		fileName: filepath.Join(dir, fmt.Sprintf("%s.json", deviceID)),
+		entries:  make(map[string]*digestCacheEntry),
+	}
+	data, err := ioutil.ReadFile(dc.fileName)
+	if err != nil {
+		return dc
+	}
+	var entries map[string]*digestCacheEntryJSON
+	if err := json.Unmarshal(data, &entries); err != nil {
+		glog.Warningf("%s: invalid digest cache: %s", dc.fileName, err)
+		return dc
+	}
+	for k, je := range entries {
+		e, err := parseDigestCacheEntry(je)
+		if err != nil {
+			glog.Warningf("%s: invalid entry %s: %s", dc.fileName, k, err)
+			continue
+		}
+		dc.entries[k] = e
+	}
+	glog.V(1).Infof("%s: %d entries", dc.fileName, len(dc.entries))
+	return dc
+}
+
+func parseDigestCacheEntry(je *digestCacheEntryJSON) (*digestCacheEntry, error) {
+	var err error
+	e := &digestCacheEntry{sectors: make([]digest, len(je.Sectors))}
+	if e.digest, err = parseDigest(je.Digest); err != nil {
+		return nil, errors.Trace(err)
+	}
+	for i, s := range je.Sectors {
+		if e.sectors[i], err = parseDigest(s); err != nil {
+			return nil, errors.Trace(err)
+		}
+	}
+	return e, nil
+}
+
+func (dc *digestCache) Get(addr uint32, length int) *digestCacheEntry {
+	if dc == nil {
+		return nil
+	}
+	return dc.entries[digestCacheKey(addr, length)]
+}
+
+// Put records contents of the image as written to flash.
+func (dc *digestCache) Put(addr uint32, data []byte) {
+	if dc == nil {
+		return
+	}
+	dc.Drop(addr, len(data))
+	dc.entries[digestCacheKey(addr, len(data))] = &digestCacheEntry{
+		digest:  md5.Sum(data),
+		sectors: sectorDigests(data),
+	}
+}
+
+// Drop removes entries that overlap with the given region,
+// contents of which is no longer known.
+func (dc *digestCache) Drop(addr uint32, length int) {
+	if dc == nil {
+		return
+	}
+	end := int(addr) + length
+	for k := range dc.entries {
+		var eAddr uint32
+		var eLen int
+		if _, err := fmt.Sscanf(k, "0x%x:%d", &eAddr, &eLen); err != nil ||
+			(int(eAddr) < end && int(eAddr)+eLen > int(addr)) {
+			delete(dc.entries, k)
+		}
+	}
+}
+
+func (dc *digestCache) Save() error {
+	if dc == nil {
+		return nil
+	}
+	entries := make(map[string]*digestCacheEntryJSON)
+	for k, e := range dc.entries {
+		je := &digestCacheEntryJSON{Digest: e.digest.String()}
+		for _, sd := range e.sectors {
+			je.Sectors = append(je.Sectors, sd.String())
+		}
+		entries[k] = je
+	}
+	data, err := json.Marshal(entries)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.MkdirAll(filepath.Dir(dc.fileName), 0755); err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(ioutil.WriteFile(dc.fileName, data, 0644))
+}
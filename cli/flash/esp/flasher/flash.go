@@ -17,17 +17,17 @@
 package flasher
 
 import (
+	"context"
 	"crypto/md5"
-	"encoding/hex"
 	"io/ioutil"
 	"math/bits"
+	"runtime/trace"
 	"sort"
 	"strings"
 	"time"
 
 	"github.com/juju/errors"
 	moscommon "github.com/mongoose-os/mos/cli/common"
-	"github.com/mongoose-os/mos/cli/flash/common"
 	"github.com/mongoose-os/mos/cli/flash/esp"
 	"github.com/mongoose-os/mos/cli/flash/esp32"
 	"github.com/mongoose-os/mos/common/fwbundle"
@@ -75,18 +75,31 @@ func Flash(ct esp.ChipType, fw *fwbundle.FirmwareBundle, opts *esp.FlashOpts) er
 		return errors.Errorf("--keep-fs and --esp-erase-chip are incompatible")
 	}
 
-	cfr, err := ConnectToFlasherClient(ct, opts)
+	images, err := prepareImages(ct, fw, opts)
 	if err != nil {
 		return errors.Trace(err)
 	}
-	defer cfr.rc.Disconnect()
 
-	if ct == esp.ChipESP8266 {
-		// Based on our knowledge of flash size, adjust type=sys_params image.
-		adjustSysParamsLocation(fw, cfr.flashParams.Size())
+	var cfr *cfResult
+	trace.WithRegion(context.Background(), "esp-connect", func() {
+		cfr, err = ConnectToFlasherClient(ct, opts)
+	})
+	if err != nil {
+		return errors.Trace(err)
 	}
+	// cfr.rc may be replaced if the baud rate is lowered.
+	defer func() { cfr.rc.Disconnect() }()
 
-	// Sort images by address
+	err = flashImages(ct, cfr, images, opts)
+	if opts.JSONStatsFile != "" {
+		writeJSONStats(opts.JSONStatsFile, newFlashReport(opts.ControlPort, cfr, err))
+	}
+	return errors.Trace(err)
+}
+
+// prepareImages extracts the images to be flashed from the bundle.
+// The result is not device-specific and can be shared by multiple devices.
+func prepareImages(ct esp.ChipType, fw *fwbundle.FirmwareBundle, opts *esp.FlashOpts) ([]*image, error) {
 	var images []*image
 	for _, p := range fw.Parts {
 		if p.Type == fwbundle.FSPartType && opts.KeepFS {
@@ -94,13 +107,13 @@ func Flash(ct esp.ChipType, fw *fwbundle.FirmwareBundle, opts *esp.FlashOpts) er
 		}
 		data, err := fw.GetPartData(p.Name)
 		if err != nil {
-			return errors.Annotatef(err, "%s: failed to get data", p.Name)
+			return nil, errors.Annotatef(err, "%s: failed to get data", p.Name)
 		}
 		// For ESP32, resolve partition name to address
 		if p.ESP32PartitionName != "" {
 			pti, err := esp32.GetPartitionInfo(fw, p.ESP32PartitionName)
 			if err != nil {
-				return errors.Annotatef(err, "%s: failed to get respolve partition %q", p.Name, p.ESP32PartitionName)
+				return nil, errors.Annotatef(err, "%s: failed to get respolve partition %q", p.Name, p.ESP32PartitionName)
 			}
 			glog.V(1).Infof("%s -> %s -> 0x%x", p.Name, p.ESP32PartitionName, pti.Pos.Offset)
 			p.Addr = pti.Pos.Offset
@@ -114,14 +127,28 @@ func Flash(ct esp.ChipType, fw *fwbundle.FirmwareBundle, opts *esp.FlashOpts) er
 		}
 		images = append(images, im)
 	}
+	return images, nil
+}
 
-	return errors.Trace(writeImages(ct, cfr, images, opts, true))
+// flashImages writes images to the connected device.
+// Images are copied before modification, their data is not altered.
+func flashImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.FlashOpts) error {
+	var devImages []*image
+	for _, im := range images {
+		dim := *im
+		devImages = append(devImages, &dim)
+	}
+	if ct == esp.ChipESP8266 {
+		// Based on our knowledge of flash size, adjust type=sys_params image.
+		adjustSysParamsLocation(devImages, cfr.flashParams.Size())
+	}
+	return errors.Trace(writeImages(ct, cfr, devImages, opts, true))
 }
 
 func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.FlashOpts, sanityCheck bool) error {
 	var err error
 
-	common.Reportf("Flash size: %d, params: %s", cfr.flashParams.Size(), cfr.flashParams)
+	cfr.Reportf("Flash size: %d, params: %s", cfr.flashParams.Size(), cfr.flashParams)
 
 	encryptionEnabled := false
 	secureBootEnabled := false
@@ -134,29 +161,36 @@ func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.Flas
 			if fcnt, err := fusesByName[esp32.FlashCryptCntFuseName].Value(true /* withDiffs */); err == nil {
 				encryptionEnabled = (bits.OnesCount64(fcnt.Uint64())%2 != 0)
 				kcs = esp32.GetKeyEncodingScheme(fusesByName)
-				common.Reportf("Flash encryption: %s, scheme: %s", enDis(encryptionEnabled), kcs)
+				cfr.Reportf("Flash encryption: %s, scheme: %s", enDis(encryptionEnabled), kcs)
 			}
 			if abs0, err := fusesByName[esp32.AbstractDone0FuseName].Value(true /* withDiffs */); err == nil {
 				secureBootEnabled = (abs0.Int64() != 0)
-				common.Reportf("Secure boot: %s", enDis(secureBootEnabled))
+				cfr.Reportf("Secure boot: %s", enDis(secureBootEnabled))
 			}
 		} else {
 			// Some boards (ARDUINO NANO 33 IOT) do not support memory reading commands to read efuses.
 			// Allow to proceed anyway.
-			common.Reportf("Failed to read eFuses, assuming no flash encryption")
+			cfr.Reportf("Failed to read eFuses, assuming no flash encryption")
 		}
 	}
 
 	for _, im := range images {
 		if im.Addr == 0 || im.Addr == 0x1000 && len(im.Data) >= 4 && im.Data[0] == 0xe9 {
-			im.Data[2], im.Data[3] = cfr.flashParams.Bytes()
+			b2, b3 := cfr.flashParams.Bytes()
+			if im.Data[2] != b2 || im.Data[3] != b3 {
+				// Data may be shared with other devices, don't modify it in place.
+				newData := make([]byte, len(im.Data))
+				copy(newData, im.Data)
+				newData[2], newData[3] = b2, b3
+				im.Data = newData
+			}
 		}
 		if ct == esp.ChipESP32 && im.ESP32Encrypt && encryptionEnabled {
 			if esp32EncryptionKey == nil {
 				if opts.ESP32EncryptionKeyFile != "" {
 					mac := strings.ToUpper(strings.Replace(fusesByName[esp32.MACAddressFuseName].MACAddressString(), ":", "", -1))
 					ekf := moscommon.ExpandPlaceholders(opts.ESP32EncryptionKeyFile, "?", mac)
-					common.Reportf("Flash encryption key: %s", ekf)
+					cfr.Reportf("Flash encryption key: %s", ekf)
 					esp32EncryptionKey, err = ioutil.ReadFile(ekf)
 					if err != nil {
 						return errors.Annotatef(err, "failed to read encryption key")
@@ -196,21 +230,42 @@ func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.Flas
 	}
 
 	imagesToWrite := images
+	var dc *digestCache
 	if opts.EraseChip {
-		common.Reportf("Erasing chip...")
-		if err = cfr.fc.EraseChip(); err != nil {
+		cfr.Reportf("Erasing chip...")
+		trace.WithRegion(context.Background(), "esp-erase-chip", func() {
+			err = cfr.fc.EraseChip()
+		})
+		if err != nil {
 			return errors.Annotatef(err, "failed to erase chip")
 		}
 	} else if opts.MinimizeWrites {
-		common.Reportf("Deduping...")
-		imagesToWrite, err = dedupImages(cfr.fc, images)
+		if opts.DigestCacheDir != "" {
+			if devID, err := getDeviceID(ct, cfr, fusesByName); err == nil {
+				dc = loadDigestCache(opts.DigestCacheDir, devID)
+			} else {
+				glog.Warningf("failed to get device id, not using digest cache: %s", err)
+			}
+		}
+		cfr.Reportf("Deduping...")
+		trace.WithRegion(context.Background(), "esp-dedup", func() {
+			imagesToWrite, err = dedupImages(cfr, dc, images)
+		})
 		if err != nil {
 			return errors.Annotatef(err, "failed to dedup images")
 		}
 	}
 
 	if len(imagesToWrite) > 0 {
-		common.Reportf("Writing...")
+		// Contents of the regions being written is unknown until they are verified,
+		// forget them now in case we fail or get interrupted.
+		for _, im := range imagesToWrite {
+			dc.Drop(im.Addr, len(im.Data))
+		}
+		if err := dc.Save(); err != nil {
+			glog.Warningf("failed to save digest cache: %s", err)
+		}
+		cfr.Reportf("Writing...")
 		start := time.Now()
 		totalBytesWritten := 0
 		for _, im := range imagesToWrite {
@@ -227,26 +282,47 @@ func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.Flas
 				}
 				data = newData
 			}
+			numDigestMismatches := 0
 			for i := 1; imageBytesWritten < len(im.Data); i++ {
-				common.Reportf("  %7d @ 0x%x", len(data), addr)
-				bytesWritten, err := cfr.fc.Write(addr, data, true /* erase */, opts.EnableCompression)
+				cfr.Reportf("  %7d @ 0x%x", len(data), addr)
+				var bytesWritten int
+				var err error
+				trace.WithRegion(context.Background(), "esp-write", func() {
+					bytesWritten, err = cfr.fc.Write(addr, data, true /* erase */, opts.EnableCompression)
+				})
 				if err != nil {
 					if bytesWritten >= flashSectorSize {
 						// We made progress, restart the retry counter.
 						i = 1
 					}
+					if isDigestMismatch(err) {
+						numDigestMismatches++
+					} else {
+						numDigestMismatches = 0
+					}
 					err = errors.Annotatef(err, "write error (attempt %d/%d)", i, numAttempts)
-					if i >= numAttempts {
+					if i >= numAttempts && !(opts.AutoBaudRate && numDigestMismatches >= maxDigestMismatches) {
 						return errors.Annotatef(err, "%s: failed to write", im.Name)
 					}
 					glog.Warningf("%s", err)
-					if err := cfr.fc.Sync(); err != nil {
+					if opts.AutoBaudRate && numDigestMismatches >= maxDigestMismatches {
+						// The link is not reliable at this speed, slow down.
+						if err := cfr.lowerBaudRate(ct, opts); err != nil {
+							return errors.Annotatef(err, "%s: failed to write", im.Name)
+						}
+						numDigestMismatches = 0
+						i = 0
+					} else if err := cfr.fc.Sync(); err != nil {
 						return errors.Annotatef(err, "lost connection with the flasher")
 					}
 					// Round down to sector boundary
 					bytesWritten = bytesWritten - (bytesWritten % flashSectorSize)
 					data = data[bytesWritten:]
 				}
+				if ws := cfr.fc.LastWriteStats(); err == nil && ws != nil {
+					ws.Name = im.Name
+					cfr.writeStats = append(cfr.writeStats, ws)
+				}
 				imageBytesWritten += bytesWritten
 				addr += uint32(bytesWritten)
 			}
@@ -254,28 +330,42 @@ func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.Flas
 		}
 		seconds := time.Since(start).Seconds()
 		bytesPerSecond := float64(totalBytesWritten) / seconds
-		common.Reportf("Wrote %d bytes in %.2f seconds (%.2f KBit/sec)", totalBytesWritten, seconds, bytesPerSecond*8/1024)
+		cfr.Reportf("Wrote %d bytes in %.2f seconds (%.2f KBit/sec)", totalBytesWritten, seconds, bytesPerSecond*8/1024)
 	}
 
-	common.Reportf("Verifying...")
-	for _, im := range images {
-		common.Reportf("  %7d @ 0x%x", len(im.Data), im.Addr)
-		digest, err := cfr.fc.Digest(im.Addr, uint32(len(im.Data)), 0 /* blockSize */)
-		if err != nil {
-			return errors.Annotatef(err, "%s: failed to compute digest %d @ 0x%x", im.Name, len(im.Data), im.Addr)
-		}
-		if len(digest) != 1 || len(digest[0]) != 16 {
-			return errors.Errorf("unexpected digest packetresult %+v", digest)
-		}
-		digestHex := strings.ToLower(hex.EncodeToString(digest[0]))
-		expectedDigest := md5.Sum(im.Data)
-		expectedDigestHex := strings.ToLower(hex.EncodeToString(expectedDigest[:]))
-		if digestHex != expectedDigestHex {
-			return errors.Errorf("%d @ 0x%x: digest mismatch: expected %s, got %s", len(im.Data), im.Addr, expectedDigestHex, digestHex)
+	if opts.VerifyReadBack {
+		cfr.Reportf("Verifying...")
+		for _, im := range images {
+			cfr.Reportf("  %7d @ 0x%x", len(im.Data), im.Addr)
+			var d digest
+			trace.WithRegion(context.Background(), "esp-verify", func() {
+				d, err = getImageDigest(cfr.fc, im)
+			})
+			if expectedDigest := digest(md5.Sum(im.Data)); err != nil || d != expectedDigest {
+				// The image may have been skipped because of a stale cache entry, make sure it is written next time.
+				dc.Drop(im.Addr, len(im.Data))
+				if serr := dc.Save(); serr != nil {
+					glog.Warningf("failed to save digest cache: %s", serr)
+				}
+				if err != nil {
+					return errors.Trace(err)
+				}
+				return errors.Errorf("%d @ 0x%x: digest mismatch: expected %s, got %s", len(im.Data), im.Addr, expectedDigest, d)
+			}
 		}
+	} else {
+		// Data that was written has been verified by the flasher while writing and the rest
+		// has been checked by dedup, no need to read everything back.
+		glog.V(1).Infof("Skipping read back verification")
+	}
+	for _, im := range images {
+		dc.Put(im.Addr, im.Data)
+	}
+	if err := dc.Save(); err != nil {
+		glog.Warningf("failed to save digest cache: %s", err)
 	}
 	if opts.BootFirmware {
-		common.Reportf("Booting firmware...")
+		cfr.Reportf("Booting firmware...")
 		if err = cfr.fc.BootFirmware(); err != nil {
 			return errors.Annotatef(err, "failed to reboot into firmware")
 		}
@@ -283,9 +373,9 @@ func writeImages(ct esp.ChipType, cfr *cfResult, images []*image, opts *esp.Flas
 	return nil
 }
 
-func adjustSysParamsLocation(fw *fwbundle.FirmwareBundle, flashSize int) {
+func adjustSysParamsLocation(images []*image, flashSize int) {
 	sysParamsAddr := uint32(flashSize - sysParamsAreaSize)
-	for _, p := range fw.Parts {
+	for _, p := range images {
 		if p.Type != sysParamsPartType {
 			continue
 		}
@@ -344,28 +434,108 @@ func sanityCheckImages(ct esp.ChipType, images []*image, flashSize, flashSectorS
 	return nil
 }
 
-func dedupImages(fc *FlasherClient, images []*image) ([]*image, error) {
+// getImageDigest returns digest of the flash region occupied by the image.
+func getImageDigest(fc *FlasherClient, im *image) (digest, error) {
+	digests, err := fc.Digest(im.Addr, uint32(len(im.Data)), 0 /* blockSize */)
+	if err != nil {
+		return digest{}, errors.Annotatef(err, "%s: failed to compute digest %d @ 0x%x", im.Name, len(im.Data), im.Addr)
+	}
+	if len(digests) != 1 {
+		return digest{}, errors.Errorf("unexpected digest packet result %+v", digests)
+	}
+	return bytesToDigest(digests[0])
+}
+
+// Number of sectors checked to validate a digest cache entry.
+const digestCacheCheckSectors = 8
+
+// checkCachedSectors compares digests of a sample of sectors on the device with the cache entry:
+// the first, the last and evenly spaced ones in between. This is much cheaper than digesting
+// the whole region, and a region rewritten by something else, e.g. a different firmware
+// flashed with another tool, almost never matches all of them.
+func checkCachedSectors(cfr *cfResult, im *image, ce *digestCacheEntry) (bool, error) {
+	n := len(ce.sectors)
+	checked := map[int]bool{}
+	for i := 0; i < digestCacheCheckSectors && i < n; i++ {
+		si := 0
+		if digestCacheCheckSectors > 1 {
+			si = i * (n - 1) / (digestCacheCheckSectors - 1)
+		}
+		if checked[si] {
+			continue
+		}
+		checked[si] = true
+		offset := si * flashSectorSize
+		end := offset + flashSectorSize
+		if end > len(im.Data) {
+			end = len(im.Data)
+		}
+		sim := &image{Name: im.Name, Addr: im.Addr + uint32(offset), Data: im.Data[offset:end]}
+		d, err := getImageDigest(cfr.fc, sim)
+		if err != nil {
+			return false, errors.Trace(err)
+		}
+		if d != ce.sectors[si] {
+			return false, nil
+		}
+	}
+	return true, nil
+}
+
+// getFlashSectorDigests returns digests of the sectors currently occupied by the image.
+// If digest cache has an entry for this region and a sample of sectors still matches it,
+// cached sector digests are used. Filesystem images are modified by the firmware at runtime,
+// so they are always digested in full.
+func getFlashSectorDigests(cfr *cfResult, dc *digestCache, im *image) ([]digest, error) {
+	numSectors := (len(im.Data) + flashSectorSize - 1) / flashSectorSize
+	if ce := dc.Get(im.Addr, len(im.Data)); ce != nil && len(ce.sectors) == numSectors && im.Type != fwbundle.FSPartType {
+		ok, err := checkCachedSectors(cfr, im, ce)
+		if err != nil {
+			return nil, errors.Trace(err)
+		}
+		if ok {
+			glog.V(1).Infof("%d @ 0x%x: using cached digests", len(im.Data), im.Addr)
+			return ce.sectors, nil
+		}
+		glog.V(1).Infof("%d @ 0x%x: cached digests are stale", len(im.Data), im.Addr)
+	}
+	digests, err := cfr.fc.Digest(im.Addr, uint32(len(im.Data)), flashSectorSize)
+	if err != nil {
+		return nil, errors.Annotatef(err, "%s: failed to compute digest %d @ 0x%x", im.Name, len(im.Data), im.Addr)
+	}
+	// There's also a full image digest at the end.
+	if len(digests) < numSectors {
+		return nil, errors.Errorf("%s: expected %d digests, got %d", im.Name, numSectors, len(digests))
+	}
+	res := make([]digest, numSectors)
+	for i := range res {
+		if res[i], err = bytesToDigest(digests[i]); err != nil {
+			return nil, errors.Trace(err)
+		}
+	}
+	return res, nil
+}
+
+func dedupImages(cfr *cfResult, dc *digestCache, images []*image) ([]*image, error) {
 	var dedupedImages []*image
 	for _, im := range images {
 		glog.V(2).Infof("%d @ 0x%x", len(im.Data), im.Addr)
 		imAddr := int(im.Addr)
-		digests, err := fc.Digest(im.Addr, uint32(len(im.Data)), flashSectorSize)
+		digests, err := getFlashSectorDigests(cfr, dc, im)
 		if err != nil {
-			return nil, errors.Annotatef(err, "%s: failed to compute digest %d @ 0x%x", im.Name, len(im.Data), im.Addr)
+			return nil, errors.Trace(err)
 		}
-		i, offset := 0, 0
+		expectedDigests := sectorDigests(im.Data)
 		var newImages []*image
 		newAddr, newLen, newTotalLen := imAddr, 0, 0
-		for offset < len(im.Data) {
+		for i, expectedDigest := range expectedDigests {
+			offset := i * flashSectorSize
 			blockLen := flashSectorSize
 			if offset+blockLen > len(im.Data) {
 				blockLen = len(im.Data) - offset
 			}
-			digestHex := strings.ToLower(hex.EncodeToString(digests[i]))
-			expectedDigest := md5.Sum(im.Data[offset : offset+blockLen])
-			expectedDigestHex := strings.ToLower(hex.EncodeToString(expectedDigest[:]))
-			glog.V(2).Infof("0x%06x %4d %s %s %t", imAddr+offset, blockLen, expectedDigestHex, digestHex, expectedDigestHex == digestHex)
-			if expectedDigestHex == digestHex {
+			glog.V(2).Infof("0x%06x %4d %s %s %t", imAddr+offset, blockLen, expectedDigest, digests[i], expectedDigest == digests[i])
+			if expectedDigest == digests[i] {
 				// Found a matching sector. If we've been building an image,  commit it.
 				if newLen > 0 {
 					nim := &image{
@@ -387,8 +557,6 @@ func dedupImages(fc *FlasherClient, images []*image) ([]*image, error) {
 				}
 				newLen += blockLen
 			}
-			offset += blockLen
-			i++
 		}
 		if newLen > 0 {
 			nim := &image{
@@ -409,7 +577,7 @@ func dedupImages(fc *FlasherClient, images []*image) ([]*image, error) {
 		// is substantial, don't bother.
 		if newTotalLen < len(im.Data) && (newTotalLen < flashBlockSize || len(im.Data)-newTotalLen >= flashBlockSize) {
 			dedupedImages = append(dedupedImages, newImages...)
-			common.Reportf("  %7d @ 0x%x -> %d", len(im.Data), im.Addr, newTotalLen)
+			cfr.Reportf("  %7d @ 0x%x -> %d", len(im.Data), im.Addr, newTotalLen)
 		} else {
 			dedupedImages = append(dedupedImages, im)
 		}
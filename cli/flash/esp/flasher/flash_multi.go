@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package flasher
+
+import (
+	"fmt"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/flash/common"
+	"github.com/mongoose-os/mos/cli/flash/esp"
+	"github.com/mongoose-os/mos/common/fwbundle"
+)
+
+// FlashMulti flashes the same firmware to devices on all the given ports
+// at the same time. Image data and compressed blocks are shared between devices.
+func FlashMulti(ct esp.ChipType, fw *fwbundle.FirmwareBundle, opts *esp.FlashOpts, ports []string) error {
+	if opts.KeepFS && opts.EraseChip {
+		return errors.Errorf("--keep-fs and --esp-erase-chip are incompatible")
+	}
+	if opts.DataPort != "" {
+		return errors.Errorf("--esp-data-port cannot be used when flashing multiple devices")
+	}
+
+	images, err := prepareImages(ct, fw, opts)
+	if err != nil {
+		return errors.Trace(err)
+	}
+
+	common.Reportf("Flashing %d devices...", len(ports))
+	start := time.Now()
+	fc := newFrameCache()
+	errs := make([]error, len(ports))
+	reports := make([]*flashReport, len(ports))
+	var wg sync.WaitGroup
+	for i, port := range ports {
+		wg.Add(1)
+		go func(i int, port string) {
+			defer wg.Done()
+			portOpts := *opts
+			portOpts.ControlPort = port
+			reports[i], errs[i] = flashPort(ct, images, &portOpts, fc, fmt.Sprintf("[%s] ", port))
+		}(i, port)
+	}
+	wg.Wait()
+	if opts.JSONStatsFile != "" {
+		writeJSONStats(opts.JSONStatsFile, reports)
+	}
+
+	numFailed := 0
+	common.Reportf("Flashed %d devices in %.2f seconds:", len(ports), time.Since(start).Seconds())
+	for i, port := range ports {
+		if errs[i] != nil {
+			common.Reportf("  %s: %s", port, errs[i])
+			numFailed++
+		} else {
+			common.Reportf("  %s: ok", port)
+		}
+	}
+	if numFailed > 0 {
+		return errors.Errorf("%d of %d devices failed to flash", numFailed, len(ports))
+	}
+	return nil
+}
+
+func flashPort(ct esp.ChipType, images []*image, opts *esp.FlashOpts, fc *frameCache, reportPrefix string) (*flashReport, error) {
+	cfr, err := ConnectToFlasherClient(ct, opts)
+	if err != nil {
+		return newFlashReport(opts.ControlPort, nil, err), errors.Trace(err)
+	}
+	// cfr.rc may be replaced if the baud rate is lowered.
+	defer func() { cfr.rc.Disconnect() }()
+	cfr.reportPrefix = reportPrefix
+	cfr.fc.frameCache = fc
+	err = flashImages(ct, cfr, images, opts)
+	return newFlashReport(opts.ControlPort, cfr, err), errors.Trace(err)
+}
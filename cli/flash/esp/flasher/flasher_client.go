@@ -18,13 +18,13 @@ package flasher
 
 import (
 	"bytes"
-	"compress/zlib"
 	"crypto/md5"
 	"encoding/binary"
 	"encoding/hex"
 	"fmt"
 	"math/rand"
 	"strings"
+	"sync"
 	"time"
 	"unsafe"
 
@@ -44,6 +44,10 @@ const (
 	// These consts should be in sync with stub_flasher.c
 	BUF_SIZE      = 4096
 	UART_BUF_SIZE = 4 * BUF_SIZE
+
+	// The stub needs BUF_SIZE of headroom in its UART buffer, more in flight may overflow it.
+	defaultWriteWindow = UART_BUF_SIZE - BUF_SIZE
+	maxWriteWindow     = UART_BUF_SIZE - BUF_SIZE
 )
 
 const (
@@ -51,6 +55,9 @@ const (
 	blockEraseTimeout = 5 * time.Second
 	// This is made small to workaround slow Mac driver
 	flashReadSize = 256
+	// Number of ReadReg commands sent before waiting for responses.
+	// Kept small so that requests fit in the UART RX FIFO.
+	readRegsBatchSize = 8
 )
 
 /* Decls from stub_flasher.h */
@@ -74,32 +81,67 @@ type FlasherClient struct {
 	srw       *common.SLIPReaderWriter
 	rom       *rom_client.ROMClient
 	connected bool
+	// Compressed frames shared with other clients, may be nil.
+	frameCache *frameCache
+	// Max amount of data in flight during write, 0 means default.
+	writeWindow int
+	// If set, write window is increased while the stub keeps up.
+	adaptiveWriteWindow bool
+	// Max amount of data the flasher sends during read without waiting for acknowledgement,
+	// 0 means flashReadSize (i.e. wait for each block).
+	readWindow     int
+	lastWriteStats *WriteStats
 }
 
 func NewFlasherClient(ct esp.ChipType, rc *rom_client.ROMClient, romBaudRate uint, baudRate uint) (*FlasherClient, error) {
 	if baudRate < 0 || baudRate > 4000000 {
 		return nil, errors.Errorf("invalid flashing baud rate (%d)", baudRate)
 	}
-	fc := &FlasherClient{ct: ct, s: rc.DataPort(), srw: common.NewSLIPReaderWriter(rc.DataPort()), rom: rc}
+	fc := &FlasherClient{ct: ct, s: rc.DataPort(), srw: rc.SLIP(), rom: rc}
 	if err := fc.connect(romBaudRate, baudRate); err != nil {
 		return nil, errors.Trace(err)
 	}
 	return fc, nil
 }
 
-func (fc *FlasherClient) connect(romBaudRate, baudRate uint) error {
+// Decoded flasher stubs, by chip type. Stubs are decoded on first use
+// and reused for subsequent connections (e.g. when flashing multiple devices).
+var (
+	stubsLock sync.Mutex
+	stubs     = make(map[esp.ChipType]*rom_client.Stub)
+)
+
+func getStub(ct esp.ChipType) (*rom_client.Stub, error) {
+	stubsLock.Lock()
+	defer stubsLock.Unlock()
+	if stub := stubs[ct]; stub != nil {
+		return stub, nil
+	}
 	var stubJSON []byte
-	switch fc.ct {
+	switch ct {
 	case esp.ChipESP8266:
 		stubJSON = esp8266.MustAsset("data/stub_flasher.json")
 	case esp.ChipESP32:
 		stubJSON = esp32.MustAsset("data/stub_flasher.json")
 	default:
-		return errors.Errorf("unknown chip type %d", fc.ct)
+		return nil, errors.Errorf("unknown chip type %d", ct)
+	}
+	stub, err := rom_client.ParseStub(stubJSON)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	stubs[ct] = stub
+	return stub, nil
+}
+
+func (fc *FlasherClient) connect(romBaudRate, baudRate uint) error {
+	stub, err := getStub(fc.ct)
+	if err != nil {
+		return errors.Trace(err)
 	}
 
 	common.Reportf("Running flasher @ %d...", baudRate)
-	err := fc.rom.RunStub(stubJSON, []uint32{uint32(romBaudRate), uint32(baudRate)})
+	err = fc.rom.RunStub(stub, []uint32{uint32(romBaudRate), uint32(baudRate)})
 	if err != nil {
 		return errors.Annotatef(err, "failed to run flasher stub")
 	}
@@ -152,8 +194,8 @@ func (fc *FlasherClient) sendCommand(cmd flasherCmd, args []uint32) error {
 
 func (fc *FlasherClient) recvResponse() ([][]byte, error) {
 	var result [][]byte
+	buf := make([]byte, 10000)
 	for {
-		buf := make([]byte, 10000)
 		n, err := fc.srw.Read(buf)
 		if err != nil {
 			return result, errors.Annotatef(err, "error reading response packet")
@@ -223,6 +265,28 @@ type writeProgress struct {
 	digest     [md5.Size]byte
 }
 
+// WriteStats describes performance of a single write operation.
+// Times are as reported by the flasher stub.
+type WriteStats struct {
+	Name        string  `json:"name,omitempty"`
+	Addr        uint32  `json:"addr"`
+	Len         int     `json:"len"`
+	BytesOnWire int     `json:"bytes_on_wire"`
+	CompFactor  float64 `json:"comp_factor"`
+	Seconds     float64 `json:"seconds"`
+	WaitTime    uint32  `json:"wait_time"`
+	DecompTime  uint32  `json:"decomp_time"`
+	WriteTime   uint32  `json:"write_time"`
+	EraseTime   uint32  `json:"erase_time"`
+	MiscTime    uint32  `json:"misc_time"`
+	TotalTime   uint32  `json:"total_time"`
+	// Stub buffer level, as reported in progress packets.
+	AvgBufLevel uint32 `json:"avg_buf_level"`
+	MaxBufLevel uint32 `json:"max_buf_level"`
+	// Write window at the end of the operation.
+	Window int `json:"window"`
+}
+
 type writeResult struct {
 	waitTime   uint32
 	decompTime uint32
@@ -241,6 +305,8 @@ sync:
 		if err := fc.sendCommand(cmdEcho, []uint32{cookie}); err != nil {
 			return errors.Trace(err)
 		}
+		// Echo response is looked for in raw data, drop whatever the SLIP reader has buffered.
+		fc.srw.Reset()
 		buf := make([]byte, 1024)
 		n := 0
 		for {
@@ -266,6 +332,7 @@ sync:
 
 func (fc *FlasherClient) Write(addr uint32, data []byte, erase bool, compress bool) (int, error) {
 	var numSent, numWritten, numBytesOnTheWire int
+	fc.lastWriteStats = nil
 	if !fc.connected {
 		return numWritten, errors.New("not connected")
 	}
@@ -278,6 +345,18 @@ func (fc *FlasherClient) Write(addr uint32, data []byte, erase bool, compress bo
 	if err != nil {
 		return numWritten, errors.Trace(err)
 	}
+	wf := newWriteFramer(data, compress, fc.frameCache)
+	defer wf.Close()
+	window := fc.writeWindow
+	if window <= 0 {
+		window = defaultWriteWindow
+	}
+	if window > maxWriteWindow {
+		window = maxWriteWindow
+	}
+	start := time.Now()
+	stats := &WriteStats{Addr: addr, Len: len(data)}
+	numProgress, sumBufLevel := 0, 0
 	digest := md5.New()
 	for numWritten < len(data) {
 		var progress writeProgress
@@ -307,35 +386,27 @@ func (fc *FlasherClient) Write(addr uint32, data []byte, erase bool, compress bo
 			return numWritten, errors.Errorf("digest mismatch @ %d: expected %s, got %s", numWritten, expectedDigestHex, digestHex)
 		}
 		numWritten = newNumWritten
+		numProgress++
+		sumBufLevel += int(progress.bufLevel)
+		if progress.bufLevel > stats.MaxBufLevel {
+			stats.MaxBufLevel = progress.bufLevel
+		}
+		if fc.adaptiveWriteWindow && numSent > 0 && numSent < len(data) && progress.bufLevel == 0 && window < maxWriteWindow {
+			// Stub has drained its buffer and is waiting for data, allow more in flight.
+			window += BUF_SIZE
+			if window > maxWriteWindow {
+				window = maxWriteWindow
+			}
+			glog.V(2).Infof("Write window -> %d", window)
+		}
 		inFlight := numSent - numWritten
-		canSend := int(UART_BUF_SIZE - BUF_SIZE - inFlight)
+		canSend := window - inFlight
 		glog.V(3).Infof("<= %d %d; %d/%d/%d; %s", numWritten, progress.bufLevel, numSent, inFlight, canSend, digestHex)
-		for numSent < len(data) && canSend > 0 {
-			numToSend := len(data) - numSent
-			if numToSend > canSend {
-				numToSend = canSend
-			}
-			if numToSend > BUF_SIZE {
-				numToSend = BUF_SIZE
-			}
-			toSend := data[numSent : numSent+numToSend]
-			var compressed bytes.Buffer
-			if compress {
-				// Try compressing, see if it gets smaller
-				w, _ := zlib.NewWriterLevel(&compressed, zlib.BestCompression)
-				w.Write(toSend)
-				w.Close()
-				glog.V(4).Infof("%d -> %d", len(toSend), compressed.Len())
-			}
-			if compress && compressed.Len() < len(toSend) {
-				toSend2 := make([]byte, 0, compressed.Len()+1)
-				toSend2 = append(toSend2, 0x01)
-				toSend = append(toSend2, compressed.Bytes()...)
-			} else {
-				toSend2 := make([]byte, 0, len(toSend)+1)
-				toSend2 = append(toSend2, 0x00)
-				toSend = append(toSend2, toSend...)
-			}
+		// Frames are prepared ahead of time, so only whole blocks are sent.
+		for wf.HasNext() && canSend >= wf.NextLen() {
+			frame := wf.Next()
+			numToSend := frame.dataLen
+			toSend := frame.data
 			ns, err := fc.srw.Write(toSend)
 			if err != nil {
 				return numWritten, errors.Annotatef(err, "flash write failed @ %d/%d", numWritten, numSent)
@@ -368,6 +439,20 @@ func (fc *FlasherClient) Write(addr uint32, data []byte, erase bool, compress bo
 		return numWritten, errors.Errorf("final digest mismatch: expected %s, got %s", expectedDigestHex, digestHex)
 	}
 	miscTime := result.totalTime - result.waitTime - result.decompTime - result.eraseTime - result.writeTime
+	stats.BytesOnWire = numBytesOnTheWire
+	stats.CompFactor = float64(numBytesOnTheWire) / float64(numWritten)
+	stats.Seconds = time.Since(start).Seconds()
+	stats.WaitTime = result.waitTime
+	stats.DecompTime = result.decompTime
+	stats.WriteTime = result.writeTime
+	stats.EraseTime = result.eraseTime
+	stats.MiscTime = miscTime
+	stats.TotalTime = result.totalTime
+	if numProgress > 0 {
+		stats.AvgBufLevel = uint32(sumBufLevel / numProgress)
+	}
+	stats.Window = window
+	fc.lastWriteStats = stats
 	glog.Infof("Write stats: waitTime:%.2f decompTime:%.2f writeTime:%.2f eraseTime:%.2f miscTime:%.2f totalTime:%d compFactor:%.2f",
 		float64(result.waitTime)/float64(result.totalTime),
 		float64(result.decompTime)/float64(result.totalTime),
@@ -380,15 +465,25 @@ func (fc *FlasherClient) Write(addr uint32, data []byte, erase bool, compress bo
 	return numWritten, nil
 }
 
+// LastWriteStats returns stats of the last successful write.
+func (fc *FlasherClient) LastWriteStats() *WriteStats {
+	return fc.lastWriteStats
+}
+
 func (fc *FlasherClient) Read(addr uint32, data []byte) error {
 	if !fc.connected {
 		return errors.New("not connected")
 	}
+	readWindow := fc.readWindow
+	if readWindow < flashReadSize {
+		readWindow = flashReadSize
+	}
 	err := fc.sendCommand(cmdFlashRead, []uint32{
-		addr, uint32(len(data)), flashReadSize, flashReadSize})
+		addr, uint32(len(data)), flashReadSize, uint32(readWindow)})
 	if err != nil {
 		return errors.Trace(err)
 	}
+	var ack [4]byte
 	numRead := 0
 	for numRead < len(data) {
 		buf := data[numRead:]
@@ -403,9 +498,8 @@ func (fc *FlasherClient) Read(addr uint32, data []byte) error {
 			return errors.Errorf("unexpected result packet length %d", n)
 		}
 		numRead += len(buf)
-		nrb := bytes.NewBuffer(nil)
-		binary.Write(nrb, binary.LittleEndian, uint32(numRead))
-		fc.srw.Write(nrb.Bytes())
+		binary.LittleEndian.PutUint32(ack[:], uint32(numRead))
+		fc.srw.Write(ack[:])
 		glog.V(3).Infof("<= %d; %d/%d", len(buf), numRead, len(data))
 	}
 	tail, err := fc.recvResponse()
@@ -440,6 +534,40 @@ func (fc *FlasherClient) ReadReg(addr uint32) (uint32, error) {
 	return res, nil
 }
 
+// ReadRegs reads multiple registers. Commands are sent in batches without waiting
+// for each response, so a batch costs a single round trip.
+func (fc *FlasherClient) ReadRegs(addrs []uint32) ([]uint32, error) {
+	if !fc.connected {
+		return nil, errors.New("not connected")
+	}
+	if err := fc.s.SetReadTimeout(1 * time.Second); err != nil {
+		return nil, errors.Annotatef(err, "failed to set read timeout")
+	}
+	res := make([]uint32, 0, len(addrs))
+	for len(res) < len(addrs) {
+		batch := addrs[len(res):]
+		if len(batch) > readRegsBatchSize {
+			batch = batch[:readRegsBatchSize]
+		}
+		for _, addr := range batch {
+			if err := fc.sendCommand(cmdReadReg, []uint32{addr}); err != nil {
+				return nil, errors.Annotatef(err, "error sending command %d", cmdReadReg)
+			}
+		}
+		for _, addr := range batch {
+			result, err := fc.recvResponse()
+			if err != nil {
+				return nil, errors.Annotatef(err, "failed to read 0x%08x", addr)
+			}
+			if len(result) != 1 || len(result[0]) != 4 {
+				return nil, errors.Errorf("invalid response to ReadReg: %v", result)
+			}
+			res = append(res, binary.LittleEndian.Uint32(result[0]))
+		}
+	}
+	return res, nil
+}
+
 func (fc *FlasherClient) WriteReg(addr uint32, value uint32) error {
 	if !fc.connected {
 		return errors.New("not connected")
@@ -17,6 +17,10 @@
 package flasher
 
 import (
+	"bytes"
+	"crypto/md5"
+	"io"
+	"os"
 	"time"
 
 	"github.com/juju/errors"
@@ -24,35 +28,149 @@ import (
 	"github.com/mongoose-os/mos/cli/flash/esp"
 )
 
-func ReadFlash(ct esp.ChipType, addr uint32, length int, opts *esp.FlashOpts) ([]byte, error) {
-	if addr < 0 {
-		return nil, errors.Errorf("invalid addr: %d", addr)
-	}
-	if length < 0 {
-		return nil, errors.Errorf("invalid addr: %d", length)
-	}
+const (
+	// Flash is read in chunks of this size, each verified by its own digest.
+	// If reading a chunk fails, the flasher is re-synced and the chunk is read again.
+	readChunkSize = 65536
+	readRetries   = 3
+)
 
+// ReadRange is a region of flash to be saved to a file.
+type ReadRange struct {
+	Addr uint32
+	// 0 together with Addr 0 means the entire flash.
+	Length int
+	// "-" means stdout.
+	File string
+}
+
+// ReadFlash reads flash regions in one session, writing data to files as it arrives.
+// If resume is set, chunks already present in the output files are checked against
+// flash digests and only the rest is read.
+func ReadFlash(ct esp.ChipType, ranges []ReadRange, resume bool, opts *esp.FlashOpts) error {
 	cfr, err := ConnectToFlasherClient(ct, opts)
 	if err != nil {
-		return nil, errors.Trace(err)
+		return errors.Trace(err)
 	}
 	defer cfr.rc.Disconnect()
 
 	flashSize := cfr.flashParams.Size()
-	if addr == 0 && length == 0 {
-		length = flashSize
-	} else if int(addr)+length > flashSize {
-		return nil, errors.Errorf("0x%x + %d exceeds flash size (%d)", addr, length, flashSize)
+	for i := range ranges {
+		r := &ranges[i]
+		if r.Length < 0 {
+			return errors.Errorf("invalid length: %d", r.Length)
+		}
+		if r.Addr == 0 && r.Length == 0 {
+			r.Length = flashSize
+		} else if int(r.Addr)+r.Length > flashSize {
+			return errors.Errorf("0x%x + %d exceeds flash size (%d)", r.Addr, r.Length, flashSize)
+		}
+	}
+	for _, r := range ranges {
+		if err := readRange(cfr.fc, r, resume); err != nil {
+			return errors.Annotatef(err, "failed to read %d @ 0x%x", r.Length, r.Addr)
+		}
 	}
+	return nil
+}
 
-	common.Reportf("Reading %d @ 0x%x...", length, addr)
-	data := make([]byte, length)
+func readRange(fc *FlasherClient, r ReadRange, resume bool) error {
+	var out io.Writer = os.Stdout
+	done := 0
+	if r.File != "-" {
+		f, err := os.OpenFile(r.File, os.O_RDWR|os.O_CREATE, 0644)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		defer f.Close()
+		if resume {
+			if done, err = getVerifiedLength(fc, r, f); err != nil {
+				return errors.Trace(err)
+			}
+			if done > 0 {
+				common.Reportf("%s: %d bytes already read", r.File, done)
+			}
+		}
+		if err := f.Truncate(int64(done)); err != nil {
+			return errors.Trace(err)
+		}
+		if _, err := f.Seek(int64(done), io.SeekStart); err != nil {
+			return errors.Trace(err)
+		}
+		out = f
+	}
+	common.Reportf("Reading %d @ 0x%x...", r.Length-done, r.Addr+uint32(done))
+	buf := make([]byte, readChunkSize)
 	start := time.Now()
-	if err := cfr.fc.Read(uint32(addr), data); err != nil {
-		return nil, errors.Annotatef(err, "failed to read %d @ 0x%x", length, addr)
+	for offset := done; offset < r.Length; {
+		chunk := buf
+		if offset+len(chunk) > r.Length {
+			chunk = chunk[:r.Length-offset]
+		}
+		if err := readChunk(fc, r.Addr+uint32(offset), chunk); err != nil {
+			return errors.Trace(err)
+		}
+		if _, err := out.Write(chunk); err != nil {
+			return errors.Annotatef(err, "failed to write %s", r.File)
+		}
+		offset += len(chunk)
 	}
 	seconds := time.Since(start).Seconds()
-	bytesPerSecond := float64(len(data)) / seconds
-	common.Reportf("Read %d bytes in %.2f seconds (%.2f KBit/sec)", length, seconds, bytesPerSecond*8/1024)
-	return data, nil
+	bytesPerSecond := float64(r.Length-done) / seconds
+	common.Reportf("Read %d bytes in %.2f seconds (%.2f KBit/sec)", r.Length-done, seconds, bytesPerSecond*8/1024)
+	if r.File != "-" {
+		common.Reportf("Wrote %s", r.File)
+	}
+	return nil
+}
+
+func readChunk(fc *FlasherClient, addr uint32, data []byte) error {
+	var err error
+	for i := 0; i <= readRetries; i++ {
+		if i > 0 {
+			common.Reportf("Read %d @ 0x%x failed (%s), retrying...", len(data), addr, err)
+			if err := fc.Sync(); err != nil {
+				return errors.Annotatef(err, "failed to re-sync with the flasher")
+			}
+		}
+		if err = fc.Read(addr, data); err == nil {
+			return nil
+		}
+	}
+	return errors.Annotatef(err, "failed to read %d @ 0x%x", len(data), addr)
+}
+
+// getVerifiedLength returns the length of the beginning of the file that matches flash contents,
+// in whole chunks.
+func getVerifiedLength(fc *FlasherClient, r ReadRange, f *os.File) (int, error) {
+	fi, err := f.Stat()
+	if err != nil {
+		return 0, errors.Trace(err)
+	}
+	n := int(fi.Size())
+	if n > r.Length {
+		n = r.Length
+	}
+	numChunks := n / readChunkSize
+	if numChunks == 0 {
+		return 0, nil
+	}
+	digests, err := fc.Digest(r.Addr, uint32(numChunks*readChunkSize), readChunkSize)
+	if err != nil {
+		return 0, errors.Annotatef(err, "failed to compute digests")
+	}
+	// There's also a digest of the entire region at the end.
+	if len(digests) < numChunks {
+		return 0, errors.Errorf("expected %d digests, got %d", numChunks, len(digests))
+	}
+	buf := make([]byte, readChunkSize)
+	for i := 0; i < numChunks; i++ {
+		if _, err := f.ReadAt(buf, int64(i*readChunkSize)); err != nil {
+			return 0, errors.Annotatef(err, "failed to read %s", r.File)
+		}
+		if d := md5.Sum(buf); !bytes.Equal(d[:], digests[i]) {
+			return i * readChunkSize, nil
+		}
+	}
+	return numChunks * readChunkSize, nil
 }
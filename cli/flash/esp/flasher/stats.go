@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package flasher
+
+import (
+	"encoding/json"
+	"io/ioutil"
+
+	glog "k8s.io/klog/v2"
+)
+
+// flashReport is the JSON report of a flashing session, see --json-stats.
+type flashReport struct {
+	Port     string        `json:"port"`
+	BaudRate uint          `json:"baud_rate"`
+	Images   []*WriteStats `json:"images"`
+	Error    string        `json:"error,omitempty"`
+}
+
+func newFlashReport(port string, cfr *cfResult, err error) *flashReport {
+	r := &flashReport{Port: port, Images: []*WriteStats{}}
+	if cfr != nil {
+		r.BaudRate = cfr.baudRate
+		r.Images = append(r.Images, cfr.writeStats...)
+	}
+	if err != nil {
+		r.Error = err.Error()
+	}
+	return r
+}
+
+func writeJSONStats(fname string, v interface{}) {
+	data, err := json.MarshalIndent(v, "", "  ")
+	if err == nil {
+		err = ioutil.WriteFile(fname, data, 0644)
+	}
+	if err != nil {
+		glog.Errorf("failed to write stats to %s: %s", fname, err)
+	}
+}
@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package flasher
+
+import (
+	"bytes"
+	"compress/zlib"
+	"crypto/md5"
+	"runtime"
+	"sync"
+
+	glog "k8s.io/klog/v2"
+)
+
+const (
+	// How many frames can be prepared ahead of the sender, per worker.
+	framesAheadPerWorker = 2
+	maxFramerWorkers     = 8
+)
+
+// writeFrame is a ready to send data packet for the flash write command:
+// a 0x01 (zlib-compressed) or 0x00 (raw) prefix followed by the payload.
+type writeFrame struct {
+	data []byte
+	// Number of bytes of the image this frame carries.
+	dataLen int
+}
+
+// frameCache holds compressed frames keyed by the digest of their data.
+// It allows sharing compression work between devices flashed with the same images.
+type frameCache struct {
+	mu     sync.Mutex
+	frames map[[md5.Size]byte]*writeFrame
+}
+
+func newFrameCache() *frameCache {
+	return &frameCache{frames: make(map[[md5.Size]byte]*writeFrame)}
+}
+
+func (fc *frameCache) get(key [md5.Size]byte) *writeFrame {
+	fc.mu.Lock()
+	defer fc.mu.Unlock()
+	return fc.frames[key]
+}
+
+func (fc *frameCache) put(key [md5.Size]byte, f *writeFrame) {
+	fc.mu.Lock()
+	defer fc.mu.Unlock()
+	fc.frames[key] = f
+}
+
+// writeFramer splits data into BUF_SIZE blocks and prepares write frames
+// on worker goroutines a few blocks ahead of the sender,
+// so compression does not stall the UART.
+type writeFramer struct {
+	data     []byte
+	compress bool
+	cache    *frameCache
+	frames   []chan *writeFrame
+	slots    chan struct{}
+	quit     chan struct{}
+	next     int
+}
+
+func numWriteBlocks(dataLen int) int {
+	return (dataLen + BUF_SIZE - 1) / BUF_SIZE
+}
+
+func newWriteFramer(data []byte, compress bool, cache *frameCache) *writeFramer {
+	wf := &writeFramer{
+		data:     data,
+		compress: compress,
+		cache:    cache,
+		frames:   make([]chan *writeFrame, numWriteBlocks(len(data))),
+		quit:     make(chan struct{}),
+	}
+	if !compress || len(wf.frames) == 0 {
+		// Framing raw data is cheap, no need for workers.
+		return wf
+	}
+	for i := range wf.frames {
+		wf.frames[i] = make(chan *writeFrame, 1)
+	}
+	numWorkers := runtime.NumCPU()
+	if numWorkers > maxFramerWorkers {
+		numWorkers = maxFramerWorkers
+	}
+	wf.slots = make(chan struct{}, numWorkers*framesAheadPerWorker)
+	jobs := make(chan int)
+	go func() {
+		defer close(jobs)
+		for i := range wf.frames {
+			select {
+			case wf.slots <- struct{}{}:
+			case <-wf.quit:
+				return
+			}
+			select {
+			case jobs <- i:
+			case <-wf.quit:
+				return
+			}
+		}
+	}()
+	for i := 0; i < numWorkers; i++ {
+		go func() {
+			for i := range jobs {
+				wf.frames[i] <- wf.makeFrame(i)
+			}
+		}()
+	}
+	return wf
+}
+
+func (wf *writeFramer) makeFrame(i int) *writeFrame {
+	block := wf.data[i*BUF_SIZE:]
+	if len(block) > BUF_SIZE {
+		block = block[:BUF_SIZE]
+	}
+	if wf.compress {
+		var key [md5.Size]byte
+		if wf.cache != nil {
+			key = md5.Sum(block)
+			if f := wf.cache.get(key); f != nil {
+				return f
+			}
+		}
+		f := compressFrame(block)
+		if wf.cache != nil {
+			wf.cache.put(key, f)
+		}
+		return f
+	}
+	return rawFrame(block)
+}
+
+func compressFrame(block []byte) *writeFrame {
+	// Try compressing, see if it gets smaller
+	compressed := bytes.NewBuffer(make([]byte, 0, len(block)+1))
+	compressed.WriteByte(0x01)
+	w, _ := zlib.NewWriterLevel(compressed, zlib.BestCompression)
+	w.Write(block)
+	w.Close()
+	glog.V(4).Infof("%d -> %d", len(block), compressed.Len()-1)
+	if compressed.Len()-1 < len(block) {
+		return &writeFrame{data: compressed.Bytes(), dataLen: len(block)}
+	}
+	return rawFrame(block)
+}
+
+func rawFrame(block []byte) *writeFrame {
+	frame := make([]byte, 0, len(block)+1)
+	frame = append(frame, 0x00)
+	frame = append(frame, block...)
+	return &writeFrame{data: frame, dataLen: len(block)}
+}
+
+// HasNext returns true if there are more frames to send.
+func (wf *writeFramer) HasNext() bool {
+	return wf.next < len(wf.frames)
+}
+
+// NextLen returns the number of data bytes carried by the next frame.
+func (wf *writeFramer) NextLen() int {
+	n := len(wf.data) - wf.next*BUF_SIZE
+	if n > BUF_SIZE {
+		n = BUF_SIZE
+	}
+	return n
+}
+
+// Next returns the next frame, waiting for it to be prepared if necessary.
+func (wf *writeFramer) Next() *writeFrame {
+	i := wf.next
+	wf.next++
+	if wf.frames[i] == nil {
+		return wf.makeFrame(i)
+	}
+	f := <-wf.frames[i]
+	<-wf.slots
+	return f
+}
+
+// Close stops the workers. Frames that were not consumed are discarded.
+func (wf *writeFramer) Close() {
+	close(wf.quit)
+}
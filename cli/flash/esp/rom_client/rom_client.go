@@ -88,7 +88,7 @@ func ConnectToROM(ct esp.ChipType, opts *esp.FlashOpts) (*ROMClient, error) {
 	scOpts := commonOpts
 	scOpts.PortName = opts.ControlPort
 	common.Reportf("Opening %s @ %d...", scOpts.PortName, opts.ROMBaudRate)
-	sc, err := serial.Open(scOpts)
+	sc, err := common.OpenSerial(scOpts)
 	if err != nil {
 		return nil, errors.Annotate(err, "failed to open control port")
 	}
@@ -97,7 +97,7 @@ func ConnectToROM(ct esp.ChipType, opts *esp.FlashOpts) (*ROMClient, error) {
 		sdOpts := commonOpts
 		sdOpts.PortName = opts.DataPort
 		common.Reportf("Opening %s...", sdOpts.PortName)
-		sd, err = serial.Open(sdOpts)
+		sd, err = common.OpenSerial(sdOpts)
 		if err != nil {
 			sc.Close()
 			return nil, errors.Annotate(err, "failed to open data port")
@@ -130,6 +130,13 @@ func (rc *ROMClient) DataPort() serial.Serial {
 	return rc.sd
 }
 
+// SLIP returns the SLIP reader/writer of the data port. It buffers received data,
+// so clients that take over the port after the ROM (e.g. the flasher stub) must use it
+// instead of the port itself for frames that may already have been received.
+func (rc *ROMClient) SLIP() *common.SLIPReaderWriter {
+	return rc.srw
+}
+
 func (rc *ROMClient) connect() error {
 	rc.connected = false
 	rc.sd.SetReadTimeout(200 * time.Millisecond)
@@ -174,6 +181,9 @@ func (rc *ROMClient) connect() error {
 
 func (rc *ROMClient) Disconnect() {
 	rc.connected = false
+	if rc.sc == nil {
+		return
+	}
 	rc.sc.Close()
 	if rc.sd != rc.sc {
 		rc.sd.Close()
@@ -275,6 +285,7 @@ func (rc *ROMClient) trySync() error {
 		argBuf.Write([]byte{0x55})
 	}
 	rc.sd.Flush()
+	rc.srw.Reset()
 	if err := rc.sendCommand(cmdSync, argBuf.Bytes(), 0); err != nil {
 		return errors.Trace(err)
 	}
@@ -378,25 +389,50 @@ type stubInfo struct {
 	DataHex     string `json:"data"`
 }
 
-// RunStub unwraps and runs a stub created by
+// Stub is a decoded stub created by
 // https://github.com/cesanta/mongoose-os/tree/master/common/platforms/esp8266/stubs
-func (rc *ROMClient) RunStub(stubJSON []byte, params []uint32) error {
-	if !rc.connected {
-		return errors.New("not connected")
-	}
+type Stub struct {
+	NumParams   int
+	ParamsStart uint32
+	CodeStart   uint32
+	Code        []byte
+	Entry       uint32
+	DataStart   uint32
+	Data        []byte
+}
+
+// ParseStub unwraps the JSON stub. The result can be reused to run the stub many times.
+func ParseStub(stubJSON []byte) (*Stub, error) {
 	var si stubInfo
 	err := json.Unmarshal(stubJSON, &si)
 	if err != nil {
-		return errors.Annotatef(err, "failed to unwrap stub")
+		return nil, errors.Annotatef(err, "failed to unwrap stub")
 	}
 	code, err := hex.DecodeString(si.CodeHex)
 	if err != nil {
-		return errors.Annotatef(err, "failed to decode code section")
+		return nil, errors.Annotatef(err, "failed to decode code section")
 	}
 	data, err := hex.DecodeString(si.DataHex)
 	if err != nil {
-		return errors.Annotatef(err, "failed to decode data section")
+		return nil, errors.Annotatef(err, "failed to decode data section")
+	}
+	return &Stub{
+		NumParams:   si.NumParams,
+		ParamsStart: si.ParamsStart,
+		CodeStart:   si.CodeStart,
+		Code:        code,
+		Entry:       si.Entry,
+		DataStart:   si.DataStart,
+		Data:        data,
+	}, nil
+}
+
+// RunStub uploads and runs the stub.
+func (rc *ROMClient) RunStub(si *Stub, params []uint32) error {
+	if !rc.connected {
+		return errors.New("not connected")
 	}
+	code, data := si.Code, si.Data
 	if false && len(params) != si.NumParams {
 		return errors.Errorf("expected %d params, got %d", si.NumParams, len(params))
 	}
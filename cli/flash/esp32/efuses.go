@@ -24,6 +24,7 @@ import (
 	"fmt"
 	"math/big"
 	"math/bits"
+	"sync"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/flash/esp"
@@ -476,14 +477,18 @@ func (f *Fuse) KeyString(kcs KeyEncodingScheme) string {
 	return hex.EncodeToString(kb)
 }
 
-func readFuseBlock(rrw esp.RegReaderWriter, num int) (*FuseBlock, error) {
-	b := &FuseBlock{
+func newFuseBlock(rrw esp.RegReaderWriter, num int, data []uint32) *FuseBlock {
+	return &FuseBlock{
 		rrw: rrw, num: num,
 		rBase: blockReadBases[num],
 		wBase: blockWriteBases[num],
-		data:  make([]uint32, blockLengths[num]),
+		data:  data,
 		diff:  make([]uint32, blockLengths[num]),
 	}
+}
+
+func readFuseBlock(rrw esp.RegReaderWriter, num int) (*FuseBlock, error) {
+	b := newFuseBlock(rrw, num, make([]uint32, blockLengths[num]))
 	if err := b.Read(); err != nil {
 		return nil, errors.Trace(err)
 	}
@@ -491,6 +496,79 @@ func readFuseBlock(rrw esp.RegReaderWriter, num int) (*FuseBlock, error) {
 	return b, nil
 }
 
+// readFuseBlocksBulk reads all the blocks with a single bulk request.
+func readFuseBlocksBulk(rrw esp.RegReaderWriter, br esp.RegBulkReader) ([]*FuseBlock, error) {
+	var regs []uint32
+	for i, n := range blockLengths {
+		for j := 0; j < n; j++ {
+			regs = append(regs, blockReadBases[i]+uint32(4*j))
+		}
+	}
+	glog.Infof("Reading eFuse blocks...")
+	vv, err := br.ReadRegs(regs)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	var blocks []*FuseBlock
+	for i, n := range blockLengths {
+		b := newFuseBlock(rrw, i, vv[:n:n])
+		glog.V(2).Infof("%s", b)
+		blocks = append(blocks, b)
+		vv = vv[n:]
+	}
+	return blocks, nil
+}
+
+// Fuse block contents of devices seen during this session, keyed by MAC address.
+// Flashing reads fuses more than once (via ROM and then via the stub), the cache saves re-reading them.
+var fuseCache = struct {
+	sync.Mutex
+	data map[uint64][][]uint32
+}{data: make(map[uint64][][]uint32)}
+
+func macKey(mac0, mac1 uint32) uint64 {
+	return uint64(mac1)<<32 | uint64(mac0)
+}
+
+func getCachedFuseBlocks(rrw esp.RegReaderWriter) []*FuseBlock {
+	var mac [2]uint32
+	for i := range mac {
+		v, err := rrw.ReadReg(blockReadBases[0] + uint32(4*(i+1)))
+		if err != nil {
+			return nil
+		}
+		mac[i] = v
+	}
+	fuseCache.Lock()
+	defer fuseCache.Unlock()
+	data := fuseCache.data[macKey(mac[0], mac[1])]
+	if data == nil {
+		return nil
+	}
+	var blocks []*FuseBlock
+	for i, bd := range data {
+		blocks = append(blocks, newFuseBlock(rrw, i, append([]uint32(nil), bd...)))
+	}
+	glog.V(1).Infof("Using cached eFuse blocks")
+	return blocks
+}
+
+func addCachedFuseBlocks(blocks []*FuseBlock) {
+	var data [][]uint32
+	for _, b := range blocks {
+		data = append(data, append([]uint32(nil), b.data...))
+	}
+	fuseCache.Lock()
+	fuseCache.data[macKey(data[0][1], data[0][2])] = data
+	fuseCache.Unlock()
+}
+
+func invalidateFuseCache() {
+	fuseCache.Lock()
+	fuseCache.data = make(map[uint64][][]uint32)
+	fuseCache.Unlock()
+}
+
 func eFuseCtlWaitIdle(rrw esp.RegReaderWriter) error {
 	for i := 0; i < 10; i++ {
 		v, err := rrw.ReadReg(eFuseCtlRegCmd)
@@ -530,18 +608,29 @@ func eFuseCtlDoOp(rrw esp.RegReaderWriter, ctlOp eFuseCtlOp) error {
 }
 
 func ReadFuses(rrw esp.RegReaderWriter) ([]*FuseBlock, []*Fuse, map[string]*Fuse, error) {
-	var blocks []*FuseBlock
+	blocks := getCachedFuseBlocks(rrw)
 
-	if err := eFuseCtlDoOp(rrw, eFuseCtlOpRead); err != nil {
-		return nil, nil, nil, errors.Annotatef(err, "failed to perform eFuse read operation")
-	}
+	if blocks == nil {
+		if err := eFuseCtlDoOp(rrw, eFuseCtlOpRead); err != nil {
+			return nil, nil, nil, errors.Annotatef(err, "failed to perform eFuse read operation")
+		}
 
-	for i := 0; i < 4; i++ {
-		b, err := readFuseBlock(rrw, i)
-		if err != nil {
-			return nil, nil, nil, errors.Annotatef(err, "failed to read eFuse block %d", i)
+		if br, ok := rrw.(esp.RegBulkReader); ok {
+			var err error
+			blocks, err = readFuseBlocksBulk(rrw, br)
+			if err != nil {
+				return nil, nil, nil, errors.Annotatef(err, "failed to read eFuse blocks")
+			}
+		} else {
+			for i := 0; i < 4; i++ {
+				b, err := readFuseBlock(rrw, i)
+				if err != nil {
+					return nil, nil, nil, errors.Annotatef(err, "failed to read eFuse block %d", i)
+				}
+				blocks = append(blocks, b)
+			}
 		}
-		blocks = append(blocks, b)
+		addCachedFuseBlocks(blocks)
 	}
 
 	fuses := []*Fuse{}
@@ -556,6 +645,7 @@ func ReadFuses(rrw esp.RegReaderWriter) ([]*FuseBlock, []*Fuse, map[string]*Fuse
 }
 
 func ProgramFuses(rrw esp.RegReaderWriter) error {
+	invalidateFuseCache()
 	if err := eFuseCtlDoOp(rrw, eFuseCtlOpWrite); err != nil {
 		return errors.Annotatef(err, "failed to perform eFuse write operation")
 	}
@@ -120,3 +120,72 @@ func TestKeyEncoding(t *testing.T) {
 		}
 	}
 }
+
+type fakeEFuseCtl struct {
+	regs     map[uint32]uint32
+	numReads int
+	bulk     bool
+}
+
+func (c *fakeEFuseCtl) ReadReg(reg uint32) (uint32, error) {
+	c.numReads++
+	return c.regs[reg], nil
+}
+
+func (c *fakeEFuseCtl) WriteReg(reg, value uint32) error {
+	if reg != eFuseCtlRegCmd {
+		c.regs[reg] = value
+	}
+	return nil
+}
+
+func (c *fakeEFuseCtl) Disconnect() {}
+
+type fakeEFuseCtlBulk struct {
+	fakeEFuseCtl
+}
+
+func (c *fakeEFuseCtlBulk) ReadRegs(regs []uint32) ([]uint32, error) {
+	c.numReads++
+	var res []uint32
+	for _, reg := range regs {
+		res = append(res, c.regs[reg])
+	}
+	return res, nil
+}
+
+func TestReadFusesCache(t *testing.T) {
+	regs := map[uint32]uint32{blockReadBases[0] + 4: 0x11223344, blockReadBases[0] + 8: 0x5566, blockReadBases[3]: 0x12345678}
+	c := &fakeEFuseCtl{regs: regs}
+	blocks, _, _, err := ReadFuses(c)
+	if err != nil {
+		t.Fatalf("ReadFuses: %s", err)
+	}
+	if blocks[3].data[0] != 0x12345678 {
+		t.Errorf("wrong data: %s", blocks[3])
+	}
+	blocks[3].diff[0] = 1
+	n := c.numReads
+	blocks, _, _, err = ReadFuses(c)
+	if err != nil {
+		t.Fatalf("ReadFuses: %s", err)
+	}
+	if c.numReads-n != 2 {
+		t.Errorf("expected cache hit with 2 reads, got %d", c.numReads-n)
+	}
+	if blocks[3].data[0] != 0x12345678 || blocks[3].HasDiffs() {
+		t.Errorf("wrong cached data: %s %v", blocks[3], blocks[3].diff)
+	}
+	if err := ProgramFuses(c); err != nil {
+		t.Fatalf("ProgramFuses: %s", err)
+	}
+	regs[blockReadBases[3]] = 0x12345679
+	cb := &fakeEFuseCtlBulk{fakeEFuseCtl{regs: regs}}
+	blocks, _, _, err = ReadFuses(cb)
+	if err != nil {
+		t.Fatalf("ReadFuses: %s", err)
+	}
+	if blocks[3].data[0] != 0x12345679 || blocks[0].data[2] != 0x5566 {
+		t.Errorf("wrong data read in bulk: %s %s", blocks[0], blocks[3])
+	}
+}
@@ -17,9 +17,10 @@
 package esp32
 
 import (
-	"bytes"
 	"crypto/aes"
 	"crypto/cipher"
+	"runtime"
+	"sync"
 
 	"github.com/juju/errors"
 )
@@ -31,6 +32,8 @@ const (
 	esp32EncryptionBlockSize        = aes.BlockSize
 	esp32EncryptionKeyLength        = 32
 	esp32EncryptionKeyTweakInterval = 32
+	// Data is split into segments of this size which are encrypted in parallel.
+	esp32EncryptionSegmentSize = 64 * 1024
 )
 
 func reverse(data []byte) {
@@ -47,60 +50,90 @@ func ESP32EncryptImageData(inData, key []byte, flashAddress, flashCryptConf uint
 	if flashAddress%esp32EncryptionBlockSize != 0 {
 		return nil, errors.Errorf("flash address must be divisible by %d", esp32EncryptionBlockSize)
 	}
-	inBuf := bytes.NewBuffer(inData)
-	outData := make([]byte, 0, len(inData))
-	blockData := make([]byte, esp32EncryptionBlockSize)
-	var cipher cipher.Block
-	for {
-		n, _ := inBuf.Read(blockData)
-		if n == 0 {
-			break
-		}
-		for n < esp32EncryptionBlockSize {
-			/* Pad with zeroes. */
-			blockData[n] = 0
-			n++
+	// Pad with zeroes to a whole number of blocks.
+	outLen := (len(inData) + esp32EncryptionBlockSize - 1) / esp32EncryptionBlockSize * esp32EncryptionBlockSize
+	outData := make([]byte, outLen)
+	copy(outData, inData)
+	masks := newESP32TweakMasks(flashCryptConf)
+	// Segment boundaries are aligned to the tweak interval, so each segment starts with a fresh key.
+	firstLen := esp32EncryptionSegmentSize - int(flashAddress%esp32EncryptionSegmentSize)
+	if firstLen >= len(outData) {
+		esp32EncryptInPlace(outData, key, flashAddress, masks)
+		return outData, nil
+	}
+	segs := make(chan int, len(outData)/esp32EncryptionSegmentSize+2)
+	for offset := 0; offset < len(outData); {
+		segs <- offset
+		if offset == 0 {
+			offset = firstLen
+		} else {
+			offset += esp32EncryptionSegmentSize
 		}
-		if cipher == nil || flashAddress%esp32EncryptionKeyTweakInterval == 0 {
-			blockKey := make([]byte, esp32EncryptionKeyLength)
-			copy(blockKey, key)
-			esp32EncryptionTweakKey(blockKey, flashAddress, flashCryptConf)
-			cipher, _ = aes.NewCipher(blockKey)
+	}
+	close(segs)
+	var wg sync.WaitGroup
+	for i := 0; i < runtime.NumCPU(); i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for offset := range segs {
+				end := offset + esp32EncryptionSegmentSize
+				if offset == 0 {
+					end = firstLen
+				}
+				if end > len(outData) {
+					end = len(outData)
+				}
+				esp32EncryptInPlace(outData[offset:end], key, flashAddress+uint32(offset), masks)
+			}
+		}()
+	}
+	wg.Wait()
+	return outData, nil
+}
+
+// esp32EncryptInPlace encrypts data, which must be a whole number of blocks, located at flashAddress.
+func esp32EncryptInPlace(data, key []byte, flashAddress uint32, masks *esp32TweakMasks) {
+	var blockKey [esp32EncryptionKeyLength]byte
+	var c cipher.Block
+	for i := 0; i < len(data); i += esp32EncryptionBlockSize {
+		if c == nil || flashAddress%esp32EncryptionKeyTweakInterval == 0 {
+			copy(blockKey[:], key)
+			masks.tweakKey(blockKey[:], flashAddress)
+			c, _ = aes.NewCipher(blockKey[:])
 		}
+		blockData := data[i : i+esp32EncryptionBlockSize]
 		reverse(blockData)
-		cipher.Decrypt(blockData, blockData)
+		c.Decrypt(blockData, blockData)
 		reverse(blockData)
-		outData = append(outData, blockData...)
 		flashAddress += esp32EncryptionBlockSize
 	}
-
-	return outData, nil
 }
 
-func esp32EncryptionTweakKeyBits(key []byte, flashAddress, keyBitIdxFrom, keyBitIdxTo uint32) {
-	for keyBitIdx := keyBitIdxFrom; keyBitIdx < keyBitIdxTo; keyBitIdx++ {
-		addrBitIdx := esp32EncryptionKeyBitTweakPattern[keyBitIdx]
-		addrMask := uint32(1) << addrBitIdx
-		if flashAddress&addrMask != 0 {
-			keyByteIdx := keyBitIdx / 8
-			keyByteMask := byte(1) << (7 - (keyBitIdx % 8))
-			key[keyByteIdx] ^= keyByteMask
+// esp32TweakMasks holds, for each flash address bit, the key bits it flips.
+type esp32TweakMasks [24][esp32EncryptionKeyLength]byte
+
+func newESP32TweakMasks(flashCryptConf uint32) *esp32TweakMasks {
+	m := &esp32TweakMasks{}
+	for i, kr := range []struct{ from, to uint32 }{{0, 67}, {67, 132}, {132, 195}, {195, 256}} {
+		if flashCryptConf&(1<<uint(i)) == 0 {
+			continue
+		}
+		for keyBitIdx := kr.from; keyBitIdx < kr.to; keyBitIdx++ {
+			addrBitIdx := esp32EncryptionKeyBitTweakPattern[keyBitIdx]
+			m[addrBitIdx][keyBitIdx/8] ^= byte(1) << (7 - (keyBitIdx % 8))
 		}
 	}
+	return m
 }
 
-func esp32EncryptionTweakKey(key []byte, flashAddress, flashCryptConf uint32) {
-	if flashCryptConf&1 != 0 {
-		esp32EncryptionTweakKeyBits(key, flashAddress, 0, 67)
-	}
-	if flashCryptConf&2 != 0 {
-		esp32EncryptionTweakKeyBits(key, flashAddress, 67, 132)
-	}
-	if flashCryptConf&4 != 0 {
-		esp32EncryptionTweakKeyBits(key, flashAddress, 132, 195)
-	}
-	if flashCryptConf&8 != 0 {
-		esp32EncryptionTweakKeyBits(key, flashAddress, 195, 256)
+func (m *esp32TweakMasks) tweakKey(key []byte, flashAddress uint32) {
+	for addrBitIdx := range m {
+		if flashAddress&(uint32(1)<<uint(addrBitIdx)) != 0 {
+			for i, b := range m[addrBitIdx] {
+				key[i] ^= b
+			}
+		}
 	}
 }
 
@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package esp32
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
+	"math/rand"
+	"testing"
+)
+
+func testEncryptionKey() []byte {
+	key := make([]byte, esp32EncryptionKeyLength)
+	for i := range key {
+		key[i] = byte(0xa0 + i)
+	}
+	return key
+}
+
+func testEncryptionData(n int) []byte {
+	data := make([]byte, n)
+	for i := range data {
+		data[i] = byte(i*131 + i>>8)
+	}
+	return data
+}
+
+// Known answers were produced by the original bit-by-bit key tweaking implementation.
+var esp32EncryptionVectors = []struct {
+	addr, cryptConf uint32
+	dataLen         int
+	// Hex of the result or, for big inputs, of its SHA256.
+	result string
+}{
+	{0x0, 0x0, 50, "5414c61760ad5c6d960c6e86673628f7f3ae2711c8221c95298906d8b1c46ad6169ffa5a5dc72f232264f848b0ff68c90fb3be8adb93c9f535e0576dfc827f0a"},
+	{0x10, 0x1, 50, "5414c61760ad5c6d960c6e86673628f7a03e662d98fc23e3f0c506ae370cb3b8c297673e8cf5add940c2ae4f7e895edf6c9e9e78e15f6127dc50c8260c5abc89"},
+	{0x1230, 0x2, 50, "f066cf5aea6f280a332bf7bc7becf5188f9dbb9506188af42e99a9b34461e562122805f6e99efa44b7e447a4bb06cf616b6a3fed8a252bc164169422624888eb"},
+	{0x10000, 0x4, 50, "e36052c38a2ead6cfcfdcc8b64520a17ad970f809fb74127b10bdc09b463648af25f0b6dca257f23ff645e09ea859b38a20a42fea42db5940b89140119e0941d"},
+	{0x3ff0, 0x8, 50, "1e77cb53aae131b55e26d62d4d16f9841cf2adc5ad2208c77653fe922ea48f5caf975ae7e9d6072e5d6cd8f9a712759d693bbbea112a5a47f6dc2951987a8044"},
+	{0x123450, 0xf, 50, "dd0b33f9bdb0f997142ec9680cd69bb2d243d24e12c796758ed9d8d9409bfc6854014d3e26ae2309fc07417cd42de265dfaa02ace46cbe84c0c12e96036fba6c"},
+	{0x10, 0x5, 50, "5414c61760ad5c6d960c6e86673628f712d0498e5c3bdf2f2eb829148b8d277568b49e9ff8f93de4a89919ac7d4d858fd7527449e9bd66af70b9f04aa0c3db24"},
+	{0xffe0, 0xf, 3*esp32EncryptionSegmentSize + 100, "e433ce9b413f10e84b9e62a16bf664890bb1d3a71cc8a4ce834a444c4501c1ad"},
+	{0x123450, 0xf, 3*esp32EncryptionSegmentSize + 100, "d19d73d747ce18ccbe007bd3b10bb317d330a72ca7af298df85fe6338c3f9736"},
+	{0x10, 0xa, 3*esp32EncryptionSegmentSize + 100, "45b60f7f41dd3392a7d1232fbf14ecea4d96b266ac76f603b524deb4d39bf47f"},
+	{0x0, 0x3, 2 * esp32EncryptionSegmentSize, "60f90f371ecfc08192f7c1c723e4ae73cf32f94523867970282617d9a8763465"},
+}
+
+func TestESP32EncryptImageDataVectors(t *testing.T) {
+	for _, v := range esp32EncryptionVectors {
+		res, err := ESP32EncryptImageData(testEncryptionData(v.dataLen), testEncryptionKey(), v.addr, v.cryptConf)
+		if err != nil {
+			t.Fatalf("0x%x/0x%x: %s", v.addr, v.cryptConf, err)
+		}
+		if len(res) > 64 {
+			d := sha256.Sum256(res)
+			res = d[:]
+		}
+		if got := hex.EncodeToString(res); got != v.result {
+			t.Errorf("0x%x/0x%x/%d: expected %s, got %s", v.addr, v.cryptConf, v.dataLen, v.result, got)
+		}
+	}
+}
+
+func TestESP32EncryptImageDataSegments(t *testing.T) {
+	key := make([]byte, esp32EncryptionKeyLength)
+	rand.Read(key)
+	data := make([]byte, 3*esp32EncryptionSegmentSize+100)
+	rand.Read(data)
+	for _, addr := range []uint32{0, 0x10, 0x1000, 0x10000 - 0x20, 0x123450} {
+		res, err := ESP32EncryptImageData(data, key, addr, 0xf)
+		if err != nil {
+			t.Fatalf("0x%x: %s", addr, err)
+		}
+		// Encrypt the same data in one go, without splitting into segments.
+		expected := make([]byte, len(res))
+		copy(expected, data)
+		esp32EncryptInPlace(expected, key, addr, newESP32TweakMasks(0xf))
+		if !bytes.Equal(res, expected) {
+			t.Fatalf("0x%x: result mismatch", addr)
+		}
+	}
+}
+
+func BenchmarkESP32EncryptImageData(b *testing.B) {
+	key := make([]byte, esp32EncryptionKeyLength)
+	rand.Read(key)
+	data := make([]byte, 1024*1024)
+	rand.Read(data)
+	b.SetBytes(int64(len(data)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := ESP32EncryptImageData(data, key, 0x10000, 0xf); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -46,11 +46,13 @@ const (
 )
 
 const (
-	flasherAsset        = "data/RS14100_SF_4MB.FLM.bin"
-	flasherBaseAddr     = 0x00000000
-	flasherStack        = 0x0004000
-	flasherWriteBufAddr = 0x0010000
-	flasherWriteBufSize = 0x0010000
+	flasherAsset    = "data/RS14100_SF_4MB.FLM.bin"
+	flasherBaseAddr = 0x00000000
+	flasherStack    = 0x0004000
+	// Two write buffers: the host fills one while the stub is programming the other.
+	flasherWriteBufAddr  = 0x0010000
+	flasherWriteBuf2Addr = 0x0020000
+	flasherWriteBufSize  = 0x0010000
 	// prefix length, applied to all function offsets.
 	flasherFuncOffset = 56
 	// Function offsets (as shown by objdump).
@@ -100,13 +102,8 @@ type FlashOpts struct {
 	KeepFS    bool
 }
 
-func runFlasherFunc(ctx2 context.Context, tgt common.Target, funcAddr uint32, args []uint32, timeout time.Duration) error {
-	ctx := ctx2
-	if timeout != 0 {
-		ctx3, cancel := context.WithTimeout(ctx, timeout)
-		ctx2 = ctx3
-		defer cancel()
-	}
+// startFlasherFunc sets up arguments and starts the function, without waiting for it to finish.
+func startFlasherFunc(ctx context.Context, tgt common.Target, funcAddr uint32, args []uint32) error {
 	for i := 0; i < len(args); i++ {
 		if err := tgt.SetReg(ctx, i, args[i]); err != nil {
 			return errors.Annotatef(err, "failed to set arg %d", i)
@@ -117,9 +114,19 @@ func runFlasherFunc(ctx2 context.Context, tgt common.Target, funcAddr uint32, ar
 		return errors.Annotatef(err, "failed to set LR")
 	}
 	if err := tgt.SetReg(ctx, cortex.PC, funcAddr+flasherFuncOffset); err != nil {
-		return errors.Annotatef(err, "failed to set LR")
+		return errors.Annotatef(err, "failed to set PC")
+	}
+	return errors.Trace(tgt.Run(ctx, false /* waitHalt */))
+}
+
+// finishFlasherFunc waits for the function started by startFlasherFunc to return and checks the result.
+func finishFlasherFunc(ctx context.Context, tgt common.Target, timeout time.Duration) error {
+	if timeout != 0 {
+		ctx2, cancel := context.WithTimeout(ctx, timeout)
+		defer cancel()
+		ctx = ctx2
 	}
-	if err := tgt.Run(ctx, true /* waitHalt */); err != nil {
+	if err := tgt.WaitHalt(ctx); err != nil {
 		return errors.Trace(err)
 	}
 	r0, err := tgt.GetReg(ctx, 0)
@@ -132,6 +139,13 @@ func runFlasherFunc(ctx2 context.Context, tgt common.Target, funcAddr uint32, ar
 	return nil
 }
 
+func runFlasherFunc(ctx context.Context, tgt common.Target, funcAddr uint32, args []uint32, timeout time.Duration) error {
+	if err := startFlasherFunc(ctx, tgt, funcAddr, args); err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(finishFlasherFunc(ctx, tgt, timeout))
+}
+
 func toWords(data []byte, padWith byte) []uint32 {
 	var w uint32
 	var dataWords []uint32
@@ -156,6 +170,33 @@ func isAllFF(data []byte) bool {
 	return true
 }
 
+type writeSegment struct {
+	addr uint32
+	data []byte
+}
+
+// getWriteSegments splits data into runs of pages that are not all FFs,
+// each fitting into a flasher write buffer. Erased pages in between are skipped.
+func getWriteSegments(addr uint32, data []byte) []writeSegment {
+	var segs []writeSegment
+	for i := 0; i < len(data); i += flashPageSize {
+		page := data[i : i+flashPageSize]
+		if isAllFF(page) {
+			continue
+		}
+		pa := addr + uint32(i)
+		if n := len(segs); n > 0 {
+			last := &segs[n-1]
+			if last.addr+uint32(len(last.data)) == pa && len(last.data)+flashPageSize <= flasherWriteBufSize {
+				last.data = data[int(last.addr-addr) : i+flashPageSize]
+				continue
+			}
+		}
+		segs = append(segs, writeSegment{addr: pa, data: page})
+	}
+	return segs
+}
+
 func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	if opts.KeepFS && opts.EraseChip {
 		return errors.Errorf("--keep-fs and --esp-erase-chip are incompatible")
@@ -317,40 +358,46 @@ func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 			glog.V(1).Infof("Skipped writing %d, all FFs", len(pData))
 			continue
 		}
-		wa := int(pAddr)
-		ourutil.Reportf("Writing %d @ 0x%x (%s)...", len(pData), wa, p.Name)
+		ourutil.Reportf("Writing %d @ 0x%x (%s)...", len(pData), pAddr, p.Name)
 		glog.V(1).Infof("Running Init(write)...")
 		if err := runFlasherFunc(ctx, cm4d, flasherFuncInit, []uint32{0x8012000, 12000000, 2}, 1*time.Second); err != nil {
 			return errors.Annotatef(err, "failed to init flasher")
 		}
-		for wi := 0; wi < len(pData); {
-			wl := len(pData) - wi
-			if wl > flasherWriteBufSize {
-				wl = flasherWriteBufSize
+		// Segment i is sent to buffer i % 2 while segment i - 1 is being written from the other one.
+		segs := getWriteSegments(pAddr, pData)
+		bufs := [2]uint32{flasherWriteBufAddr, flasherWriteBuf2Addr}
+		send := func(i int) error {
+			seg := segs[i]
+			glog.V(1).Infof("Sending %d to 0x%x...", len(seg.data), bufs[i%2])
+			sendStart := time.Now()
+			if err := mapc.WriteTargetMem(ctx, bufs[i%2], toWords(seg.data, 0xff)); err != nil {
+				return errors.Annotatef(err, "failed to upload data @ 0x%x", seg.addr)
 			}
-			chunk := pData[wi : wi+wl]
-			if !isAllFF(chunk) {
-				glog.V(1).Infof("Sending %d to 0x%x...", wl, flasherWriteBufAddr)
-				sendStart := time.Now()
-				data := toWords(chunk, 0xff)
-				if err := mapc.WriteTargetMem(ctx, flasherWriteBufAddr, data); err != nil {
-					return errors.Annotatef(err, "failed to upload data @ 0x%x", wi)
-				}
-				tSend += time.Since(sendStart)
-				writeStart := time.Now()
-				glog.V(1).Infof("Writing %d @ 0x%x...", wl, wa)
-				if err := runFlasherFunc(ctx, cm4d, flasherFuncProgramPage, []uint32{uint32(wa), uint32(wl), uint32(flasherWriteBufAddr)}, 5*time.Second); err != nil {
-					return errors.Annotatef(err, "failed to write @ 0x%x", wa)
+			tSend += time.Since(sendStart)
+			return nil
+		}
+		if err := send(0); err != nil {
+			return errors.Trace(err)
+		}
+		for i, seg := range segs {
+			glog.V(1).Infof("Writing %d @ 0x%x...", len(seg.data), seg.addr)
+			if err := startFlasherFunc(ctx, cm4d, flasherFuncProgramPage, []uint32{seg.addr, uint32(len(seg.data)), bufs[i%2]}); err != nil {
+				return errors.Annotatef(err, "failed to write @ 0x%x", seg.addr)
+			}
+			if i+1 < len(segs) {
+				if err := send(i + 1); err != nil {
+					return errors.Trace(err)
 				}
-				tWrite += time.Since(writeStart)
-			} else {
-				glog.V(1).Infof("Skipped writing %d @ 0x%x, all FFs", len(chunk), wa)
 			}
-			wa += wl
-			wi += wl
+			waitStart := time.Now()
+			if err := finishFlasherFunc(ctx, cm4d, 5*time.Second); err != nil {
+				return errors.Annotatef(err, "failed to write @ 0x%x", seg.addr)
+			}
+			tWrite += time.Since(waitStart)
 		}
 	}
 	tAll := time.Since(start)
+	// Sending overlaps with writing, write is the time spent waiting for the stub after sending.
 	glog.Infof("Took %.3f (%.3f erase, %.3f send, %.3f write)",
 		tAll.Seconds(), tErase.Seconds(), tSend.Seconds(), tWrite.Seconds())
 	ourutil.Reportf("Done! Running firmware...")
@@ -29,6 +29,8 @@ type FlashOpts struct {
 	Serial      string
 	Timeout     time.Duration
 	KeepFS      bool
+	// Only write blocks that differ from current flash contents (st-flash only).
+	MinimizeWrites bool
 }
 
 func Flash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
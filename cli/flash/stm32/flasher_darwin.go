@@ -17,7 +17,11 @@
 package stm32
 
 import (
+	"sync/atomic"
+	"time"
+
 	"github.com/juju/errors"
+	"golang.org/x/sys/unix"
 )
 
 func GetSTLinkMountForPort(port string) (string, string, error) {
@@ -28,3 +32,47 @@ func GetSTLinkMountForPort(port string) (string, string, error) {
 func GetSTLinkMounts() ([]string, error) {
 	return getSTLinkMountsInDir("/Volumes")
 }
+
+// watchFile returns a channel that receives a value when the file is deleted,
+// renamed or the underlying volume is unmounted.
+func watchFile(name string) (<-chan struct{}, func(), error) {
+	fd, err := unix.Open(name, unix.O_EVTONLY, 0)
+	if err != nil {
+		return nil, nil, errors.Annotatef(err, "open")
+	}
+	kq, err := unix.Kqueue()
+	if err != nil {
+		unix.Close(fd)
+		return nil, nil, errors.Annotatef(err, "kqueue")
+	}
+	var ev unix.Kevent_t
+	unix.SetKevent(&ev, fd, unix.EVFILT_VNODE, unix.EV_ADD|unix.EV_CLEAR)
+	ev.Fflags = unix.NOTE_DELETE | unix.NOTE_RENAME | unix.NOTE_REVOKE
+	if _, err := unix.Kevent(kq, []unix.Kevent_t{ev}, nil, nil); err != nil {
+		unix.Close(kq)
+		unix.Close(fd)
+		return nil, nil, errors.Annotatef(err, "kevent")
+	}
+	ch := make(chan struct{}, 1)
+	var stopped int32
+	go func() {
+		defer unix.Close(fd)
+		defer unix.Close(kq)
+		// Closing kqueue does not reliably wake up a waiting kevent, so wait with a timeout.
+		ts := unix.NsecToTimespec(int64(200 * time.Millisecond))
+		events := make([]unix.Kevent_t, 1)
+		for atomic.LoadInt32(&stopped) == 0 {
+			n, err := unix.Kevent(kq, nil, events, &ts)
+			if err != nil && err != unix.EINTR {
+				return
+			}
+			if n > 0 {
+				select {
+				case ch <- struct{}{}:
+				default:
+				}
+			}
+		}
+	}()
+	return ch, func() { atomic.StoreInt32(&stopped, 1) }, nil
+}
@@ -24,6 +24,7 @@ import (
 	"strings"
 
 	"github.com/juju/errors"
+	"golang.org/x/sys/unix"
 	glog "k8s.io/klog/v2"
 )
 
@@ -82,3 +83,32 @@ func GetSTLinkMountForPort(port string) (string, string, error) {
 func GetSTLinkMounts() ([]string, error) {
 	return getSTLinkMountsInDir(filepath.Join("/", "media", os.Getenv("USER")))
 }
+
+// watchFile returns a channel that receives a value when the file is deleted,
+// moved or the underlying file system is unmounted.
+func watchFile(name string) (<-chan struct{}, func(), error) {
+	fd, err := unix.InotifyInit1(unix.IN_CLOEXEC | unix.IN_NONBLOCK)
+	if err != nil {
+		return nil, nil, errors.Annotatef(err, "inotify_init")
+	}
+	if _, err := unix.InotifyAddWatch(fd, name, unix.IN_DELETE_SELF|unix.IN_MOVE_SELF|unix.IN_ATTRIB|unix.IN_UNMOUNT); err != nil {
+		unix.Close(fd)
+		return nil, nil, errors.Annotatef(err, "inotify_add_watch")
+	}
+	// Non-blocking descriptor is handled by the runtime poller, so Close unblocks Read.
+	f := os.NewFile(uintptr(fd), "inotify")
+	ch := make(chan struct{}, 1)
+	go func() {
+		buf := make([]byte, 4096)
+		for {
+			if _, err := f.Read(buf); err != nil {
+				return
+			}
+			select {
+			case ch <- struct{}{}:
+			default:
+			}
+		}
+	}()
+	return ch, func() { f.Close() }, nil
+}
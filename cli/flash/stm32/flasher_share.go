@@ -34,6 +34,8 @@ var (
 	stlinkDevPrefixes = []string{"DIS_", "NODE_"}
 )
 
+const sharePollInterval = 100 * time.Millisecond
+
 func getSTLinkMountsInDir(dir string) ([]string, error) {
 	glog.V(1).Infof("Looking for ST-Link devices under %q", dir)
 	ee, err := ioutil.ReadDir(dir)
@@ -75,13 +77,29 @@ func flashShare(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 
 	common.Reportf("Waiting for operation to complete...")
 
+	return waitForRemoval(name, opts.Timeout)
+}
+
+// waitForRemoval waits for the file to disappear, which means the ST-Link has consumed it.
+// File system notifications are used to react quickly, with polling as a fallback.
+func waitForRemoval(name string, timeout time.Duration) error {
+	events, stop, err := watchFile(name)
+	if err == nil {
+		defer stop()
+	} else {
+		glog.V(1).Infof("Not watching %s, will poll: %s", name, err)
+	}
+
 	start := time.Now()
+	ticker := time.NewTicker(sharePollInterval)
+	defer ticker.Stop()
 
 	for {
-		_, err = os.Stat(name)
+		_, err := os.Stat(name)
 		if err != nil {
 			if os.IsNotExist(err) {
 				// File is disappeared: operation ok
+				glog.V(1).Infof("Flashing took %s", time.Since(start))
 				return nil
 			} else {
 				// On Windows, this sometimes raises spurious errors, like CreateFile error.
@@ -91,10 +109,13 @@ func flashShare(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 			}
 		}
 
-		if time.Since(start) > opts.Timeout {
+		if time.Since(start) > timeout {
 			return errors.Errorf("timeout")
 		}
 
-		time.Sleep(1000 * time.Millisecond)
+		select {
+		case <-events:
+		case <-ticker.C:
+		}
 	}
 }
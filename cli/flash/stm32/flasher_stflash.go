@@ -17,12 +17,16 @@
 package stm32
 
 import (
+	"bytes"
 	"fmt"
+	"io/ioutil"
+	"os"
 	"os/exec"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/common/fwbundle"
 	"github.com/mongoose-os/mos/cli/ourutil"
+	glog "k8s.io/klog/v2"
 )
 
 func checkSTFlashPath(path string) string {
@@ -37,6 +41,82 @@ func checkSTFlashPath(path string) string {
 	return path
 }
 
+// Changed data is written in blocks of this size, aligned on absolute address.
+// It is a multiple of the largest erase sector, so writing a block never erases data outside of it.
+const stFlashBlockSize = 256 * 1024
+
+func runSTFlash(stFlashPath string, opts *FlashOpts, args ...string) error {
+	cmd := []string{stFlashPath}
+	if opts.Serial != "" {
+		cmd = append(cmd, "--serial", fmt.Sprintf("0x%s", opts.Serial))
+	}
+	cmd = append(cmd, args...)
+	return ourutil.RunCmd(ourutil.CmdOutOnError, cmd...)
+}
+
+// readSTFlash reads current contents of the flash region.
+func readSTFlash(stFlashPath string, opts *FlashOpts, addr uint32, length int) ([]byte, error) {
+	f, err := ioutil.TempFile("", "stm32-read-*.bin")
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	fname := f.Name()
+	f.Close()
+	defer os.Remove(fname)
+	if err := runSTFlash(stFlashPath, opts, "read", fname, fmt.Sprintf("%#x", addr), fmt.Sprintf("%d", length)); err != nil {
+		return nil, errors.Annotatef(err, "st-flash read failed")
+	}
+	data, err := ioutil.ReadFile(fname)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if len(data) != length {
+		return nil, errors.Errorf("short read: %d of %d", len(data), length)
+	}
+	return data, nil
+}
+
+type stFlashRange struct {
+	addr uint32
+	data []byte
+}
+
+// getChangedRanges compares new data with current flash contents and returns
+// runs of blocks that differ.
+func getChangedRanges(addr uint32, data, cur []byte) []stFlashRange {
+	var res []stFlashRange
+	for offset := 0; offset < len(data); {
+		end := int((addr+uint32(offset))/stFlashBlockSize+1)*stFlashBlockSize - int(addr)
+		if end > len(data) {
+			end = len(data)
+		}
+		if !bytes.Equal(data[offset:end], cur[offset:end]) {
+			if n := len(res); n > 0 && res[n-1].addr+uint32(len(res[n-1].data)) == addr+uint32(offset) {
+				res[n-1].data = data[int(res[n-1].addr-addr):end]
+			} else {
+				res = append(res, stFlashRange{addr: addr + uint32(offset), data: data[offset:end]})
+			}
+		}
+		offset = end
+	}
+	return res
+}
+
+func writeSTFlashRange(stFlashPath string, opts *FlashOpts, r stFlashRange) error {
+	f, err := ioutil.TempFile("", "stm32-write-*.bin")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	fname := f.Name()
+	defer os.Remove(fname)
+	_, err = f.Write(r.data)
+	f.Close()
+	if err != nil {
+		return errors.Trace(err)
+	}
+	return runSTFlash(stFlashPath, opts, "write", fname, fmt.Sprintf("%#x", r.addr))
+}
+
 func flashSTFlash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	stFlashPath := checkSTFlashPath(opts.STFlashPath)
 	if stFlashPath == "" {
@@ -47,18 +127,36 @@ func flashSTFlash(fw *fwbundle.FirmwareBundle, opts *FlashOpts) error {
 	}
 	ourutil.Reportf("Using %s", stFlashPath)
 	for _, p := range fw.PartsByAddr() {
-		fname, dataLen, err := fw.GetPartDataFile(p.Name)
+		if !opts.MinimizeWrites {
+			fname, dataLen, err := fw.GetPartDataFile(p.Name)
+			if err != nil {
+				return errors.Trace(err)
+			}
+			ourutil.Reportf("Flashing %q (%d @ %#x)...", p.Name, dataLen, p.Addr)
+			if err := runSTFlash(stFlashPath, opts, "write", fname, fmt.Sprintf("%#x", p.Addr)); err != nil {
+				return errors.Annotatef(err, "st-flash command failed")
+			}
+			continue
+		}
+		data, err := fw.GetPartData(p.Name)
 		if err != nil {
 			return errors.Trace(err)
 		}
-		ourutil.Reportf("Flashing %q (%d @ %#x)...", p.Name, dataLen, p.Addr)
-		cmd := []string{stFlashPath}
-		if opts.Serial != "" {
-			cmd = append(cmd, "--serial", fmt.Sprintf("0x%s", opts.Serial))
+		ranges := []stFlashRange{{addr: p.Addr, data: data}}
+		if cur, err := readSTFlash(stFlashPath, opts, p.Addr, len(data)); err == nil {
+			ranges = getChangedRanges(p.Addr, data, cur)
+		} else {
+			glog.Warningf("failed to read current contents of %q, writing all of it: %s", p.Name, err)
+		}
+		if len(ranges) == 0 {
+			ourutil.Reportf("%q (%d @ %#x) is unchanged, skipping", p.Name, len(data), p.Addr)
+			continue
 		}
-		cmd = append(cmd, "write", fname, fmt.Sprintf("%#x", p.Addr))
-		if err := ourutil.RunCmd(ourutil.CmdOutOnError, cmd...); err != nil {
-			return errors.Annotatef(err, "st-flash command failed")
+		for _, r := range ranges {
+			ourutil.Reportf("Flashing %q (%d @ %#x)...", p.Name, len(r.data), r.addr)
+			if err := writeSTFlashRange(stFlashPath, opts, r); err != nil {
+				return errors.Annotatef(err, "st-flash command failed")
+			}
 		}
 	}
 	return nil
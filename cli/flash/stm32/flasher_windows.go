@@ -69,3 +69,8 @@ func GetSTLinkMountForPort(port string) (string, string, error) {
 	// TODO(rojer)
 	return "", "", errors.NotImplementedf("GetSTLinkMountForPort")
 }
+
+// watchFile is not implemented on Windows, completion is detected by polling.
+func watchFile(name string) (<-chan struct{}, func(), error) {
+	return nil, nil, errors.NotImplementedf("watchFile")
+}
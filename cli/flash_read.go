@@ -19,11 +19,11 @@
 package main
 
 import (
-	"io/ioutil"
-	"os"
-	"strconv"
-
 	"context"
+	"fmt"
+	"path/filepath"
+	"strconv"
+	"strings"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/dev"
@@ -34,6 +34,42 @@ import (
 	flag "github.com/spf13/pflag"
 )
 
+var flashReadResume = false
+
+func init() {
+	flag.BoolVar(&flashReadResume, "flash-read-resume", false,
+		"Continue an interrupted flash-read: data already in the output file is verified "+
+			"against flash digests and only the rest is read")
+}
+
+// parseReadRanges parses comma-separated addr:length pairs.
+// With more than one range, each is saved to a separate file with the address added to the name.
+func parseReadRanges(spec, outFile string) ([]espFlasher.ReadRange, error) {
+	var ranges []espFlasher.ReadRange
+	parts := strings.Split(spec, ",")
+	for _, rs := range parts {
+		al := strings.SplitN(rs, ":", 2)
+		if len(al) != 2 {
+			return nil, errors.Errorf("invalid range %q, must be addr:length", rs)
+		}
+		addr, err := strconv.ParseUint(al[0], 0, 32)
+		if err != nil {
+			return nil, errors.Annotatef(err, "invalid address")
+		}
+		length, err := strconv.ParseInt(al[1], 0, 64)
+		if err != nil {
+			return nil, errors.Annotatef(err, "invalid length")
+		}
+		r := espFlasher.ReadRange{Addr: uint32(addr), Length: int(length), File: outFile}
+		if len(parts) > 1 && outFile != "-" {
+			ext := filepath.Ext(outFile)
+			r.File = fmt.Sprintf("%s.0x%x%s", strings.TrimSuffix(outFile, ext), addr, ext)
+		}
+		ranges = append(ranges, r)
+	}
+	return ranges, nil
+}
+
 func flashRead(ctx context.Context, devConn dev.DevConn) error {
 	// if given devConn is not nil, we should disconnect it while flash reading is in progress
 	if devConn != nil {
@@ -42,57 +78,42 @@ func flashRead(ctx context.Context, devConn dev.DevConn) error {
 	}
 
 	var err error
-	var addr, length int64
-	outFile := ""
+	var ranges []espFlasher.ReadRange
 	args := flag.Args()
 	switch len(args) {
 	case 2:
 		// Nothing, will auto-detect the size and read entire flash.
-		outFile = args[1]
+		ranges = []espFlasher.ReadRange{{File: args[1]}}
+	case 3:
+		// addr:length[,addr:length...]
+		ranges, err = parseReadRanges(args[1], args[2])
 	case 4:
-		addr, err = strconv.ParseInt(args[1], 0, 64)
-		if err != nil {
-			return errors.Annotatef(err, "invalid address")
-		}
-		length, err = strconv.ParseInt(args[2], 0, 64)
-		if err != nil {
-			return errors.Annotatef(err, "invalid length")
-		}
-		outFile = args[3]
+		ranges, err = parseReadRanges(args[1]+":"+args[2], args[3])
 	default:
 		return errors.Errorf("invalid arguments")
 	}
+	if err != nil {
+		return errors.Trace(err)
+	}
 
 	port, err := devutil.GetPort()
 	if err != nil {
 		return errors.Trace(err)
 	}
 
-	var data []byte
 	platform := flags.Platform()
 	switch platform {
 	case "esp32":
 		espFlashOpts.ControlPort = port
-		data, err = espFlasher.ReadFlash(esp.ChipESP32, uint32(addr), int(length), &espFlashOpts)
+		err = espFlasher.ReadFlash(esp.ChipESP32, ranges, flashReadResume, &espFlashOpts)
 	case "esp8266":
 		espFlashOpts.ControlPort = port
-		data, err = espFlasher.ReadFlash(esp.ChipESP8266, uint32(addr), int(length), &espFlashOpts)
+		err = espFlasher.ReadFlash(esp.ChipESP8266, ranges, flashReadResume, &espFlashOpts)
 	case "stm32":
 		err = errors.NotImplementedf("flash reading for %s", platform)
 	default:
 		err = errors.NotImplementedf("flash reading for %s", platform)
 	}
 
-	if err == nil {
-		if outFile == "-" {
-			_, err = os.Stdout.Write(data)
-		} else {
-			err = ioutil.WriteFile(outFile, data, 0644)
-			if err == nil {
-				reportf("Wrote %s", outFile)
-			}
-		}
-	}
-
 	return errors.Trace(err)
 }
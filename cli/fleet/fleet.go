@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fleet
+
+import (
+	"bufio"
+	"context"
+	"encoding/json"
+	"os"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/devutil"
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/ourutil"
+)
+
+var (
+	targetsFlag     = flag.String("targets", "", "File with fleet targets, one port (e.g. mqtt://broker/device) per line")
+	concurrencyFlag = flag.Int("fleet-concurrency", 32, "Maximum number of fleet targets called at the same time")
+	rateFlag        = flag.Float64("fleet-rate", 0, "Maximum number of fleet calls started per second, 0 - unlimited")
+)
+
+// result is a line of the fleet call output.
+type result struct {
+	Target     string          `json:"target"`
+	Result     json.RawMessage `json:"result,omitempty"`
+	Error      string          `json:"error,omitempty"`
+	DurationMs int64           `json:"duration_ms"`
+}
+
+// Fleet runs a command on many devices. The only command so far is "call":
+//
+//	mos fleet call --targets devices.txt Sys.GetInfo
+//
+// Results are printed to stdout as they arrive, one JSON object per line.
+func Fleet(ctx context.Context, _ dev.DevConn) error {
+	args := flag.Args()[1:]
+	if len(args) < 1 || args[0] != "call" {
+		return errors.Errorf("usage: mos fleet call --targets FILE METHOD [ARGS]")
+	}
+	if len(args) < 2 {
+		return errors.Errorf("method required")
+	}
+	method, params := args[1], ""
+	if len(args) > 2 {
+		params = args[2]
+	}
+	if *targetsFlag == "" {
+		return errors.Errorf("--targets is required")
+	}
+	targets, err := readTargets(*targetsFlag)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	return callAll(ctx, targets, method, params)
+}
+
+// readTargets reads the targets file, skipping empty lines and "#" comments.
+func readTargets(fname string) ([]string, error) {
+	f, err := os.Open(fname)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	defer f.Close()
+	var targets []string
+	s := bufio.NewScanner(f)
+	for s.Scan() {
+		t := strings.TrimSpace(s.Text())
+		if t == "" || strings.HasPrefix(t, "#") {
+			continue
+		}
+		targets = append(targets, t)
+	}
+	if err := s.Err(); err != nil {
+		return nil, errors.Annotatef(err, "failed to read %s", fname)
+	}
+	return targets, nil
+}
+
+func callAll(ctx context.Context, targets []string, method, params string) error {
+	return runAll(ctx, targets, func(ctx context.Context, target string) *result {
+		return callTarget(ctx, target, method, params)
+	})
+}
+
+// runAll runs fn for all the targets, at most --fleet-concurrency at a time
+// and starting no more than --fleet-rate per second, and prints the results.
+func runAll(ctx context.Context, targets []string, fn func(ctx context.Context, target string) *result) error {
+	numWorkers := *concurrencyFlag
+	if numWorkers <= 0 {
+		numWorkers = 1
+	}
+	if numWorkers > len(targets) {
+		numWorkers = len(targets)
+	}
+	var outLock sync.Mutex
+	enc := json.NewEncoder(os.Stdout)
+	numOK, numFailed := 0, 0
+	queue := make(chan string)
+	var wg sync.WaitGroup
+	for i := 0; i < numWorkers; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for target := range queue {
+				res := fn(ctx, target)
+				outLock.Lock()
+				if res.Error == "" {
+					numOK++
+				} else {
+					numFailed++
+				}
+				enc.Encode(res)
+				outLock.Unlock()
+			}
+		}()
+	}
+	var tick <-chan time.Time
+	if *rateFlag > 0 {
+		ticker := time.NewTicker(time.Duration(float64(time.Second) / *rateFlag))
+		defer ticker.Stop()
+		tick = ticker.C
+	}
+feed:
+	for i, target := range targets {
+		if tick != nil && i > 0 {
+			select {
+			case <-tick:
+			case <-ctx.Done():
+				break feed
+			}
+		}
+		select {
+		case queue <- target:
+		case <-ctx.Done():
+			break feed
+		}
+	}
+	close(queue)
+	wg.Wait()
+	ourutil.Reportf("%d ok, %d failed, %d not called", numOK, numFailed, len(targets)-numOK-numFailed)
+	if numFailed > 0 {
+		return errors.Errorf("%d of %d targets failed", numFailed, len(targets))
+	}
+	return ctx.Err()
+}
+
+// callTarget connects to the target, performs the call and disconnects.
+// Connections to the same MQTT broker are shared between targets.
+func callTarget(ctx context.Context, target, method, params string) *result {
+	res := &result{Target: target}
+	start := time.Now()
+	if *flags.Timeout > 0 {
+		var cancel context.CancelFunc
+		ctx, cancel = context.WithTimeout(ctx, *flags.Timeout)
+		defer cancel()
+	}
+	err := func() error {
+		dc, err := devutil.CreateDevConn(ctx, target, func(junk []byte) {})
+		if err != nil {
+			return errors.Annotatef(err, "failed to connect")
+		}
+		defer dc.Disconnect(context.Background())
+		r, err := dc.CallRaw(ctx, method, params)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		res.Result = r
+		return nil
+	}()
+	res.DurationMs = int64(time.Since(start) / time.Millisecond)
+	if err != nil {
+		glog.V(1).Infof("%s: %s", target, errors.ErrorStack(err))
+		res.Error = err.Error()
+		if ctx.Err() == context.DeadlineExceeded {
+			res.Error = "timed out"
+		}
+	}
+	return res
+}
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fleet
+
+import (
+	"context"
+	"time"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/devutil"
+)
+
+type setupFunc func(ctx context.Context, devConn dev.DevConn) error
+
+// Provision wraps a device setup command (aws-iot-setup, gcp-iot-setup, etc)
+// so it can be run on all the devices listed in the --targets file:
+//
+//	mos aws-iot-setup --targets tray.txt --fleet-concurrency 16
+//
+// Devices are set up concurrently over their own connections, cloud clients
+// and one-time checks are shared between them by the setup command.
+// Without --targets, the device specified by --port is set up.
+// perDeviceFlags are flags whose values identify a single device (its ID, key or
+// certificate), they cannot be used with --targets.
+func Provision(setup setupFunc, perDeviceFlags ...string) func(ctx context.Context, devConn dev.DevConn) error {
+	return func(ctx context.Context, _ dev.DevConn) error {
+		if *targetsFlag == "" {
+			devConn, err := devutil.CreateDevConnFromFlags(ctx)
+			if err != nil {
+				return errors.Trace(err)
+			}
+			defer devConn.Disconnect(context.Background())
+			return setup(ctx, devConn)
+		}
+		for _, name := range perDeviceFlags {
+			if flag.CommandLine.Changed(name) {
+				return errors.Errorf("--%s applies to a single device and cannot be used with --targets", name)
+			}
+		}
+		targets, err := readTargets(*targetsFlag)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		return runAll(ctx, targets, func(ctx context.Context, target string) *result {
+			return provisionTarget(ctx, target, setup)
+		})
+	}
+}
+
+func provisionTarget(ctx context.Context, target string, setup setupFunc) *result {
+	res := &result{Target: target}
+	start := time.Now()
+	err := func() error {
+		dc, err := devutil.CreateDevConn(ctx, target, func(junk []byte) {})
+		if err != nil {
+			return errors.Annotatef(err, "failed to connect")
+		}
+		defer dc.Disconnect(context.Background())
+		return setup(ctx, dc)
+	}()
+	res.DurationMs = int64(time.Since(start) / time.Millisecond)
+	if err != nil {
+		glog.Errorf("%s: %s", target, errors.ErrorStack(err))
+		res.Error = err.Error()
+	}
+	return res
+}
@@ -19,9 +19,9 @@ package fs
 import (
 	"bytes"
 	"context"
-	"encoding/base64"
 	"fmt"
 	"io"
+	"io/ioutil"
 	"os"
 	"path"
 	"sort"
@@ -29,14 +29,15 @@ import (
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/dev"
-	"github.com/mongoose-os/mos/cli/flags"
 	"github.com/mongoose-os/mos/cli/ourutil"
 	flag "github.com/spf13/pflag"
-	glog "k8s.io/klog/v2"
 )
 
 var (
-	longFormat = flag.BoolP("long", "l", false, "Long output format.")
+	longFormat   = flag.BoolP("long", "l", false, "Long output format.")
+	windowFlag   = flag.Int("fs-window", 4, "Number of FS.Get/FS.Put requests to keep in flight")
+	resumeFlag   = flag.Bool("fs-resume", false, "Resume partially completed get and put transfers")
+	sizeOnlyFlag = flag.Bool("fs-sync-size-only", false, "When syncing directories, compare files by size only, not content")
 )
 
 type ListArgs struct {
@@ -110,59 +111,9 @@ type GetResult struct {
 	Left *int64  `json:"left,omitempty"`
 }
 
-func getFileSink(ctx context.Context, devConn dev.DevConn, name string, sink io.Writer) error {
-	// Get file
-	var offset int64
-
-	attempts := *flags.FsOpAttempts
-	for {
-		// Get the next chunk of data
-		ctx2, cancel := context.WithTimeout(ctx, devConn.GetTimeout())
-		defer cancel()
-		glog.V(1).Infof("Getting %s %d @ %d (attempts %d)", name, flags.ChunkSize, offset, attempts)
-		var chunk GetResult
-		if err := devConn.Call(ctx2, "FS.Get", &GetArgs{
-			Filename: &name,
-			Offset:   offset,
-			Len:      int64(*flags.ChunkSize),
-		}, &chunk); err != nil {
-			attempts -= 1
-			if attempts > 0 {
-				glog.Warningf("Error: %s", err)
-				continue
-			}
-			// TODO(dfrank): probably handle out of memory error by retrying with a
-			// smaller chunk size
-			return errors.Trace(err)
-		}
-		attempts = *flags.FsOpAttempts
-
-		decoded, err := base64.StdEncoding.DecodeString(*chunk.Data)
-		if err != nil {
-			return errors.Trace(err)
-		}
-
-		offset += int64(len(decoded))
-
-		for len(decoded) > 0 {
-			if n, err := sink.Write(decoded); err != nil {
-				return errors.Trace(err)
-			} else {
-				decoded = decoded[n:]
-			}
-		}
-
-		// Check if there is some data left
-		if *chunk.Left == 0 {
-			break
-		}
-	}
-	return nil
-}
-
 func GetFile(ctx context.Context, devConn dev.DevConn, name string) (string, error) {
 	buf := bytes.NewBuffer(nil)
-	err := getFileSink(ctx, devConn, name, buf)
+	err := getFileSink(ctx, devConn, name, 0, buf)
 	return string(buf.Bytes()), err
 }
 
@@ -171,11 +122,18 @@ func Get(ctx context.Context, devConn dev.DevConn) error {
 	if len(args) < 2 {
 		return errors.Errorf("filename is required")
 	}
-	if len(args) > 2 {
+	if len(args) > 3 {
 		return errors.Errorf("extra arguments")
 	}
-	filename := args[1]
-	return errors.Trace(getFileSink(ctx, devConn, filename, os.Stdout))
+	devFilename := args[1]
+	if len(args) < 3 {
+		return errors.Trace(getFileSink(ctx, devConn, devFilename, 0, os.Stdout))
+	}
+	hostFilename := args[2]
+	if strings.HasSuffix(devFilename, "/") {
+		return errors.Trace(syncDirFromDevice(ctx, devConn, devFilename, hostFilename))
+	}
+	return errors.Trace(GetToFile(ctx, devConn, devFilename, hostFilename))
 }
 
 func Put(ctx context.Context, devConn dev.DevConn) error {
@@ -194,6 +152,14 @@ func Put(ctx context.Context, devConn dev.DevConn) error {
 		devFilename = args[2]
 	}
 
+	if fi, err := os.Stat(hostFilename); err == nil && fi.IsDir() {
+		devDir := ""
+		if len(args) >= 3 {
+			devDir = args[2]
+		}
+		return errors.Trace(syncDirToDevice(ctx, devConn, hostFilename, devDir))
+	}
+
 	return PutFile(ctx, devConn, hostFilename, devFilename)
 }
 
@@ -203,62 +169,20 @@ func PutFile(ctx context.Context, devConn dev.DevConn, hostFilename, devFilename
 		return errors.Trace(err)
 	}
 
-	return PutData(ctx, devConn, bytes.NewBuffer(fileData), devFilename)
+	offset := 0
+	if *resumeFlag {
+		offset = putResumeOffset(ctx, devConn, fileData, devFilename)
+	}
+
+	return errors.Trace(putData(ctx, devConn, fileData, devFilename, offset))
 }
 
 func PutData(ctx context.Context, devConn dev.DevConn, r io.Reader, devFilename string) error {
-	data := make([]byte, *flags.ChunkSize)
-	appendFlag := false
-
-	offset := 0
-	attempts := *flags.FsOpAttempts
-	for {
-		// Read the next chunk from the file.
-		n, readErr := r.Read(data)
-		if n > 0 {
-			for attempts > 0 {
-				ctx2, cancel := context.WithTimeout(ctx, devConn.GetTimeout())
-				defer cancel()
-				glog.V(1).Infof("Sending %s %d @ %d (attempts %d)", devFilename, n, offset, attempts)
-				putArgs := &struct {
-					Filename string `json:"filename"`
-					Offset   int    `json:"offset"`
-					Append   bool   `json:"append"`
-					Data     string `json:"data"`
-				}{
-					Filename: devFilename,
-					Offset:   offset,
-					Append:   appendFlag,
-					Data:     base64.StdEncoding.EncodeToString(data[:n]),
-				}
-				if err := devConn.Call(ctx2, "FS.Put", putArgs, nil); err != nil {
-					attempts -= 1
-					if attempts > 0 {
-						glog.Warningf("Error: %s", err)
-						continue
-					}
-					return errors.Trace(err)
-				} else {
-					break
-				}
-			}
-		}
-		attempts = *flags.FsOpAttempts
-		if readErr != nil {
-			if errors.Cause(readErr) == io.EOF {
-				// Reached EOF, quit the loop normally.
-				break
-			}
-			// Some non-EOF error, return error.
-			return errors.Trace(readErr)
-		}
-
-		// All subsequent writes to this file will append the chunk.
-		appendFlag = true
-		offset += n
+	data, err := ioutil.ReadAll(r)
+	if err != nil {
+		return errors.Annotatef(err, "failed to read data")
 	}
-
-	return nil
+	return errors.Trace(putData(ctx, devConn, data, devFilename, 0))
 }
 
 type RemoveArgs struct {
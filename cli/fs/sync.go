@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fs
+
+import (
+	"bytes"
+	"context"
+	"io/ioutil"
+	"os"
+	"path"
+	"path/filepath"
+	"strings"
+
+	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/ourutil"
+	glog "k8s.io/klog/v2"
+)
+
+// listRemoteSizes returns sizes of files in the device directory, keyed by name.
+func listRemoteSizes(ctx context.Context, devConn dev.DevConn, dir string) (map[string]int64, error) {
+	if dir == "" {
+		dir = "/"
+	}
+	var files []ListExtResult
+	if err := devConn.Call(ctx, "FS.ListExt", &ListExtArgs{Path: &dir}, &files); err != nil {
+		return nil, errors.Annotatef(err, "failed to list %s", dir)
+	}
+	res := make(map[string]int64)
+	for _, f := range files {
+		if f.Name != nil && f.Size != nil {
+			res[*f.Name] = *f.Size
+		}
+	}
+	return res, nil
+}
+
+// upToDate returns true if the device file has the same contents as data.
+// Unless --fs-sync-size-only is set, files of the same size are read back and compared.
+func upToDate(ctx context.Context, devConn dev.DevConn, devFilename string, data []byte, remoteSize int64) bool {
+	if remoteSize != int64(len(data)) {
+		return false
+	}
+	if *sizeOnlyFlag {
+		return true
+	}
+	buf := bytes.NewBuffer(nil)
+	if err := getFileSink(ctx, devConn, devFilename, 0, buf); err != nil {
+		glog.Warningf("%s: %s", devFilename, err)
+		return false
+	}
+	return bytes.Equal(buf.Bytes(), data)
+}
+
+// syncDirToDevice uploads files under hostDir that differ from their device copies.
+func syncDirToDevice(ctx context.Context, devConn dev.DevConn, hostDir, devDir string) error {
+	devDir = strings.TrimSuffix(devDir, "/")
+	remoteDirs := make(map[string]map[string]int64)
+	numSkipped, numPut := 0, 0
+	err := filepath.Walk(hostDir, func(p string, fi os.FileInfo, err error) error {
+		if err != nil {
+			return errors.Trace(err)
+		}
+		if fi.IsDir() {
+			return nil
+		}
+		rel, err := filepath.Rel(hostDir, p)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		devFilename := path.Join(devDir, filepath.ToSlash(rel))
+		dir := path.Dir(devFilename)
+		if dir == "." {
+			dir = ""
+		}
+		sizes, ok := remoteDirs[dir]
+		if !ok {
+			if sizes, err = listRemoteSizes(ctx, devConn, dir); err != nil {
+				// Directory may not exist yet.
+				glog.V(1).Infof("%s", err)
+				sizes = map[string]int64{}
+			}
+			remoteDirs[dir] = sizes
+		}
+		data, err := ioutil.ReadFile(p)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		remoteSize, exists := sizes[path.Base(devFilename)]
+		if exists && upToDate(ctx, devConn, devFilename, data, remoteSize) {
+			glog.V(1).Infof("%s is up to date", devFilename)
+			numSkipped++
+			return nil
+		}
+		ourutil.Reportf("Putting %s -> %s (%d)...", p, devFilename, len(data))
+		offset := 0
+		if *resumeFlag && exists && remoteSize > 0 && remoteSize < int64(len(data)) &&
+			tailMatches(ctx, devConn, devFilename, data, remoteSize) {
+			offset = int(remoteSize)
+		}
+		if err := putData(ctx, devConn, data, devFilename, offset); err != nil {
+			return errors.Annotatef(err, "%s", p)
+		}
+		numPut++
+		return nil
+	})
+	if err != nil {
+		return errors.Trace(err)
+	}
+	ourutil.Reportf("%d files updated, %d up to date", numPut, numSkipped)
+	return nil
+}
+
+// syncDirFromDevice downloads files in the device directory that differ from their local copies.
+// Device directory listing is not recursive, only files directly in devDir are fetched.
+func syncDirFromDevice(ctx context.Context, devConn dev.DevConn, devDir, hostDir string) error {
+	sizes, err := listRemoteSizes(ctx, devConn, devDir)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.MkdirAll(hostDir, 0755); err != nil {
+		return errors.Trace(err)
+	}
+	numSkipped, numGot := 0, 0
+	for name, size := range sizes {
+		devFilename := path.Join(strings.TrimPrefix(devDir, "/"), name)
+		hostFilename := filepath.Join(hostDir, name)
+		local, lerr := ioutil.ReadFile(hostFilename)
+		if lerr == nil && int64(len(local)) == size && *sizeOnlyFlag {
+			glog.V(1).Infof("%s is up to date", hostFilename)
+			numSkipped++
+			continue
+		}
+		ourutil.Reportf("Getting %s -> %s (%d)...", devFilename, hostFilename, size)
+		if *resumeFlag {
+			if err := GetToFile(ctx, devConn, devFilename, hostFilename); err != nil {
+				return errors.Annotatef(err, "%s", devFilename)
+			}
+			numGot++
+			continue
+		}
+		// Contents has to be fetched to be compared anyway, only rewrite the local file if it differs.
+		buf := bytes.NewBuffer(nil)
+		if err := getFileSink(ctx, devConn, devFilename, 0, buf); err != nil {
+			return errors.Annotatef(err, "%s", devFilename)
+		}
+		if lerr == nil && bytes.Equal(buf.Bytes(), local) {
+			numSkipped++
+			continue
+		}
+		if err := ioutil.WriteFile(hostFilename, buf.Bytes(), 0644); err != nil {
+			return errors.Trace(err)
+		}
+		numGot++
+	}
+	ourutil.Reportf("%d files updated, %d up to date", numGot, numSkipped)
+	return nil
+}
@@ -0,0 +1,365 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fs
+
+import (
+	"bytes"
+	"context"
+	"encoding/base64"
+	"io"
+	"io/ioutil"
+	"os"
+	"path"
+
+	"github.com/juju/errors"
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/ourutil"
+	glog "k8s.io/klog/v2"
+)
+
+type getChunk struct {
+	name     string
+	offset   int64
+	length   int64
+	attempts int
+	res      GetResult
+	blob     []byte
+	pc       dev.PendingCall
+	cancel   context.CancelFunc
+}
+
+func (c *getChunk) send(ctx context.Context, devConn dev.DevConn) {
+	var ctx2 context.Context
+	ctx2, c.cancel = context.WithTimeout(ctx, devConn.GetTimeout())
+	c.attempts++
+	glog.V(1).Infof("Getting %s %d @ %d (attempt %d)", c.name, c.length, c.offset, c.attempts)
+	c.res = GetResult{}
+	c.blob = nil
+	args := &GetArgs{
+		Filename: &c.name,
+		Offset:   c.offset,
+		Len:      c.length,
+	}
+	if bdc := dev.GetBlobDevConn(devConn); bdc != nil && *flags.BinaryData {
+		// The device may return the data as an attachment instead of the "data" field.
+		c.pc = bdc.CallAsyncBlob(ctx2, "FS.Get", args, nil, &c.res, &c.blob)
+		return
+	}
+	c.pc = dev.CallAsync(ctx2, devConn, "FS.Get", args, &c.res)
+}
+
+func (c *getChunk) wait() ([]byte, error) {
+	err := c.pc.Wait()
+	c.cancel()
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if c.res.Left == nil {
+		return nil, errors.Errorf("invalid response")
+	}
+	if c.res.Data == nil {
+		if c.blob == nil && *c.res.Left > 0 {
+			return nil, errors.Errorf("invalid response")
+		}
+		return c.blob, nil
+	}
+	return base64.StdEncoding.DecodeString(*c.res.Data)
+}
+
+// getFileSink reads the file starting at offset and writes it to sink.
+// The first chunk is fetched on its own to learn the size of the file,
+// then up to --fs-window chunks are requested at a time.
+func getFileSink(ctx context.Context, devConn dev.DevConn, name string, offset int64, sink io.Writer) error {
+	chunkSize := int64(*flags.ChunkSize)
+	first := &getChunk{name: name, offset: offset, length: chunkSize}
+	var data []byte
+	for {
+		var err error
+		first.send(ctx, devConn)
+		if data, err = first.wait(); err == nil {
+			break
+		}
+		if first.attempts >= *flags.FsOpAttempts {
+			// TODO(dfrank): probably handle out of memory error by retrying with a
+			// smaller chunk size
+			return errors.Trace(err)
+		}
+		glog.Warningf("Error: %s", err)
+	}
+	if _, err := sink.Write(data); err != nil {
+		return errors.Trace(err)
+	}
+	offset += int64(len(data))
+	end := offset + *first.res.Left
+
+	var queue, inFlight []*getChunk
+	for o := offset; o < end; o += chunkSize {
+		l := end - o
+		if l > chunkSize {
+			l = chunkSize
+		}
+		queue = append(queue, &getChunk{name: name, offset: o, length: l})
+	}
+	drain := func() {
+		for _, c := range inFlight {
+			c.cancel()
+			c.pc.Wait()
+		}
+	}
+	window := dev.CallWindow(devConn, *windowFlag)
+	for len(queue) > 0 || len(inFlight) > 0 {
+		for len(inFlight) < window && len(queue) > 0 {
+			c := queue[0]
+			queue = queue[1:]
+			c.send(ctx, devConn)
+			inFlight = append(inFlight, c)
+		}
+		// Chunks are consumed in order, so data reaches the sink sequentially.
+		c := inFlight[0]
+		data, err := c.wait()
+		if err == nil && int64(len(data)) != c.length {
+			err = errors.Errorf("%s: expected %d bytes @ %d, got %d, file changed?", name, c.length, c.offset, len(data))
+			inFlight = inFlight[1:]
+			drain()
+			return err
+		}
+		if err != nil {
+			if c.attempts >= *flags.FsOpAttempts {
+				inFlight = inFlight[1:]
+				drain()
+				return errors.Annotatef(err, "%s: read failed at offset %d", name, c.offset)
+			}
+			// Reads are idempotent, re-request the chunk and wait for it again.
+			glog.Warningf("Error: %s", err)
+			c.send(ctx, devConn)
+			continue
+		}
+		inFlight = inFlight[1:]
+		if _, err := sink.Write(data); err != nil {
+			drain()
+			return errors.Trace(err)
+		}
+	}
+	return nil
+}
+
+// readRemoteRange returns length bytes of the device file at offset.
+func readRemoteRange(ctx context.Context, devConn dev.DevConn, name string, offset, length int64) ([]byte, error) {
+	c := &getChunk{name: name, offset: offset, length: length}
+	c.send(ctx, devConn)
+	data, err := c.wait()
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if int64(len(data)) > length {
+		data = data[:length]
+	}
+	return data, nil
+}
+
+// tailMatches checks that the size bytes of data are likely to be what the device file starts with,
+// by comparing the last chunk.
+func tailMatches(ctx context.Context, devConn dev.DevConn, name string, data []byte, size int64) bool {
+	length := int64(*flags.ChunkSize)
+	if length > size {
+		length = size
+	}
+	remote, err := readRemoteRange(ctx, devConn, name, size-length, length)
+	if err != nil {
+		glog.V(1).Infof("%s: %s", name, err)
+		return false
+	}
+	return bytes.Equal(remote, data[size-length:size])
+}
+
+// GetToFile downloads the device file to a local file.
+// With --fs-resume, an existing partial local file is appended to.
+func GetToFile(ctx context.Context, devConn dev.DevConn, devFilename, hostFilename string) error {
+	var offset int64
+	mode := os.O_CREATE | os.O_WRONLY | os.O_TRUNC
+	if *resumeFlag {
+		if data, err := ioutil.ReadFile(hostFilename); err == nil && len(data) > 0 {
+			if tailMatches(ctx, devConn, devFilename, data, int64(len(data))) {
+				offset = int64(len(data))
+				mode = os.O_WRONLY | os.O_APPEND
+				ourutil.Reportf("Resuming %s from offset %d", hostFilename, offset)
+			}
+		}
+	}
+	f, err := os.OpenFile(hostFilename, mode, 0644)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := getFileSink(ctx, devConn, devFilename, offset, f); err != nil {
+		f.Close()
+		return errors.Trace(err)
+	}
+	return errors.Trace(f.Close())
+}
+
+type PutArgs struct {
+	Filename string `json:"filename"`
+	Offset   int    `json:"offset"`
+	Append   bool   `json:"append"`
+	Data     string `json:"data"`
+}
+
+// PutBlobArgs are the arguments of FS.Put with data carried by the binary attachment.
+type PutBlobArgs struct {
+	Filename string `json:"filename"`
+	Offset   int    `json:"offset"`
+	Append   bool   `json:"append"`
+}
+
+type putChunk struct {
+	offset int
+	data   []byte
+	pc     dev.PendingCall
+	cancel context.CancelFunc
+}
+
+func (c *putChunk) wait() error {
+	err := c.pc.Wait()
+	c.cancel()
+	return err
+}
+
+// remoteFileSize returns the size of the device file, -1 if it does not exist.
+func remoteFileSize(ctx context.Context, devConn dev.DevConn, name string) (int64, error) {
+	dir := path.Dir(name)
+	if dir == "." {
+		dir = "/"
+	}
+	var files []ListExtResult
+	if err := devConn.Call(ctx, "FS.ListExt", &ListExtArgs{Path: &dir}, &files); err != nil {
+		return -1, errors.Trace(err)
+	}
+	base := path.Base(name)
+	for _, f := range files {
+		if f.Name != nil && *f.Name == base && f.Size != nil {
+			return *f.Size, nil
+		}
+	}
+	return -1, nil
+}
+
+// putResumeOffset returns the offset to continue uploading data from
+// if the device file looks like a partial copy of it, 0 otherwise.
+func putResumeOffset(ctx context.Context, devConn dev.DevConn, data []byte, devFilename string) int {
+	size, err := remoteFileSize(ctx, devConn, devFilename)
+	if err != nil || size <= 0 || size > int64(len(data)) {
+		return 0
+	}
+	if !tailMatches(ctx, devConn, devFilename, data, size) {
+		return 0
+	}
+	ourutil.Reportf("Resuming %s from offset %d", devFilename, size)
+	return int(size)
+}
+
+// putChunks sends data starting at offset, keeping up to --fs-window FS.Put requests in flight.
+// On failure it returns the range of offsets the device file size may legitimately have:
+// if any chunk after the failed one succeeded, the file is garbled and the range is empty.
+func putChunks(ctx context.Context, devConn dev.DevConn, data []byte, devFilename string, offset int) (int, int, error) {
+	var inFlight []*putChunk
+	var firstErr error
+	failedStart, failedEnd := 0, -1
+	window := dev.CallWindow(devConn, *windowFlag)
+	var bdc dev.BlobDevConn
+	if *flags.BinaryData {
+		bdc = dev.GetBlobDevConn(devConn)
+	}
+	wait := func() {
+		c := inFlight[0]
+		inFlight = inFlight[1:]
+		err := c.wait()
+		switch {
+		case err != nil && firstErr == nil:
+			firstErr = errors.Annotatef(err, "%s: write failed at offset %d", devFilename, c.offset)
+			failedStart, failedEnd = c.offset, c.offset+len(c.data)
+		case err == nil && firstErr != nil:
+			failedStart, failedEnd = 0, -1
+		}
+	}
+	for offset < len(data) && firstErr == nil {
+		if len(inFlight) == window {
+			wait()
+			continue
+		}
+		n := len(data) - offset
+		if n > *flags.ChunkSize {
+			n = *flags.ChunkSize
+		}
+		c := &putChunk{offset: offset, data: data[offset : offset+n]}
+		var ctx2 context.Context
+		ctx2, c.cancel = context.WithTimeout(ctx, devConn.GetTimeout())
+		glog.V(1).Infof("Sending %s %d @ %d", devFilename, n, offset)
+		// All writes after the first one append to the file.
+		if bdc != nil {
+			c.pc = bdc.CallAsyncBlob(ctx2, "FS.Put", &PutBlobArgs{
+				Filename: devFilename,
+				Offset:   offset,
+				Append:   offset > 0,
+			}, c.data, nil, nil)
+		} else {
+			c.pc = dev.CallAsync(ctx2, devConn, "FS.Put", &PutArgs{
+				Filename: devFilename,
+				Offset:   offset,
+				Append:   offset > 0,
+				Data:     base64.StdEncoding.EncodeToString(c.data),
+			}, nil)
+		}
+		inFlight = append(inFlight, c)
+		offset += n
+	}
+	for len(inFlight) > 0 {
+		wait()
+	}
+	return failedStart, failedEnd, firstErr
+}
+
+// putData uploads data to the device file starting at offset.
+// After a failure, the transfer continues from the size of the partially written file
+// if it is consistent with what was sent, or starts over otherwise.
+func putData(ctx context.Context, devConn dev.DevConn, data []byte, devFilename string, offset int) error {
+	if len(data) == 0 && offset == 0 {
+		// Create an empty file.
+		return errors.Trace(devConn.Call(ctx, "FS.Put", &PutArgs{Filename: devFilename}, nil))
+	}
+	attempts := *flags.FsOpAttempts
+	for offset < len(data) {
+		failedStart, failedEnd, err := putChunks(ctx, devConn, data, devFilename, offset)
+		if err == nil {
+			break
+		}
+		attempts--
+		if attempts <= 0 {
+			return errors.Trace(err)
+		}
+		glog.Warningf("Error: %s", err)
+		offset = 0
+		ctx2, cancel := context.WithTimeout(ctx, devConn.GetTimeout())
+		size, serr := remoteFileSize(ctx2, devConn, devFilename)
+		cancel()
+		if serr == nil && int(size) >= failedStart && int(size) <= failedEnd {
+			offset = int(size)
+		}
+		glog.Infof("%s: continuing from offset %d", devFilename, offset)
+	}
+	return nil
+}
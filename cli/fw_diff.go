@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package main
+
+import (
+	"context"
+
+	"github.com/juju/errors"
+	flag "github.com/spf13/pflag"
+
+	"github.com/mongoose-os/mos/cli/dev"
+	"github.com/mongoose-os/mos/common/fwbundle"
+)
+
+// fwDiff shows which blocks of each part of the new firmware differ from the old firmware,
+// i.e. what has to be written to a device running the old firmware.
+// Filesystem parts are compared in units of the filesystem erase size.
+func fwDiff(ctx context.Context, devConn dev.DevConn) error {
+	if len(flag.Args()) != 3 {
+		return errors.Errorf("old and new firmware files are required")
+	}
+	oldFW, err := fwbundle.ReadZipFirmwareBundle(flag.Args()[1])
+	if err != nil {
+		return errors.Annotatef(err, "failed to read old firmware")
+	}
+	defer oldFW.Cleanup()
+	newFW, err := fwbundle.ReadZipFirmwareBundle(flag.Args()[2])
+	if err != nil {
+		return errors.Annotatef(err, "failed to read new firmware")
+	}
+	defer newFW.Cleanup()
+	totalSize, totalChanged := 0, 0
+	for _, p := range newFW.PartsByAddr() {
+		data, err := p.GetData()
+		if err != nil {
+			// Parts without data (e.g. ones that only reserve space) are not written.
+			reportf("%s: @ 0x%x, no data, skipped (%s)", p.Name, p.Addr, err)
+			continue
+		}
+		totalSize += len(data)
+		op := oldFW.Parts[p.Name]
+		if op == nil || op.Addr != p.Addr || op.ESP32PartitionName != p.ESP32PartitionName || op.FSSize != p.FSSize {
+			reportf("%s: %d @ 0x%x, new or moved", p.Name, len(data), p.Addr)
+			totalChanged += len(data)
+			continue
+		}
+		oldData, err := op.GetData()
+		if err != nil {
+			reportf("%s: %d @ 0x%x, no old data (%s)", p.Name, len(data), p.Addr, err)
+			totalChanged += len(data)
+			continue
+		}
+		ranges := fwbundle.DiffImages(oldData, data, p.DiffBlockSize())
+		changed := 0
+		for _, r := range ranges {
+			changed += r.Len
+		}
+		reportf("%s: %d @ 0x%x, %d changed in %d ranges (block size %d)",
+			p.Name, len(data), p.Addr, changed, len(ranges), p.DiffBlockSize())
+		for _, r := range ranges {
+			reportf("  %7d @ 0x%x", r.Len, p.Addr+uint32(r.Offset))
+		}
+		totalChanged += changed
+	}
+	reportf("Total: %d of %d bytes changed", totalChanged, totalSize)
+	return nil
+}
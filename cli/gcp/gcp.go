@@ -26,6 +26,7 @@ import (
 	"fmt"
 	"os"
 	"path/filepath"
+	"sync"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/atca"
@@ -40,6 +41,30 @@ import (
 	glog "k8s.io/klog/v2"
 )
 
+// The API client is shared by devices provisioned in the same run (see fleet.Provision).
+var (
+	apiClientLock sync.Mutex
+	apiClient     *cloudiot.Service
+)
+
+func getAPIClient(ctx context.Context) (*cloudiot.Service, error) {
+	apiClientLock.Lock()
+	defer apiClientLock.Unlock()
+	if apiClient != nil {
+		return apiClient, nil
+	}
+	httpClient, err := google.DefaultClient(ctx, cloudiot.CloudPlatformScope)
+	if err != nil {
+		return nil, errors.Annotatef(err, "failed to create GCP HTTP client")
+	}
+	c, err := cloudiot.New(httpClient)
+	if err != nil {
+		return nil, errors.Annotatef(err, "failed to create GCP client")
+	}
+	apiClient = c
+	return c, nil
+}
+
 func FileExists(path string) bool {
 	_, err := os.Stat(path)
 	return err == nil
@@ -50,13 +75,9 @@ func GCPIoTSetup(ctx context.Context, devConn dev.DevConn) error {
 		return errors.Errorf("Please set --gcp-project, --gcp-region and --gcp-registry")
 	}
 
-	httpClient, err := google.DefaultClient(ctx, cloudiot.CloudPlatformScope)
+	iotAPIClient, err := getAPIClient(ctx)
 	if err != nil {
-		return errors.Annotatef(err, "failed to create GCP HTTP client")
-	}
-	iotAPIClient, err := cloudiot.New(httpClient)
-	if err != nil {
-		return errors.Annotatef(err, "failed to create GCP client")
+		return errors.Trace(err)
 	}
 
 	ourutil.Reportf("Connecting to the device...")
@@ -0,0 +1,293 @@
+// Copyright (c) 2014-2017 Cesanta Software Limited
+// All rights reserved
+
+package interpreter
+
+import (
+	"strings"
+	"sync"
+
+	"github.com/juju/errors"
+)
+
+// Expressions are parsed into a tree once and cached by their text, since the
+// same conds and ${} expressions are evaluated for every lib of every build.
+// The grammar is:
+//
+//   or      = and { "||" and }
+//   and     = cmp { "&&" cmp }
+//   cmp     = unary [ ( "==" | "!=" ) unary ]
+//   unary   = "!" unary | primary
+//   primary = "(" or ")" | "defined(" name ")" | string | name
+//
+// Strings are double-quoted and can't contain quotes. Names are anything
+// suitable for MosVars.GetVar, e.g. foo.bar.baz.
+
+type exprNode interface {
+	eval(mi *MosInterpreter) (interface{}, error)
+}
+
+type strNode struct {
+	val interface{}
+}
+
+type varNode struct {
+	name string
+}
+
+type definedNode struct {
+	name string
+}
+
+type notNode struct {
+	x exprNode
+}
+
+type cmpNode struct {
+	eq   bool
+	x, y exprNode
+}
+
+type logicNode struct {
+	and  bool
+	x, y exprNode
+}
+
+func (n *strNode) eval(mi *MosInterpreter) (interface{}, error) {
+	return n.val, nil
+}
+
+func (n *varNode) eval(mi *MosInterpreter) (interface{}, error) {
+	val, ok := mi.MVars.GetVar(n.name)
+	if !ok {
+		return nil, errors.Errorf("failed to evaluate %s", n.name)
+	}
+	return val, nil
+}
+
+func (n *definedNode) eval(mi *MosInterpreter) (interface{}, error) {
+	_, ok := mi.MVars.GetVar(n.name)
+	return ok, nil
+}
+
+func (n *notNode) eval(mi *MosInterpreter) (interface{}, error) {
+	x, err := evalBool(mi, n.x)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return !x, nil
+}
+
+func (n *cmpNode) eval(mi *MosInterpreter) (interface{}, error) {
+	x, err := evalString(mi, n.x)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	y, err := evalString(mi, n.y)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return (x == y) == n.eq, nil
+}
+
+func (n *logicNode) eval(mi *MosInterpreter) (interface{}, error) {
+	x, err := evalBool(mi, n.x)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	// Short-circuit, so that e.g. defined(foo) && foo == "bar" works.
+	if x != n.and {
+		return x, nil
+	}
+	y, err := evalBool(mi, n.y)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return y, nil
+}
+
+func evalString(mi *MosInterpreter, n exprNode) (string, error) {
+	val, err := n.eval(mi)
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	s, ok := val.(string)
+	if !ok {
+		return "", errors.Errorf("only strings are allowed, %T given (%s)", val, val)
+	}
+	return s, nil
+}
+
+func evalBool(mi *MosInterpreter, n exprNode) (bool, error) {
+	val, err := n.eval(mi)
+	if err != nil {
+		return false, errors.Trace(err)
+	}
+	b, ok := val.(bool)
+	if !ok {
+		return false, errors.Errorf("expected bool, got %T (%v)", val, val)
+	}
+	return b, nil
+}
+
+type compiledExpr struct {
+	root exprNode
+	err  error
+}
+
+var exprCache sync.Map // string -> *compiledExpr
+
+// compileExpr returns the parsed expression, parsing it on first use.
+func compileExpr(expr string) (exprNode, error) {
+	if ce, ok := exprCache.Load(expr); ok {
+		return ce.(*compiledExpr).root, ce.(*compiledExpr).err
+	}
+	p := &exprParser{expr: expr}
+	root, err := p.parse()
+	ce, _ := exprCache.LoadOrStore(expr, &compiledExpr{root: root, err: err})
+	return ce.(*compiledExpr).root, ce.(*compiledExpr).err
+}
+
+type exprParser struct {
+	expr string
+	pos  int
+}
+
+func (p *exprParser) parse() (exprNode, error) {
+	n, err := p.parseOr()
+	if err == nil && p.skipSpace() < len(p.expr) {
+		err = errors.Errorf("unexpected %q", p.expr[p.pos:])
+	}
+	if err != nil {
+		return nil, errors.Errorf("can't parse the expression %s: %s", p.expr, err)
+	}
+	return n, nil
+}
+
+func (p *exprParser) skipSpace() int {
+	for p.pos < len(p.expr) && isSpace(p.expr[p.pos]) {
+		p.pos++
+	}
+	return p.pos
+}
+
+// accept consumes tok if it is next in the input.
+func (p *exprParser) accept(tok string) bool {
+	p.skipSpace()
+	if strings.HasPrefix(p.expr[p.pos:], tok) {
+		p.pos += len(tok)
+		return true
+	}
+	return false
+}
+
+func (p *exprParser) parseOr() (exprNode, error) {
+	x, err := p.parseAnd()
+	for err == nil && p.accept("||") {
+		var y exprNode
+		y, err = p.parseAnd()
+		x = &logicNode{and: false, x: x, y: y}
+	}
+	return x, err
+}
+
+func (p *exprParser) parseAnd() (exprNode, error) {
+	x, err := p.parseCmp()
+	for err == nil && p.accept("&&") {
+		var y exprNode
+		y, err = p.parseCmp()
+		x = &logicNode{and: true, x: x, y: y}
+	}
+	return x, err
+}
+
+func (p *exprParser) parseCmp() (exprNode, error) {
+	x, err := p.parseUnary()
+	if err != nil {
+		return nil, err
+	}
+	eq := true
+	switch {
+	case p.accept("=="):
+	case p.accept("!="):
+		eq = false
+	default:
+		return x, nil
+	}
+	y, err := p.parseUnary()
+	if err != nil {
+		return nil, err
+	}
+	return &cmpNode{eq: eq, x: x, y: y}, nil
+}
+
+func (p *exprParser) parseUnary() (exprNode, error) {
+	if p.skipSpace(); strings.HasPrefix(p.expr[p.pos:], "!") && !strings.HasPrefix(p.expr[p.pos:], "!=") {
+		p.pos++
+		x, err := p.parseUnary()
+		if err != nil {
+			return nil, err
+		}
+		return &notNode{x: x}, nil
+	}
+	return p.parsePrimary()
+}
+
+func (p *exprParser) parsePrimary() (exprNode, error) {
+	if p.accept("(") {
+		x, err := p.parseOr()
+		if err != nil {
+			return nil, err
+		}
+		if !p.accept(")") {
+			return nil, errors.Errorf("missing )")
+		}
+		return x, nil
+	}
+	word := p.word()
+	switch {
+	case word == "":
+		if p.pos == len(p.expr) {
+			return nil, errors.Errorf("unexpected end")
+		}
+		return nil, errors.Errorf("unexpected %q", p.expr[p.pos:])
+	case word == "defined" && p.accept("("):
+		name := p.word()
+		if name == "" || !p.accept(")") {
+			return nil, errors.Errorf("defined() takes a variable name")
+		}
+		return &definedNode{name: name}, nil
+	case len(word) >= 2 && word[0] == '"' && word[len(word)-1] == '"' && !strings.Contains(word[1:len(word)-1], `"`):
+		return &strNode{val: word[1 : len(word)-1]}, nil
+	}
+	// Anything else is a variable name; like before, malformed operands such as
+	// "foo"bar only fail when evaluated.
+	return &varNode{name: word}, nil
+}
+
+// word consumes an operand: everything up to a space, an operator or a
+// parenthesis, with quoted parts taken as is.
+func (p *exprParser) word() string {
+	p.skipSpace()
+	start := p.pos
+	for p.pos < len(p.expr) {
+		c := p.expr[p.pos]
+		if c == '"' {
+			if i := strings.IndexByte(p.expr[p.pos+1:], '"'); i >= 0 {
+				p.pos += i + 2
+				continue
+			}
+			p.pos = len(p.expr)
+			break
+		}
+		if isSpace(c) || strings.IndexByte("=!&|()", c) >= 0 {
+			break
+		}
+		p.pos++
+	}
+	return p.expr[start:p.pos]
+}
+
+func isSpace(c byte) bool {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+}
@@ -5,17 +5,10 @@ package interpreter
 
 import (
 	"fmt"
-	"regexp"
 
 	"github.com/juju/errors"
 )
 
-var (
-	regexpPart    = regexp.MustCompile(`\s+`)
-	regexpString  = regexp.MustCompile(`^\"[^"]*\"$`)
-	regexpDefined = regexp.MustCompile(`^defined\(\s*([^)]+)\s*\)$`)
-)
-
 // MosInterpreter can evaluate very simple expressions, see EvaluateExpr.
 // Expressions are evaluated against enclosed MosVars.
 type MosInterpreter struct {
@@ -38,62 +31,28 @@ func (mi *MosInterpreter) Copy() *MosInterpreter {
 //
 //   - operand
 //   - operand1 op operand2
+//   - cond1 && cond2, cond1 || cond2, !cond, (cond)
 //
-// Where either operand can be a string like "foo", or an expression
-// suitable for MosVars.GetVar, e.g. foo.bar.baz. Operation can be either
-// == or !=.
+// Where either operand can be a string like "foo", defined(foo.bar), or an
+// expression suitable for MosVars.GetVar, e.g. foo.bar.baz. Operation can be
+// either == or !=, and only strings can be compared. See expr.go for the
+// grammar.
 //
 // Examples:
 //
 //  - arch
 //  - build_vars.FOO_BAR == "foo"
 //  - "bar"
+//  - defined(build_vars.FOO) && build_vars.FOO != "0"
 //
-// In the future it will be hopefully refactored into a proper expression
-// parsing and evaluation, but so far it's a quick hack which solves the
-// problem at hand.
+// Expressions are parsed once and cached, so evaluating the same expression
+// again only does the variable lookups.
 func (mi *MosInterpreter) EvaluateExpr(expr string) (interface{}, error) {
-	parts := regexpPart.Split(expr, -1)
-
-	switch len(parts) {
-	case 1:
-		return mi.evaluatePart(parts[0])
-
-	case 3:
-		operand1, err := mi.evaluatePart(parts[0])
-		if err != nil {
-			return nil, errors.Trace(err)
-		}
-
-		op := parts[1]
-
-		operand2, err := mi.evaluatePart(parts[2])
-		if err != nil {
-			return nil, errors.Trace(err)
-		}
-
-		operand1Str, ok := operand1.(string)
-		if !ok {
-			return nil, errors.Errorf("only strings are allowed, %T given (%s)", operand1, operand1)
-		}
-
-		operand2Str, ok := operand2.(string)
-		if !ok {
-			return nil, errors.Errorf("only strings are allowed, %T given (%s)", operand2, operand2)
-		}
-
-		switch op {
-		case "==":
-			return operand1Str == operand2Str, nil
-		case "!=":
-			return operand1Str != operand2Str, nil
-		default:
-			return nil, errors.Errorf("%q is not a valid operation", op)
-		}
-
-	default:
-		return nil, errors.Errorf("can't parse the expression %s", expr)
+	root, err := compileExpr(expr)
+	if err != nil {
+		return nil, errors.Trace(err)
 	}
+	return root.eval(mi)
 }
 
 // EvaluateExprString calls EvaluateExpr and converts the result to string
@@ -121,22 +80,3 @@ func (mi *MosInterpreter) EvaluateExprBool(expr string) (bool, error) {
 
 	return valBool, nil
 }
-
-func (mi *MosInterpreter) evaluatePart(expr string) (interface{}, error) {
-	if regexpString.MatchString(expr) {
-		// Expression looks like a string
-		return expr[1 : len(expr)-1], nil
-	} else if subexprs := regexpDefined.FindStringSubmatch(expr); subexprs != nil {
-		// Expression looks like "defined(foo)"
-		_, ok := mi.MVars.GetVar(subexprs[1])
-		return ok, nil
-	} else {
-		// Try to get variable value
-		val, ok := mi.MVars.GetVar(expr)
-		if !ok {
-			return nil, errors.Errorf("failed to evaluate %s", expr)
-		}
-
-		return val, nil
-	}
-}
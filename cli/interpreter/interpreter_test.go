@@ -70,6 +70,15 @@ func TestInterpreterBasic(t *testing.T) {
 		interpExpectBool{`defined(foo)`, true, ""},
 		interpExpectBool{`defined(bar.baz.boo)`, true, ""},
 		interpExpectBool{`defined(bar.baz.booo)`, false, ""},
+
+		interpExpectBool{`defined(foo) && foo == "foo_val"`, true, ""},
+		interpExpectBool{`defined(booo) && booo == "x"`, false, ""},
+		interpExpectBool{`foo == "x" || bar.baz.boo == "boo_val"`, true, ""},
+		interpExpectBool{`foo == "x" || foo == "y" && defined(foo)`, false, ""},
+		interpExpectBool{`(foo == "x" || foo == "foo_val") && !defined(booo)`, true, ""},
+		interpExpectBool{`foo == "foo_val" && foo`, false, "expected bool, got string (foo_val)"},
+		interpExpectBool{`foo == "foo_val" &&`, false, "can't parse the expression foo == \"foo_val\" &&: unexpected end"},
+		interpExpectBool{`(foo == "foo_val"`, false, "can't parse the expression (foo == \"foo_val\": missing )"},
 	}
 
 	for _, v := range eb {
@@ -90,3 +99,32 @@ func TestInterpreterBasic(t *testing.T) {
 	}
 
 }
+
+func TestInterpreterCopy(t *testing.T) {
+	mVars := NewMosVars()
+	mVars.SetVar("bar.baz.boo", "boo_val")
+	mi := NewInterpreter(mVars)
+
+	mi2 := mi.Copy()
+	mi2.MVars.SetVar("bar.baz.boo", "boo_val2")
+	mi2.MVars.SetVar("bar.qux", "qux_val")
+
+	for _, v := range []struct {
+		mi     *MosInterpreter
+		expr   string
+		result bool
+	}{
+		{mi, `bar.baz.boo == "boo_val"`, true},
+		{mi, `defined(bar.qux)`, false},
+		{mi2, `bar.baz.boo == "boo_val2"`, true},
+		{mi2, `defined(bar.qux)`, true},
+	} {
+		res, err := v.mi.EvaluateExprBool(v.expr)
+		if err != nil {
+			t.Fatalf("expr %q: %s", v.expr, err)
+		}
+		if res != v.result {
+			t.Fatalf("expr %q: want result %t, got %t", v.expr, v.result, res)
+		}
+	}
+}
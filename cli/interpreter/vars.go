@@ -19,6 +19,8 @@ package interpreter
 import (
 	"fmt"
 	"regexp"
+	"strings"
+	"sync"
 
 	"github.com/juju/errors"
 )
@@ -29,20 +31,62 @@ var (
 	varRegexp = regexp.MustCompile(`\$\{[^}]+\}`)
 )
 
+// varTemplate is a string split into literal text and ${} expressions.
+type varTemplate struct {
+	parts []varTemplatePart
+}
+
+type varTemplatePart struct {
+	// Literal text, or the whole ${...} if expr is not empty.
+	text string
+	expr string
+}
+
+var varTemplateCache sync.Map // string -> *varTemplate
+
+func getVarTemplate(s string) *varTemplate {
+	if t, ok := varTemplateCache.Load(s); ok {
+		return t.(*varTemplate)
+	}
+	t := &varTemplate{}
+	last := 0
+	for _, m := range varRegexp.FindAllStringIndex(s, -1) {
+		if m[0] > last {
+			t.parts = append(t.parts, varTemplatePart{text: s[last:m[0]]})
+		}
+		t.parts = append(t.parts, varTemplatePart{text: s[m[0]:m[1]], expr: s[m[0]+2 : m[1]-1]})
+		last = m[1]
+	}
+	if last < len(s) {
+		t.parts = append(t.parts, varTemplatePart{text: s[last:]})
+	}
+	tt, _ := varTemplateCache.LoadOrStore(s, t)
+	return tt.(*varTemplate)
+}
+
 func ExpandVars(interp *MosInterpreter, s string, skipFailed bool) (string, error) {
+	// Most manifest strings have nothing to expand.
+	if !strings.Contains(s, "${") {
+		return s, nil
+	}
 	var errRet error
-	result := varRegexp.ReplaceAllStringFunc(s, func(v string) string {
-		expr := v[2 : len(v)-1]
-		val, err := interp.EvaluateExprString(expr)
+	var sb strings.Builder
+	for _, p := range getVarTemplate(s).parts {
+		if p.expr == "" {
+			sb.WriteString(p.text)
+			continue
+		}
+		val, err := interp.EvaluateExprString(p.expr)
 		if err != nil {
 			if skipFailed {
-				return v
+				sb.WriteString(p.text)
+				continue
 			}
 			errRet = errors.Annotatef(err, "expanding expressions in %q", s)
 		}
-		return val
-	})
-	return result, errRet
+		sb.WriteString(val)
+	}
+	return sb.String(), errRet
 }
 
 func ExpandVarsSlice(interp *MosInterpreter, slice []string, skipFailed bool) ([]string, error) {
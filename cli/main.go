@@ -27,6 +27,7 @@ import (
 	"math/big"
 	mRand "math/rand"
 	"os"
+	"runtime/trace"
 	"strings"
 	"time"
 
@@ -42,9 +43,13 @@ import (
 	"github.com/mongoose-os/mos/cli/common/state"
 	"github.com/mongoose-os/mos/cli/config"
 	"github.com/mongoose-os/mos/cli/create_fw_bundle"
+	"github.com/mongoose-os/mos/cli/daemon"
 	"github.com/mongoose-os/mos/cli/debug_core_dump"
 	"github.com/mongoose-os/mos/cli/dev"
 	"github.com/mongoose-os/mos/cli/devutil"
+	"github.com/mongoose-os/mos/cli/emulator"
+	"github.com/mongoose-os/mos/cli/flags"
+	"github.com/mongoose-os/mos/cli/fleet"
 	"github.com/mongoose-os/mos/cli/fs"
 	"github.com/mongoose-os/mos/cli/gcp"
 	license "github.com/mongoose-os/mos/cli/license_cmd"
@@ -52,6 +57,7 @@ import (
 	"github.com/mongoose-os/mos/cli/ota"
 	"github.com/mongoose-os/mos/cli/update"
 	"github.com/mongoose-os/mos/cli/watson"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
 	"github.com/mongoose-os/mos/common/pflagenv"
 	"github.com/mongoose-os/mos/version"
 )
@@ -77,6 +83,8 @@ var (
 
 	helpFull = flag.Bool("full", false, "Show full help, including advanced flags")
 
+	probePorts = flag.Bool("probe", false, "With ports: identify devices on the ports (arch, MAC, device ID)")
+
 	isUI = false
 )
 
@@ -95,6 +103,44 @@ type command struct {
 	extended    bool
 }
 
+// Commands that only talk to the device and do not use local state or migrated data.
+// Initialization of those is skipped to make scripted invocations start faster.
+var deviceOnlyCommands = map[string]bool{
+	"call":       true,
+	"config-get": true,
+	"config-set": true,
+	"get":        true,
+	"ls":         true,
+	"put":        true,
+	"rm":         true,
+	"version":    true,
+	"wifi":       true,
+}
+
+type startupPhase struct {
+	name string
+	at   time.Duration
+}
+
+// Startup phases reported by --startup-trace.
+var (
+	startTime     = time.Now()
+	startupPhases []startupPhase
+)
+
+// traceStartup records the end of a startup phase.
+func traceStartup(name string) {
+	startupPhases = append(startupPhases, startupPhase{name, time.Since(startTime)})
+}
+
+func printStartupTrace() {
+	prev := time.Duration(0)
+	for _, p := range startupPhases {
+		fmt.Fprintf(os.Stderr, "%-12s %10s %10s\n", p.name, (p.at - prev).Round(time.Microsecond), p.at.Round(time.Microsecond))
+		prev = p.at
+	}
+}
+
 type YesNoMaybe float32
 
 const (
@@ -119,22 +165,25 @@ func init() {
 		{"build", buildHandler, `Build a firmware from the sources located in the current directory`, nil, []string{"arch", "platform", "local", "repo", "clean", "server"}, No, false},
 		{"clone", clone.Clone, `Clone a repo`, nil, []string{}, No, false},
 		{"flash", flash, `Flash firmware to the device`, nil, []string{"port", "firmware"}, Maybe, false},
-		{"flash-read", flashRead, `Read a region of flash`, []string{"platform"}, []string{"port"}, No, false},
+		{"flash-read", flashRead, `Read a region of flash`, []string{"platform"}, []string{"port", "esp-flash-read-window"}, No, false},
 		{"flash-write", flashWrite, `Write a region of flash`, []string{"platform"}, []string{"port"}, No, false},
 		{"console", console, `Simple serial port console`, nil, []string{"port"}, No, false}, //TODO: needDevConn
 		{"ls", fs.Ls, `List files at the local device's filesystem`, nil, []string{"port"}, Yes, false},
-		{"get", fs.Get, `Read file from the local device's filesystem and print to stdout`, nil, []string{"port"}, Yes, false},
-		{"put", fs.Put, `Put file from the host machine to the local device's filesystem`, nil, []string{"port"}, Yes, false},
+		{"get", fs.Get, `Read file from the local device's filesystem and print to stdout or save to a file. If device path ends with /, sync directory contents`, nil, []string{"port", "fs-window", "fs-resume", "fs-sync-size-only"}, Yes, false},
+		{"put", fs.Put, `Put file or directory from the host machine to the local device's filesystem`, nil, []string{"port", "fs-window", "fs-resume", "fs-sync-size-only"}, Yes, false},
 		{"rm", fs.Rm, `Delete a file from the device's filesystem`, nil, []string{"port"}, Yes, false},
-		{"ota", ota.OTA, `Perform an OTA update on a device`, nil, []string{"port"}, Yes, false},
+		{"ota", ota.OTA, `Perform an OTA update on a device`, nil, []string{"port", "ota-window"}, Yes, false},
 		{"config-get", config.Get, `Get config value from the locally attached device`, nil, []string{"port"}, Yes, false},
 		{"config-set", config.Set, `Set config value at the locally attached device`, nil, []string{"port"}, Yes, false},
 		{"call", call, `Perform a device API call. "mos call RPC.List" shows available methods`, nil, []string{"port"}, Yes, false},
+		{"daemon", daemon.Daemon, `Keep device connections open and serve requests of other mos invocations started with --daemon`, nil, []string{"daemon-addr", "daemon-idle-timeout", "daemon-metrics-addr", "daemon-token-file", "port"}, No, false},
+		{"emulator", emulator.Emulator, `Run an in-memory device emulator for throughput testing`, nil, []string{"emulator-addr", "emulator-baud-rate", "emulator-latency", "emulator-esp-addr", "emulator-esp-chip", "emulator-esp-flash-size"}, No, true},
+		{"fleet", fleet.Fleet, `Call an RPC service on many devices listed in the --targets file`, nil, []string{"targets", "fleet-concurrency", "fleet-rate", "timeout"}, No, false},
 		{"create-fw-bundle", create_fw_bundle.CreateFWBundle, `Create or modify a firmware ZIP bundle from disparate parts.`, nil, nil, No, false},
 		{"debug-core-dump", debug_core_dump.DebugCoreDump, `Debug a core dump`, nil, nil, No, false},
-		{"aws-iot-setup", aws.AWSIoTSetup, `Provision the device for AWS IoT cloud`, nil, []string{"atca-slot", "aws-region", "port", "use-atca"}, Yes, false},
-		{"azure-iot-setup", azure.AzureIoTSetup, `Provision the device for Azure IoT Hub`, nil, []string{"atca-slot", "azure-auth-file", "port", "use-atca"}, Yes, false},
-		{"gcp-iot-setup", gcp.GCPIoTSetup, `Provision the device for Google IoT Core`, nil, []string{"atca-slot", "gcp-region", "port", "use-atca", "registry"}, Yes, false},
+		{"aws-iot-setup", fleet.Provision(aws.AWSIoTSetup, "aws-cert-file", "aws-key-file"), `Provision the device for AWS IoT cloud`, nil, []string{"atca-slot", "aws-region", "port", "use-atca", "targets", "fleet-concurrency"}, Maybe, false},
+		{"azure-iot-setup", fleet.Provision(azure.AzureIoTSetup, "azure-device-id", "azure-cert-file", "azure-key-file"), `Provision the device for Azure IoT Hub`, nil, []string{"atca-slot", "azure-auth-file", "port", "use-atca", "targets", "fleet-concurrency"}, Maybe, false},
+		{"gcp-iot-setup", fleet.Provision(gcp.GCPIoTSetup, "gcp-cert-file", "gcp-key-file"), `Provision the device for Google IoT Core`, nil, []string{"atca-slot", "gcp-region", "port", "use-atca", "registry", "targets", "fleet-concurrency"}, Maybe, false},
 		{"watson-iot-setup", watson.WatsonIoTSetup, `Provision the device for IBM Watson IoT Platform`, nil, []string{}, Yes, false},
 		{"mdash-setup", mdash.MdashSetup, `Provision the device for mDash`, nil, []string{"port"}, Yes, false},
 		{"update", update.Update, `Self-update mos tool; optionally update channel can be given (e.g. "latest", "release", or some exact version)`, nil, nil, No, false},
@@ -157,9 +206,10 @@ func init() {
 		{"esp32-efuse-set", esp32EFuseSet, `Set ESP32 eFuses`, nil, nil, No, true},
 		{"esp32-encrypt-image", esp32EncryptImage, `Encrypt a ESP32 firmware image`, []string{"esp32-encryption-key-file", "esp32-flash-address"}, nil, No, true},
 		{"esp32-gen-key", esp32GenKey, `Generate and program an encryption key`, nil, nil, No, true},
+		{"fw-diff", fwDiff, `Show which blocks of the firmware parts differ between two firmware bundles`, nil, nil, No, true},
 		{"eval-manifest-expr", evalManifestExpr, `Evaluate the expression against the final manifest`, nil, nil, No, true},
 		{"git-credentials", gitCredentials, `Git credentials helper mode`, nil, nil, No, true},
-		{"ports", showPorts, `Show serial ports`, nil, nil, No, true},
+		{"ports", showPorts, `Show serial ports`, nil, []string{"probe", "port-probe-timeout"}, No, true},
 	}
 }
 
@@ -178,7 +228,14 @@ func showVersion(ctx context.Context, devConn dev.DevConn) error {
 }
 
 func showPorts(ctx context.Context, devConn dev.DevConn) error {
-	fmt.Printf("%s\n", strings.Join(devutil.EnumerateSerialPorts(), "\n"))
+	ports := devutil.EnumerateSerialPorts()
+	if !*probePorts {
+		fmt.Printf("%s\n", strings.Join(ports, "\n"))
+		return nil
+	}
+	for _, sd := range devutil.ProbePorts(ctx, ports) {
+		fmt.Printf("%s\n", devutil.FormatSerialDevice(&sd))
+	}
 	return nil
 }
 
@@ -254,43 +311,58 @@ func main() {
 
 	pflagenv.Parse(envPrefix)
 
+	if err := startProfiling(); err != nil {
+		log.Fatal(err)
+	}
+
 	glog.Infof("Version: %s", version.Version)
 	glog.Infof("Build ID: %s", version.BuildId)
 	glog.Infof("Update channel: %s", update.GetUpdateChannel())
 
-	if err := paths.Init(); err != nil {
-		log.Fatal(err)
-	}
-
-	if err := state.Init(); err != nil {
-		log.Fatal(err)
-	}
+	traceStartup("flags")
 
-	if err := update.Init(); err != nil {
+	if err := paths.Init(); err != nil {
 		log.Fatal(err)
 	}
 
-	consoleInit()
+	traceStartup("paths")
 
 	if len(flag.Args()) == 0 || flag.Arg(0) == "ui" {
 		isUI = true
 		aws.IsUI = true
 	}
 
-	ctx := context.Background()
-	var devConn dev.DevConn
-
 	cmd := &commands[0]
 	if !isUI {
 		cmd = getCommand(flag.Arg(0))
 	}
+
+	if cmd == nil || !deviceOnlyCommands[cmd.name] {
+		if err := state.Init(); err != nil {
+			log.Fatal(err)
+		}
+
+		if err := update.Init(); err != nil {
+			log.Fatal(err)
+		}
+
+		traceStartup("state")
+	}
+
+	consoleInit()
+
+	ctx := context.Background()
+	var devConn dev.DevConn
+
 	if cmd != nil && cmd.needDevConn == Yes {
 		var err error
 		devConn, err = devutil.CreateDevConnFromFlags(ctx)
 		if err != nil {
 			fmt.Println(errors.Trace(err))
+			stopProfiling()
 			os.Exit(1)
 		}
+		traceStartup("connect")
 	}
 
 	if cmd == nil {
@@ -298,10 +370,21 @@ func main() {
 		os.Exit(1)
 	}
 
+	ctx, task := trace.NewTask(ctx, cmd.name)
 	err := run(cmd, ctx, devConn)
+	task.End()
+	traceStartup("run")
+	update.WaitMigration()
 	if devConn != nil {
 		devConn.Disconnect(context.Background())
 	}
+	if *flags.Stats {
+		stats.WriteSummary(os.Stderr)
+	}
+	if *flags.StartupTrace {
+		printStartupTrace()
+	}
+	stopProfiling()
 	if err != nil {
 		glog.Infof("Error: %+v", errors.ErrorStack(err))
 		fmt.Fprintf(os.Stderr, "Error: %s\n", errors.ErrorStack(err))
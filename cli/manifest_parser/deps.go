@@ -20,34 +20,141 @@ import (
 	"sort"
 )
 
+// Deps is a dependency graph of named nodes. Nodes are numbered in the order
+// they are first mentioned, and dependencies are kept as slices of node
+// numbers.
+//
+// Each node also has a level: 0 for nodes without dependencies, otherwise one
+// more than the highest level of its dependencies. Levels are updated as
+// dependencies are added, which also detects cycles as soon as they appear.
 type Deps struct {
-	m map[string][]string
-	// We need to use a separate map for existence, because m might contain
-	// optional dependencies
-	exists map[string]struct{}
+	ids   map[string]int
+	names []string
+	deps  [][]int
+	// Reverse dependencies, used to update levels.
+	rdeps [][]int
+	level []int
+	// Whether the node was added with AddNode or has dependencies. A node that
+	// is only mentioned as a dependency is optional and does not exist.
+	listed []bool
+	exists []bool
+
+	// The first cycle found by AddDep, node names starting and ending with
+	// the same node.
+	cycle []string
+	// Topological orders, computed on demand: with and without optional deps.
+	topo [2][]string
 }
 
 func NewDeps() *Deps {
 	return &Deps{
-		m:      make(map[string][]string),
-		exists: make(map[string]struct{}),
+		ids: make(map[string]int),
+	}
+}
+
+func (d *Deps) id(node string) int {
+	if id, ok := d.ids[node]; ok {
+		return id
 	}
+	id := len(d.names)
+	d.ids[node] = id
+	d.names = append(d.names, node)
+	d.deps = append(d.deps, nil)
+	d.rdeps = append(d.rdeps, nil)
+	d.level = append(d.level, 0)
+	d.listed = append(d.listed, false)
+	d.exists = append(d.exists, false)
+	return id
+}
+
+func (d *Deps) changed() {
+	d.topo = [2][]string{}
 }
 
 func (d *Deps) AddNode(node string) {
-	if _, ok := d.m[node]; !ok {
-		d.m[node] = []string{}
+	id := d.id(node)
+	if !d.listed[id] || !d.exists[id] {
+		d.changed()
 	}
-	d.exists[node] = struct{}{}
+	d.listed[id] = true
+	d.exists[id] = true
 }
 
 func (d *Deps) AddDep(node string, dep string) {
-	for _, d := range d.m[node] {
-		if d == dep {
+	id := d.id(node)
+	depID := d.id(dep)
+	if !d.listed[id] {
+		d.listed[id] = true
+		d.changed()
+	}
+	for _, did := range d.deps[id] {
+		if did == depID {
 			return
 		}
 	}
-	d.m[node] = append(d.m[node], dep)
+	d.deps[id] = append(d.deps[id], depID)
+	d.rdeps[depID] = append(d.rdeps[depID], id)
+	d.changed()
+	if d.cycle == nil {
+		d.raiseLevels(id, depID)
+	}
+}
+
+// raiseLevels restores the level invariant after adding a dependency of node
+// on dep: the level of node and of everything depending on it must be higher
+// than that of dep. If that requires raising dep itself, there is a cycle.
+func (d *Deps) raiseLevels(node, dep int) {
+	if node == dep {
+		d.cycle = []string{d.names[node], d.names[node]}
+		return
+	}
+	if d.level[node] > d.level[dep] {
+		return
+	}
+	d.level[node] = d.level[dep] + 1
+	queue := []int{node}
+	for len(queue) > 0 {
+		x := queue[0]
+		queue = queue[1:]
+		for _, y := range d.rdeps[x] {
+			if y == dep {
+				d.cycle = d.findCycle(node, dep)
+				return
+			}
+			if d.level[y] <= d.level[x] {
+				d.level[y] = d.level[x] + 1
+				queue = append(queue, y)
+			}
+		}
+	}
+}
+
+// findCycle returns the cycle created by the dependency of node on dep:
+// node, dep, ..., node.
+func (d *Deps) findCycle(node, dep int) []string {
+	visited := make([]bool, len(d.names))
+	var path []int
+	var find func(x int) bool
+	find = func(x int) bool {
+		path = append(path, x)
+		if x == node {
+			return true
+		}
+		visited[x] = true
+		for _, y := range d.deps[x] {
+			if !visited[y] && find(y) {
+				return true
+			}
+		}
+		path = path[:len(path)-1]
+		return false
+	}
+	find(dep)
+	cycle := []string{d.names[node]}
+	for _, x := range path {
+		cycle = append(cycle, d.names[x])
+	}
+	return cycle
 }
 
 func (d *Deps) AddDeps(node string, deps []string) {
@@ -57,8 +164,36 @@ func (d *Deps) AddDeps(node string, deps []string) {
 }
 
 func (d *Deps) RemoveNode(node string) {
-	delete(d.m, node)
-	delete(d.exists, node)
+	id, ok := d.ids[node]
+	if !ok {
+		return
+	}
+	for _, did := range d.deps[id] {
+		rd := d.rdeps[did][:0]
+		for _, x := range d.rdeps[did] {
+			if x != id {
+				rd = append(rd, x)
+			}
+		}
+		d.rdeps[did] = rd
+	}
+	d.deps[id] = nil
+	d.listed[id] = false
+	d.exists[id] = false
+	d.changed()
+
+	// Removing a dependency can break a cycle and lower levels, recompute.
+	d.cycle = nil
+	for i := range d.level {
+		d.level[i] = 0
+	}
+	for x := range d.deps {
+		for _, y := range d.deps[x] {
+			if d.cycle == nil {
+				d.raiseLevels(x, y)
+			}
+		}
+	}
 }
 
 func (d *Deps) AddNodeWithDeps(node string, deps []string) {
@@ -70,115 +205,120 @@ func (d *Deps) AddNodeWithDeps(node string, deps []string) {
 
 func (d *Deps) GetNodes() []string {
 	var nodes []string
-	for n, _ := range d.m {
-		nodes = append(nodes, n)
+	for id, n := range d.names {
+		if d.listed[id] {
+			nodes = append(nodes, n)
+		}
 	}
 	return nodes
 }
 
+// GetDeps returns dependencies of the node in the order they were added.
 func (d *Deps) GetDeps(node string) []string {
-	return d.m[node]
+	id, ok := d.ids[node]
+	if !ok || !d.listed[id] {
+		return nil
+	}
+	ret := make([]string, 0, len(d.deps[id]))
+	for _, did := range d.deps[id] {
+		ret = append(ret, d.names[did])
+	}
+	return ret
 }
 
 func (d *Deps) NodeExists(node string) bool {
-	_, ok := d.exists[node]
-	return ok
+	id, ok := d.ids[node]
+	return ok && d.exists[id]
+}
+
+// Levels returns nodes grouped by level, lowest first. Nodes on the same
+// level do not depend on each other, and depend only on nodes from lower
+// levels. If skipOptDeps is true, optional dependencies are not included.
+// Returns nil if there is a dependency cycle.
+func (d *Deps) Levels(skipOptDeps bool) [][]string {
+	if d.cycle != nil {
+		return nil
+	}
+	var levels [][]string
+	for id, n := range d.names {
+		if skipOptDeps && !d.exists[id] {
+			continue
+		}
+		for len(levels) <= d.level[id] {
+			levels = append(levels, nil)
+		}
+		levels[d.level[id]] = append(levels[d.level[id]], n)
+	}
+	// Optional deps and removed nodes can leave some levels empty.
+	ret := levels[:0]
+	for _, l := range levels {
+		if len(l) > 0 {
+			sort.Strings(l)
+			ret = append(ret, l)
+		}
+	}
+	return ret
 }
 
 // Topological returns a slice of node names in the topological order. If
 // skipOptDeps is true, optional dependencies are not present in the resulting
 // slice (dependency is optional if it's mentioned as a dependency for some
 // node, but not present as a node itself).
+//
+// The order is computed once and reused until the graph changes.
 func (d *Deps) Topological(skipOptDeps bool) (topo []string, cycle []string) {
-	dfo := &depthFirstOrder{
-		marked:  map[string]bool{},
-		onStack: map[string]bool{},
-		names:   []string{},
-		cycle:   nil,
+	if d.cycle != nil {
+		return nil, append([]string(nil), d.cycle...)
+	}
+	ti := 0
+	if skipOptDeps {
+		ti = 1
+	}
+	if d.topo[ti] == nil {
+		d.topo[ti] = d.topological(skipOptDeps)
 	}
+	topo = make([]string, len(d.topo[ti]))
+	copy(topo, d.topo[ti])
+	return topo, nil
+}
 
+func (d *Deps) topological(skipOptDeps bool) []string {
 	// It's not actually necessary to sort nodes, the resulting topological
 	// order will be correct without it as well, but the result will not be
 	// always the same.
 	//
 	// We'd rather want the same output given the same depencency graph, so
-	// let's sort nodes.
-	keys := make([]string, len(d.m))
-	i := 0
-	for k, _ := range d.m {
-		sort.Strings(d.m[k])
-		keys[i] = k
-		i++
-	}
-	sort.Strings(keys)
-
-	for _, k := range keys {
-		if !dfo.marked[k] {
-			dfo.depthFirstSearch(d, k, skipOptDeps)
-			if dfo.cycle != nil {
-				reverse(dfo.cycle)
-				return nil, dfo.cycle
-			}
-		}
+	// let's visit nodes and their deps in the order of their names.
+	byName := func(ids []int) []int {
+		ret := append([]int(nil), ids...)
+		sort.Slice(ret, func(i, j int) bool { return d.names[ret[i]] < d.names[ret[j]] })
+		return ret
 	}
-
-	ret := dfo.names
-
-	// Remove optional deps from the resulting slice
-	if skipOptDeps {
-		ret = []string{}
-		for _, n := range dfo.names {
-			if d.NodeExists(n) {
-				ret = append(ret, n)
-			}
+	var roots []int
+	for id := range d.names {
+		if d.listed[id] {
+			roots = append(roots, id)
 		}
 	}
 
-	return ret, nil
-}
-
-type depthFirstOrder struct {
-	marked  map[string]bool
-	onStack map[string]bool
-	names   []string
-	cycle   []string
-}
-
-func (dfo *depthFirstOrder) depthFirstSearch(d *Deps, name string, skipOptDeps bool) {
-	dfo.onStack[name] = true
-	defer func() { dfo.onStack[name] = false }()
-
-	dfo.marked[name] = true
-
-	for _, k := range d.m[name] {
-
-		if !dfo.marked[k] {
-			dfo.depthFirstSearch(d, k, skipOptDeps)
-			if dfo.cycle != nil {
-				// Dependency cycle was already detected, so we're not going to
-				// continue. But before returning, check if first and last items of a
-				// cycle are equal. If not, the cycle is not yet completed, so add a
-				// current item there
-				if dfo.cycle[0] != dfo.cycle[len(dfo.cycle)-1] {
-					dfo.cycle = append(dfo.cycle, name)
-				}
-				return
+	marked := make([]bool, len(d.names))
+	names := []string{}
+	var visit func(id int)
+	visit = func(id int) {
+		marked[id] = true
+		for _, did := range byName(d.deps[id]) {
+			if !marked[did] {
+				visit(did)
 			}
-		} else if dfo.onStack[k] {
-			// Dependency graph is not a DAG (i.e. it has a directed cycle), so
-			// it's impossible to sort nodes topologically. Start building a cycle
-			// slice and return.
-			dfo.cycle = []string{k, name}
-			return
+		}
+		if !skipOptDeps || d.exists[id] {
+			names = append(names, d.names[id])
 		}
 	}
-
-	dfo.names = append(dfo.names, name)
-}
-
-func reverse(s []string) {
-	last := len(s) - 1
-	for i := 0; i < len(s)/2; i++ {
-		s[i], s[last-i] = s[last-i], s[i]
+	for _, id := range byName(roots) {
+		if !marked[id] {
+			visit(id)
+		}
 	}
+	return names
 }
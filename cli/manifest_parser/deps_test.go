@@ -77,6 +77,29 @@ func TestDeps(t *testing.T) {
 	}
 }
 
+func TestDepsLevels(t *testing.T) {
+	deps := NewDeps()
+
+	deps.AddNodeWithDeps("subbar", nil)
+	deps.AddNodeWithDeps("app", []string{"bar", "foo"})
+	deps.AddNodeWithDeps("foo", []string{"bar", "baz"})
+	deps.AddNodeWithDeps("bar", []string{"subbar"})
+
+	want := [][]string{{"baz", "subbar"}, {"bar"}, {"foo"}, {"app"}}
+	if got := deps.Levels(false); !reflect.DeepEqual(want, got) {
+		t.Fatalf("want: %q, got: %q", want, got)
+	}
+	want = [][]string{{"subbar"}, {"bar"}, {"foo"}, {"app"}}
+	if got := deps.Levels(true); !reflect.DeepEqual(want, got) {
+		t.Fatalf("want: %q, got: %q", want, got)
+	}
+
+	deps.AddDep("subbar", "app")
+	if got := deps.Levels(true); got != nil {
+		t.Fatalf("want nil levels with a cycle, got: %q", got)
+	}
+}
+
 func TestDepsRandom(t *testing.T) {
 	for i := 10; i < 100; i++ {
 		d := generateDepsDAG(i)
@@ -84,7 +107,7 @@ func TestDepsRandom(t *testing.T) {
 			t.Fatal(err)
 		}
 
-		//fmt.Printf("nodes: %v\n", d.m)
+		//fmt.Printf("nodes: %v\n", depsMap(d))
 		//for j := 0; j < 10; j++ {
 		//topo, _ := d.Topological(true)
 		//fmt.Printf("topo #%d: %v\n", j, topo)
@@ -97,7 +120,7 @@ func TestDepsRandom(t *testing.T) {
 
 		topo, cycle := d.Topological(true)
 		if topo != nil {
-			t.Fatalf("nodes: %v, topo: %v, there is a cycle from %d to %d, so topo should be nil", d.m, topo, n, n)
+			t.Fatalf("nodes: %v, topo: %v, there is a cycle from %d to %d, so topo should be nil", depsMap(d), topo, n, n)
 		}
 
 		if err := checkCycle(cycle, []string{sn}); err != nil {
@@ -136,8 +159,16 @@ func randInt(min int, max int) int {
 	return min + rand.Intn(max-min)
 }
 
+func depsMap(d *Deps) map[string][]string {
+	ret := map[string][]string{}
+	for _, n := range d.GetNodes() {
+		ret[n] = d.GetDeps(n)
+	}
+	return ret
+}
+
 func tryDeps(d *Deps) error {
-	nodes := d.m
+	nodes := depsMap(d)
 
 	skipOptDeps := true
 
@@ -164,6 +195,24 @@ func tryDeps(d *Deps) error {
 		}
 	}
 
+	// Check that deps are on lower levels
+	levelOf := map[string]int{}
+	for i, l := range d.Levels(false) {
+		for _, n := range l {
+			levelOf[n] = i
+		}
+	}
+	for node, deps := range nodes {
+		for _, dep := range deps {
+			if levelOf[dep] >= levelOf[node] {
+				return errors.Errorf(
+					"nodes: %v, %q (level %d) is a dep of %q (level %d) and should be on a lower level",
+					nodes, dep, levelOf[dep], node, levelOf[node],
+				)
+			}
+		}
+	}
+
 	if skipOptDeps {
 		// Check that topological slice does not contain extra items
 		for _, cur := range topo {
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package manifest_parser
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"runtime"
+	"strings"
+)
+
+// dirListing is the contents of a directory, names are sorted.
+type dirListing struct {
+	names []string
+	isDir map[string]bool
+	err   error
+}
+
+// dirIndex resolves paths and globs reading each directory only once.
+// It assumes the tree does not change while it is used, and is not safe for concurrent use.
+type dirIndex struct {
+	cwd  string
+	dirs map[string]*dirListing
+}
+
+func newDirIndex() *dirIndex {
+	cwd, _ := os.Getwd()
+	return &dirIndex{cwd: cwd, dirs: make(map[string]*dirListing)}
+}
+
+func (idx *dirIndex) list(dir string) *dirListing {
+	key := filepath.Clean(dir)
+	if !filepath.IsAbs(key) {
+		key = filepath.Join(idx.cwd, key)
+	}
+	if l, ok := idx.dirs[key]; ok {
+		return l
+	}
+	l := &dirListing{isDir: make(map[string]bool)}
+	fis, err := ioutil.ReadDir(key)
+	if err != nil {
+		l.err = err
+	}
+	for _, fi := range fis {
+		isDir := fi.IsDir()
+		if fi.Mode()&os.ModeSymlink != 0 {
+			if sfi, err := os.Stat(filepath.Join(key, fi.Name())); err == nil {
+				isDir = sfi.IsDir()
+			}
+		}
+		l.names = append(l.names, fi.Name())
+		l.isDir[fi.Name()] = isDir
+	}
+	idx.dirs[key] = l
+	return l
+}
+
+// stat returns whether the path exists and is a directory, same as os.Stat would.
+// Paths that are not found in the index are checked with os.Stat,
+// to get the same errors and to handle case-insensitive file systems.
+func (idx *dirIndex) stat(path string) (bool, error) {
+	p := filepath.Clean(path)
+	parent, name := filepath.Split(p)
+	if name != "" && name != "." && name != ".." {
+		l := idx.list(parent)
+		if isDir, ok := l.isDir[name]; ok && l.err == nil {
+			return isDir, nil
+		}
+	}
+	fi, err := os.Stat(path)
+	if err != nil {
+		return false, err
+	}
+	return fi.IsDir(), nil
+}
+
+func (idx *dirIndex) exists(path string) bool {
+	p := filepath.Clean(path)
+	parent, name := filepath.Split(p)
+	if name != "" && name != "." && name != ".." {
+		l := idx.list(parent)
+		if _, ok := l.isDir[name]; ok && l.err == nil {
+			return true
+		}
+	}
+	_, err := os.Lstat(path)
+	return err == nil
+}
+
+func hasGlobMeta(path string) bool {
+	magicChars := `*?[`
+	if runtime.GOOS != "windows" {
+		magicChars = `*?[\`
+	}
+	return strings.ContainsAny(path, magicChars)
+}
+
+// glob is filepath.Glob that uses the index instead of reading directories.
+func (idx *dirIndex) glob(pattern string) ([]string, error) {
+	// Check pattern is well-formed.
+	if _, err := filepath.Match(pattern, ""); err != nil {
+		return nil, err
+	}
+	if !hasGlobMeta(pattern) {
+		if !idx.exists(pattern) {
+			return nil, nil
+		}
+		return []string{pattern}, nil
+	}
+	dir, file := filepath.Split(pattern)
+	volumeLen := len(filepath.VolumeName(dir))
+	switch dir[volumeLen:] {
+	case "":
+		dir += "."
+	case string(filepath.Separator):
+	default:
+		// Chop off trailing separator.
+		dir = dir[:len(dir)-1]
+	}
+	if !hasGlobMeta(dir[volumeLen:]) {
+		return idx.globDir(dir, file, nil)
+	}
+	// Prevent infinite recursion.
+	if dir == pattern {
+		return nil, filepath.ErrBadPattern
+	}
+	dirs, err := idx.glob(dir)
+	if err != nil {
+		return nil, err
+	}
+	var matches []string
+	for _, d := range dirs {
+		if matches, err = idx.globDir(d, file, matches); err != nil {
+			return nil, err
+		}
+	}
+	return matches, nil
+}
+
+func (idx *dirIndex) globDir(dir, pattern string, matches []string) ([]string, error) {
+	if isDir, err := idx.stat(dir); err != nil || !isDir {
+		return matches, nil
+	}
+	for _, n := range idx.list(dir).names {
+		matched, err := filepath.Match(pattern, n)
+		if err != nil {
+			return matches, err
+		}
+		if matched {
+			matches = append(matches, filepath.Join(dir, n))
+		}
+	}
+	return matches, nil
+}
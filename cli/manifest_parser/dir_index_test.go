@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package manifest_parser
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+)
+
+func TestDirIndexGlob(t *testing.T) {
+	dir, err := ioutil.TempDir("", "dir_index")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	for _, f := range []string{"a/x.c", "a/y.cpp", "a/b/z.c", "c/x.c", "c/d/e.h", "f.c"} {
+		fn := filepath.Join(dir, filepath.FromSlash(f))
+		os.MkdirAll(filepath.Dir(fn), 0755)
+		if err := ioutil.WriteFile(fn, nil, 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	idx := newDirIndex()
+	for _, p := range []string{"*", "*.c", "a/*.c", "*/*.c", "*/*/*", "a/b", "a/nope", "nope/*.c", "f.c/*", "[ac]/x.?", "a/[", "f.c"} {
+		pattern := filepath.Join(dir, filepath.FromSlash(p))
+		want, wantErr := filepath.Glob(pattern)
+		got, gotErr := idx.glob(pattern)
+		if !reflect.DeepEqual(got, want) || (gotErr == nil) != (wantErr == nil) {
+			t.Errorf("%s: got %q %v, want %q %v", p, got, gotErr, want, wantErr)
+		}
+	}
+	for _, p := range []string{"a", "a/x.c", "a/nope", "f.c/x"} {
+		fn := filepath.Join(dir, filepath.FromSlash(p))
+		fi, wantErr := os.Stat(fn)
+		isDir, gotErr := idx.stat(fn)
+		if (gotErr == nil) != (wantErr == nil) || (wantErr == nil && isDir != fi.IsDir()) {
+			t.Errorf("%s: got %t %v, want %v", p, isDir, gotErr, wantErr)
+		}
+	}
+}
@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package manifest_parser
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"time"
+
+	"github.com/juju/errors"
+	yaml "gopkg.in/yaml.v2"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/build"
+	"github.com/mongoose-os/mos/version"
+)
+
+// ManifestCache keeps the result of lib resolution and conds expansion
+// between builds. It is reused as long as none of the manifests it was
+// computed from have changed and the inputs are the same.
+type ManifestCache struct {
+	// File to store the resolved manifest in.
+	File string
+	// Inputs of lib resolution other than manifests and adjustments, e.g. lib locations.
+	// Cached manifest resolved with a different key is not used.
+	Key string
+	// Cached manifest older than this is not used, so libs still get updated. 0 - no limit.
+	MaxAge time.Duration
+	// Called for every lib of a cached manifest to restore what is not stored, e.g. credentials.
+	RestoreLib func(m *build.SWModule)
+}
+
+// manifestCacheFile is a manifest file the cached manifest was computed from.
+type manifestCacheFile struct {
+	Path string `yaml:"path"`
+	// -1 if the file did not exist (e.g. there was no mos_<platform>.yml).
+	Size  int64  `yaml:"size"`
+	MTime int64  `yaml:"mtime"`
+	Hash  string `yaml:"hash,omitempty"`
+}
+
+// manifestCacheLib keeps state of a handled lib which is not serialized with the manifest.
+type manifestCacheLib struct {
+	UserVersion string `yaml:"user_version,omitempty"`
+	Prepared    bool   `yaml:"prepared,omitempty"`
+	RepoVersion string `yaml:"repo_version,omitempty"`
+	RepoDirty   bool   `yaml:"repo_dirty,omitempty"`
+}
+
+type manifestCacheEntry struct {
+	Key      string               `yaml:"key"`
+	Created  int64                `yaml:"created"`
+	MTime    int64                `yaml:"mtime"`
+	Files    []manifestCacheFile  `yaml:"files"`
+	Libs     []manifestCacheLib   `yaml:"libs"`
+	Manifest *build.FWAppManifest `yaml:"manifest"`
+}
+
+// key returns a hash of everything other than manifest files the result depends on.
+func (mc *ManifestCache) key(dir string, adjustments *build.ManifestAdjustments, requireArch bool) (string, error) {
+	data, err := yaml.Marshal(struct {
+		Dir         string
+		Adjustments *build.ManifestAdjustments
+		RequireArch bool
+		MosVersion  string
+		Key         string
+	}{dir, adjustments, requireArch, version.GetMosVersion(), mc.Key})
+	if err != nil {
+		return "", errors.Trace(err)
+	}
+	h := sha256.Sum256(data)
+	return hex.EncodeToString(h[:]), nil
+}
+
+func hashFile(data []byte) string {
+	h := sha256.Sum256(data)
+	return hex.EncodeToString(h[:])
+}
+
+func newManifestCacheFile(path string) (manifestCacheFile, error) {
+	mf := manifestCacheFile{Path: path, Size: -1}
+	fi, err := os.Stat(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return mf, nil
+		}
+		return mf, errors.Trace(err)
+	}
+	data, err := ioutil.ReadFile(path)
+	if err != nil {
+		return mf, errors.Trace(err)
+	}
+	mf.Size = fi.Size()
+	mf.MTime = fi.ModTime().UnixNano()
+	mf.Hash = hashFile(data)
+	return mf, nil
+}
+
+// unchanged returns true if the file has the same contents as when it was recorded.
+// Contents are only hashed if the size is the same but the mtime is not.
+func (mf *manifestCacheFile) unchanged() bool {
+	fi, err := os.Stat(mf.Path)
+	if err != nil {
+		return os.IsNotExist(err) && mf.Size == -1
+	}
+	if fi.Size() != mf.Size {
+		return false
+	}
+	if fi.ModTime().UnixNano() == mf.MTime {
+		return true
+	}
+	data, err := ioutil.ReadFile(mf.Path)
+	return err == nil && hashFile(data) == mf.Hash
+}
+
+// load returns the cached manifest and its mtime if it is still valid.
+func (mc *ManifestCache) load(key string) (*build.FWAppManifest, time.Time, bool) {
+	data, err := ioutil.ReadFile(mc.File)
+	if err != nil {
+		return nil, time.Time{}, false
+	}
+	var e manifestCacheEntry
+	if err := yaml.Unmarshal(data, &e); err != nil || e.Manifest == nil || len(e.Libs) != len(e.Manifest.LibsHandled) {
+		glog.Infof("%s: invalid manifest cache, ignoring", mc.File)
+		return nil, time.Time{}, false
+	}
+	if e.Key != key {
+		glog.Infof("manifest cache: inputs changed")
+		return nil, time.Time{}, false
+	}
+	if mc.MaxAge > 0 && time.Since(time.Unix(0, e.Created)) > mc.MaxAge {
+		glog.Infof("manifest cache: expired")
+		return nil, time.Time{}, false
+	}
+	for _, mf := range e.Files {
+		if !mf.unchanged() {
+			glog.Infof("manifest cache: %s changed", mf.Path)
+			return nil, time.Time{}, false
+		}
+	}
+	manifest := e.Manifest
+	if manifest.BuildVars == nil {
+		manifest.BuildVars = make(map[string]string)
+	}
+	if manifest.CDefs == nil {
+		manifest.CDefs = make(map[string]string)
+	}
+	for i := range manifest.LibsHandled {
+		lh, cl := &manifest.LibsHandled[i], &e.Libs[i]
+		lh.Manifest = &build.FWAppManifest{}
+		lh.Manifest.Version = cl.UserVersion
+		if cl.Prepared {
+			lh.Lib.SetLocalPathAndRepoVersion(lh.Path, cl.RepoVersion, cl.RepoDirty)
+		}
+		if mc.RestoreLib != nil {
+			mc.RestoreLib(&lh.Lib)
+		}
+	}
+	glog.Infof("manifest cache: %d files unchanged, using %s", len(e.Files), mc.File)
+	return manifest, time.Unix(0, e.MTime), true
+}
+
+// save stores the manifest read from the given files. It must be called before the manifest is modified further.
+func (mc *ManifestCache) save(key string, manifest *build.FWAppManifest, mtime time.Time, files []string) error {
+	e := manifestCacheEntry{
+		Key:      key,
+		Created:  time.Now().UnixNano(),
+		MTime:    mtime.UnixNano(),
+		Manifest: manifest,
+	}
+	for _, f := range files {
+		mf, err := newManifestCacheFile(f)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		e.Files = append(e.Files, mf)
+	}
+	for _, lh := range manifest.LibsHandled {
+		var cl manifestCacheLib
+		if lh.Manifest != nil {
+			cl.UserVersion = lh.Manifest.Version
+		}
+		var err error
+		cl.RepoVersion, cl.RepoDirty, err = lh.Lib.GetRepoVersion()
+		cl.Prepared = (err == nil)
+		e.Libs = append(e.Libs, cl)
+	}
+	data, err := yaml.Marshal(&e)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	if err := os.MkdirAll(filepath.Dir(mc.File), 0777); err != nil {
+		return errors.Trace(err)
+	}
+	tmpFile := mc.File + ".tmp"
+	if err := ioutil.WriteFile(tmpFile, data, 0666); err != nil {
+		return errors.Trace(err)
+	}
+	return errors.Trace(os.Rename(tmpFile, mc.File))
+}
@@ -22,6 +22,7 @@ package manifest_parser
 
 import (
 	"bytes"
+	"context"
 	"fmt"
 	"io"
 	"io/ioutil"
@@ -29,6 +30,7 @@ import (
 	"path"
 	"path/filepath"
 	"runtime"
+	"runtime/trace"
 	"sort"
 	"strings"
 	"sync"
@@ -45,6 +47,7 @@ import (
 	moscommon "github.com/mongoose-os/mos/cli/common"
 	"github.com/mongoose-os/mos/cli/interpreter"
 	"github.com/mongoose-os/mos/cli/ourutil"
+	"github.com/mongoose-os/mos/common/ourglob"
 	"github.com/mongoose-os/mos/version"
 )
 
@@ -72,6 +75,9 @@ const (
 
 	allLibsKeyword = "@all_libs"
 
+	// Prebuilt binaries of this many libs are looked up and fetched at the same time.
+	maxParallelPrebuiltFetches = 8
+
 	assetPrefix           = "asset://"
 	rootManifestAssetName = "data/root_manifest.yml"
 
@@ -99,6 +105,8 @@ type ComponentProvider interface {
 
 type ReadManifestCallbacks struct {
 	ComponentProvider ComponentProvider
+	// If set, resolved manifest is cached and reused while the manifests stay the same.
+	Cache *ManifestCache
 }
 
 type RMFOut struct {
@@ -123,6 +131,7 @@ func ReadManifestFinal(
 	requireArch, preferPrebuiltLibs bool,
 	binaryLibsUpdateInterval time.Duration,
 ) (*build.FWAppManifest, *RMFOut, error) {
+	defer trace.StartRegion(context.Background(), "manifest-parse").End()
 	interp = interp.Copy()
 
 	if adjustments == nil {
@@ -135,11 +144,36 @@ func ReadManifestFinal(
 		return nil, nil, errors.Trace(err)
 	}
 
-	manifest, mtime, err := readManifestWithLibs(
-		dir, adjustments, logWriter, interp, cbs, requireArch,
-	)
-	if err != nil {
-		return nil, nil, errors.Trace(err)
+	// Version overrides are not serialized, so manifests built with deps versions are not cached.
+	cache := cbs.Cache
+	if adjustments.DepsVersions != nil {
+		cache = nil
+	}
+	cacheKey := ""
+	var manifest *build.FWAppManifest
+	var mtime time.Time
+	if cache != nil {
+		if cacheKey, err = cache.key(dir, adjustments, requireArch); err != nil {
+			return nil, nil, errors.Trace(err)
+		}
+		var ok bool
+		if manifest, mtime, ok = cache.load(cacheKey); ok {
+			ourutil.Freportf(logWriter, "Manifests have not changed, using cached libs")
+		}
+	}
+	if manifest == nil {
+		var manifestFiles []string
+		manifest, mtime, manifestFiles, err = readManifestWithLibs(
+			dir, adjustments, logWriter, interp, cbs, requireArch,
+		)
+		if err != nil {
+			return nil, nil, errors.Trace(err)
+		}
+		if cache != nil {
+			if err := cache.save(cacheKey, manifest, mtime, manifestFiles); err != nil {
+				glog.Warningf("failed to save manifest cache: %s", err)
+			}
+		}
 	}
 
 	if manifest.Name == "" {
@@ -294,112 +328,143 @@ func ReadManifestFinal(
 	// }}}
 
 	// Convert manifest.Sources into paths to concrete existing source files.
-	manifest.Sources, fp.AppSourceDirs, err = resolvePaths(manifest.Sources, *sourceGlobs)
+	// Sources and filesystem of the app and all libs are resolved against the same index,
+	// so every directory is only read once.
+	idx := newDirIndex()
+	manifest.Sources, fp.AppSourceDirs, err = resolvePaths(idx, manifest.Sources, *sourceGlobs)
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
 
-	manifest.Filesystem, fp.AppFSDirs, err = resolvePaths(manifest.Filesystem, []string{"*"})
+	manifest.Filesystem, fp.AppFSDirs, err = resolvePaths(idx, manifest.Filesystem, []string{"*"})
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
 
-	// Apply fs_filters.
-	var newFs []string
-	for i, f := range manifest.Filesystem {
-		bf := filepath.Base(f)
-		include := true
-		for _, e := range manifest.FSFilters {
-			if e.Include != "" && e.Exclude != "" {
-				return nil, nil, errors.Errorf("fs_filters entry %d: only one of include or exclude is allowed", i)
-			}
-			if e.Include != "" {
-				if matched, _ := path.Match(e.Include, bf); matched {
-					include = true
-					break
-				}
-			}
-			if e.Exclude != "" {
-				if matched, _ := path.Match(e.Exclude, bf); matched {
-					glog.Infof("%q excluded by %q", f, e.Exclude)
-					include = false
-					break
-				}
-			}
+	// Apply fs_filters, the first matching entry decides.
+	var fsPatterns []string
+	var fsIncludes []bool
+	for i, e := range manifest.FSFilters {
+		switch {
+		case e.Include != "" && e.Exclude != "":
+			return nil, nil, errors.Errorf("fs_filters entry %d: only one of include or exclude is allowed", i)
+		case e.Include != "":
+			fsPatterns = append(fsPatterns, e.Include)
+			fsIncludes = append(fsIncludes, true)
+		case e.Exclude != "":
+			fsPatterns = append(fsPatterns, e.Exclude)
+			fsIncludes = append(fsIncludes, false)
 		}
-		if include {
-			newFs = append(newFs, f)
+	}
+	fsFilters, err := ourglob.NewPatternSet(fsPatterns, ourglob.SetOptions{WholeOrBase: true})
+	if err != nil {
+		return nil, nil, errors.Annotatef(err, "fs_filters")
+	}
+	var newFs []string
+	for _, f := range manifest.Filesystem {
+		if i := fsFilters.MatchAny(filepath.Base(f)); i >= 0 && !fsIncludes[i] {
+			glog.Infof("%q excluded by %q", f, fsPatterns[i])
+			continue
 		}
+		newFs = append(newFs, f)
 	}
 	manifest.Filesystem = newFs
 	manifest.FSFilters = nil
 
 	// When building an app, also add all libs' sources or prebuilt binaries.
 	if manifest.Type == build.ManifestTypeApp {
-		for k, lcur := range manifest.LibsHandled {
-			libSourceDirs := []string{}
+		// findPrebuiltLib returns the path to the prebuilt binary of the lib, fetching it if necessary.
+		// It is called for all the libs in parallel.
+		findPrebuiltLib := func(lcur *build.FWAppManifestLibHandled) (string, []error, error) {
+			var variants []string
+			if lcur.Lib.Variant != "" {
+				variants = append(variants, lcur.Lib.Variant)
+			}
+			libVersion := lcur.Lib.GetVersion(manifest.LibsVersion)
+			if v, ok := interp.MVars.GetVar("build_vars.BOARD"); ok && v.(string) != "" {
+				variants = append(variants, fmt.Sprintf("%s-%s", manifest.Platform, v.(string)))
+			}
+			variants = append(variants, manifest.Platform)
+			var fetchErrs []error
+			for _, variant := range variants {
+				bl := moscommon.GetBinaryLibFilePath(buildDirAbs, lcur.Lib.Name, variant, libVersion)
+				fi, err := os.Stat(bl)
+				if err == nil {
+					// Local file exists, check it.
+					// We want to re-fetch "latest" libs regularly (same way as repos get pulled).
+					if libVersion != version.LatestVersionName || binaryLibsUpdateInterval == 0 ||
+						fi.ModTime().Add(binaryLibsUpdateInterval).After(time.Now()) {
+						if fi.Size() == 0 {
+							// It's a tombstone, meaning this variant does not exist. Skip it.
+							glog.V(1).Infof("%s is a tombstone, skipping", bl)
+							continue
+						}
+						bl, err := filepath.Abs(bl)
+						if err != nil {
+							return "", nil, errors.Trace(err)
+						}
+						ourutil.Freportf(logWriter, "Prebuilt binary for %q already exists at %q", lcur.Lib.Name, bl)
+						return bl, nil, nil
+					}
+				}
+				// Try fetching
+				fetchErr := lcur.Lib.FetchPrebuiltBinary(variant, libVersion, bl)
+				if fetchErr == nil {
+					ourutil.Freportf(logWriter, "Successfully fetched prebuilt binary for %q to %q", lcur.Lib.Name, bl)
+					return bl, nil, nil
+				}
+				fetchErrs = append(fetchErrs, fetchErr)
+				if os.IsNotExist(errors.Cause(fetchErr)) {
+					// This variant does not exist, create a tombstone to avoid fetching in the future.
+					glog.V(1).Infof("%s: creating a tombstone", bl)
+					ioutil.WriteFile(bl, nil, 0664)
+				}
+			}
+			return "", fetchErrs, nil
+		}
 
-			origSources := lcur.Sources
+		// Resolve sources first, then look for prebuilt binaries of the libs that need them.
+		libSourceDirs := make([][]string, len(manifest.LibsHandled))
+		origSources := make([][]string, len(manifest.LibsHandled))
+		for k, lcur := range manifest.LibsHandled {
+			origSources[k] = lcur.Sources
 			// Convert dirs and globs to actual files
-			manifest.LibsHandled[k].Sources, libSourceDirs, err = resolvePaths(lcur.Sources, *sourceGlobs)
+			manifest.LibsHandled[k].Sources, libSourceDirs[k], err = resolvePaths(idx, lcur.Sources, *sourceGlobs)
 			if err != nil {
 				return nil, nil, errors.Trace(err)
 			}
+		}
 
+		type prebuiltLibResult struct {
+			path      string
+			fetchErrs []error
+			err       error
+		}
+		prebuiltLibs := make([]prebuiltLibResult, len(manifest.LibsHandled))
+		var wg sync.WaitGroup
+		sem := make(chan struct{}, maxParallelPrebuiltFetches)
+		for k := range manifest.LibsHandled {
+			lh := &manifest.LibsHandled[k]
 			// Check if binary version of the lib exists. We do this if there are
 			// no sources or if we prefer binary libs (for speed).
-			binaryLib := ""
-			var fetchErrs []error
-			if (len(manifest.LibsHandled[k].Sources) == 0 && len(origSources) != 0) || preferPrebuiltLibs {
-				var variants []string
-				if lcur.Lib.Variant != "" {
-					variants = append(variants, lcur.Lib.Variant)
-				}
-				libVersion := lcur.Lib.GetVersion(manifest.LibsVersion)
-				if v, ok := interp.MVars.GetVar("build_vars.BOARD"); ok && v.(string) != "" {
-					variants = append(variants, fmt.Sprintf("%s-%s", manifest.Platform, v.(string)))
-				}
-				variants = append(variants, manifest.Platform)
-				for _, variant := range variants {
-					bl := moscommon.GetBinaryLibFilePath(buildDirAbs, lcur.Lib.Name, variant, libVersion)
-					fi, err := os.Stat(bl)
-					if err == nil {
-						// Local file exists, check it.
-						// We want to re-fetch "latest" libs regularly (same way as repos get pulled).
-						if libVersion != version.LatestVersionName || binaryLibsUpdateInterval == 0 ||
-							fi.ModTime().Add(binaryLibsUpdateInterval).After(time.Now()) {
-							if fi.Size() == 0 {
-								// It's a tombstone, meaning this variant does not exist. Skip it.
-								glog.V(1).Infof("%s is a tombstone, skipping", bl)
-								continue
-							}
-							bl, err := filepath.Abs(bl)
-							if err != nil {
-								return nil, nil, errors.Trace(err)
-							}
-							ourutil.Freportf(logWriter, "Prebuilt binary for %q already exists at %q", lcur.Lib.Name, bl)
-							binaryLib = bl
-							break
-						}
-					}
-					// Try fetching
-					fetchErr := lcur.Lib.FetchPrebuiltBinary(variant, libVersion, bl)
-					if fetchErr == nil {
-						ourutil.Freportf(logWriter, "Successfully fetched prebuilt binary for %q to %q", lcur.Lib.Name, bl)
-						binaryLib = bl
-					} else {
-						fetchErrs = append(fetchErrs, fetchErr)
-						if os.IsNotExist(errors.Cause(fetchErr)) {
-							// This variant does not exist, create a tombstone to avoid fetching in the future.
-							glog.V(1).Infof("%s: creating a tombstone", bl)
-							ioutil.WriteFile(bl, nil, 0664)
-						}
-					}
-					if binaryLib != "" {
-						break
-					}
-				}
+			if (len(lh.Sources) == 0 && len(origSources[k]) != 0) || preferPrebuiltLibs {
+				wg.Add(1)
+				go func(k int) {
+					defer wg.Done()
+					sem <- struct{}{}
+					defer func() { <-sem }()
+					r := &prebuiltLibs[k]
+					r.path, r.fetchErrs, r.err = findPrebuiltLib(lh)
+				}(k)
 			}
+		}
+		wg.Wait()
+
+		for k := range manifest.LibsHandled {
+			if err := prebuiltLibs[k].err; err != nil {
+				return nil, nil, errors.Trace(err)
+			}
+			binaryLib, fetchErrs := prebuiltLibs[k].path, prebuiltLibs[k].fetchErrs
 			if binaryLib != "" {
 				// We should use binary lib instead of sources
 				manifest.LibsHandled[k].Sources = []string{}
@@ -407,7 +472,7 @@ func ReadManifestFinal(
 				manifest.BinaryLibs = append(manifest.BinaryLibs, binaryLib)
 			} else {
 				// Use lib sources, not prebuilt binary
-				if len(manifest.LibsHandled[k].Sources) == 0 && len(origSources) != 0 {
+				if len(manifest.LibsHandled[k].Sources) == 0 && len(origSources[k]) != 0 {
 					// Originally the lib had some sources in its mos.yml, but turns out
 					// that they don't exist (closed source lib), and we have failed to fetch a prebuilt
 					// binary for it. Error out with a descriptive message.
@@ -421,7 +486,7 @@ func ReadManifestFinal(
 				manifest.Sources = append(manifest.Sources, manifest.LibsHandled[k].Sources...)
 			}
 
-			fp.AppSourceDirs = append(fp.AppSourceDirs, libSourceDirs...)
+			fp.AppSourceDirs = append(fp.AppSourceDirs, libSourceDirs[k]...)
 		}
 
 		// Generate deps manifest.
@@ -478,12 +543,14 @@ func ReadManifestFinal(
 		}
 	}
 
-	manifest.BinaryLibs, fp.AppBinLibDirs, err = resolvePaths(manifest.BinaryLibs, []string{"*.a"})
+	// Prebuilt binaries and generated files have been written since, start with a fresh index.
+	idx = newDirIndex()
+	manifest.BinaryLibs, fp.AppBinLibDirs, err = resolvePaths(idx, manifest.BinaryLibs, []string{"*.a"})
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
 
-	manifest.Tests, _, err = resolvePaths(manifest.Tests, []string{"*"})
+	manifest.Tests, _, err = resolvePaths(idx, manifest.Tests, []string{"*"})
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
@@ -530,6 +597,9 @@ type manifestParseContext struct {
 
 	mtx        *sync.Mutex
 	libsByName *libByNameMap
+
+	// Manifest files read so far (including non-existent platform-specific ones).
+	manifestFiles []string
 }
 
 // readManifestWithLibs reads manifest from the provided dir, "expands" all
@@ -541,7 +611,7 @@ func readManifestWithLibs(
 	logWriter io.Writer, interp *interpreter.MosInterpreter,
 	cbs *ReadManifestCallbacks,
 	requireArch bool,
-) (*build.FWAppManifest, time.Time, error) {
+) (*build.FWAppManifest, time.Time, []string, error) {
 	interp = interp.Copy()
 	libsHandled := map[string]*build.FWAppManifestLibHandled{}
 
@@ -574,7 +644,7 @@ func readManifestWithLibs(
 
 	manifest, mtime, err := readManifestWithLibs2(dir, pc)
 	if err != nil {
-		return nil, time.Time{}, errors.Trace(err)
+		return nil, time.Time{}, nil, errors.Trace(err)
 	}
 
 	pc.prepareLibs = append(pc.prepareLibs, &prepareLibsEntry{
@@ -595,7 +665,7 @@ func readManifestWithLibs(
 			for _, ple := range pll {
 				libsMtime, err := prepareLibs(ple.parentNodeName, ple.manifest, pc)
 				if err != nil {
-					return nil, time.Time{}, errors.Trace(err)
+					return nil, time.Time{}, nil, errors.Trace(err)
 				} else {
 					if libsMtime.After(mtime) {
 						mtime = libsMtime
@@ -607,7 +677,7 @@ func readManifestWithLibs(
 		// Get all deps in topological order
 		depsTopo, cycle := deps.Topological(true)
 		if cycle != nil {
-			return nil, time.Time{}, errors.Errorf(
+			return nil, time.Time{}, nil, errors.Errorf(
 				"dependency cycle: %v", strings.Join(cycle, " -> "),
 			)
 		}
@@ -671,11 +741,12 @@ func readManifestWithLibs(
 
 		initDepsTopo, cycle := initDepsExpanded.Topological(true)
 		if cycle != nil {
-			return nil, time.Time{}, errors.Errorf(
+			return nil, time.Time{}, nil, errors.Errorf(
 				"init dependency cycle: %v", strings.Join(cycle, " -> "),
 			)
 		}
 		manifest.InitDeps = initDepsTopo
+		glog.V(1).Infof("init levels: %s", initDepsExpanded.Levels(true))
 
 		// Create a LibsHandled slice in topological order computed above
 		manifest.LibsHandled = make([]build.FWAppManifestLibHandled, 0, len(depsTopo))
@@ -696,7 +767,7 @@ func readManifestWithLibs(
 				if len(manifest.Libs) > 0 {
 					libsMtime, err := prepareLibs(depsApp, manifest, pc)
 					if err != nil {
-						return nil, time.Time{}, errors.Trace(err)
+						return nil, time.Time{}, nil, errors.Trace(err)
 					}
 					if libsMtime.After(mtime) {
 						mtime = libsMtime
@@ -706,7 +777,7 @@ func readManifestWithLibs(
 					if len(lh.Manifest.Libs) > 0 {
 						libsMtime, err := prepareLibs(lh.Lib.Name, lh.Manifest, pc)
 						if err != nil {
-							return nil, time.Time{}, errors.Trace(err)
+							return nil, time.Time{}, nil, errors.Trace(err)
 						}
 						if libsMtime.After(mtime) {
 							mtime = libsMtime
@@ -715,17 +786,17 @@ func readManifestWithLibs(
 				}
 				continue
 			}
-			return nil, time.Time{}, errors.Trace(err)
+			return nil, time.Time{}, nil, errors.Trace(err)
 		}
 
 		if err := expandManifestAllLibsPaths(manifest); err != nil {
-			return nil, time.Time{}, errors.Trace(err)
+			return nil, time.Time{}, nil, errors.Trace(err)
 		}
 
 		break
 	}
 
-	return manifest, mtime, nil
+	return manifest, mtime, pc.manifestFiles, nil
 }
 
 func readManifestWithLibs2(dir string, pc *manifestParseContext) (*build.FWAppManifest, time.Time, error) {
@@ -737,6 +808,11 @@ func readManifestWithLibs2(dir string, pc *manifestParseContext) (*build.FWAppMa
 	pc.mtx.Lock()
 	defer pc.mtx.Unlock()
 
+	pc.manifestFiles = append(pc.manifestFiles, moscommon.GetManifestFilePath(dir))
+	if manifest.Platform != "" {
+		pc.manifestFiles = append(pc.manifestFiles, moscommon.GetManifestArchFilePath(dir, manifest.Platform))
+	}
+
 	if pc.requireArch && manifest.Platform == "" {
 		return nil, time.Time{}, errors.Errorf("--platform must be specified or mos.yml should contain a platform key")
 	}
@@ -1780,14 +1856,15 @@ func quoteOrNULL(s string) string {
 
 func getDepsInitCCode(manifest *build.FWAppManifest, dm *build.DepsManifest) ([]byte, error) {
 	tplData := libsInitData{}
-	for _, n := range manifest.InitDeps {
-		var lh *build.FWAppManifestLibHandled
-		for _, lh1 := range manifest.LibsHandled {
-			if lh1.Lib.Name == n {
-				lh = &lh1
-				break
-			}
+	libsHandled := map[string]*build.FWAppManifestLibHandled{}
+	for i := range manifest.LibsHandled {
+		lh := &manifest.LibsHandled[i]
+		if _, ok := libsHandled[lh.Lib.Name]; !ok {
+			libsHandled[lh.Lib.Name] = lh
 		}
+	}
+	for _, n := range manifest.InitDeps {
+		lh := libsHandled[n]
 		initFunc := "NULL"
 		if len(lh.Sources) > 0 || len(lh.BinaryLibs) > 0 {
 			initFunc = fmt.Sprintf("mgos_%s_init", ourutil.IdentifierFromString(lh.Lib.Name))
@@ -1857,7 +1934,7 @@ func getDepsInitCCode(manifest *build.FWAppManifest, dm *build.DepsManifest) ([]
 // Paths in srcPaths can be prefixed with a `+` (which is a no-op) or with `-`
 // (which excludes matching files from the result). E.g. []string{"foo",
 // "-foo/bar"} means "all files under foo, except foo/bar".
-func resolvePaths(srcPaths []string, globs []string) (files []string, dirs []string, err error) {
+func resolvePaths(idx *dirIndex, srcPaths []string, globs []string) (files []string, dirs []string, err error) {
 	// Get separate slices of paths to add and paths to remove
 	add := []string{}
 	remove := []string{}
@@ -1873,12 +1950,12 @@ func resolvePaths(srcPaths []string, globs []string) (files []string, dirs []str
 	}
 
 	// Get slice of concrete files to add and to remove
-	addFiles, addDirs, err := resolvePathsUnprefixed(add, globs)
+	addFiles, addDirs, err := resolvePathsUnprefixed(idx, add, globs)
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
 
-	removeFiles, removeDirs, err := resolvePathsUnprefixed(remove, globs)
+	removeFiles, removeDirs, err := resolvePathsUnprefixed(idx, remove, globs)
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
@@ -1918,15 +1995,15 @@ func resolvePaths(srcPaths []string, globs []string) (files []string, dirs []str
 
 // resolvePathsUnprefixed is like resolvePaths, but doesn't support
 // `-` and `+` as filename prefixes.
-func resolvePathsUnprefixed(srcPaths []string, globs []string) (files []string, dirs []string, err error) {
+func resolvePathsUnprefixed(idx *dirIndex, srcPaths []string, globs []string) (files []string, dirs []string, err error) {
 	var fileGlobs []string
-	fileGlobs, dirs, err = globify(srcPaths, globs)
+	fileGlobs, dirs, err = globify(idx, srcPaths, globs)
 	if err != nil {
 		return nil, nil, errors.Trace(err)
 	}
 
 	for _, g := range fileGlobs {
-		matches, err := filepath.Glob(g)
+		matches, err := idx.glob(g)
 		if err != nil {
 			return nil, nil, errors.Trace(err)
 		}
@@ -1940,7 +2017,7 @@ func resolvePathsUnprefixed(srcPaths []string, globs []string) (files []string,
 // globify takes a list of paths, and for each of them which resolves to a
 // directory adds each glob from provided globs. Other paths are added as they
 // are.
-func globify(srcPaths []string, globs []string) (sources []string, dirs []string, err error) {
+func globify(idx *dirIndex, srcPaths []string, globs []string) (sources []string, dirs []string, err error) {
 	cwd, err := filepath.Abs(".")
 	if err != nil {
 		return nil, nil, errors.Trace(err)
@@ -1948,9 +2025,9 @@ func globify(srcPaths []string, globs []string) (sources []string, dirs []string
 
 	for _, p := range srcPaths {
 		p = filepath.FromSlash(p)
-		finfo, err := os.Stat(p)
+		isDir, err := idx.stat(p)
 		var curDir string
-		if err == nil && finfo.IsDir() {
+		if err == nil && isDir {
 			// Item exists and is a directory; add given globs to it
 			for _, glob := range globs {
 				sources = append(sources, filepath.Join(p, glob))
@@ -1968,7 +2045,7 @@ func globify(srcPaths []string, globs []string) (sources []string, dirs []string
 
 				// Try to interpret current item as a glob; if it does not resolve
 				// to anything, we'll silently ignore it
-				matches, err := filepath.Glob(p)
+				matches, err := idx.glob(p)
 				if err != nil {
 					return nil, nil, errors.Trace(err)
 				}
@@ -159,76 +159,85 @@ func singleManifestTest(t *testing.T, appPath string) error {
 	}
 
 	for _, platform := range platforms {
-		logWriter := &bytes.Buffer{}
-		interp := interpreter.NewInterpreter(newMosVars())
-
-		t.Logf("testing %q for %q", appPath, platform)
-
-		manifest, _, err := ReadManifestFinal(
-			filepath.Join(appPath, appDir), &build.ManifestAdjustments{
-				Platform:  platform,
-				BuildVars: descr.BuildVars,
-			}, logWriter, interp,
-			&ReadManifestCallbacks{ComponentProvider: &compProviderTest{descr: &descr}}, true, descr.PreferBinaryLibs, 0,
-		)
-
-		expectedErrorFilename := filepath.Join(appPath, expectedDir, platform, errorTextFile)
-		expectedErrorBytes, _ := ioutil.ReadFile(expectedErrorFilename)
-		expectedError := strings.TrimSpace(string(expectedErrorBytes))
-
-		if err != nil {
-			if expectedError != "" {
-				if strings.Contains(err.Error(), expectedError) {
-					continue
-				} else {
-					return errors.Errorf("%s: expected error message to contain %q but it didn't (the message was: %q); see %s",
-						appPath, expectedError, err.Error(), expectedErrorFilename)
+		cacheFile := moscommon.GetManifestCacheFilePath(moscommon.GetBuildDir(filepath.Join(appPath, appDir)))
+		os.Remove(cacheFile)
+
+		// The second pass uses the manifest cached by the first one and must produce the same results.
+		for pass := 0; pass < 2; pass++ {
+			logWriter := &bytes.Buffer{}
+			interp := interpreter.NewInterpreter(newMosVars())
+
+			t.Logf("testing %q for %q (pass %d)", appPath, platform, pass)
+
+			manifest, _, err := ReadManifestFinal(
+				filepath.Join(appPath, appDir), &build.ManifestAdjustments{
+					Platform:  platform,
+					BuildVars: descr.BuildVars,
+				}, logWriter, interp,
+				&ReadManifestCallbacks{
+					ComponentProvider: &compProviderTest{descr: &descr},
+					Cache:             &ManifestCache{File: cacheFile},
+				}, true, descr.PreferBinaryLibs, 0,
+			)
+
+			expectedErrorFilename := filepath.Join(appPath, expectedDir, platform, errorTextFile)
+			expectedErrorBytes, _ := ioutil.ReadFile(expectedErrorFilename)
+			expectedError := strings.TrimSpace(string(expectedErrorBytes))
+
+			if err != nil {
+				if expectedError != "" {
+					if strings.Contains(err.Error(), expectedError) {
+						continue
+					} else {
+						return errors.Errorf("%s: expected error message to contain %q but it didn't (the message was: %q); see %s",
+							appPath, expectedError, err.Error(), expectedErrorFilename)
+					}
+				}
+				return errors.Trace(err)
+			} else {
+				if expectedError != "" {
+					return errors.Errorf("%s: expected parsing to fail but it didn't", appPath)
 				}
 			}
-			return errors.Trace(err)
-		} else {
-			if expectedError != "" {
-				return errors.Errorf("%s: expected parsing to fail but it didn't", appPath)
-			}
-		}
-
-		data, err := yaml.Marshal(manifest)
-		if err != nil {
-			return errors.Trace(err)
-		}
 
-		data, err = addPlaceholders(data, appPath)
-		if err != nil {
-			return errors.Trace(err)
-		}
+			data, err := yaml.Marshal(manifest)
+			if err != nil {
+				return errors.Trace(err)
+			}
 
-		buildDir := moscommon.GetBuildDir(filepath.Join(appPath, appDir))
-		os.MkdirAll(buildDir, 0777)
+			data, err = addPlaceholders(data, appPath)
+			if err != nil {
+				return errors.Trace(err)
+			}
 
-		actualFilename := filepath.Join(buildDir, finalManifestName)
-		ioutil.WriteFile(actualFilename, data, 0644)
-		expectedFilename := filepath.Join(appPath, expectedDir, platform, finalManifestName)
+			buildDir := moscommon.GetBuildDir(filepath.Join(appPath, appDir))
+			os.MkdirAll(buildDir, 0777)
 
-		if err = compareFiles(actualFilename, expectedFilename); err != nil {
-			return errors.Trace(err)
-		}
+			actualFilename := filepath.Join(buildDir, finalManifestName)
+			ioutil.WriteFile(actualFilename, data, 0644)
+			expectedFilename := filepath.Join(appPath, expectedDir, platform, finalManifestName)
 
-		{ // Verify deps_manifest
-			actualFilename = filepath.Join(buildDir, "gen", depsManifestName)
-			expectedFilename = filepath.Join(appPath, expectedDir, platform, depsManifestName)
 			if err = compareFiles(actualFilename, expectedFilename); err != nil {
 				return errors.Trace(err)
 			}
-		}
 
-		{ // Verify deps_init
-			actualFilename = filepath.Join(buildDir, "gen", depsInitName)
-			expectedFilename = filepath.Join(appPath, expectedDir, platform, depsInitName)
-			if _, err := os.Stat(expectedFilename); err == nil {
+			{ // Verify deps_manifest
+				actualFilename = filepath.Join(buildDir, "gen", depsManifestName)
+				expectedFilename = filepath.Join(appPath, expectedDir, platform, depsManifestName)
 				if err = compareFiles(actualFilename, expectedFilename); err != nil {
 					return errors.Trace(err)
 				}
 			}
+
+			{ // Verify deps_init
+				actualFilename = filepath.Join(buildDir, "gen", depsInitName)
+				expectedFilename = filepath.Join(appPath, expectedDir, platform, depsInitName)
+				if _, err := os.Stat(expectedFilename); err == nil {
+					if err = compareFiles(actualFilename, expectedFilename); err != nil {
+						return errors.Trace(err)
+					}
+				}
+			}
 		}
 	}
 
@@ -299,3 +308,54 @@ func addPlaceholders(data []byte, appPath string) ([]byte, error) {
 
 	return data, nil
 }
+
+// BenchmarkReadManifestFinal parses all the test apps that are expected to parse successfully,
+// without the manifest cache.
+func BenchmarkReadManifestFinal(b *testing.B) {
+	type benchCase struct {
+		appPath, platform string
+		descr             *TestDescr
+	}
+	var cases []benchCase
+	err := filepath.Walk(testManifestsDir, func(p string, fi os.FileInfo, err error) error {
+		if err != nil || !fi.IsDir() || !strings.HasPrefix(fi.Name(), testPrefix) {
+			return err
+		}
+		descr := &TestDescr{}
+		if descrData, err := ioutil.ReadFile(filepath.Join(p, testDescriptorName)); err == nil {
+			if err := yaml.Unmarshal(descrData, descr); err != nil {
+				return errors.Trace(err)
+			}
+		}
+		platformFiles, err := ioutil.ReadDir(filepath.Join(p, expectedDir))
+		if err != nil {
+			return errors.Trace(err)
+		}
+		for _, pf := range platformFiles {
+			if _, err := os.Stat(filepath.Join(p, expectedDir, pf.Name(), errorTextFile)); err == nil {
+				continue
+			}
+			cases = append(cases, benchCase{appPath: p, platform: pf.Name(), descr: descr})
+		}
+		return filepath.SkipDir
+	})
+	if err != nil {
+		b.Fatal(errors.ErrorStack(err))
+	}
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		for _, c := range cases {
+			_, _, err := ReadManifestFinal(
+				filepath.Join(c.appPath, appDir), &build.ManifestAdjustments{
+					Platform:  c.platform,
+					BuildVars: c.descr.BuildVars,
+				}, ioutil.Discard, interpreter.NewInterpreter(newMosVars()),
+				&ReadManifestCallbacks{ComponentProvider: &compProviderTest{descr: c.descr}},
+				true, c.descr.PreferBinaryLibs, 0,
+			)
+			if err != nil {
+				b.Fatalf("%s (%s): %s", c.appPath, c.platform, errors.ErrorStack(err))
+			}
+		}
+	}
+}
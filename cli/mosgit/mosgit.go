@@ -4,9 +4,17 @@
 package mosgit
 
 import (
+	"crypto/sha256"
 	"flag"
+	"fmt"
+	"net/url"
+	"path"
+	"path/filepath"
 	"runtime"
+	"strings"
+	"sync"
 
+	"github.com/mongoose-os/mos/cli/common/paths"
 	"github.com/mongoose-os/mos/common/ourgit"
 	glog "k8s.io/klog/v2"
 )
@@ -14,11 +22,21 @@ import (
 var (
 	useShellGitFlag = flag.Bool("use-shell-git", false, "use external git binary instead of internal implementation")
 	useGoGitFlag    = flag.Bool("use-go-git", false, "use internal Git library (go-git)")
+	hostJobsFlag    = flag.Int("git-jobs-per-host", 4, "maximum number of concurrent git clones, fetches and pulls from the same host")
 
 	haveShellGit    = false
 	checkedShellGit = false
 )
 
+// Network operations in progress, per host.
+var (
+	hostSemsLock sync.Mutex
+	hostSems     = map[string]chan struct{}{}
+
+	mirrorLocksLock sync.Mutex
+	mirrorLocks     = map[string]*sync.Mutex{}
+)
+
 // NewOurGit returns an instance of OurGit: if --use-shell-git is given it'll
 // be a shell-based implementation; otherwise a go-git-based one.
 func NewOurGit(creds *ourgit.Credentials) ourgit.OurGit {
@@ -56,3 +74,76 @@ func IsClean(gitinst ourgit.OurGit, localDir, version string) (bool, error) {
 	}
 	return gitinst.IsClean(localDir, version, excl)
 }
+
+// hostOf returns the host of a repo URL, "https://host/path" or "user@host:path".
+func hostOf(repoURL string) string {
+	if u, err := url.Parse(repoURL); err == nil && u.Host != "" {
+		return u.Host
+	}
+	h := repoURL
+	if i := strings.Index(h, "@"); i >= 0 {
+		h = h[i+1:]
+	}
+	if i := strings.Index(h, ":"); i >= 0 {
+		h = h[:i]
+	}
+	return h
+}
+
+// AcquireHost waits until a network operation with the repo can be started
+// and returns the function to call when it is done. Clones, fetches and pulls from
+// the same host are limited to --git-jobs-per-host, so preparing many libs in
+// parallel does not open dozens of connections to the same server.
+func AcquireHost(repoURL string) func() {
+	host := hostOf(repoURL)
+	hostSemsLock.Lock()
+	sem := hostSems[host]
+	if sem == nil {
+		n := *hostJobsFlag
+		if n <= 0 {
+			n = 1
+		}
+		sem = make(chan struct{}, n)
+		hostSems[host] = sem
+	}
+	hostSemsLock.Unlock()
+	sem <- struct{}{}
+	return func() { <-sem }
+}
+
+// getMirrorDir returns the directory of the repo mirror in the --git-cache-dir.
+func getMirrorDir(repoURL string) string {
+	name := path.Base(strings.TrimSuffix(strings.TrimSuffix(repoURL, "/"), ".git"))
+	// Different URLs of repos with the same name get different mirrors.
+	sum := sha256.Sum256([]byte(repoURL))
+	return filepath.Join(paths.GitCacheDir, hostOf(repoURL), fmt.Sprintf("%s-%x.git", name, sum[:4]))
+}
+
+// PrepareMirror creates or updates the mirror of the repo in --git-cache-dir
+// and returns its path, which can be used as CloneOptions.ReferenceDir.
+// Cloning with the mirror as a reference copies its objects locally instead of
+// downloading the full history for every clone; clones do not depend on the mirror afterwards.
+// Returns an empty string if mirrors are disabled or not supported.
+func PrepareMirror(gitinst ourgit.OurGit, creds *ourgit.Credentials, repoURL string) string {
+	if paths.GitCacheDir == "" || !ourgit.IsShellGit(gitinst) {
+		return ""
+	}
+	dir := getMirrorDir(repoURL)
+	mirrorLocksLock.Lock()
+	lock := mirrorLocks[dir]
+	if lock == nil {
+		lock = &sync.Mutex{}
+		mirrorLocks[dir] = lock
+	}
+	mirrorLocksLock.Unlock()
+	lock.Lock()
+	defer lock.Unlock()
+	release := AcquireHost(repoURL)
+	defer release()
+	glog.Infof("Updating mirror of %s in %s", repoURL, dir)
+	if err := ourgit.UpdateMirrorShell(creds, repoURL, dir); err != nil {
+		glog.Warningf("%s", err)
+		return ""
+	}
+	return dir
+}
@@ -17,10 +17,10 @@
 package ota
 
 import (
-	"bytes"
 	"context"
 	"encoding/base64"
 	"encoding/json"
+	"runtime/trace"
 	"time"
 
 	"github.com/juju/errors"
@@ -28,6 +28,7 @@ import (
 	"github.com/mongoose-os/mos/cli/flags"
 	"github.com/mongoose-os/mos/cli/ourutil"
 	flag "github.com/spf13/pflag"
+	glog "k8s.io/klog/v2"
 )
 
 var (
@@ -35,8 +36,108 @@ var (
 		"If set, update must be explicitly committed within this time after finishing")
 	updateTimeoutFlag = flag.Duration("update-timeout", 600*time.Second,
 		"Timeout for entire update operation")
+	windowFlag = flag.Int("ota-window", 4,
+		"Number of OTA.Write requests to keep in flight. Set to 1 to wait for each chunk to be acknowledged")
 )
 
+const writeAttempts = 3
+
+type otaChunk struct {
+	offset   int64
+	data     []byte
+	attempts int
+	pc       dev.PendingCall
+	cancel   context.CancelFunc
+}
+
+func (c *otaChunk) send(ctx context.Context, devConn dev.DevConn) {
+	var ctx2 context.Context
+	ctx2, c.cancel = context.WithTimeout(ctx, devConn.GetTimeout())
+	c.attempts++
+	if bdc := dev.GetBlobDevConn(devConn); bdc != nil && *flags.BinaryData {
+		// Data is carried by the attachment instead of the "data" field.
+		sta := struct {
+			Offset int64 `json:"offset"`
+		}{Offset: c.offset}
+		c.pc = bdc.CallAsyncBlob(ctx2, "OTA.Write", &sta, c.data, nil, nil)
+		return
+	}
+	sta := struct {
+		Offset int64  `json:"offset"`
+		Data   string `json:"data"`
+	}{Offset: c.offset, Data: base64.StdEncoding.EncodeToString(c.data)}
+	c.pc = dev.CallAsync(ctx2, devConn, "OTA.Write", &sta, nil)
+}
+
+func (c *otaChunk) wait() error {
+	err := c.pc.Wait()
+	c.cancel()
+	return err
+}
+
+// writeData sends data with OTA.Write, keeping up to --ota-window chunks in flight.
+// Chunks that fail are retransmitted (in order) after the ones already in flight complete.
+func writeData(ctx context.Context, devConn dev.DevConn, data []byte) error {
+	defer trace.StartRegion(ctx, "ota-write").End()
+	var queue, inFlight []*otaChunk
+	for offset := 0; offset < len(data); offset += *flags.ChunkSize {
+		end := offset + *flags.ChunkSize
+		if end > len(data) {
+			end = len(data)
+		}
+		queue = append(queue, &otaChunk{offset: int64(offset), data: data[offset:end]})
+	}
+	window := dev.CallWindow(devConn, *windowFlag)
+	glog.V(1).Infof("%d chunks, window %d", len(queue), window)
+	written, lastReportWritten := 0, 0
+	lastReport := time.Now()
+	for len(queue) > 0 || len(inFlight) > 0 {
+		for len(inFlight) < window && len(queue) > 0 {
+			c := queue[0]
+			queue = queue[1:]
+			c.send(ctx, devConn)
+			inFlight = append(inFlight, c)
+		}
+		var failed []*otaChunk
+		var lastErr error
+		for len(inFlight) > 0 {
+			c := inFlight[0]
+			inFlight = inFlight[1:]
+			if err := c.wait(); err != nil {
+				if len(failed) > 0 {
+					// Chunks sent after a failed one are likely rejected because of it,
+					// this does not count as an attempt.
+					glog.V(1).Infof("write at offset %d failed after an earlier failure: %s", c.offset, err)
+					c.attempts--
+				} else {
+					glog.Warningf("write at offset %d failed (attempt %d): %s", c.offset, c.attempts, err)
+					if c.attempts >= writeAttempts {
+						lastErr = errors.Annotatef(err, "write failed at offset %d", c.offset)
+					}
+				}
+				failed = append(failed, c)
+			} else {
+				written += len(c.data)
+			}
+			// Keep the pipe full unless something went wrong.
+			if len(failed) > 0 {
+				continue
+			}
+			break
+		}
+		if lastErr != nil {
+			return lastErr
+		}
+		queue = append(failed, queue...)
+		if written-lastReportWritten >= 65536 || time.Since(lastReport) > 5*time.Second {
+			ourutil.Reportf("  %d of %d (%.2f%%)", written, len(data), float64(written)*100.0/float64(len(data)))
+			lastReportWritten = written
+			lastReport = time.Now()
+		}
+	}
+	return nil
+}
+
 func OTA(ctx context.Context, devConn dev.DevConn) error {
 	args := flag.Args()
 	fwFilename := ""
@@ -89,37 +190,9 @@ func OTA(ctx context.Context, devConn dev.DevConn) error {
 	}
 
 	ourutil.Reportf("Writing data...")
-	fwFile := bytes.NewBuffer(fwFileData)
-	data := make([]byte, *flags.ChunkSize)
-	total := int64(0)
-	lastReport := time.Now()
-	for {
-		n, err := fwFile.Read(data)
-		if n < 0 {
-			return errors.Annotatef(err, "error reading file data")
-		} else if n == 0 {
-			break
-		}
-		dataB64 := base64.StdEncoding.EncodeToString(data[:n])
-		sta := struct {
-			Offset int64  `json:"offset"`
-			Data   string `json:"data"`
-		}{Offset: total, Data: dataB64}
-		for i := 0; i < 3; i++ {
-			ctx2, _ := context.WithTimeout(ctx, devConn.GetTimeout())
-			if err = devConn.Call(ctx2, "OTA.Write", &sta, nil); err == nil {
-				break
-			}
-			if i == 2 {
-				devConn.Call(ctx, "OTA.End", nil, nil)
-				return errors.Annotatef(err, "write failed at offset %d", total)
-			}
-		}
-		total += int64(n)
-		if total%65536 == 0 || time.Since(lastReport) > 5*time.Second {
-			ourutil.Reportf("  %d of %d (%.2f%%)", total, fwFileSize, float64(total)*100.0/float64(fwFileSize))
-			lastReport = time.Now()
-		}
+	if err := writeData(ctx, devConn, fwFileData); err != nil {
+		devConn.Call(ctx, "OTA.End", nil, nil)
+		return errors.Trace(err)
 	}
 
 	ourutil.Reportf("Finalizing update...")
@@ -33,8 +33,13 @@ func FileNameFromString(name string) string {
 	return ret
 }
 
+// IsURL returns true if the argument is an HTTP(S) URL rather than a file name.
+func IsURL(nameOrURL string) bool {
+	return strings.HasPrefix(nameOrURL, "http://") || strings.HasPrefix(nameOrURL, "https://")
+}
+
 func ReadOrFetchFile(nameOrURL string) ([]byte, error) {
-	if strings.HasPrefix(nameOrURL, "http://") || strings.HasPrefix(nameOrURL, "https://") {
+	if IsURL(nameOrURL) {
 		Reportf("Fetching %s...", nameOrURL)
 		resp, err := http.Get(nameOrURL)
 		if err != nil {
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package main
+
+import (
+	"os"
+	"runtime"
+	"runtime/pprof"
+	"runtime/trace"
+
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/cli/flags"
+)
+
+// stopProfiling is set by startProfiling and must be called before exiting.
+var stopProfiling = func() {}
+
+// startProfiling starts CPU profiling and execution tracing if requested with --cpuprofile and --trace.
+// stopProfiling stops them and writes the heap profile requested with --memprofile.
+func startProfiling() error {
+	var stops []func()
+	if *flags.CPUProfile != "" {
+		f, err := os.Create(*flags.CPUProfile)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		if err := pprof.StartCPUProfile(f); err != nil {
+			f.Close()
+			return errors.Annotatef(err, "failed to start CPU profile")
+		}
+		stops = append(stops, func() {
+			pprof.StopCPUProfile()
+			f.Close()
+		})
+	}
+	if *flags.Trace != "" {
+		f, err := os.Create(*flags.Trace)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		if err := trace.Start(f); err != nil {
+			f.Close()
+			return errors.Annotatef(err, "failed to start trace")
+		}
+		stops = append(stops, func() {
+			trace.Stop()
+			f.Close()
+		})
+	}
+	if *flags.MemProfile != "" {
+		stops = append(stops, func() {
+			writeMemProfile(*flags.MemProfile)
+		})
+	}
+	stopProfiling = func() {
+		for _, stop := range stops {
+			stop()
+		}
+		stops = nil
+	}
+	return nil
+}
+
+func writeMemProfile(fname string) {
+	f, err := os.Create(fname)
+	if err != nil {
+		glog.Errorf("failed to write heap profile: %s", err)
+		return
+	}
+	defer f.Close()
+	// Get up-to-date statistics.
+	runtime.GC()
+	if err := pprof.WriteHeapProfile(f); err != nil {
+		glog.Errorf("failed to write heap profile: %s", err)
+	}
+}
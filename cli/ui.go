@@ -53,7 +53,7 @@ var (
 	wwwRoot      = ""
 	startBrowser = true
 	startWebview = true
-	wsClients    = make(map[*websocket.Conn]int)
+	wsClients    = make(map[*websocket.Conn]*wsClient)
 	wsClientsMtx = sync.Mutex{}
 	lockChan     = make(chan int)
 	unlockChan   = make(chan bool)
@@ -99,29 +99,121 @@ func httpReply(w http.ResponseWriter, result interface{}, err error) {
 	httpReplyExt(w, result, err, asJSON)
 }
 
-func wsSend(ws *websocket.Conn, m wsmessage) {
-	t, _ := json.Marshal(m)
-	websocket.Message.Send(ws, string(t))
+const (
+	// Messages are pushed to UI clients in batches, at most this often.
+	wsFlushInterval = 50 * time.Millisecond
+	// Maximum number of messages queued for a client, the oldest are dropped beyond that.
+	wsQueueLen = 1000
+	// A client that does not accept a batch in this time is disconnected.
+	wsSendTimeout = 10 * time.Second
+)
+
+// wsClient queues messages for a UI client and sends them in batches,
+// so a chatty device or a slow browser does not hold up the rest of mos.
+type wsClient struct {
+	ws   *websocket.Conn
+	lock sync.Mutex
+	// Ring buffer of queued messages.
+	queue   []wsmessage
+	head, n int
+	dropped int
+	wake    chan struct{}
+	done    chan struct{}
+}
+
+func newWSClient(ws *websocket.Conn) *wsClient {
+	return &wsClient{
+		ws:    ws,
+		queue: make([]wsmessage, wsQueueLen),
+		wake:  make(chan struct{}, 1),
+		done:  make(chan struct{}),
+	}
+}
+
+func (c *wsClient) push(m wsmessage) {
+	c.lock.Lock()
+	if c.n == len(c.queue) {
+		c.head = (c.head + 1) % len(c.queue)
+		c.n--
+		c.dropped++
+	}
+	c.queue[(c.head+c.n)%len(c.queue)] = m
+	c.n++
+	c.lock.Unlock()
+	select {
+	case c.wake <- struct{}{}:
+	default:
+	}
+}
+
+// takeBatch returns the queued messages, with consecutive console output merged.
+func (c *wsClient) takeBatch() []wsmessage {
+	c.lock.Lock()
+	defer c.lock.Unlock()
+	var batch []wsmessage
+	if c.dropped > 0 {
+		batch = append(batch, wsmessage{"stdio", fmt.Sprintf("\n[%d messages dropped, UI is not keeping up]\n", c.dropped)})
+		c.dropped = 0
+	}
+	for ; c.n > 0; c.n-- {
+		m := c.queue[c.head]
+		c.queue[c.head] = wsmessage{}
+		c.head = (c.head + 1) % len(c.queue)
+		if last := len(batch) - 1; last >= 0 && batch[last].Cmd == m.Cmd && (m.Cmd == "uart" || m.Cmd == "stdio") {
+			batch[last].Data += m.Data
+			continue
+		}
+		batch = append(batch, m)
+	}
+	return batch
+}
+
+func (c *wsClient) run() {
+	for {
+		select {
+		case <-c.wake:
+		case <-c.done:
+			return
+		}
+		// Let more messages accumulate before sending.
+		select {
+		case <-time.After(wsFlushInterval):
+		case <-c.done:
+			return
+		}
+		for _, m := range c.takeBatch() {
+			t, _ := json.Marshal(m)
+			c.ws.SetWriteDeadline(time.Now().Add(wsSendTimeout))
+			if err := websocket.Message.Send(c.ws, string(t)); err != nil {
+				glog.Infof("Websocket send error: %v, closing connection", err)
+				c.ws.Close()
+				return
+			}
+		}
+	}
 }
 
 func wsBroadcast(m wsmessage) {
 	wsClientsMtx.Lock()
 	defer wsClientsMtx.Unlock()
-	for ws := range wsClients {
-		wsSend(ws, m)
+	for _, c := range wsClients {
+		c.push(m)
 	}
 }
 
 func wsHandler(ws *websocket.Conn) {
+	c := newWSClient(ws)
 	defer func() {
 		wsClientsMtx.Lock()
 		defer wsClientsMtx.Unlock()
 		delete(wsClients, ws)
+		close(c.done)
 		ws.Close()
 	}()
 	wsClientsMtx.Lock()
-	wsClients[ws] = 1
+	wsClients[ws] = c
 	wsClientsMtx.Unlock()
+	go c.run()
 
 	for {
 		var text string
@@ -160,8 +252,8 @@ func startUI(ctx context.Context, devConn dev.DevConn) error {
 	r, w, _ := os.Pipe()
 	os.Stdout, os.Stderr = w, w
 	go func() {
+		data := make([]byte, 4096)
 		for {
-			data := make([]byte, 512)
 			n, err := r.Read(data)
 			if err != nil {
 				break
@@ -56,7 +56,13 @@ const (
 )
 
 var (
-	migrateFlag = flag.Bool("migrate", true, "Migrate data from the previous version if needed")
+	migrateFlag             = flag.Bool("migrate", true, "Migrate data from the previous version if needed")
+	migrateJobsFlag         = flag.Int("migrate-jobs", 4, "Number of projects to migrate in parallel")
+	migrateInBackgroundFlag = flag.Bool("migrate-in-background", true,
+		"Migrate data in the background while the command runs. The command waits for migration to finish before exiting.")
+
+	// Closed when background migration is done.
+	migrationDone chan struct{}
 
 	brewPackageNames = map[UpdateChannel]string{
 		UpdateChannelRelease: "mos",
@@ -269,7 +275,15 @@ func getUpdateChannelByMosVersion(mosVersion string) UpdateChannel {
 
 func Init() error {
 	if *migrateFlag {
-		if err := migrateData(); err != nil {
+		if *migrateInBackgroundFlag {
+			migrationDone = make(chan struct{})
+			go func() {
+				defer close(migrationDone)
+				if err := migrateData(); err != nil {
+					fmt.Println(err.Error())
+				}
+			}()
+		} else if err := migrateData(); err != nil {
 			// Just print the error
 			fmt.Println(err.Error())
 		}
@@ -278,6 +292,19 @@ func Init() error {
 	return nil
 }
 
+// WaitMigration waits for the background data migration started by Init, if any.
+func WaitMigration() {
+	if migrationDone == nil {
+		return
+	}
+	select {
+	case <-migrationDone:
+	default:
+		ourutil.Reportf("Waiting for data migration to finish...")
+		<-migrationDone
+	}
+}
+
 // migrateData converts old single libs/apps/modules dirs (if they are present)
 // to the new per-version shape, and then checks in state.json whether current
 // version already has imported libs from previous version. If not, then
@@ -314,10 +341,7 @@ func migrateData() error {
 		ourutil.Reportf("First run of the version %s, initializing...", mosVersion)
 
 		// Get sorted list of all versions available
-		versions := []string{}
-		for k, _ := range state.GetState().Versions {
-			versions = append(versions, k)
-		}
+		versions := state.GetVersions()
 		goversion.Sort(versions)
 
 		if len(versions) > 0 {
@@ -347,7 +371,8 @@ func migrateData() error {
 
 // migrateProjects migrates all projects from the given oldVer to newVer,
 // in the directory determined by the given template dirTpl (like ~/.mos/libs-${mos.version})
-// All projects are migrated in parallel
+// Projects are migrated in parallel, up to --migrate-jobs at a time, into a temporary
+// directory which is renamed when done, so an interrupted migration is redone next time.
 func migrateProjects(dirTpl, oldVer, newVer string) error {
 	oldDir, err := paths.NormalizePath(dirTpl, oldVer)
 	if err != nil {
@@ -370,20 +395,70 @@ func migrateProjects(dirTpl, oldVer, newVer string) error {
 		return nil
 	}
 
-	// We migrate all dirs in parallel, and we just print errors, because we
-	// don't care much about them
+	tmpDir := newDir + ".tmp"
+	if err := os.RemoveAll(tmpDir); err != nil {
+		return errors.Annotatef(err, "failed to remove %s", tmpDir)
+	}
+
+	// We just print errors, because we don't care much about them
+	numJobs := *migrateJobsFlag
+	if numJobs < 1 {
+		numJobs = 1
+	}
+	sem := make(chan struct{}, numJobs)
 	wg := &sync.WaitGroup{}
 	for _, entry := range entries {
 		wg.Add(1)
-		go migrateProj(
-			filepath.Join(oldDir, entry.Name()),
-			filepath.Join(newDir, entry.Name()),
-			oldVer,
-			wg,
-		)
+		sem <- struct{}{}
+		go func(name string) {
+			migrateProj(
+				filepath.Join(oldDir, name),
+				filepath.Join(tmpDir, name),
+				oldVer,
+				wg,
+			)
+			<-sem
+		}(entry.Name())
 	}
 	wg.Wait()
 
+	if err := os.MkdirAll(tmpDir, 0755); err != nil {
+		return errors.Trace(err)
+	}
+	if _, err := os.Stat(newDir); err != nil {
+		if err := os.Rename(tmpDir, newDir); err != nil {
+			return errors.Annotatef(err, "failed to rename %s to %s", tmpDir, newDir)
+		}
+		return nil
+	}
+
+	// The target dir was created while we were migrating (e.g. by the command
+	// running alongside a background migration), so merge into it, leaving
+	// whatever already exists there intact.
+	return errors.Trace(mergeMigratedDir(tmpDir, newDir))
+}
+
+// mergeMigratedDir moves the entries of tmpDir which don't exist in newDir
+// into newDir, and removes tmpDir.
+func mergeMigratedDir(tmpDir, newDir string) error {
+	entries, err := ioutil.ReadDir(tmpDir)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	for _, entry := range entries {
+		src := filepath.Join(tmpDir, entry.Name())
+		dst := filepath.Join(newDir, entry.Name())
+		if _, err := os.Stat(dst); err == nil {
+			ourutil.Reportf("%s already exists, not migrating %s", dst, entry.Name())
+			continue
+		}
+		if err := os.Rename(src, dst); err != nil {
+			return errors.Annotatef(err, "failed to rename %s to %s", src, dst)
+		}
+	}
+	if err := os.RemoveAll(tmpDir); err != nil {
+		return errors.Annotatef(err, "failed to remove %s", tmpDir)
+	}
 	return nil
 }
 
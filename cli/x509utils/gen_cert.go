@@ -159,12 +159,12 @@ func GeneratePrivateKey(ctx context.Context, keyType CertType, useATCA bool, dev
 					"https://github.com/cesanta/mongoose-os-docs/blob/master/mos/userguide/security.md#setup-guide")
 		}
 		ourutil.Reportf("Generating new private key in slot %d", ATCASlot)
-		if err = devConn.Call(ctx, "ATCA.GenKey", &atca.GenKeyArgs{
-			Slot: int64(ATCASlot),
-		}, nil); err != nil {
+		// GenKey returns the public key, so the signer does not need to ask for it.
+		pubKey, err := atca.GenKey(ctx, ATCASlot, false /* dryRun */, devConn)
+		if err != nil {
 			return nil, nil, nil, errors.Annotatef(err, "failed to generate private key in slot %d", ATCASlot)
 		}
-		keySigner = atca.NewSigner(ctx, devConn, ATCASlot)
+		keySigner = atca.NewSignerWithPublicKey(ctx, devConn, ATCASlot, pubKey)
 		keyPEMBlockType = "EC PRIVATE KEY"
 	} else {
 		switch keyType {
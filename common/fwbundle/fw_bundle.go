@@ -19,6 +19,7 @@ package fwbundle
 import (
 	"encoding/json"
 	"fmt"
+	"io"
 	"io/ioutil"
 	"os"
 	"path/filepath"
@@ -38,6 +39,8 @@ type FirmwareBundle struct {
 	FirmwareManifest
 
 	tempDir string
+	// Underlying archive file, if any.
+	closer io.Closer
 }
 
 type firmwareManifest struct {
@@ -121,6 +124,16 @@ func (fw *FirmwareBundle) GetPartData(name string) ([]byte, error) {
 	return p.GetData()
 }
 
+// GetPartDataReader returns a reader for the part's data.
+// Unlike GetPartData, it does not necessarily keep the entire part in memory.
+func (fw *FirmwareBundle) GetPartDataReader(name string) (io.ReadCloser, error) {
+	p := fw.Parts[name]
+	if p == nil {
+		return nil, errors.Errorf("%q: no such part", name)
+	}
+	return p.GetDataReader()
+}
+
 func (fw *FirmwareBundle) GetPartDataFile(name string) (string, int, error) {
 	data, err := fw.GetPartData(name)
 	if err != nil {
@@ -146,6 +159,10 @@ func (fw *FirmwareBundle) GetPartDataFile(name string) (string, int, error) {
 }
 
 func (fw *FirmwareBundle) Cleanup() {
+	if fw.closer != nil {
+		fw.closer.Close()
+		fw.closer = nil
+	}
 	if fw.tempDir != "" {
 		glog.Infof("Cleaning up %q", fw.tempDir)
 		os.RemoveAll(fw.tempDir)
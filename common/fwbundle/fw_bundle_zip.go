@@ -21,10 +21,15 @@ import (
 	"compress/flate"
 	"encoding/binary"
 	"encoding/json"
+	"hash/crc32"
 	"io"
 	"io/ioutil"
+	"math"
+	"os"
 	"path"
 	"path/filepath"
+	"runtime"
+	"sync"
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/cli/ourutil"
@@ -43,64 +48,226 @@ const (
 	zipExtraDataID = uint16(0x293a)
 )
 
-func ReadZipFirmwareBundle(fname string) (*FirmwareBundle, error) {
-	var r *zip.Reader
+// zipBundleReader provides lazy access to the entries of a firmware bundle archive.
+// Entries are only decompressed when part data is requested.
+type zipBundleReader struct {
+	fname string
+	zr    *zip.Reader
+	// Contents of the entire archive, if it was fetched into memory.
+	zipData []byte
+	files   map[string]*zip.File
 
-	zipData, err := ourutil.ReadOrFetchFile(fname)
-	if err != nil {
-		return nil, errors.Trace(err)
-	}
+	mu    sync.Mutex
+	cache map[string][]byte
+}
 
-	r, err = zip.NewReader(bytes.NewReader(zipData), int64(len(zipData)))
-	if err != nil {
-		return nil, errors.Annotatef(err, "%s: invalid firmware file", fname)
+func ReadZipFirmwareBundle(fname string) (*FirmwareBundle, error) {
+	var err error
+	zbr := &zipBundleReader{
+		fname: fname,
+		files: make(map[string]*zip.File),
+		cache: make(map[string][]byte),
 	}
-
 	fwb := NewBundle()
 
-	blobs := make(map[string][]byte)
-
-	for _, f := range r.File {
-		rc, err := f.Open()
+	if ourutil.IsURL(fname) {
+		zbr.zipData, err = ourutil.ReadOrFetchFile(fname)
 		if err != nil {
-			return nil, errors.Annotatef(err, "%s: failed to open", fname)
+			return nil, errors.Trace(err)
 		}
-		data, err := ioutil.ReadAll(rc)
-		if err != nil {
-			return nil, errors.Annotatef(err, "%s: failed to read", fname)
+		zbr.zr, err = zip.NewReader(bytes.NewReader(zbr.zipData), int64(len(zbr.zipData)))
+	} else {
+		var f *os.File
+		var st os.FileInfo
+		if f, err = os.Open(fname); err != nil {
+			return nil, errors.Trace(err)
+		}
+		if st, err = f.Stat(); err != nil {
+			f.Close()
+			return nil, errors.Trace(err)
 		}
-		rc.Close()
-		blobs[path.Base(f.Name)] = data
+		fwb.closer = f
+		zbr.zr, err = zip.NewReader(f, st.Size())
+	}
+	if err != nil {
+		fwb.Cleanup()
+		return nil, errors.Annotatef(err, "%s: invalid firmware file", fname)
+	}
+
+	for _, f := range zbr.zr.File {
+		zbr.files[path.Base(f.Name)] = f
 	}
-	manifestData := blobs[ManifestFileName]
-	if manifestData == nil {
+	manifestData, err := zbr.getData(ManifestFileName)
+	if err != nil {
+		fwb.Cleanup()
 		return nil, errors.Errorf("%s: no %s in the archive", fname, ManifestFileName)
 	}
 	err = json.Unmarshal(manifestData, &fwb.FirmwareManifest)
 	if err != nil {
+		fwb.Cleanup()
 		return nil, errors.Annotatef(err, "%s: failed to parse manifest", fname)
 	}
 	for n, p := range fwb.FirmwareManifest.Parts {
 		p.Name = n
 		p.SetDataProvider(func(name, src string) ([]byte, error) {
-			data, ok := blobs[src]
-			if !ok {
-				return nil, errors.Errorf("%s not found in the archive", src)
-			}
-			return data, nil
+			return zbr.getData(src)
+		})
+		p.SetStreamProvider(func(name, src string) (io.ReadCloser, error) {
+			return zbr.open(src)
 		})
 	}
 	return fwb, nil
 }
 
-func WriteZipFirmwareBytes(fwb *FirmwareBundle, buf *bytes.Buffer, compress bool, extraAttrs map[string]interface{}) error {
-	zw := zip.NewWriter(buf)
-	// When compressing, use best compression.
-	zw.RegisterCompressor(zip.Deflate, func(out io.Writer) (io.WriteCloser, error) {
-		return flate.NewWriter(out, flate.BestCompression)
-	})
+func (zbr *zipBundleReader) getFile(name string) (*zip.File, error) {
+	f := zbr.files[name]
+	if f == nil {
+		return nil, errors.Errorf("%s not found in the archive", name)
+	}
+	return f, nil
+}
+
+// getData returns contents of the archive entry.
+// If the archive is in memory and the entry is stored, no copy is made.
+func (zbr *zipBundleReader) getData(name string) ([]byte, error) {
+	zbr.mu.Lock()
+	defer zbr.mu.Unlock()
+	if data, ok := zbr.cache[name]; ok {
+		return data, nil
+	}
+	f, err := zbr.getFile(name)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	var data []byte
+	if zbr.zipData != nil && f.Method == zip.Store && f.CompressedSize64 == f.UncompressedSize64 {
+		offset, err := f.DataOffset()
+		if err != nil {
+			return nil, errors.Annotatef(err, "%s: failed to read %s", zbr.fname, name)
+		}
+		end := offset + int64(f.UncompressedSize64)
+		if offset < 0 || end > int64(len(zbr.zipData)) {
+			return nil, errors.Errorf("%s: invalid entry %s", zbr.fname, name)
+		}
+		data = zbr.zipData[offset:end:end]
+	} else {
+		rc, err := f.Open()
+		if err != nil {
+			return nil, errors.Annotatef(err, "%s: failed to open %s", zbr.fname, name)
+		}
+		defer rc.Close()
+		data = make([]byte, 0, f.UncompressedSize64)
+		buf := bytes.NewBuffer(data)
+		if _, err := io.Copy(buf, rc); err != nil {
+			return nil, errors.Annotatef(err, "%s: failed to read %s", zbr.fname, name)
+		}
+		data = buf.Bytes()
+	}
+	glog.V(3).Infof("%s: read %s (%d bytes)", zbr.fname, name, len(data))
+	zbr.cache[name] = data
+	return data, nil
+}
+
+// open returns a decompressing reader for the archive entry.
+func (zbr *zipBundleReader) open(name string) (io.ReadCloser, error) {
+	zbr.mu.Lock()
+	data, ok := zbr.cache[name]
+	zbr.mu.Unlock()
+	if ok {
+		return ioutil.NopCloser(bytes.NewReader(data)), nil
+	}
+	f, err := zbr.getFile(name)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	rc, err := f.Open()
+	if err != nil {
+		return nil, errors.Annotatef(err, "%s: failed to open %s", zbr.fname, name)
+	}
+	return rc, nil
+}
+
+// Parts with sampled byte entropy above this many bits per byte are taken to be
+// compressed or encrypted already and are stored without compression.
+const storeEntropyThreshold = 7.9
+
+// isCompressible estimates whether data is worth compressing
+// from the byte entropy of a few samples spread over it.
+func isCompressible(data []byte) bool {
+	const numSamples, sampleLen = 16, 4096
+	if len(data) < 1024 {
+		return true
+	}
+	step := len(data) / numSamples
+	if step < sampleLen {
+		step = sampleLen
+	}
+	var counts [256]int
+	n := 0
+	for off := 0; off < len(data); off += step {
+		end := off + sampleLen
+		if end > len(data) {
+			end = len(data)
+		}
+		for _, b := range data[off:end] {
+			counts[b]++
+		}
+		n += end - off
+	}
+	e := 0.0
+	for _, c := range counts {
+		if c > 0 {
+			p := float64(c) / float64(n)
+			e -= p * math.Log2(p)
+		}
+	}
+	return e < storeEntropyThreshold
+}
+
+// zipEntry is an archive entry with data ready to be written out.
+type zipEntry struct {
+	fh   *zip.FileHeader
+	size int
+	// Compressed data if fh.Method is zip.Deflate.
+	data []byte
+}
+
+func newZipEntry(name string, data []byte, compress bool) (*zipEntry, error) {
+	ze := &zipEntry{
+		fh:   &zip.FileHeader{Name: name, Method: zip.Store, CRC32: crc32.ChecksumIEEE(data)},
+		size: len(data),
+		data: data,
+	}
+	if !compress || !isCompressible(data) {
+		return ze, nil
+	}
+	var buf bytes.Buffer
+	fw, err := flate.NewWriter(&buf, flate.BestCompression)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if _, err := fw.Write(data); err != nil {
+		return nil, errors.Trace(err)
+	}
+	if err := fw.Close(); err != nil {
+		return nil, errors.Trace(err)
+	}
+	// Not worth it if it does not get smaller.
+	if buf.Len() < len(data) {
+		ze.fh.Method = zip.Deflate
+		ze.data = buf.Bytes()
+	}
+	return ze, nil
+}
+
+// WriteZipFirmware writes the bundle as a ZIP archive to w.
+// When compressing, parts are compressed concurrently, except for those that
+// look compressed already, which are stored.
+func WriteZipFirmware(fwb *FirmwareBundle, w io.Writer, compress bool, extraAttrs map[string]interface{}) error {
+	zw := zip.NewWriter(w)
 	// Rewrite sources to be relative to archive.
-	for _, p := range fwb.Parts {
+	var parts []*FirmwarePart
+	for _, p := range fwb.PartsByAddr() {
 		if p.Src == "" {
 			continue
 		}
@@ -113,6 +280,7 @@ func WriteZipFirmwareBytes(fwb *FirmwareBundle, buf *bytes.Buffer, compress bool
 		if err := p.CalcChecksum(); err != nil {
 			return errors.Annotatef(err, "%s: failed to calculate checksum", p.Name)
 		}
+		parts = append(parts, p)
 	}
 	manifestData, err := json.MarshalIndent(&fwb.FirmwareManifest, "", " ")
 	if err != nil {
@@ -129,34 +297,37 @@ func WriteZipFirmwareBytes(fwb *FirmwareBundle, buf *bytes.Buffer, compress bool
 		extraData.Write(extraAttrData)
 	}
 	glog.V(1).Infof("Manifest:\n%s", string(manifestData))
-	zfh := &zip.FileHeader{
-		Name:  ManifestFileName,
-		Extra: extraData.Bytes(),
-	}
-	if compress {
-		zfh.Method = zip.Deflate
-	} else {
-		zfh.Method = zip.Store
-	}
-	if err := zw.AddFile(zfh, manifestData); err != nil {
+	mze, err := newZipEntry(ManifestFileName, manifestData, compress)
+	if err != nil {
 		return errors.Annotatef(err, "error adding %s", ManifestFileName)
 	}
-	for _, p := range fwb.Parts {
-		if p.Src == "" {
-			continue
-		}
-		data, err := p.GetData()
-		if err != nil {
-			return errors.Annotatef(err, "error getting data for %s", p.Name)
-		}
-		zfh = &zip.FileHeader{Name: p.Src}
-		if compress {
-			zfh.Method = zip.Deflate
-		} else {
-			zfh.Method = zip.Store
+	mze.fh.Extra = extraData.Bytes()
+	entries := make([]*zipEntry, len(parts))
+	errs := make([]error, len(parts))
+	sem := make(chan struct{}, runtime.NumCPU())
+	var wg sync.WaitGroup
+	for i, p := range parts {
+		wg.Add(1)
+		sem <- struct{}{}
+		go func(i int, p *FirmwarePart) {
+			defer func() { <-sem; wg.Done() }()
+			data, err := p.GetData()
+			if err != nil {
+				errs[i] = errors.Annotatef(err, "error getting data for %s", p.Name)
+				return
+			}
+			entries[i], errs[i] = newZipEntry(p.Src, data, compress)
+		}(i, p)
+	}
+	wg.Wait()
+	// Entries are written in a fixed order, the output does not depend on scheduling.
+	for i, ze := range append([]*zipEntry{mze}, entries...) {
+		if i > 0 && errs[i-1] != nil {
+			return errors.Trace(errs[i-1])
 		}
-		if err := zw.AddFile(zfh, data); err != nil {
-			return errors.Annotatef(err, "%s: error adding %s", p.Name, p.Src)
+		glog.V(2).Infof("%s: %d -> %d", ze.fh.Name, ze.size, len(ze.data))
+		if err := zw.AddRaw(ze.fh, ze.data, uint64(ze.size)); err != nil {
+			return errors.Annotatef(err, "error adding %s", ze.fh.Name)
 		}
 	}
 	if err = zw.Close(); err != nil {
@@ -165,10 +336,38 @@ func WriteZipFirmwareBytes(fwb *FirmwareBundle, buf *bytes.Buffer, compress bool
 	return nil
 }
 
+func WriteZipFirmwareBytes(fwb *FirmwareBundle, buf *bytes.Buffer, compress bool, extraAttrs map[string]interface{}) error {
+	return WriteZipFirmware(fwb, buf, compress, extraAttrs)
+}
+
+// WriteZipFirmwareBundle writes the bundle to fname. Data is written to a temporary file
+// which replaces fname only on success: parts of fwb may be read lazily from fname itself.
+// On success, the archive fwb was read from is closed, its parts are kept in memory.
 func WriteZipFirmwareBundle(fwb *FirmwareBundle, fname string, compress bool, extraAttrs map[string]interface{}) error {
-	buf := new(bytes.Buffer)
-	if err := WriteZipFirmwareBytes(fwb, buf, compress, extraAttrs); err != nil {
-		return err
+	f, err := ioutil.TempFile(filepath.Dir(fname), "."+filepath.Base(fname)+".tmp*")
+	if err != nil {
+		return errors.Trace(err)
+	}
+	tmpName := f.Name()
+	if err = WriteZipFirmware(fwb, f, compress, extraAttrs); err == nil {
+		err = f.Close()
+	} else {
+		f.Close()
+	}
+	if err == nil && fwb.closer != nil {
+		// All the part data is in memory now. Close the input, which may be fname itself:
+		// on Windows, a file that is open cannot be replaced.
+		fwb.closer.Close()
+		fwb.closer = nil
+	}
+	if err == nil {
+		// TempFile creates files with 0600, make it look like a normally created file.
+		os.Chmod(tmpName, 0644)
+		err = os.Rename(tmpName, fname)
 	}
-	return ioutil.WriteFile(fname, buf.Bytes(), 0644)
+	if err != nil {
+		os.Remove(tmpName)
+		return errors.Annotatef(err, "failed to write %s", fname)
+	}
+	return nil
 }
@@ -0,0 +1,191 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fwbundle
+
+import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"testing"
+
+	zip "github.com/mongoose-os/mos/common/ourzip"
+)
+
+func TestZipFirmwareBundleRoundTrip(t *testing.T) {
+	td, err := ioutil.TempDir("", "fwbundle_test_")
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	defer os.RemoveAll(td)
+
+	enc := make([]byte, 100000)
+	rand.New(rand.NewSource(1)).Read(enc)
+	parts := map[string][]byte{
+		"app": bytes.Repeat([]byte("0123456789abcdef"), 10000),
+		"fs":  []byte("fs data"),
+		"enc": enc,
+	}
+	for _, compress := range []bool{false, true} {
+		fwb := NewBundle()
+		fwb.Name = "test"
+		for n, data := range parts {
+			p := &FirmwarePart{Name: n, Src: n + ".bin"}
+			p.SetData(data)
+			fwb.AddPart(p)
+		}
+		fname := filepath.Join(td, "fw.zip")
+		if err := WriteZipFirmwareBundle(fwb, fname, compress, nil); err != nil {
+			t.Fatalf("%t: %s", compress, err)
+		}
+		zr, err := zip.OpenReader(fname)
+		if err != nil {
+			t.Fatalf("%t: %s", compress, err)
+		}
+		for _, f := range zr.File {
+			wantMethod := zip.Store
+			if compress && (f.Name == "app.bin" || f.Name == ManifestFileName) {
+				wantMethod = zip.Deflate
+			}
+			if f.Method != wantMethod {
+				t.Errorf("%t: %s: want method %d, got %d", compress, f.Name, wantMethod, f.Method)
+			}
+		}
+		zr.Close()
+		fwb2, err := ReadZipFirmwareBundle(fname)
+		if err != nil {
+			t.Fatalf("%t: %s", compress, err)
+		}
+		if fwb2.Name != "test" || len(fwb2.Parts) != len(parts) {
+			t.Fatalf("%t: invalid manifest %+v", compress, fwb2.FirmwareManifest)
+		}
+		for n, data := range parts {
+			data2, err := fwb2.GetPartData(n)
+			if err != nil {
+				t.Fatalf("%t: %s: %s", compress, n, err)
+			}
+			if !bytes.Equal(data, data2) {
+				t.Errorf("%t: %s: data mismatch", compress, n)
+			}
+			rc, err := fwb2.GetPartDataReader(n)
+			if err != nil {
+				t.Fatalf("%t: %s: %s", compress, n, err)
+			}
+			data3, err := ioutil.ReadAll(rc)
+			rc.Close()
+			if err != nil {
+				t.Fatalf("%t: %s: %s", compress, n, err)
+			}
+			if !bytes.Equal(data, data3) {
+				t.Errorf("%t: %s: stream data mismatch", compress, n)
+			}
+		}
+		// Corrupt checksum, streaming read should detect it.
+		fwb2.Parts["app"].ChecksumSHA1 = "0000000000000000000000000000000000000000"
+		fwb2.Parts["app"].ChecksumSHA256 = ""
+		rc, err := fwb2.Parts["app"].GetDataReader()
+		if err != nil {
+			t.Fatalf("%t: %s", compress, err)
+		}
+		if _, err := ioutil.ReadAll(rc); err == nil {
+			t.Errorf("%t: expected checksum error", compress)
+		}
+		rc.Close()
+		fwb2.Cleanup()
+	}
+}
+
+func TestZipFirmwareBundleRewriteInPlace(t *testing.T) {
+	td, err := ioutil.TempDir("", "fwbundle_test_")
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	defer os.RemoveAll(td)
+	fname := filepath.Join(td, "fw.zip")
+	data := bytes.Repeat([]byte("0123456789abcdef"), 1000)
+	fwb := NewBundle()
+	p := &FirmwarePart{Name: "app", Src: "app.bin"}
+	p.SetData(data)
+	fwb.AddPart(p)
+	if err := WriteZipFirmwareBundle(fwb, fname, true, nil); err != nil {
+		t.Fatalf("%s", err)
+	}
+	// Parts of fwb2 are read from fname while it is being rewritten.
+	fwb2, err := ReadZipFirmwareBundle(fname)
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	fwb2.Name = "rewritten"
+	err = WriteZipFirmwareBundle(fwb2, fname, true, nil)
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	// The input must be closed before fname is replaced, or the rename fails on Windows.
+	if fwb2.closer != nil {
+		t.Errorf("input archive is still open")
+	}
+	if data2, err := fwb2.GetPartData("app"); err != nil || !bytes.Equal(data, data2) {
+		t.Errorf("part data lost after rewrite: %v", err)
+	}
+	fwb2.Cleanup()
+	fwb3, err := ReadZipFirmwareBundle(fname)
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	defer fwb3.Cleanup()
+	data3, err := fwb3.GetPartData("app")
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	if fwb3.Name != "rewritten" || !bytes.Equal(data, data3) {
+		t.Errorf("invalid bundle after rewrite")
+	}
+	if fis, _ := ioutil.ReadDir(td); len(fis) != 1 {
+		t.Errorf("temp files left behind: %d files", len(fis))
+	}
+}
+
+func BenchmarkWriteZipFirmwareBytes(b *testing.B) {
+	rnd := rand.New(rand.NewSource(1))
+	fwb := NewBundle()
+	fwb.Name = "bench"
+	total := 0
+	for i, size := range []int{4 * 1024 * 1024, 1024 * 1024, 64 * 1024} {
+		// Half random, half repeated, so compression has some work to do.
+		data := make([]byte, size)
+		rnd.Read(data[:size/2])
+		n := fmt.Sprintf("part%d", i)
+		p := &FirmwarePart{Name: n, Src: n + ".bin"}
+		p.SetData(data)
+		fwb.AddPart(p)
+		total += size
+	}
+	for _, compress := range []bool{false, true} {
+		b.Run(fmt.Sprintf("compress=%t", compress), func(b *testing.B) {
+			b.SetBytes(int64(total))
+			var buf bytes.Buffer
+			for i := 0; i < b.N; i++ {
+				buf.Reset()
+				if err := WriteZipFirmwareBytes(fwb, &buf, compress, nil); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
@@ -17,10 +17,14 @@
 package fwbundle
 
 import (
+	"bytes"
 	"crypto/sha1"
 	"crypto/sha256"
 	"encoding/hex"
 	"encoding/json"
+	"hash"
+	"io"
+	"io/ioutil"
 	"reflect"
 	"strconv"
 	"strings"
@@ -59,12 +63,17 @@ type firmwarePart struct {
 	// Other user-specified attributes are preserved here.
 	attrs map[string]interface{}
 
-	data         []byte
-	dataProvider DataProvider
+	data           []byte
+	dataProvider   DataProvider
+	streamProvider StreamProvider
 }
 
 type DataProvider func(name, src string) ([]byte, error)
 
+// StreamProvider is an optional alternative to DataProvider that allows reading
+// part data without loading all of it into memory.
+type StreamProvider func(name, src string) (io.ReadCloser, error)
+
 func PartFromString(ps string) (*FirmwarePart, error) {
 	np := strings.SplitN(ps, ":", 2)
 	if len(np) < 2 {
@@ -140,6 +149,59 @@ func (p *FirmwarePart) SetDataProvider(dp DataProvider) {
 	p.dataProvider = dp
 }
 
+func (p *FirmwarePart) SetStreamProvider(sp StreamProvider) {
+	p.streamProvider = sp
+}
+
+// GetDataReader returns a reader for the part's data.
+// Checksums, if present, are verified when the end of data is reached.
+func (p *FirmwarePart) GetDataReader() (io.ReadCloser, error) {
+	if p.Src == "" || p.data != nil || p.streamProvider == nil {
+		data, err := p.GetData()
+		if err != nil {
+			return nil, errors.Trace(err)
+		}
+		return ioutil.NopCloser(bytes.NewReader(data)), nil
+	}
+	rc, err := p.streamProvider(p.Name, p.Src)
+	if err != nil {
+		return nil, errors.Annotatef(err, "%s: error retrieving data", p.Name)
+	}
+	return &partDataReader{p: p, rc: rc, sha1: sha1.New(), sha256: sha256.New()}, nil
+}
+
+type partDataReader struct {
+	p      *FirmwarePart
+	rc     io.ReadCloser
+	sha1   hash.Hash
+	sha256 hash.Hash
+}
+
+func (r *partDataReader) Read(b []byte) (int, error) {
+	n, err := r.rc.Read(b)
+	r.sha1.Write(b[:n])
+	r.sha256.Write(b[:n])
+	if err == io.EOF {
+		if r.p.ChecksumSHA1 != "" {
+			csSHA1 := hex.EncodeToString(r.sha1.Sum(nil))
+			if r.p.ChecksumSHA1 != csSHA1 {
+				return n, errors.Errorf("%s: checksum does not match (want %s, got %s)", r.p.Name, r.p.ChecksumSHA1, csSHA1)
+			}
+		}
+		if r.p.ChecksumSHA256 != "" {
+			csSHA256 := hex.EncodeToString(r.sha256.Sum(nil))
+			if r.p.ChecksumSHA256 != csSHA256 {
+				return n, errors.Errorf("%s: checksum does not match (want %s, got %s)", r.p.Name, r.p.ChecksumSHA256, csSHA256)
+			}
+		}
+	}
+	return n, err
+}
+
+func (r *partDataReader) Close() error {
+	return r.rc.Close()
+}
+
 func (p *FirmwarePart) GetData() ([]byte, error) {
 	var data []byte
 	var err error
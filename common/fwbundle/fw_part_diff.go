@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fwbundle
+
+import (
+	"bytes"
+)
+
+// Block size used to compare parts that do not specify a filesystem geometry.
+// It is the flash sector size on all the supported platforms.
+const DefaultDiffBlockSize = 4096
+
+// BlockRange is a range of bytes within a part image.
+type BlockRange struct {
+	Offset int
+	Len    int
+}
+
+// DiffImages compares newData with oldData in blocks of blockSize bytes and returns
+// the ranges of newData that need to be written to turn oldData into newData.
+// Adjacent changed blocks are merged into one range. Blocks past the end of oldData
+// are always considered changed, the last block may be shorter than blockSize.
+func DiffImages(oldData, newData []byte, blockSize int) []BlockRange {
+	var res []BlockRange
+	for offset := 0; offset < len(newData); offset += blockSize {
+		end := offset + blockSize
+		if end > len(newData) {
+			end = len(newData)
+		}
+		if end <= len(oldData) && bytes.Equal(oldData[offset:end], newData[offset:end]) {
+			continue
+		}
+		if n := len(res); n > 0 && res[n-1].Offset+res[n-1].Len == offset {
+			res[n-1].Len += end - offset
+		} else {
+			res = append(res, BlockRange{Offset: offset, Len: end - offset})
+		}
+	}
+	return res
+}
+
+// DiffBlockSize returns the unit in which changes to the part should be compared.
+// For filesystem images this is the erase size of the filesystem: the filesystem
+// is laid out in these units and a changed file only affects the units it occupies.
+func (p *FirmwarePart) DiffBlockSize() int {
+	if p.Type == FSPartType {
+		switch {
+		case p.FSEraseSize > 0:
+			return int(p.FSEraseSize)
+		case p.FSBlockSize > 0:
+			return int(p.FSBlockSize)
+		}
+	}
+	return DefaultDiffBlockSize
+}
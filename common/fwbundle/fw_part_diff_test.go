@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package fwbundle
+
+import (
+	"bytes"
+	"reflect"
+	"testing"
+)
+
+func TestDiffImages(t *testing.T) {
+	old := bytes.Repeat([]byte{0xff}, 40)
+	mod := func(offsets ...int) []byte {
+		res := append([]byte(nil), old...)
+		for _, o := range offsets {
+			res[o] = 0
+		}
+		return res
+	}
+	cases := []struct {
+		newData []byte
+		expd    []BlockRange
+	}{
+		{old, nil},
+		{mod(0), []BlockRange{{0, 10}}},
+		{mod(9, 10), []BlockRange{{0, 20}}},
+		{mod(5, 35), []BlockRange{{0, 10}, {30, 10}}},
+		{append(mod(25), 1, 2, 3), []BlockRange{{20, 10}, {40, 3}}},
+		{old[:35], nil},
+		{mod(39)[:35], nil},
+		{mod(34)[:35], []BlockRange{{30, 5}}},
+	}
+	for i, c := range cases {
+		res := DiffImages(old, c.newData, 10)
+		if !reflect.DeepEqual(res, c.expd) {
+			t.Errorf("%d: expected %v, got %v", i, c.expd, res)
+		}
+	}
+}
+
+func TestDiffBlockSize(t *testing.T) {
+	if bs := (&FirmwarePart{Type: "app", FSEraseSize: 8192}).DiffBlockSize(); bs != DefaultDiffBlockSize {
+		t.Errorf("app part: got %d", bs)
+	}
+	if bs := (&FirmwarePart{Type: FSPartType, FSBlockSize: 8192, FSEraseSize: 65536}).DiffBlockSize(); bs != 65536 {
+		t.Errorf("fs part: got %d", bs)
+	}
+	if bs := (&FirmwarePart{Type: FSPartType, FSBlockSize: 8192}).DiffBlockSize(); bs != 8192 {
+		t.Errorf("fs part without erase size: got %d", bs)
+	}
+}
@@ -19,10 +19,9 @@ package fwbundle
 import (
 	"bufio"
 	"bytes"
-	"encoding/binary"
-	"encoding/hex"
 	"fmt"
-	"io/ioutil"
+	"io"
+	"os"
 
 	"github.com/juju/errors"
 )
@@ -37,133 +36,240 @@ type HexPart struct {
 	Data []byte
 }
 
-func ParseHexBundle(hexData []byte, fill byte, maxGapSize int) (*HexBundle, error) {
-	hb := &HexBundle{}
-	eof := false
-	scanner := bufio.NewScanner(bytes.NewBuffer(hexData))
-	lineNo := 0
-	var curData []byte
-	var partBase, curBase, curAddr uint32
-	setPartBase := false
-	for scanner.Scan() {
-		lineNo++
-		l := scanner.Text()
-		if len(l) == 0 {
-			continue
+const maxHexLineLen = 4096
+
+// Value of each hex digit, 0xff for non-digits.
+var hexDigitValue [256]byte
+
+func init() {
+	for i := range hexDigitValue {
+		hexDigitValue[i] = 0xff
+	}
+	for i, c := range "0123456789abcdef" {
+		hexDigitValue[c] = byte(i)
+	}
+	for i, c := range "ABCDEF" {
+		hexDigitValue[c] = byte(10 + i)
+	}
+}
+
+// decodeHexInto decodes src into dst, which is reused if it has enough capacity.
+func decodeHexInto(dst, src []byte) ([]byte, bool) {
+	n := len(src) / 2
+	if cap(dst) < n {
+		dst = make([]byte, n)
+	}
+	dst = dst[:n]
+	for i := 0; i < n; i++ {
+		h, l := hexDigitValue[src[2*i]], hexDigitValue[src[2*i+1]]
+		if h > 0xf || l > 0xf {
+			return nil, false
 		}
-		if l[0] != ':' {
-			return nil, errors.Errorf("line %d: invalid start of the line", lineNo)
+		dst[i] = h<<4 | l
+	}
+	return dst, true
+}
+
+// hexParser assembles data records into parts. Data is copied straight from
+// the record buffer into the part, records are never allocated individually.
+type hexParser struct {
+	hb         HexBundle
+	fill       byte
+	maxGapSize int
+	cur        *HexPart
+	curEnd     uint32
+	base       uint32
+	eof        bool
+	rec        []byte
+}
+
+func (hp *hexParser) addData(addr uint32, data []byte) {
+	if hp.cur != nil && addr != hp.curEnd {
+		// There is a discontinuity in data, small gaps are filled, otherwise a new part is started.
+		if gap := int64(addr) - int64(hp.curEnd); gap > 0 && gap < int64(hp.maxGapSize) {
+			for i := int64(0); i < gap; i++ {
+				hp.cur.Data = append(hp.cur.Data, hp.fill)
+			}
+		} else {
+			hp.flush()
+		}
+	}
+	if hp.cur == nil {
+		hp.cur = &HexPart{Addr: addr}
+	}
+	hp.cur.Data = append(hp.cur.Data, data...)
+	hp.curEnd = addr + uint32(len(data))
+}
+
+func (hp *hexParser) flush() {
+	if hp.cur != nil {
+		hp.hb.Parts = append(hp.hb.Parts, hp.cur)
+		hp.cur = nil
+	}
+}
+
+// parseIntelHexLine parses an Intel HEX record, l starts with ':'.
+func (hp *hexParser) parseIntelHexLine(l []byte) error {
+	if len(l) < 11 || len(l)%2 != 1 {
+		return errors.Errorf("too short (%d)", len(l))
+	}
+	ld, ok := decodeHexInto(hp.rec, l[1:])
+	if !ok {
+		return errors.Errorf("error decoding record body")
+	}
+	hp.rec = ld
+	recLen := int(ld[0])
+	if len(ld) != 4+recLen+1 {
+		return errors.Errorf("invalid length %d", len(ld))
+	}
+	checksum := ld[len(ld)-1]
+	cs := uint8(0)
+	for _, b := range ld[:len(ld)-1] {
+		cs += b
+	}
+	cs = (cs ^ 0xff) + 1
+	if cs != checksum {
+		return errors.Errorf("invalid checksum (want %02x, got %02x)", checksum, cs)
+	}
+	recOffset := uint32(ld[1])<<8 | uint32(ld[2])
+	recType := ld[3]
+	data := ld[4 : 4+recLen]
+	switch recType {
+	case 0:
+		hp.addData(hp.base+recOffset, data)
+	case 1:
+		hp.eof = true
+	case 2:
+		if recLen != 2 {
+			return errors.Errorf("invalid extended segment address")
 		}
-		if len(l) < 11 || len(l)%2 != 1 {
-			return nil, errors.Errorf("line %d: too short (%d)", lineNo, len(l))
+		hp.base = (uint32(data[0])<<8 | uint32(data[1])) << 4
+	case 3:
+		if recLen != 4 {
+			return errors.Errorf("start segment address")
 		}
-		ld, err := hex.DecodeString(l[1:])
-		if err != nil {
-			return nil, errors.Errorf("line %d: error decoding record body", lineNo)
+		cs := uint32(data[0])<<8 | uint32(data[1])
+		ip := uint32(data[2])<<8 | uint32(data[3])
+		hp.hb.Start = (cs << 4) | ip
+	case 4:
+		if recLen != 2 {
+			return errors.Errorf("invalid extended linear address")
 		}
-		buf := bytes.NewBuffer(ld)
-		var recLen uint8
-		binary.Read(buf, binary.BigEndian, &recLen)
-		if len(ld) != 4+int(recLen)+1 {
-			return nil, errors.Errorf("line %d: invalid length %d", lineNo, len(ld))
+		hp.base = (uint32(data[0])<<8 | uint32(data[1])) << 16
+	case 5:
+		if recLen != 4 {
+			return errors.Errorf("invalid start linear address")
 		}
-		checksum := uint8(ld[len(ld)-1])
-		cs := uint8(0)
-		for _, b := range ld[:len(ld)-1] {
-			cs += uint8(b)
+		hp.hb.Start = uint32(data[0])<<24 | uint32(data[1])<<16 | uint32(data[2])<<8 | uint32(data[3])
+	default:
+		return errors.Errorf("unsupported record type (%d)", recType)
+	}
+	return nil
+}
+
+// parseSRECLine parses a Motorola S-record, l starts with 'S'.
+func (hp *hexParser) parseSRECLine(l []byte) error {
+	if len(l) < 4 || len(l)%2 != 0 {
+		return errors.Errorf("too short (%d)", len(l))
+	}
+	recType := l[1]
+	ld, ok := decodeHexInto(hp.rec, l[2:])
+	if !ok {
+		return errors.Errorf("error decoding record body")
+	}
+	hp.rec = ld
+	if int(ld[0]) != len(ld)-1 {
+		return errors.Errorf("invalid length %d", len(ld))
+	}
+	cs := uint8(0)
+	for _, b := range ld {
+		cs += b
+	}
+	if cs != 0xff {
+		return errors.Errorf("invalid checksum")
+	}
+	addrLen := 0
+	switch recType {
+	case '0', '1', '5', '9':
+		addrLen = 2
+	case '2', '6', '8':
+		addrLen = 3
+	case '3', '7':
+		addrLen = 4
+	default:
+		return errors.Errorf("unsupported record type (S%c)", recType)
+	}
+	if len(ld) < 1+addrLen+1 {
+		return errors.Errorf("invalid length %d", len(ld))
+	}
+	addr := uint32(0)
+	for _, b := range ld[1 : 1+addrLen] {
+		addr = addr<<8 | uint32(b)
+	}
+	data := ld[1+addrLen : len(ld)-1]
+	switch recType {
+	case '1', '2', '3':
+		hp.addData(addr, data)
+	case '7', '8', '9':
+		hp.hb.Start = addr
+		hp.eof = true
+	}
+	// S0 (header) and S5/S6 (record count) carry nothing we need.
+	return nil
+}
+
+// ParseHexBundleReader parses Intel HEX or Motorola S-record data.
+// Gaps between data records shorter than maxGapSize are filled with fill,
+// larger gaps start a new part, so flashers do not need to write or erase them.
+func ParseHexBundleReader(r io.Reader, fill byte, maxGapSize int) (*HexBundle, error) {
+	hp := &hexParser{fill: fill, maxGapSize: maxGapSize}
+	br := bufio.NewReaderSize(r, maxHexLineLen)
+	for lineNo := 1; !hp.eof; lineNo++ {
+		l, err := br.ReadSlice('\n')
+		if err == bufio.ErrBufferFull {
+			return nil, errors.Errorf("line %d: too long", lineNo)
+		} else if err != nil && err != io.EOF {
+			return nil, errors.Annotatef(err, "line %d", lineNo)
 		}
-		cs = (cs ^ 0xff) + 1
-		if cs != checksum {
-			return nil, errors.Errorf("line %d: invalid checksum (want %02x, got %02x)", lineNo, checksum, cs)
+		if len(l) == 0 && err == io.EOF {
+			break
 		}
-		var recOffset uint16
-		binary.Read(buf, binary.BigEndian, &recOffset)
-		var recType uint8
-		binary.Read(buf, binary.BigEndian, &recType)
-		switch recType {
-		case 0:
-			data := make([]byte, recLen)
-			buf.Read(data)
-			addr := curBase + uint32(recOffset)
-			if !setPartBase {
-				partBase = curBase
-				setPartBase = true
-			}
-			if curData != nil && addr != curAddr {
-				// There is a discontinuity in data.
-				gap := int(addr - curAddr)
-				if gap < maxGapSize {
-					// Fill the gap if we're told so
-					for i := 0; i < gap; i++ {
-						curData = append(curData, fill)
-					}
-				} else {
-					// Flush the part, start a new one
-					hb.Parts = append(hb.Parts, &HexPart{
-						Addr: partBase,
-						Data: curData,
-					})
-					curBase = addr
-					curData = nil
-					partBase = addr
-
-				}
-			}
-			curData = append(curData, data...)
-			curAddr = curBase + uint32(recOffset) + uint32(len(data))
-		case 1:
-			if curData != nil {
-				hb.Parts = append(hb.Parts, &HexPart{
-					Addr: partBase,
-					Data: curData,
-				})
-			}
-			eof = true
-		case 2:
-			if recLen != 2 {
-				return nil, errors.Errorf("line %d: invalid extended segment address", lineNo)
-			}
-			var addr uint16
-			binary.Read(buf, binary.BigEndian, &addr)
-			curBase = uint32(addr) << 4
-		case 3:
-			if recLen != 4 {
-				return nil, errors.Errorf("line %d: start segment address", lineNo)
-			}
-			var cs, ip uint16
-			binary.Read(buf, binary.BigEndian, &cs)
-			binary.Read(buf, binary.BigEndian, &ip)
-			hb.Start = (uint32(cs) << 4) | uint32(ip)
-		case 4:
-			if recLen != 2 {
-				return nil, errors.Errorf("line %d: invalid extended linear address", lineNo)
+		l = bytes.TrimRight(l, "\r\n")
+		if len(l) > 0 {
+			var perr error
+			switch l[0] {
+			case ':':
+				perr = hp.parseIntelHexLine(l)
+			case 'S':
+				perr = hp.parseSRECLine(l)
+			default:
+				perr = errors.Errorf("invalid start of the line")
 			}
-			var addr uint16
-			binary.Read(buf, binary.BigEndian, &addr)
-			curBase = uint32(addr) << 16
-		case 5:
-			if recLen != 4 {
-				return nil, errors.Errorf("line %d: invalid start linear address", lineNo)
+			if perr != nil {
+				return nil, errors.Annotatef(perr, "line %d", lineNo)
 			}
-			binary.Read(buf, binary.BigEndian, &hb.Start)
-		default:
-			return nil, errors.Errorf("line %d: unsupported record type (%d)", lineNo, recType)
 		}
-		if eof {
+		if err == io.EOF {
 			break
 		}
 	}
-	if err := scanner.Err(); err != nil {
-		return nil, errors.Annotatef(err, "line %d", lineNo)
-	}
-	if !eof {
+	if !hp.eof {
 		return nil, errors.Errorf("unexpected end of data")
 	}
-	return hb, nil
+	hp.flush()
+	return &hp.hb, nil
+}
+
+func ParseHexBundle(hexData []byte, fill byte, maxGapSize int) (*HexBundle, error) {
+	return ParseHexBundleReader(bytes.NewReader(hexData), fill, maxGapSize)
 }
 
 func PartsFromHex(hexData []byte, baseName string, fill byte, maxGapSize int) ([]*FirmwarePart, error) {
-	hb, err := ParseHexBundle(hexData, fill, maxGapSize)
+	return partsFromHexReader(bytes.NewReader(hexData), baseName, fill, maxGapSize)
+}
+
+func partsFromHexReader(r io.Reader, baseName string, fill byte, maxGapSize int) ([]*FirmwarePart, error) {
+	hb, err := ParseHexBundleReader(r, fill, maxGapSize)
 	if err != nil {
 		return nil, errors.Annotatef(err, "error parsing hex data")
 	}
@@ -186,9 +292,10 @@ func PartsFromHex(hexData []byte, baseName string, fill byte, maxGapSize int) ([
 }
 
 func PartsFromHexFile(fname string, baseName string, fill byte, maxGapSize int) ([]*FirmwarePart, error) {
-	hexData, err := ioutil.ReadFile(fname)
+	f, err := os.Open(fname)
 	if err != nil {
 		return nil, errors.Trace(err)
 	}
-	return PartsFromHex(hexData, baseName, fill, maxGapSize)
+	defer f.Close()
+	return partsFromHexReader(f, baseName, fill, maxGapSize)
 }
@@ -18,6 +18,7 @@ package fwbundle
 
 import (
 	"bytes"
+	"fmt"
 	"testing"
 )
 
@@ -99,6 +100,33 @@ func TestParseHexBundle(t *testing.T) {
 				&pTestCase{addr: 0x3000, data: "!!!"},
 			},
 		},
+		// 6 - S-records
+		{data: `
+S00600004844521B
+S10700004F484149D7
+S9030000FC
+`,
+			start: 0,
+			parts: []*pTestCase{
+				&pTestCase{addr: 0, data: "OHAI"},
+			},
+		},
+		// 7 - S-records, 32-bit address and start
+		{data: "S30908000000" + "4F484149CD\r\nS70508000100F1\r\n",
+			start: 0x8000100,
+			parts: []*pTestCase{
+				&pTestCase{addr: 0x8000000, data: "OHAI"},
+			},
+		},
+		// 8 - invalid digit
+		{data: `
+:04000000GF484149DB
+:00000001FF
+`, fail: true},
+		// 9 - no EOF record
+		{data: `
+:040000004F484149DB
+`, fail: true},
 	}
 
 	for i, c := range cases {
@@ -129,3 +157,65 @@ func TestParseHexBundle(t *testing.T) {
 		}
 	}
 }
+
+func TestParseHexBundleGaps(t *testing.T) {
+	// Two records with a 4 byte gap, then one after a large gap.
+	data := `
+:040000004F484149DB
+:0400080057544621E2
+:020000040001F9
+:020010002121AC
+:00000001FF
+`
+	hb, err := ParseHexBundle([]byte(data), '.', 16)
+	if err != nil {
+		t.Fatalf("got error: %s", err)
+	}
+	if len(hb.Parts) != 2 {
+		t.Fatalf("invalid number of parts: expected 2, got %d", len(hb.Parts))
+	}
+	if hb.Parts[0].Addr != 0 || string(hb.Parts[0].Data) != "OHAI....WTF!" {
+		t.Fatalf("invalid part 0: 0x%x %q", hb.Parts[0].Addr, hb.Parts[0].Data)
+	}
+	if hb.Parts[1].Addr != 0x10010 || string(hb.Parts[1].Data) != "!!" {
+		t.Fatalf("invalid part 1: 0x%x %q", hb.Parts[1].Addr, hb.Parts[1].Data)
+	}
+}
+
+// genIntelHex returns an Intel HEX image of size bytes starting at addr, 32 bytes per record.
+func genIntelHex(addr uint32, size int) []byte {
+	var buf bytes.Buffer
+	record := func(addr uint16, recType byte, data []byte) {
+		sum := byte(len(data)) + byte(addr>>8) + byte(addr) + recType
+		fmt.Fprintf(&buf, ":%02X%04X%02X", len(data), addr, recType)
+		for _, b := range data {
+			fmt.Fprintf(&buf, "%02X", b)
+			sum += b
+		}
+		fmt.Fprintf(&buf, "%02X\n", byte(-int(sum)))
+	}
+	data := make([]byte, 32)
+	for off := 0; off < size; off += len(data) {
+		a := addr + uint32(off)
+		if off == 0 || a&0xffff == 0 {
+			record(0, 4, []byte{byte(a >> 24), byte(a >> 16)})
+		}
+		for i := range data {
+			data[i] = byte(off + i)
+		}
+		record(uint16(a), 0, data)
+	}
+	record(0, 1, nil)
+	return buf.Bytes()
+}
+
+func BenchmarkParseHexBundle(b *testing.B) {
+	hexData := genIntelHex(0x8000000, 1024*1024)
+	b.SetBytes(int64(len(hexData)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := ParseHexBundle(hexData, 0xff, 0); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
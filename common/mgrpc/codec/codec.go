@@ -53,6 +53,8 @@ type Options struct {
 	Serial  SerialCodecOptions
 	UDP     UDPCodecOptions
 	Watson  WatsonCodecOptions
+	// Applies to all the codecs that support compression (GCP, HTTP, MQTT, Watson).
+	Compression CompressionOptions
 }
 
 // ConnectionInfo provides information about the connection.
@@ -64,6 +66,8 @@ type ConnectionInfo struct {
 	RemoteAddr string
 	// PeerCertificates is the certificate chain presented by the peer.
 	PeerCertificates []*x509.Certificate
+	// BinaryFrames indicates that frames can carry raw binary attachments (frame.Frame.Blob).
+	BinaryFrames bool
 }
 
 // IsEOF returns true when err means "end of file".
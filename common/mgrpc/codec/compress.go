@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package codec
+
+import (
+	"bytes"
+	"compress/zlib"
+	"io"
+	"io/ioutil"
+	"sync/atomic"
+
+	"github.com/juju/errors"
+)
+
+// CompressionOptions control compression of frames sent by message-based codecs.
+// Compressed frames are JSON frames compressed with deflate in zlib format,
+// which is easy to tell from JSON by the first byte.
+type CompressionOptions struct {
+	// Frames larger than this many bytes are compressed, 0 - never compress.
+	Threshold int
+	// Compress without waiting for the peer to show it supports compressed frames.
+	// By default, compression starts once a compressed frame is received from the peer.
+	NoNegotiate bool
+}
+
+// frameCompressor compresses outgoing frames once the peer is known to support it.
+// Incoming compressed frames are always accepted.
+type frameCompressor struct {
+	opts         CompressionOptions
+	peerSupports int32
+}
+
+func newFrameCompressor(opts CompressionOptions) *frameCompressor {
+	fc := &frameCompressor{opts: opts}
+	if opts.NoNegotiate {
+		fc.peerSupports = 1
+	}
+	return fc
+}
+
+// isCompressed returns true if data starts with a zlib header.
+// JSON frames start with "{" or whitespace, which is never a valid header.
+func isCompressed(data []byte) bool {
+	return len(data) >= 2 && data[0]&0x0f == 8 && (uint16(data[0])<<8|uint16(data[1]))%31 == 0
+}
+
+func compressFrame(data []byte) ([]byte, error) {
+	var buf bytes.Buffer
+	w := zlib.NewWriter(&buf)
+	if _, err := w.Write(data); err != nil {
+		return nil, errors.Trace(err)
+	}
+	if err := w.Close(); err != nil {
+		return nil, errors.Trace(err)
+	}
+	return buf.Bytes(), nil
+}
+
+// decompressFrame decompresses a frame, which must not exceed maxFrameLen when decompressed.
+func decompressFrame(data []byte) ([]byte, error) {
+	r, err := zlib.NewReader(bytes.NewReader(data))
+	if err != nil {
+		return nil, errors.Annotatef(err, "invalid compressed frame")
+	}
+	defer r.Close()
+	res, err := ioutil.ReadAll(io.LimitReader(r, maxFrameLen+1))
+	if err != nil {
+		return nil, errors.Annotatef(err, "invalid compressed frame")
+	}
+	if len(res) > maxFrameLen {
+		return nil, errors.Errorf("decompressed frame is too long (> %d)", maxFrameLen)
+	}
+	return res, nil
+}
+
+// shouldCompress returns true if a frame of n bytes should be compressed.
+func (fc *frameCompressor) shouldCompress(n int) bool {
+	return fc.opts.Threshold > 0 && n > fc.opts.Threshold && atomic.LoadInt32(&fc.peerSupports) != 0
+}
+
+// encode returns the data to send for the JSON frame.
+func (fc *frameCompressor) encode(data []byte) []byte {
+	if !fc.shouldCompress(len(data)) {
+		return data
+	}
+	cdata, err := compressFrame(data)
+	// Not worth it if it does not get smaller.
+	if err != nil || len(cdata) >= len(data) {
+		return data
+	}
+	return cdata
+}
+
+// decode returns the JSON frame data, decompressing it if necessary.
+func (fc *frameCompressor) decode(data []byte) ([]byte, error) {
+	if !isCompressed(data) {
+		return data, nil
+	}
+	fc.setPeerSupports(true)
+	return decompressFrame(data)
+}
+
+func (fc *frameCompressor) setPeerSupports(supports bool) {
+	v := int32(0)
+	if supports {
+		v = 1
+	}
+	atomic.StoreInt32(&fc.peerSupports, v)
+}
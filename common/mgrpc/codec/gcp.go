@@ -54,10 +54,12 @@ const (
 
 type GCPCodecOptions struct {
 	CreateTopic bool
+	Compression CompressionOptions
 }
 
 type gcpCodec struct {
 	opts     *GCPCodecOptions
+	comp     *frameCompressor
 	name     string
 	project  string
 	region   string
@@ -124,6 +126,7 @@ func NewGCPCodec(connectURL string, opts *GCPCodecOptions) (Codec, error) {
 		registry: parts[2],
 		device:   parts[3],
 		opts:     opts,
+		comp:     newFrameCompressor(opts.Compression),
 
 		topic:        qsvalueOrDefault(vv, topicQSParam, defaultGCPTopic),
 		subscription: qsvalueOrDefault(vv, subscriptionQSParam, defaultGCPSubscription),
@@ -258,8 +261,14 @@ func (c *gcpCodec) subscribe() error {
 				m.Nack()
 				return
 			}
+			data, err := c.comp.decode(m.Data)
+			if err != nil {
+				glog.Errorf("%s", err)
+				m.Nack()
+				return
+			}
 			f := &frame.Frame{}
-			if err := json.Unmarshal(m.Data, f); err != nil {
+			if err := json.Unmarshal(data, f); err != nil {
 				glog.Errorf("Invalid json (%s): %s", err, m.Data)
 				m.Nack()
 				return
@@ -329,6 +338,7 @@ func (c *gcpCodec) Send(ctx context.Context, f *frame.Frame) error {
 	name := fmt.Sprintf("projects/%s/locations/%s/registries/%s/devices/%s",
 		c.project, c.region, c.registry, c.device)
 	glog.V(2).Infof("%s -> %s", fj, name)
+	fj = c.comp.encode(fj)
 	req := cloudiot.SendCommandToDeviceRequest{
 		BinaryData: base64.StdEncoding.EncodeToString(fj),
 		Subfolder:  c.reqSubfolder,
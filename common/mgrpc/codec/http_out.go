@@ -24,6 +24,7 @@ import (
 	"fmt"
 	"io"
 	"net/http"
+	"strings"
 	"sync"
 
 	"github.com/juju/errors"
@@ -39,15 +40,19 @@ type outboundHttpCodec struct {
 	queue         []*frame.Frame
 	cond          *sync.Cond
 	client        *http.Client
+	comp          *frameCompressor
 }
 
 // OutboundHTTP sends outbound frames in HTTP POST requests and
 // returns replies with Recv.
-func OutboundHTTP(url string, tlsConfig *tls.Config) Codec {
+// Request bodies are compressed if the server advertises "deflate" in Accept-Encoding,
+// responses are decompressed by the HTTP client.
+func OutboundHTTP(url string, tlsConfig *tls.Config, co CompressionOptions) Codec {
 	r := &outboundHttpCodec{
 		closeNotifier: make(chan struct{}),
 		url:           url,
 		client:        &http.Client{Transport: &http.Transport{TLSClientConfig: tlsConfig}},
+		comp:          newFrameCompressor(co),
 	}
 	r.cond = sync.NewCond(r)
 	return r
@@ -68,8 +73,7 @@ func (c *outboundHttpCodec) Send(ctx context.Context, f *frame.Frame) error {
 		return errors.Trace(err)
 	}
 	glog.V(2).Infof("Sending to %q over HTTP POST: %q", c.url, string(b))
-	// TODO(imax): use http.Client to set the timeout.
-	resp, err := c.client.Post(c.url, "application/json", bytes.NewReader(b))
+	resp, err := c.post(b)
 	if err != nil {
 		return errors.Trace(err)
 	}
@@ -89,6 +93,34 @@ func (c *outboundHttpCodec) Send(ctx context.Context, f *frame.Frame) error {
 	return nil
 }
 
+func (c *outboundHttpCodec) post(b []byte) (*http.Response, error) {
+	body := c.comp.encode(b)
+	compressed := len(body) != len(b)
+	// TODO(imax): use http.Client to set the timeout.
+	req, err := http.NewRequest("POST", c.url, bytes.NewReader(body))
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	req.Header.Set("Content-Type", "application/json")
+	if compressed {
+		req.Header.Set("Content-Encoding", "deflate")
+	}
+	resp, err := c.client.Do(req)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	if compressed && resp.StatusCode == http.StatusUnsupportedMediaType {
+		glog.V(1).Infof("%s does not accept compressed requests", c.url)
+		resp.Body.Close()
+		c.comp.setPeerSupports(false)
+		return c.post(b)
+	}
+	if strings.Contains(resp.Header.Get("Accept-Encoding"), "deflate") {
+		c.comp.setPeerSupports(true)
+	}
+	return resp, nil
+}
+
 func (c *outboundHttpCodec) Recv(ctx context.Context) (*frame.Frame, error) {
 	// Check if there's anything left in the queue.
 	var r *frame.Frame
@@ -18,15 +18,19 @@ package codec
 
 import (
 	"context"
+	"crypto/sha256"
 	"crypto/tls"
+	"encoding/hex"
 	"encoding/json"
 	"fmt"
 	"io"
 	"math/rand"
 	"net/url"
+	"strings"
 	"sync"
 
 	"github.com/mongoose-os/mos/common/mgrpc/frame"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
 
 	mqtt "github.com/eclipse/paho.mqtt.golang"
 	"github.com/juju/errors"
@@ -41,15 +45,46 @@ type MQTTCodecOptions struct {
 	PubTopic string
 	SubTopic string
 	Src      string
+	// Maximum number of publishes in flight. Send returns as soon as the message is queued,
+	// errors are reported by subsequent sends. 0 - wait for each publish to complete.
+	PublishWindow int
+	Compression   CompressionOptions
 }
 
+// mqttClient is a broker connection shared by all the codecs that use
+// the same broker and credentials. Incoming messages are routed to codecs
+// by their subscriptions.
+type mqttClient struct {
+	key      string
+	clientID string
+	cli      mqtt.Client
+	pubSem   chan struct{}
+	// Serializes (un)subscribe operations, which wait for the broker.
+	subMu sync.Mutex
+
+	mu     sync.Mutex
+	codecs map[*mqttCodec]bool
+	subs   map[string]map[*mqttCodec]bool // topic filter -> codecs
+	pubErr error
+	lost   bool
+
+	// Closed when the connection attempt is done, connErr is set if it failed.
+	ready   chan struct{}
+	connErr error
+}
+
+var mqttClients = struct {
+	sync.Mutex
+	m map[string]*mqttClient
+}{m: make(map[string]*mqttClient)}
+
 type mqttCodec struct {
 	src         string
 	dst         string
 	closeNotify chan struct{}
-	ready       chan struct{}
 	rchan       chan frame.Frame
-	cli         mqtt.Client
+	mc          *mqttClient
+	comp        *frameCompressor
 	closeOnce   sync.Once
 	isTLS       bool
 	pubTopic    string
@@ -115,70 +150,295 @@ func MQTT(dst string, tlsConfig *tls.Config, co *MQTTCodecOptions) (Codec, error
 	c := &mqttCodec{
 		dst:         topic,
 		closeNotify: make(chan struct{}),
-		ready:       make(chan struct{}),
 		rchan:       make(chan frame.Frame),
 		src:         co.Src,
 		pubTopic:    co.PubTopic,
 		subTopic:    co.SubTopic,
 		isTLS:       (u.Scheme == "mqtts"),
 		subTopics:   make(map[string]bool),
+		comp:        newFrameCompressor(co.Compression),
+	}
+
+	// Client ID is random unless specified, so it is not part of the key in that case.
+	key := fmt.Sprintf("%s|%s|%s|%s|%s", opts.Servers[0], co.ClientID, opts.Username, opts.Password, tlsIdentity(tlsConfig))
+	c.mc, err = getMQTTClient(key, opts, co.PublishWindow, c)
+	if err != nil {
+		return nil, errors.Trace(err)
 	}
 	if c.src == "" {
-		c.src = opts.ClientID
+		c.src = c.mc.clientID
+	}
+
+	if c.subTopic != "" {
+		if err := c.subscribe(c.subTopic); err != nil {
+			c.Close()
+			return nil, errors.Trace(err)
+		}
 	}
 
-	opts.SetConnectionLostHandler(c.onConnectionLost)
+	return c, nil
+}
+
+// tlsIdentity returns a string identifying the client certificates and the server verification
+// settings of the config, so that connections with different TLS identities are not shared.
+func tlsIdentity(tlsConfig *tls.Config) string {
+	if tlsConfig == nil {
+		return "notls"
+	}
+	h := sha256.New()
+	fmt.Fprintf(h, "%q %t\n", tlsConfig.ServerName, tlsConfig.InsecureSkipVerify)
+	for _, cert := range tlsConfig.Certificates {
+		for _, der := range cert.Certificate {
+			fmt.Fprintf(h, "cert %x\n", sha256.Sum256(der))
+		}
+	}
+	if tlsConfig.RootCAs != nil {
+		for _, subj := range tlsConfig.RootCAs.Subjects() {
+			fmt.Fprintf(h, "ca %x\n", sha256.Sum256(subj))
+		}
+	} else {
+		fmt.Fprintf(h, "system CAs\n")
+	}
+	return hex.EncodeToString(h.Sum(nil))
+}
 
-	c.cli = mqtt.NewClient(opts)
-	token := c.cli.Connect()
+// getMQTTClient returns a connected client for the key, creating one if necessary, and adds c to its users.
+// The global lock is only held while looking up the client, connecting happens outside of it.
+func getMQTTClient(key string, opts *mqtt.ClientOptions, publishWindow int, c *mqttCodec) (*mqttClient, error) {
+	mqttClients.Lock()
+	mc := mqttClients.m[key]
+	isNew := (mc == nil)
+	if isNew {
+		mc = &mqttClient{
+			key:      key,
+			clientID: opts.ClientID,
+			codecs:   make(map[*mqttCodec]bool),
+			subs:     make(map[string]map[*mqttCodec]bool),
+			ready:    make(chan struct{}),
+		}
+		if publishWindow > 0 {
+			mc.pubSem = make(chan struct{}, publishWindow)
+		}
+		mqttClients.m[key] = mc
+	}
+	// Registered while holding the lock, so a concurrent release does not disconnect the client under us.
+	mc.mu.Lock()
+	mc.codecs[c] = true
+	mc.mu.Unlock()
+	mqttClients.Unlock()
+	if !isNew {
+		glog.V(1).Infof("Reusing MQTT connection to %s", opts.Servers[0])
+		<-mc.ready
+		if mc.connErr != nil {
+			return nil, errors.Trace(mc.connErr)
+		}
+		return mc, nil
+	}
+	opts.SetConnectionLostHandler(mc.onConnectionLost)
+	// Subscriptions do not have their own callbacks, all messages come here and are routed by topic.
+	opts.SetDefaultPublishHandler(mc.onMessage)
+	mc.cli = mqtt.NewClient(opts)
+	token := mc.cli.Connect()
 	token.Wait()
 	if err := token.Error(); err != nil {
-		return nil, errors.Annotatef(err, "MQTT connect error")
+		mc.connErr = errors.Annotatef(err, "MQTT connect error")
+		mqttClients.Lock()
+		if mqttClients.m[key] == mc {
+			delete(mqttClients.m, key)
+		}
+		mqttClients.Unlock()
 	}
+	close(mc.ready)
+	if mc.connErr != nil {
+		return nil, mc.connErr
+	}
+	return mc, nil
+}
 
-	if c.subTopic != "" {
-		err = c.subscribe(c.subTopic)
+// release removes c from the client's users, the connection is closed when the last one is gone.
+func (mc *mqttClient) release(c *mqttCodec, topics []string) {
+	mc.subMu.Lock()
+	defer mc.subMu.Unlock()
+	mqttClients.Lock()
+	mc.mu.Lock()
+	delete(mc.codecs, c)
+	var unsub []string
+	for _, topic := range topics {
+		delete(mc.subs[topic], c)
+		if len(mc.subs[topic]) == 0 {
+			delete(mc.subs, topic)
+			unsub = append(unsub, topic)
+		}
+	}
+	last, lost := len(mc.codecs) == 0, mc.lost
+	mc.mu.Unlock()
+	if last && mqttClients.m[mc.key] == mc {
+		delete(mqttClients.m, mc.key)
 	}
+	mqttClients.Unlock()
+	if lost {
+		return
+	}
+	if last {
+		mc.cli.Disconnect(0)
+		return
+	}
+	if len(unsub) > 0 {
+		glog.V(1).Infof("Unsubscribing from %v", unsub)
+		mc.cli.Unsubscribe(unsub...).Wait()
+	}
+}
 
-	return c, errors.Trace(err)
+func (mc *mqttClient) subscribe(c *mqttCodec, topic string) error {
+	mc.subMu.Lock()
+	defer mc.subMu.Unlock()
+	mc.mu.Lock()
+	codecs := mc.subs[topic]
+	mc.mu.Unlock()
+	if codecs == nil {
+		glog.V(1).Infof("Subscribing to [%s]", topic)
+		token := mc.cli.Subscribe(topic, 1 /* qos */, nil)
+		token.Wait()
+		if err := token.Error(); err != nil {
+			return errors.Annotatef(err, "MQTT subscribe error")
+		}
+		codecs = make(map[*mqttCodec]bool)
+	}
+	mc.mu.Lock()
+	codecs[c] = true
+	mc.subs[topic] = codecs
+	mc.mu.Unlock()
+	return nil
 }
 
-func (c *mqttCodec) subscribe(topic string) error {
-	c.mu.Lock()
-	defer c.mu.Unlock()
-	if c.subTopics[topic] {
+func (mc *mqttClient) publish(topic string, msg []byte) error {
+	if mc.pubSem == nil {
+		token := mc.cli.Publish(topic, 1 /* qos */, false /* retained */, msg)
+		token.Wait()
+		if err := token.Error(); err != nil {
+			return errors.Annotatef(err, "MQTT publish error")
+		}
 		return nil
 	}
-	glog.V(1).Infof("Subscribing to [%s]", topic)
-	token := c.cli.Subscribe(topic, 1 /* qos */, c.onMessage)
-	token.Wait()
-	if err := token.Error(); err != nil {
-		return errors.Annotatef(err, "MQTT subscribe error")
+	mc.mu.Lock()
+	err := mc.pubErr
+	mc.pubErr = nil
+	mc.mu.Unlock()
+	if err != nil {
+		return errors.Annotatef(err, "MQTT publish error")
 	}
-	c.subTopics[topic] = true
+	mc.pubSem <- struct{}{}
+	token := mc.cli.Publish(topic, 1 /* qos */, false /* retained */, msg)
+	go func() {
+		token.Wait()
+		if err := token.Error(); err != nil {
+			mc.mu.Lock()
+			mc.pubErr = err
+			mc.mu.Unlock()
+		}
+		<-mc.pubSem
+	}()
 	return nil
 }
 
-func (c *mqttCodec) onMessage(cli mqtt.Client, msg mqtt.Message) {
+// topicMatches returns true if the topic matches the subscription filter, which may contain wildcards.
+func topicMatches(filter, topic string) bool {
+	fp, tp := strings.Split(filter, "/"), strings.Split(topic, "/")
+	for i, p := range fp {
+		if p == "#" {
+			return true
+		}
+		if i >= len(tp) || (p != "+" && p != tp[i]) {
+			return false
+		}
+	}
+	return len(fp) == len(tp)
+}
+
+func (mc *mqttClient) onMessage(cli mqtt.Client, msg mqtt.Message) {
 	glog.V(4).Infof("Got MQTT message, topic [%s], message [%s]", msg.Topic(), msg.Payload())
+	stats.AddWire("mqtt", false /* tx */, len(msg.Payload()))
+	targets := make(map[*mqttCodec]bool)
+	mc.mu.Lock()
+	for filter, codecs := range mc.subs {
+		if topicMatches(filter, msg.Topic()) {
+			for c := range codecs {
+				targets[c] = true
+			}
+		}
+	}
+	mc.mu.Unlock()
+	if len(targets) == 0 {
+		glog.V(1).Infof("No receivers for [%s]", msg.Topic())
+		return
+	}
+	data := msg.Payload()
+	if isCompressed(data) {
+		var err error
+		if data, err = decompressFrame(data); err != nil {
+			glog.Errorf("%s", err)
+			return
+		}
+		for c := range targets {
+			c.comp.setPeerSupports(true)
+		}
+	}
 	f := &frame.Frame{}
-	if err := json.Unmarshal(msg.Payload(), &f); err != nil {
+	if err := json.Unmarshal(data, &f); err != nil {
 		glog.Errorf("Invalid json (%s): %+v", err, msg.Payload())
 		return
 	}
-	c.rchan <- *f
+	for c := range targets {
+		select {
+		case c.rchan <- *f:
+		case <-c.closeNotify:
+		}
+	}
 }
 
-func (c *mqttCodec) onConnectionLost(cli mqtt.Client, err error) {
+func (mc *mqttClient) onConnectionLost(cli mqtt.Client, err error) {
 	glog.Errorf("Lost conection to MQTT broker: %s", err)
-	c.Close()
+	mqttClients.Lock()
+	if mqttClients.m[mc.key] == mc {
+		delete(mqttClients.m, mc.key)
+	}
+	mqttClients.Unlock()
+	mc.mu.Lock()
+	mc.lost = true
+	var codecs []*mqttCodec
+	for c := range mc.codecs {
+		codecs = append(codecs, c)
+	}
+	mc.mu.Unlock()
+	for _, c := range codecs {
+		c.Close()
+	}
+}
+
+func (c *mqttCodec) subscribe(topic string) error {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.subTopics[topic] {
+		return nil
+	}
+	if err := c.mc.subscribe(c, topic); err != nil {
+		return errors.Trace(err)
+	}
+	c.subTopics[topic] = true
+	return nil
 }
 
 func (c *mqttCodec) Close() {
 	c.closeOnce.Do(func() {
 		glog.V(1).Infof("Closing %s", c)
 		close(c.closeNotify)
-		c.cli.Disconnect(0)
+		c.mu.Lock()
+		var topics []string
+		for topic := range c.subTopics {
+			topics = append(topics, topic)
+		}
+		c.mu.Unlock()
+		c.mc.release(c, topics)
 	})
 }
 
@@ -192,7 +452,7 @@ func (c *mqttCodec) String() string {
 
 func (c *mqttCodec) Info() ConnectionInfo {
 	return ConnectionInfo{
-		IsConnected: c.cli.IsConnected(),
+		IsConnected: c.mc.cli.IsConnected(),
 		TLS:         c.isTLS,
 		RemoteAddr:  c.dst,
 	}
@@ -232,12 +492,9 @@ func (c *mqttCodec) Send(ctx context.Context, f *frame.Frame) error {
 		topic = fmt.Sprintf("%s/rpc", f.Dst)
 	}
 	glog.V(4).Infof("Sending [%s] to [%s]", msg, topic)
-	token := c.cli.Publish(topic, 1 /* qos */, false /* retained */, msg)
-	token.Wait()
-	if err := token.Error(); err != nil {
-		return errors.Annotatef(err, "MQTT publish error")
-	}
-	return nil
+	msg = c.comp.encode(msg)
+	stats.AddWire("mqtt", true /* tx */, len(msg))
+	return errors.Trace(c.mc.publish(topic, msg))
 }
 
 func (c *mqttCodec) SetOptions(opts *Options) error {
@@ -19,6 +19,8 @@ package codec
 import (
 	"context"
 	"fmt"
+	"io"
+	"math/rand"
 	"sync"
 	"time"
 
@@ -31,6 +33,21 @@ import (
 
 type ConnectFunc func(addr string) (Codec, error)
 
+const (
+	minReconnectBackoff = 100 * time.Millisecond
+	maxReconnectBackoff = 15 * time.Second
+	// Connections that lasted at least this long reset the backoff when they are lost.
+	stableConnectionTime = 10 * time.Second
+	// Unanswered requests older than this are not sent again after reconnect,
+	// the caller has most likely given up on them.
+	maxReplayAge = 30 * time.Second
+)
+
+type unackedFrame struct {
+	f    *frame.Frame
+	sent time.Time
+}
+
 type reconnectWrapperCodec struct {
 	addr    string
 	connect ConnectFunc
@@ -39,18 +56,29 @@ type reconnectWrapperCodec struct {
 	conn        Codec
 	connEstd    chan error
 	nextAttempt time.Time
+	backoff     time.Duration
+	connectedAt time.Time
+	// Requests that were sent but have not been responded to yet, oldest first.
+	// They are sent again, with the same IDs, over a new connection if the old one is lost.
+	unacked        []unackedFrame
+	replayQueueLen int
 
 	closeNotifier chan struct{}
 	closeOnce     sync.Once
 }
 
-func NewReconnectWrapperCodec(addr string, connect ConnectFunc) Codec {
+// NewReconnectWrapperCodec returns a codec that connects using the connect function
+// and keeps reconnecting when the connection is lost, with exponential backoff.
+// Up to replayQueueLen unanswered requests are sent again after reconnecting,
+// so requests may be delivered more than once; 0 disables that.
+func NewReconnectWrapperCodec(addr string, connect ConnectFunc, replayQueueLen int) Codec {
 	rwc := &reconnectWrapperCodec{
-		addr:          addr,
-		connect:       connect,
-		nextAttempt:   time.Now(),
-		connEstd:      make(chan error), // closed when a new connection is established, or an error if permanently fails
-		closeNotifier: make(chan struct{}),
+		addr:           addr,
+		connect:        connect,
+		nextAttempt:    time.Now(),
+		connEstd:       make(chan error), // closed when a new connection is established, or an error if permanently fails
+		closeNotifier:  make(chan struct{}),
+		replayQueueLen: replayQueueLen,
 	}
 	go rwc.maintainConnection()
 	return rwc
@@ -95,6 +123,10 @@ func (rwc *reconnectWrapperCodec) maintainConnection() {
 				rwc.lock.Lock()
 				rwc.conn = nil
 				rwc.connEstd = make(chan error)
+				if time.Since(rwc.connectedAt) >= stableConnectionTime {
+					rwc.backoff = 0
+				}
+				rwc.scheduleAttemptLocked()
 				rwc.lock.Unlock()
 			}
 		}
@@ -108,10 +140,14 @@ func (rwc *reconnectWrapperCodec) maintainConnection() {
 
 		glog.V(1).Infof("%s connecting", rwc)
 		conn, err := rwc.connect(rwc.addr)
+		if err == nil {
+			if err = rwc.replay(conn); err != nil {
+				conn.Close()
+			}
+		}
 		rwc.lock.Lock()
-		// TODO(rojer): implement backoff.
-		rwc.nextAttempt = time.Now().Add(2 * time.Second)
 		if err != nil {
+			rwc.scheduleAttemptLocked()
 			if errors.Cause(err) == websocket.ErrBadStatus {
 				glog.Errorf("%s fatal connection error: %+v", rwc.stringLocked(), err)
 				rwc.connEstd <- errors.Trace(err)
@@ -122,12 +158,78 @@ func (rwc *reconnectWrapperCodec) maintainConnection() {
 			continue
 		}
 		rwc.conn = conn
+		rwc.connectedAt = time.Now()
 		glog.Infof("%s connected", rwc.stringLocked())
 		close(rwc.connEstd)
 		rwc.lock.Unlock()
 	}
 }
 
+// scheduleAttemptLocked increases the backoff and sets the time of the next connection attempt.
+// Jitter is added, so many clients disconnected at once do not reconnect in lockstep.
+func (rwc *reconnectWrapperCodec) scheduleAttemptLocked() {
+	if rwc.backoff == 0 {
+		rwc.backoff = minReconnectBackoff
+	} else if rwc.backoff *= 2; rwc.backoff > maxReconnectBackoff {
+		rwc.backoff = maxReconnectBackoff
+	}
+	delay := rwc.backoff/2 + time.Duration(rand.Int63n(int64(rwc.backoff/2)+1))
+	rwc.nextAttempt = time.Now().Add(delay)
+}
+
+// replay sends unanswered requests over the new connection, in the original order.
+func (rwc *reconnectWrapperCodec) replay(conn Codec) error {
+	rwc.lock.Lock()
+	var frames []*frame.Frame
+	unacked := rwc.unacked[:0]
+	for _, uf := range rwc.unacked {
+		if time.Since(uf.sent) < maxReplayAge {
+			frames = append(frames, uf.f)
+			unacked = append(unacked, uf)
+		}
+	}
+	rwc.unacked = unacked
+	rwc.lock.Unlock()
+	if len(frames) == 0 {
+		return nil
+	}
+	glog.Infof("%s re-sending %d requests", rwc, len(frames))
+	ctx, cancel := context.WithTimeout(context.Background(), maxReplayAge)
+	defer cancel()
+	for _, f := range frames {
+		if err := conn.Send(ctx, f); err != nil {
+			return errors.Annotatef(err, "failed to re-send %d", f.ID)
+		}
+	}
+	return nil
+}
+
+// track remembers a request, so it can be sent again if the connection is lost before the response arrives.
+func (rwc *reconnectWrapperCodec) track(f *frame.Frame) bool {
+	if rwc.replayQueueLen <= 0 || f.Method == "" || f.ID == 0 || f.NoResponse {
+		return false
+	}
+	rwc.lock.Lock()
+	defer rwc.lock.Unlock()
+	if len(rwc.unacked) >= rwc.replayQueueLen {
+		glog.V(1).Infof("%s replay queue is full, dropping %d", rwc.stringLocked(), rwc.unacked[0].f.ID)
+		rwc.unacked = append(rwc.unacked[:0], rwc.unacked[1:]...)
+	}
+	rwc.unacked = append(rwc.unacked, unackedFrame{f: f, sent: time.Now()})
+	return true
+}
+
+func (rwc *reconnectWrapperCodec) untrack(id int64) {
+	rwc.lock.Lock()
+	defer rwc.lock.Unlock()
+	for i, uf := range rwc.unacked {
+		if uf.f.ID == id {
+			rwc.unacked = append(rwc.unacked[:i], rwc.unacked[i+1:]...)
+			return
+		}
+	}
+}
+
 func (rwc *reconnectWrapperCodec) getConn(ctx context.Context) (Codec, error) {
 	for {
 		rwc.lock.Lock()
@@ -139,6 +241,8 @@ func (rwc *reconnectWrapperCodec) getConn(ctx context.Context) (Codec, error) {
 		select {
 		case <-ctx.Done():
 			return nil, errors.Trace(ctx.Err())
+		case <-rwc.closeNotifier:
+			return nil, errors.Trace(io.EOF)
 		case err, ok := <-connEstd:
 			if ok {
 				return nil, errors.Annotatef(err, "fatal connection error, not reconnecting")
@@ -168,10 +272,19 @@ func (rwc *reconnectWrapperCodec) Recv(ctx context.Context) (*frame.Frame, error
 		}
 		switch {
 		case err == nil:
+			if frame.Method == "" && frame.ID != 0 && rwc.replayQueueLen > 0 {
+				rwc.untrack(frame.ID)
+			}
 			return frame, nil
 		case IsEOF(err):
 			rwc.closeConn()
-			return nil, errors.Trace(err)
+			select {
+			case <-rwc.closeNotifier:
+				return nil, errors.Trace(err)
+			default:
+				// Wait for the connection to be re-established.
+				continue
+			}
 		default:
 			return nil, errors.Trace(err)
 		}
@@ -184,9 +297,14 @@ func (rwc *reconnectWrapperCodec) Send(ctx context.Context, frame *frame.Frame)
 		if err != nil {
 			return errors.Trace(err)
 		}
+		tracked := rwc.track(frame)
 		err = conn.Send(ctx, frame)
 		if err != nil {
 			glog.V(1).Infof("%s send error: %s", rwc, err)
+			// It will be sent again by this loop, not replayed.
+			if tracked {
+				rwc.untrack(frame.ID)
+			}
 			rwc.closeConn()
 			continue
 		}
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package codec
+
+import (
+	"bytes"
+	"encoding/json"
+	"sync"
+
+	"github.com/juju/errors"
+
+	"github.com/mongoose-os/mos/common/mgrpc/frame"
+)
+
+const (
+	rxBufInitialSize = 16384
+	// Minimum amount of space to read into.
+	rxBufMinRead = 4096
+	// Frames larger than this are dropped.
+	maxFrameLen = 4 * 1024 * 1024
+	// Buffers larger than this are not returned to the pool.
+	maxPooledBufSize = 65536
+)
+
+// rxBuffer accumulates received data. Data is read directly into the free space
+// at the end of the buffer and parsed in place. Consumed space at the front is
+// reclaimed by moving the unconsumed data down when more room is needed, so the
+// buffer does not grow beyond the size of the largest frame plus one read.
+type rxBuffer struct {
+	buf  []byte
+	r, w int
+}
+
+// data returns unconsumed data. It is only valid until the next call to free().
+func (b *rxBuffer) data() []byte {
+	return b.buf[b.r:b.w]
+}
+
+func (b *rxBuffer) len() int {
+	return b.w - b.r
+}
+
+func (b *rxBuffer) consume(n int) {
+	b.r += n
+	if b.r == b.w {
+		b.r, b.w = 0, 0
+		// Do not hold on to memory after an unusually large frame.
+		if len(b.buf) > maxPooledBufSize {
+			b.buf = nil
+		}
+	}
+}
+
+// free returns space to read into, at least rxBufMinRead bytes long.
+func (b *rxBuffer) free() []byte {
+	if len(b.buf)-b.w < rxBufMinRead {
+		if b.r > 0 {
+			n := copy(b.buf, b.buf[b.r:b.w])
+			b.r, b.w = 0, n
+		}
+		if len(b.buf)-b.w < rxBufMinRead {
+			newSize := 2 * len(b.buf)
+			if newSize < rxBufInitialSize {
+				newSize = rxBufInitialSize
+			}
+			for newSize-b.w < rxBufMinRead {
+				newSize *= 2
+			}
+			nb := make([]byte, newSize)
+			copy(nb, b.buf[:b.w])
+			b.buf = nb
+		}
+	}
+	return b.buf[b.w:]
+}
+
+// commit marks n bytes returned by free() as filled.
+func (b *rxBuffer) commit(n int) {
+	b.w += n
+}
+
+var txBufPool = sync.Pool{
+	New: func() interface{} { return bytes.NewBuffer(make([]byte, 0, 1024)) },
+}
+
+func getTxBuf() *bytes.Buffer {
+	buf := txBufPool.Get().(*bytes.Buffer)
+	buf.Reset()
+	return buf
+}
+
+func putTxBuf(buf *bytes.Buffer) {
+	if buf.Cap() <= maxPooledBufSize {
+		txBufPool.Put(buf)
+	}
+}
+
+// encodeJSONFrameTo appends JSON encoding of the frame to buf, same as frame.MarshalJSON.
+func encodeJSONFrameTo(f *frame.Frame, buf *bytes.Buffer) error {
+	e := json.NewEncoder(buf)
+	e.SetEscapeHTML(false)
+	return errors.Trace(e.Encode(f))
+}
@@ -45,6 +45,12 @@ const (
 	interCharacterTimeout time.Duration = 200 * time.Millisecond
 
 	warnInterval = 25
+
+	// Frames queued for sending are coalesced into writes of up to this size.
+	maxSerialWriteBatch = 16384
+	// Once the device is known to use flow control, the amount sent between pauses
+	// grows from SendChunkSize up to this while the device keeps up.
+	maxSendCredit = 512
 )
 
 type SerialCodecOptions struct {
@@ -64,10 +70,19 @@ type serialCodec struct {
 	lastEOFTime     time.Time
 	handsShaken     bool
 	handsShakenLock sync.Mutex
-	writeLock       sync.Mutex
 	hsCounter       int
 	warnCounter     int
 
+	// Writes are queued and performed by the writer goroutine.
+	wqLock      sync.Mutex
+	wq          []*serialWrite
+	wqNotify    chan struct{}
+	wbuf        []byte
+	writeCtx    context.Context
+	closeNotify chan struct{}
+	closeOnce   sync.Once
+	cancelWrite context.CancelFunc
+
 	// Underlying serial port implementation allows concurrent Read/Write, but
 	// calling Close while Read/Write is in progress results in a race. A
 	// read-write lock fits perfectly for this case: for either Read or Write we
@@ -80,6 +95,15 @@ type serialCodec struct {
 	// xonLock should only be acquired to obtain the channel, it should not be held while waiting.
 	xonChan chan interface{}
 	xonLock sync.Mutex
+	// Set when the device first sends XOFF. Pacing is then driven by flow control instead of fixed delays.
+	fcSeen        bool
+	xoffSinceLast bool
+	sendCredit    int
+}
+
+type serialWrite struct {
+	data []byte
+	done chan error
 }
 
 func Serial(ctx context.Context, portName string, opts *SerialCodecOptions) (Codec, error) {
@@ -118,8 +142,12 @@ func Serial(ctx context.Context, portName string, opts *SerialCodecOptions) (Cod
 		conn:        s,
 		handsShaken: false,
 		xonChan:     make(chan interface{}),
+		wqNotify:    make(chan struct{}, 1),
+		closeNotify: make(chan struct{}),
 	}
+	sc.writeCtx, sc.cancelWrite = context.WithCancel(context.Background())
 	close(sc.xonChan) // Sending is initially allowed
+	go sc.writer()
 	return newStreamConn(sc, true /* addChecksum */, opts.JunkHandler), nil
 }
 
@@ -161,6 +189,8 @@ func (c *serialCodec) blockWrite() {
 	default:
 		// nothing - channel is open, sending is already blocked
 	}
+	c.fcSeen = true
+	c.xoffSinceLast = true
 	c.xonLock.Unlock()
 }
 
@@ -197,15 +227,17 @@ func (c *serialCodec) connWrite(ctx context.Context, buf []byte) (written int, e
 	// details.
 	c.closeLock.RLock()
 	defer c.closeLock.RUnlock()
-	chunkSize := c.opts.SendChunkSize
-	if chunkSize > 0 {
-		for i := 0; i < len(buf); i += chunkSize {
-			n, err := c.connWriteWithFC(ctx, buf[i:min(i+chunkSize, len(buf))])
+	if c.opts.SendChunkSize > 0 {
+		for written < len(buf) {
+			chunkSize, paced := c.nextChunkSize()
+			n, err := c.connWriteWithFC(ctx, buf[written:min(written+chunkSize, len(buf))])
 			written += n
 			if err != nil {
 				return written, errors.Trace(err)
 			}
-			time.Sleep(c.opts.SendChunkDelay)
+			if paced {
+				time.Sleep(c.opts.SendChunkDelay)
+			}
 		}
 		return written, nil
 	} else {
@@ -221,7 +253,33 @@ func (c *serialCodec) connWrite(ctx context.Context, buf []byte) (written int, e
 	}
 }
 
+// nextChunkSize returns the number of bytes to send before pausing and whether
+// a fixed SendChunkDelay pause is needed after that.
+// Until the device has shown that it uses XON/XOFF, chunks of SendChunkSize are sent
+// with a fixed delay between them. After that, the delay is dropped and XOFF alone pauses
+// sending: the chunk size doubles while the device keeps up and is halved after every XOFF.
+func (c *serialCodec) nextChunkSize() (int, bool) {
+	c.xonLock.Lock()
+	defer c.xonLock.Unlock()
+	minCredit := c.opts.SendChunkSize
+	if !c.fcSeen {
+		return minCredit, true
+	}
+	if c.xoffSinceLast {
+		c.sendCredit /= 2
+		c.xoffSinceLast = false
+	} else {
+		c.sendCredit *= 2
+	}
+	c.sendCredit = max(minCredit, min(c.sendCredit, max(minCredit, maxSendCredit)))
+	return c.sendCredit, false
+}
+
 func (c *serialCodec) connClose() error {
+	c.closeOnce.Do(func() {
+		close(c.closeNotify)
+		c.cancelWrite()
+	})
 	// Close can't be called concurrently with Read/Write, so, lock closeLock
 	// for writing.
 	c.closeLock.Lock()
@@ -248,9 +306,100 @@ func (c *serialCodec) Read(buf []byte) (read int, err error) {
 	return res, errors.Trace(err)
 }
 
+// WriteWithContext queues data for the writer goroutine and waits for it to be sent.
 func (c *serialCodec) WriteWithContext(ctx context.Context, b []byte) (written int, err error) {
-	c.writeLock.Lock()
-	defer c.writeLock.Unlock()
+	w := &serialWrite{data: b, done: make(chan error, 1)}
+	c.wqLock.Lock()
+	c.wq = append(c.wq, w)
+	c.wqLock.Unlock()
+	select {
+	case c.wqNotify <- struct{}{}:
+	default:
+	}
+	select {
+	case err := <-w.done:
+		if err != nil {
+			return 0, errors.Trace(err)
+		}
+		return len(b), nil
+	case <-ctx.Done():
+		// If the writer has already taken the data, it has been copied and will still be sent.
+		c.dequeue(w)
+		return 0, ctx.Err()
+	case <-c.closeNotify:
+		c.dequeue(w)
+		return 0, errors.Trace(io.EOF)
+	}
+}
+
+func (c *serialCodec) dequeue(w *serialWrite) {
+	c.wqLock.Lock()
+	defer c.wqLock.Unlock()
+	for i, qw := range c.wq {
+		if qw == w {
+			c.wq = append(c.wq[:i], c.wq[i+1:]...)
+			break
+		}
+	}
+}
+
+func (c *serialCodec) queueLen() int {
+	c.wqLock.Lock()
+	defer c.wqLock.Unlock()
+	return len(c.wq)
+}
+
+// takeBatch removes queued writes from the queue and returns their data, concatenated.
+// The data is only valid until the next call.
+func (c *serialCodec) takeBatch() ([]byte, []*serialWrite) {
+	c.wqLock.Lock()
+	defer c.wqLock.Unlock()
+	data := c.wbuf[:0]
+	n := 0
+	for ; n < len(c.wq); n++ {
+		if n > 0 && len(data)+len(c.wq[n].data) > maxSerialWriteBatch {
+			break
+		}
+		data = append(data, c.wq[n].data...)
+	}
+	ws := make([]*serialWrite, n)
+	copy(ws, c.wq)
+	c.wq = append(c.wq[:0], c.wq[n:]...)
+	if cap(data) <= maxPooledBufSize {
+		c.wbuf = data
+	}
+	return data, ws
+}
+
+// writer performs queued writes. Frames queued while a write is in progress
+// are sent together in the next one.
+func (c *serialCodec) writer() {
+	for {
+		select {
+		case <-c.wqNotify:
+		case <-c.closeNotify:
+			return
+		}
+		for c.queueLen() > 0 {
+			err := c.handshake(c.writeCtx)
+			if err == nil && !c.areHandsShaken() {
+				// Writers gave up while waiting for handshake, retry if more were queued meanwhile.
+				continue
+			}
+			data, ws := c.takeBatch()
+			if err == nil && len(ws) > 0 {
+				glog.V(4).Infof("writing %d frames, %d bytes", len(ws), len(data))
+				_, err = c.connWrite(c.writeCtx, data)
+			}
+			for _, w := range ws {
+				w.done <- err
+			}
+		}
+	}
+}
+
+// handshake makes sure the other side is listening. It gives up when there is nothing left to send.
+func (c *serialCodec) handshake(ctx context.Context) error {
 	if c.opts.SendChunkDelay != 0 {
 		// If user wants faster transfers, save time on handshake after initial one.
 		c.setHandsShaken(false)
@@ -262,24 +411,27 @@ func (c *serialCodec) WriteWithContext(ctx context.Context, b []byte) (written i
 		c.unblockWrite()
 		glog.V(1).Infof("sending handshake...")
 		if _, err := c.connWrite(ctx, hs); err != nil {
-			return 0, errors.Trace(err)
+			return errors.Trace(err)
 		}
 		select {
 		case <-ctx.Done():
-			return 0, ctx.Err()
+			return ctx.Err()
 		case <-time.After(handshakeInterval):
 			c.warnCounter++
 			if c.warnCounter >= warnInterval {
 				glog.Errorf("No response to handshake. Is %s the right port? Is rpc-uart enabled?", c.portName)
 				c.warnCounter = 0
 			}
-			break
+		}
+		if c.queueLen() == 0 {
+			// All the writers gave up waiting.
+			return nil
 		}
 	}
 	// Device is ready, send data.
 	// We start with writes unblocked, since we just had a successful sync.
 	c.unblockWrite()
-	return c.connWrite(ctx, b)
+	return nil
 }
 
 func (c *serialCodec) Close() error {
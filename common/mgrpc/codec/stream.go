@@ -19,6 +19,7 @@ package codec
 import (
 	"bytes"
 	"context"
+	"encoding/binary"
 	"encoding/json"
 	"fmt"
 	"hash/crc32"
@@ -31,6 +32,7 @@ import (
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/common/mgrpc/frame"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
 	glog "k8s.io/klog/v2"
 )
 
@@ -39,6 +41,21 @@ const (
 	streamFrameDelimiter1 string = `"""`
 	// New delimiter (as of 2018/06/14).
 	streamFrameDelimiter2 string = "\n"
+
+	// Binary frames start with streamFrameDelimiter1 followed by this marker,
+	// which cannot start a JSON frame. Marker is followed by 8 hex digits of the body length,
+	// then the escaped body: frame encoded with frame.MarshalBinary followed by big-endian CRC32.
+	binaryFrameMarker    byte = 0x02
+	binaryFrameLenDigits      = 8
+	maxBinaryFrameLen         = 1 << 20
+	// Bytes that cannot appear in the body of a binary frame (XON/XOFF are used for flow control)
+	// are replaced with binaryFrameEscape followed by the byte XOR binaryFrameEscapeXOR.
+	binaryFrameEscape    byte = 0x7d
+	binaryFrameEscapeXOR byte = 0x20
+
+	// Peers that support binary framing advertise it by sending this frame during handshake.
+	// Once received, we switch to sending binary frames, the peer replies in kind.
+	binaryFramesAdvert = `{"binary_frames":1}`
 )
 
 var wantRead = errors.New("wantRead")
@@ -61,6 +78,8 @@ type streamConn interface {
 type streamConnectionCodec struct {
 	// Stream connection implementation (see tcp.go and serial.go).
 	conn streamConn
+	// Name of the connection type, for stats.
+	kind string
 
 	// EOF flags and their lock.
 	eof          bool
@@ -68,8 +87,12 @@ type streamConnectionCodec struct {
 	eofLock      sync.Mutex
 
 	// Rx buffer and its lock.
-	rxBuf     []byte
+	rxBuf     rxBuffer
 	rxBufLock sync.Mutex
+	// Parser state: whether there is a frame at the beginning of rxBuf whose end
+	// is yet to be received, and how much of rxBuf has already been scanned.
+	inFrame bool
+	scanned int
 
 	// A channel that gets closed once the underlying connection has been closed,
 	// and its lock.
@@ -79,12 +102,24 @@ type streamConnectionCodec struct {
 	// Whether to add a CRC32 checksum after each frame.
 	addChecksum bool
 
+	// Whether the peer supports binary frames, and its lock.
+	binaryFrames     bool
+	binaryFramesLock sync.Mutex
+
 	junkHandler func(junk []byte)
 }
 
 func newStreamConn(conn streamConn, addChecksum bool, junkHandler func(junk []byte)) Codec {
+	kind := "stream"
+	switch conn.(type) {
+	case *serialCodec:
+		kind = "serial"
+	case *tcpCodec:
+		kind = "tcp"
+	}
 	return &streamConnectionCodec{
 		conn:          conn,
+		kind:          kind,
 		closeNotifier: make(chan struct{}),
 
 		addChecksum: addChecksum,
@@ -96,160 +131,274 @@ func (scc *streamConnectionCodec) String() string {
 	return fmt.Sprintf("[streamConnectionCodec to %s]", scc.conn.RemoteAddr())
 }
 
-// tailMatch returns the number of bytes of needle that match at the tail of haystack,
-// i.e. how many bytes need to be kept in order to be able to match the needle with
-// additional data.
-func tailMatch(haystack, needle []byte) int {
-	for l := len(needle); l > 0; l-- {
-		if bytes.HasSuffix(haystack, needle[0:l]) {
-			return l
+// indexDelimiter returns position and length of the first frame delimiter in data at or after from.
+// If data ends with what may be a prefix of a delimiter, its position is returned with zero length.
+func indexDelimiter(data []byte, from int) (int, int) {
+	for from < len(data) {
+		i := bytes.IndexAny(data[from:], "\n\"")
+		if i < 0 {
+			return -1, 0
+		}
+		i += from
+		if data[i] == '\n' {
+			return i, len(streamFrameDelimiter2)
+		}
+		n := len(streamFrameDelimiter1)
+		if i+n > len(data) {
+			if bytes.HasPrefix([]byte(streamFrameDelimiter1), data[i:]) {
+				return i, 0
+			}
+		} else if string(data[i:i+n]) == streamFrameDelimiter1 {
+			return i, n
 		}
+		from = i + 1
+	}
+	return -1, 0
+}
+
+func frameDelimiterLen(data []byte) int {
+	if len(data) > 0 && data[0] == '\n' {
+		return len(streamFrameDelimiter2)
 	}
-	return 0
+	return len(streamFrameDelimiter1)
+}
+
+// consume discards n bytes at the beginning of rx buffer.
+func (scc *streamConnectionCodec) consume(n int) {
+	scc.rxBuf.consume(n)
+	scc.scanned -= n
+	if scc.scanned < 0 {
+		scc.scanned = 0
+	}
+}
+
+// consumeJunk yields n bytes at the beginning of rx buffer as junk.
+func (scc *streamConnectionCodec) consumeJunk(n int) {
+	if n <= 0 {
+		return
+	}
+	junk := scc.rxBuf.data()[:n]
+	if scc.junkHandler != nil {
+		// Handler may hold on to or modify the data, so give it a copy.
+		scc.junkHandler(append([]byte(nil), junk...))
+	} else {
+		glog.V(4).Infof("junk: %s", junk)
+	}
+	scc.consume(n)
 }
 
 // frameFromRxBuf tries to get frame from rx buffer, returns a frame or nil if
 // there are no valid frames received.
+// Scanning resumes where it stopped the last time, so each byte is examined once
+// no matter how many reads it takes to receive a frame.
 func (scc *streamConnectionCodec) frameFromRxBuf() (*frame.Frame, error) {
-	var err error
-	var junk, frameData, remainder []byte
-	var junkLen, frameBegin, frameDataBegin, frameDataEnd, frameEnd int
-	remainder = scc.rxBuf
-	frameBegin1 := bytes.Index(remainder, []byte(streamFrameDelimiter1))
-	frameBegin2 := bytes.Index(remainder, []byte(streamFrameDelimiter2))
-	frameBegin = min(frameBegin1, frameBegin2)
-	if frameBegin < 0 {
-		frameBegin = max(frameBegin1, frameBegin2)
-	}
-	frameEnd = -1
-	// Yield stuff before begin as junk, except suffix which can become part of a match.
-	if frameBegin >= 0 {
-		junkLen = frameBegin
-		frameBeginLen := 0
-		// It's a beginning of a frame if it is followed by an opening brace.
-		if frameBegin == frameBegin1 {
-			frameBeginLen = len(streamFrameDelimiter1)
-		} else {
-			frameBeginLen = len(streamFrameDelimiter2)
-		}
-		frameDataBegin = frameBeginLen
-		if frameDataBegin < len(remainder) {
-			if remainder[frameDataBegin] != '{' && remainder[frameDataBegin] != eofChar {
+	for {
+		data := scc.rxBuf.data()
+		if !scc.inFrame {
+			// Look for the beginning of a frame, anything before it is junk.
+			pos, dl := indexDelimiter(data, scc.scanned)
+			if pos < 0 {
+				scc.consumeJunk(len(data))
+				return nil, wantRead
+			}
+			// Keep delimiter (or its prefix) and wait for more data.
+			scc.consumeJunk(pos)
+			if dl == 0 || dl >= scc.rxBuf.len() {
+				scc.scanned = 0
+				return nil, wantRead
+			}
+			data = scc.rxBuf.data()
+			switch c := data[dl]; {
+			case c == binaryFrameMarker && dl == len(streamFrameDelimiter1):
+				f, err := scc.binaryFrameFromRxBuf()
+				if f == nil && err == nil {
+					continue
+				}
+				return f, err
+			case c == '{' || c == eofChar:
+				// It's a beginning of a frame if it is followed by an opening brace.
+				scc.inFrame = true
+				scc.scanned = dl
+			default:
 				// It's some random junk or maybe we lost sync, skip the thing.
-				junkLen += frameBeginLen
-				frameBegin = -1
-				frameDataBegin = -1
+				scc.consumeJunk(dl)
 			}
-		} else {
-			// Wait for one more byte.
-			frameBegin = -1
-			frameDataBegin = -1
-			err = wantRead
-		}
-	} else {
-		junkLen = len(scc.rxBuf) - tailMatch(scc.rxBuf, []byte(streamFrameDelimiter1))
-		err = wantRead
-	}
-	if junkLen > 0 {
-		junk = scc.rxBuf[:junkLen]
-		remainder = scc.rxBuf[junkLen:]
-		if scc.junkHandler != nil {
-			scc.junkHandler(junk)
-		} else {
-			glog.V(4).Infof("junk: %s", junk)
+			continue
 		}
-	}
-	if frameBegin >= 0 && len(remainder) >= len(streamFrameDelimiter1)*2 {
-		frameDataEnd1 := bytes.Index(scc.rxBuf[frameDataBegin:], []byte(streamFrameDelimiter1))
-		frameDataEnd2 := bytes.Index(scc.rxBuf[frameDataBegin:], []byte(streamFrameDelimiter2))
-		frameDataEnd = min(frameDataEnd1, frameDataEnd2)
-		if frameDataEnd < 0 {
-			frameDataEnd = max(frameDataEnd1, frameDataEnd2)
-		}
-		if frameDataEnd >= 0 {
-			if frameDataEnd == frameDataEnd1 {
-				frameEnd = frameDataEnd + len(streamFrameDelimiter1)
+		// There is a frame at the beginning of the buffer, look for its end.
+		dataBegin := frameDelimiterLen(data)
+		pos, dl := indexDelimiter(data, scc.scanned)
+		frameEnd := pos + dl
+		if pos < 0 || dl == 0 {
+			if pos >= 0 {
+				scc.scanned = pos
 			} else {
-				frameEnd = frameDataEnd + len(streamFrameDelimiter2)
+				scc.scanned = len(data)
 			}
-			frameDataEnd += frameDataBegin
-			frameEnd += frameDataBegin
-		} else {
 			// We have not received frame delimeter, so let's see if we've got EOF then
 			scc.eofLock.Lock()
-			if scc.eof {
-				// Yes we have EOF. If we were waiting so we'll consider all data in the Rx buffer as a frame
-				frameEnd = len(remainder)
+			eof := scc.eof
+			if eof {
+				// Yes we have EOF. We'll consider all data in the Rx buffer as a frame
 				scc.lastFrameEof = true
 			}
 			scc.eofLock.Unlock()
+			if !eof {
+				if len(data) > maxFrameLen {
+					glog.Errorf("%s: frame is too long (%d), dropping", scc, len(data))
+					scc.inFrame = false
+					scc.consumeJunk(len(data))
+				}
+				return nil, wantRead
+			}
+			pos, frameEnd = len(data), len(data)
 		}
+		frameData := data[dataBegin:pos]
+		glog.V(4).Infof("len %d frameEnd %d '%s'", len(data), frameEnd, frameData)
+		scc.inFrame = false
+		// Frame data references the buffer, consume it only when done.
+		f, err := scc.parseFrame(frameData)
+		scc.consume(frameEnd)
+		if f != nil {
+			stats.AddWire(scc.kind, false /* tx */, frameEnd)
+		}
+		return f, err
 	}
-	if frameDataBegin > 0 && frameDataEnd > 0 {
-		frameData = scc.rxBuf[frameDataBegin:frameDataEnd]
-		remainder = scc.rxBuf[frameEnd:]
+}
+
+func (scc *streamConnectionCodec) parseFrame(frameData []byte) (*frame.Frame, error) {
+	// Check if the frame needs special treatment
+	handled, err := scc.conn.PreprocessFrame(frameData)
+	if err != nil {
+		return nil, errors.Trace(err)
 	}
-	glog.V(4).Infof("len %d junkLen %d frameBegin %d frameEnd %d remLen %d '%s' '%s' '%s'", len(scc.rxBuf), junkLen, frameBegin, frameEnd, len(remainder), junk, frameData, remainder)
-	if len(remainder) != len(scc.rxBuf) {
-		// Update rxBuf to contain only remainder of the data. We create a new slice
-		// instead of just doing "scc.rxBuf = remainder", because then underlying
-		// array of rxBuf would constantly grow, and memory for parsed data will
-		// never be reclaimed.
-		scc.rxBuf = make([]byte, len(remainder))
-		copy(scc.rxBuf, remainder)
+	if handled {
+		// The frame has been treated specially, so here we just ignore it.
+		return nil, nil
 	}
 
-	if len(frameData) > 0 {
-		// Check if the frame needs special treatment
-		handled, err := scc.conn.PreprocessFrame(frameData)
+	// See if the frame comes with a checksum. If yes, strip and verify it.
+	frameData = trimWhitespace(frameData)
+	framePayload := frameData
+	var meta []byte
+	i := len(frameData) - 1
+	for i > 0 && frameData[i] != '}' {
+		meta = frameData[i:]
+		framePayload = frameData[:i]
+		i--
+	}
+	if len(meta) > 0 {
+		fields := strings.Split(string(meta), ",")
+		expectedCRC, err := strconv.ParseInt(fields[0], 16, 64)
+		glog.V(4).Infof("frame metadata: %q, expected CRC: %08x", fields, expectedCRC)
 		if err != nil {
-			return nil, errors.Trace(err)
+			return nil, errors.Annotatef(err, "malformed frame metadata: %q", meta)
 		}
-		if handled {
-			// The frame has been treated specially, so here we just ignore it.
-			return nil, nil
+		crc := crc32.ChecksumIEEE(framePayload)
+		if crc != uint32(expectedCRC) {
+			return nil, errors.Errorf("CRC mismatch: expected 0x%08x, got 0x%08x", expectedCRC, crc)
 		}
+	}
 
-		// See if the frame comes with a checksum. If yes, strip and verify it.
-		frameData = trimWhitespace(frameData)
-		framePayload := frameData
-		var meta []byte
-		i := len(frameData) - 1
-		for i > 0 && frameData[i] != '}' {
-			meta = frameData[i:]
-			framePayload = frameData[:i]
-			i--
-		}
-		if len(meta) > 0 {
-			fields := strings.Split(string(meta), ",")
-			expectedCRC, err := strconv.ParseInt(fields[0], 16, 64)
-			glog.V(4).Infof("frame metadata: %q, expected CRC: %08x", fields, expectedCRC)
-			if err != nil {
-				return nil, errors.Annotatef(err, "malformed frame metadata: %q", meta)
-			}
-			crc := crc32.ChecksumIEEE(framePayload)
-			if crc != uint32(expectedCRC) {
-				return nil, errors.Errorf("CRC mismatch: expected 0x%08x, got 0x%08x", expectedCRC, crc)
-			}
-		}
+	if string(framePayload) == binaryFramesAdvert {
+		glog.V(1).Infof("%s: peer supports binary frames", scc)
+		scc.setBinaryFrames(true)
+		return nil, nil
+	}
 
-		// Try to parse framePayload.
-		frame := &frame.Frame{SizeHint: len(framePayload)}
-		err = json.Unmarshal(framePayload, frame)
+	// Try to parse framePayload.
+	frame := &frame.Frame{SizeHint: len(framePayload)}
+	err = json.Unmarshal(framePayload, frame)
 
-		if err != nil {
-			// There was an error during parsing, so just log the error and drop the
-			// erroneous data
-			glog.Errorf("%s: failed to parse frame: %#v %+v", scc, string(frameData), err)
-			return nil, nil
+	if err != nil {
+		// There was an error during parsing, so just log the error and drop the
+		// erroneous data
+		glog.Errorf("%s: failed to parse frame: %#v %+v", scc, string(frameData), err)
+		return nil, nil
+	}
+	return frame, nil
+}
+
+// binaryFrameFromRxBuf parses a binary frame at the beginning of rx buffer.
+func (scc *streamConnectionCodec) binaryFrameFromRxBuf() (*frame.Frame, error) {
+	hdrLen := len(streamFrameDelimiter1) + 1 + binaryFrameLenDigits
+	data := scc.rxBuf.data()
+	if len(data) < hdrLen {
+		return nil, wantRead
+	}
+	bodyLen, err := strconv.ParseUint(string(data[hdrLen-binaryFrameLenDigits:hdrLen]), 16, 32)
+	if err != nil || bodyLen > maxBinaryFrameLen {
+		// Not a valid frame after all, drop the delimiter and resync.
+		scc.consumeJunk(len(streamFrameDelimiter1))
+		return nil, nil
+	}
+	frameLen := hdrLen + int(bodyLen)
+	if len(data) < frameLen {
+		return nil, wantRead
+	}
+	// Unescaping copies the data, so the blob does not reference the buffer.
+	body, err := unescapeBinary(data[hdrLen:frameLen])
+	scc.consume(frameLen)
+	if err == nil && len(body) < 4 {
+		err = errors.Errorf("frame too short")
+	}
+	var f *frame.Frame
+	if err == nil {
+		payload := body[:len(body)-4]
+		expectedCRC := binary.BigEndian.Uint32(body[len(body)-4:])
+		if crc := crc32.ChecksumIEEE(payload); crc != expectedCRC {
+			err = errors.Errorf("CRC mismatch: expected 0x%08x, got 0x%08x", expectedCRC, crc)
+		} else {
+			f, err = frame.UnmarshalBinary(payload)
 		}
-		return frame, nil
-	} else {
-		if frameDataBegin > 0 {
-			err = wantRead
+	}
+	if err != nil {
+		// Frame boundaries are known, so just drop the frame.
+		glog.Errorf("%s: failed to parse binary frame: %s", scc, err)
+		return nil, nil
+	}
+	stats.AddWire(scc.kind, false /* tx */, frameLen)
+	return f, nil
+}
+
+func escapeBinary(dst, src []byte) []byte {
+	for _, b := range src {
+		switch b {
+		case xonChar, xoffChar, binaryFrameEscape:
+			dst = append(dst, binaryFrameEscape, b^binaryFrameEscapeXOR)
+		default:
+			dst = append(dst, b)
 		}
-		return nil, err
 	}
+	return dst
+}
+
+func unescapeBinary(src []byte) ([]byte, error) {
+	dst := make([]byte, 0, len(src))
+	for i := 0; i < len(src); i++ {
+		b := src[i]
+		if b == binaryFrameEscape {
+			i++
+			if i == len(src) {
+				return nil, errors.Errorf("truncated escape sequence")
+			}
+			b = src[i] ^ binaryFrameEscapeXOR
+		}
+		dst = append(dst, b)
+	}
+	return dst, nil
+}
+
+func (scc *streamConnectionCodec) useBinaryFrames() bool {
+	scc.binaryFramesLock.Lock()
+	defer scc.binaryFramesLock.Unlock()
+	return scc.binaryFrames
+}
+
+func (scc *streamConnectionCodec) setBinaryFrames(enable bool) {
+	scc.binaryFramesLock.Lock()
+	defer scc.binaryFramesLock.Unlock()
+	scc.binaryFrames = enable
 }
 
 func trimWhitespace(b []byte) []byte {
@@ -270,11 +419,10 @@ func trimWhitespace(b []byte) []byte {
 func (scc *streamConnectionCodec) Recv(ctx context.Context) (*frame.Frame, error) {
 	scc.rxBufLock.Lock()
 	defer scc.rxBufLock.Unlock()
-	buf := make([]byte, 10000)
 	var frame *frame.Frame
 	for {
 		var err error
-		for len(scc.rxBuf) > 0 && err != wantRead {
+		for scc.rxBuf.len() > 0 && err != wantRead {
 			frame, err = scc.frameFromRxBuf()
 			if err != nil && err != wantRead {
 				return nil, errors.Trace(err)
@@ -283,18 +431,19 @@ func (scc *streamConnectionCodec) Recv(ctx context.Context) (*frame.Frame, error
 				return frame, nil
 			}
 		}
+		buf := scc.rxBuf.free()
 		readLen, err := scc.conn.Read(buf)
 		eof := IsEOF(err)
 		scc.eofLock.Lock()
 		scc.eof = eof
 		lastFrameEof := scc.lastFrameEof
 		scc.eofLock.Unlock()
-		glog.V(3).Infof("%d bytes read, err %q, eof? %t buffer: [%s]", readLen, err, eof, string(scc.rxBuf))
+		glog.V(3).Infof("%d bytes read, err %q, eof? %t data: [%s]", readLen, err, eof, string(buf[:readLen]))
 		if err != nil && err != io.EOF {
 			scc.Close()
 			return nil, errors.Trace(err)
 		}
-		if len(scc.rxBuf) == 0 && eof {
+		if scc.rxBuf.len() == 0 && eof {
 			// Heuristic to maintain "netcat-ability": terminate half-closed
 			// connection immediately unless the last successfully parsed frame ended
 			// at EOF and not at a delimiter.
@@ -305,31 +454,73 @@ func (scc *streamConnectionCodec) Recv(ctx context.Context) (*frame.Frame, error
 			}
 			return nil, errors.Trace(io.EOF)
 		}
-		// TODO(rojer): Limit frame buffer size.
-		scc.rxBuf = append(scc.rxBuf, buf[:readLen]...)
+		scc.rxBuf.commit(readLen)
 	}
 }
 
-func (scc *streamConnectionCodec) Send(ctx context.Context, f *frame.Frame) error {
-	frameData := []byte(streamFrameDelimiter2)
-	frameData = append(frameData, []byte(streamFrameDelimiter1)...)
-	framePayload, err := frame.MarshalJSON(f)
-	if err != nil {
+func (scc *streamConnectionCodec) encodeJSONFrame(f *frame.Frame, buf *bytes.Buffer) error {
+	if len(f.Blob) > 0 {
+		return errors.Errorf("binary attachment requires binary framing, which is not supported by the peer")
+	}
+	buf.WriteString(streamFrameDelimiter2)
+	buf.WriteString(streamFrameDelimiter1)
+	payloadBegin := buf.Len()
+	e := json.NewEncoder(buf)
+	e.SetEscapeHTML(false)
+	if err := e.Encode(f); err != nil {
 		return errors.Trace(err)
 	}
-	framePayload = trimWhitespace(framePayload)
-	frameData = append(frameData, framePayload...)
+	framePayload := trimWhitespace(buf.Bytes()[payloadBegin:])
+	buf.Truncate(payloadBegin + len(framePayload))
 	if scc.addChecksum {
-		crcHex := fmt.Sprintf("%08x", crc32.ChecksumIEEE(framePayload))
-		frameData = append(frameData, []byte(crcHex)...)
+		fmt.Fprintf(buf, "%08x", crc32.ChecksumIEEE(framePayload))
+	}
+	buf.WriteString(streamFrameDelimiter1)
+	buf.WriteString(streamFrameDelimiter2)
+	return nil
+}
+
+func encodeBinaryFrame(f *frame.Frame, buf *bytes.Buffer) error {
+	payload, err := frame.MarshalBinary(f)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	var crc [4]byte
+	binary.BigEndian.PutUint32(crc[:], crc32.ChecksumIEEE(payload))
+	hdrLen := len(streamFrameDelimiter2) + len(streamFrameDelimiter1) + 1 + binaryFrameLenDigits
+	frameData := buf.Bytes()[:0]
+	frameData = append(frameData, make([]byte, hdrLen)...)
+	frameData = escapeBinary(frameData, payload)
+	frameData = escapeBinary(frameData, crc[:])
+	bodyLen := len(frameData) - hdrLen
+	if bodyLen > maxBinaryFrameLen {
+		return errors.Errorf("frame is too big (%d)", bodyLen)
+	}
+	hdr := fmt.Sprintf("%s%s%c%0*x", streamFrameDelimiter2, streamFrameDelimiter1, binaryFrameMarker, binaryFrameLenDigits, bodyLen)
+	copy(frameData, hdr)
+	buf.Reset()
+	buf.Write(frameData)
+	return nil
+}
+
+func (scc *streamConnectionCodec) Send(ctx context.Context, f *frame.Frame) error {
+	buf := getTxBuf()
+	defer putTxBuf(buf)
+	var err error
+	if scc.useBinaryFrames() {
+		err = encodeBinaryFrame(f, buf)
+	} else {
+		err = scc.encodeJSONFrame(f, buf)
+	}
+	if err != nil {
+		return errors.Trace(err)
 	}
-	frameData = append(frameData, []byte(streamFrameDelimiter1)...)
-	frameData = append(frameData, []byte(streamFrameDelimiter2)...)
-	_, err = scc.conn.WriteWithContext(ctx, frameData)
+	_, err = scc.conn.WriteWithContext(ctx, buf.Bytes())
 	if err != nil {
 		scc.Close()
 		return errors.Trace(err)
 	}
+	stats.AddWire(scc.kind, true /* tx */, buf.Len())
 	scc.eofLock.Lock()
 	if scc.eof {
 		// Sender has closed and this was the one frame we were waiting for and now it's time to close.
@@ -355,7 +546,7 @@ func (scc *streamConnectionCodec) MaxNumFrames() int {
 }
 
 func (scc *streamConnectionCodec) Info() ConnectionInfo {
-	return ConnectionInfo{RemoteAddr: scc.conn.RemoteAddr(), IsConnected: true}
+	return ConnectionInfo{RemoteAddr: scc.conn.RemoteAddr(), IsConnected: true, BinaryFrames: scc.useBinaryFrames()}
 }
 
 func (scc *streamConnectionCodec) SetOptions(opts *Options) error {
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package codec
+
+import (
+	"bytes"
+	"context"
+	"fmt"
+	"strings"
+	"testing"
+
+	"github.com/mongoose-os/mos/common/mgrpc/frame"
+)
+
+// nullStreamConn is a stream connection that is never read from or written to.
+type nullStreamConn struct{}
+
+func (nullStreamConn) Read(p []byte) (int, error) {
+	return 0, nil
+}
+
+func (nullStreamConn) Close() error {
+	return nil
+}
+
+func (nullStreamConn) WriteWithContext(ctx context.Context, p []byte) (int, error) {
+	return len(p), nil
+}
+
+func (nullStreamConn) RemoteAddr() string {
+	return "null"
+}
+
+func (nullStreamConn) PreprocessFrame(frameData []byte) (bool, error) {
+	return false, nil
+}
+
+func (nullStreamConn) SetOptions(opts *Options) error {
+	return nil
+}
+
+// benchFrames returns n frames of the kind devices send during FS.Get, with base64 data.
+func benchFrames(b *testing.B, scc *streamConnectionCodec, binary bool, n int) []byte {
+	var res bytes.Buffer
+	result := fmt.Sprintf(`{"data":%q,"left":0}`, strings.Repeat("QUJDRA==", 512))
+	for i := 0; i < n; i++ {
+		f := frame.NewResponseFrame("dev", "mos", "", &frame.Response{ID: int64(i + 1), Response: []byte(result)})
+		buf := &bytes.Buffer{}
+		var err error
+		if binary {
+			err = encodeBinaryFrame(f, buf)
+		} else {
+			err = scc.encodeJSONFrame(f, buf)
+		}
+		if err != nil {
+			b.Fatal(err)
+		}
+		res.Write(buf.Bytes())
+	}
+	return res.Bytes()
+}
+
+func BenchmarkFrameFromRxBuf(b *testing.B) {
+	for _, binary := range []bool{false, true} {
+		b.Run(fmt.Sprintf("binary=%t", binary), func(b *testing.B) {
+			scc := newStreamConn(nullStreamConn{}, true /* addChecksum */, nil).(*streamConnectionCodec)
+			const numFrames = 100
+			data := benchFrames(b, scc, binary, numFrames)
+			b.SetBytes(int64(len(data)))
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				// Feed the data in chunks, the way reads from the port do.
+				numParsed := 0
+				for rem := data; len(rem) > 0; {
+					n := copy(scc.rxBuf.free(), rem)
+					scc.rxBuf.commit(n)
+					rem = rem[n:]
+					for {
+						f, err := scc.frameFromRxBuf()
+						if err == wantRead {
+							break
+						} else if err != nil {
+							b.Fatal(err)
+						}
+						if f != nil {
+							numParsed++
+						}
+					}
+				}
+				if numParsed != numFrames {
+					b.Fatalf("parsed %d frames, want %d", numParsed, numFrames)
+				}
+			}
+		})
+	}
+}
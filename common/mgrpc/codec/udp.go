@@ -28,6 +28,8 @@ import (
 
 const (
 	UDPURLScheme = "udp"
+
+	udpMaxFrameLen = 10000
 )
 
 type UDPCodecOptions struct {
@@ -35,6 +37,8 @@ type UDPCodecOptions struct {
 
 type udpCodec struct {
 	conn net.Conn
+	// Frames are received one at a time, so the buffer is reused.
+	rxBuf []byte
 }
 
 func UDP(addr string) Codec {
@@ -46,7 +50,10 @@ func UDP(addr string) Codec {
 }
 
 func (c *udpCodec) Recv(ctx context.Context) (*frame.Frame, error) {
-	buf := make([]byte, 10000)
+	if c.rxBuf == nil {
+		c.rxBuf = make([]byte, udpMaxFrameLen)
+	}
+	buf := c.rxBuf
 	readLen, err := c.conn.Read(buf)
 	if err != nil {
 		c.Close()
@@ -60,11 +67,12 @@ func (c *udpCodec) Recv(ctx context.Context) (*frame.Frame, error) {
 }
 
 func (c *udpCodec) Send(ctx context.Context, f *frame.Frame) error {
-	b, err := json.Marshal(f)
-	if err != nil {
+	buf := getTxBuf()
+	defer putTxBuf(buf)
+	if err := encodeJSONFrameTo(f, buf); err != nil {
 		return errors.Trace(err)
 	}
-	_, err = c.conn.Write(b)
+	_, err := c.conn.Write(buf.Bytes())
 	return errors.Trace(err)
 }
 
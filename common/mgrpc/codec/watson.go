@@ -48,6 +48,7 @@ type WatsonCodecOptions struct {
 	AppID        string // a random one will be generated if not set
 	APIKey       string
 	APIAuthToken string
+	Compression  CompressionOptions
 }
 
 func NewWatsonCodec(dst string, tlsConfig *tls.Config, co *WatsonCodecOptions) (Codec, error) {
@@ -95,6 +96,8 @@ func NewWatsonCodec(dst string, tlsConfig *tls.Config, co *WatsonCodecOptions) (
 		ClientID: fmt.Sprintf("a:%s:%s", orgId, appId),
 		PubTopic: fmt.Sprintf("iot-2/type/%s/id/%s/cmd/mgrpc-%s/fmt/json", devType, devId, devId),
 		SubTopic: fmt.Sprintf("iot-2/type/%s/id/+/evt/mgrpc-%s/fmt/json", devType, appId),
+
+		Compression: co.Compression,
 	}
 	glog.V(1).Infof("URL: %s, opts: %+v", murl, *mopts)
 	mopts.Password = apiAuthToken
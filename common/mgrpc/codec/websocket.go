@@ -24,6 +24,7 @@ import (
 
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/common/mgrpc/frame"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
 	"golang.org/x/net/websocket"
 	glog "k8s.io/klog/v2"
 )
@@ -32,12 +33,13 @@ const (
 	WSProtocol = "clubby.cesanta.com"
 )
 
-func jsonMarshal(v interface{}) ([]byte, byte, error) {
-	if _, ok := v.(*frame.Frame); !ok {
-		return nil, websocket.TextFrame, errors.Errorf("only clubby frames are supported, got %T", v)
+// rawMarshal sends frames encoded by wsCodec.Send.
+func rawMarshal(v interface{}) ([]byte, byte, error) {
+	b, ok := v.([]byte)
+	if !ok {
+		return nil, websocket.TextFrame, errors.Errorf("only encoded frames are supported, got %T", v)
 	}
-	b, err := frame.MarshalJSON(v.(*frame.Frame))
-	return b, websocket.TextFrame, err
+	return b, websocket.TextFrame, nil
 }
 
 func jsonUnmarshal(data []byte, payloadType byte, v interface{}) error {
@@ -46,6 +48,7 @@ func jsonUnmarshal(data []byte, payloadType byte, v interface{}) error {
 		return errors.Errorf("only clubby frames are supported, got %T", v)
 	}
 	f12.SizeHint = len(data)
+	stats.AddWire("websocket", false /* tx */, len(data))
 	if payloadType != websocket.TextFrame && payloadType != websocket.BinaryFrame {
 		return errors.Errorf("unknown frame type: %d", payloadType)
 	}
@@ -56,7 +59,7 @@ func WebSocket(conn *websocket.Conn) Codec {
 	r := &wsCodec{
 		closeNotify: make(chan struct{}),
 		conn:        conn,
-		codec:       websocket.Codec{Marshal: jsonMarshal, Unmarshal: jsonUnmarshal},
+		codec:       websocket.Codec{Marshal: rawMarshal, Unmarshal: jsonUnmarshal},
 	}
 	return r
 }
@@ -86,8 +89,19 @@ func (c *wsCodec) Recv(ctx context.Context) (*frame.Frame, error) {
 	return &f12, nil
 }
 
+// Send encodes the frame into a pooled buffer, which is returned to the pool
+// once the message has been written out.
 func (c *wsCodec) Send(ctx context.Context, f12 *frame.Frame) error {
-	return errors.Trace(c.codec.Send(c.conn, f12))
+	buf := getTxBuf()
+	defer putTxBuf(buf)
+	if err := encodeJSONFrameTo(f12, buf); err != nil {
+		return errors.Trace(err)
+	}
+	if err := c.codec.Send(c.conn, buf.Bytes()); err != nil {
+		return errors.Trace(err)
+	}
+	stats.AddWire("websocket", true /* tx */, buf.Len())
+	return nil
 }
 
 func (c *wsCodec) Close() {
@@ -42,6 +42,8 @@ type connectOptions struct {
 	enableReconnect  bool
 	enableCompatArgs bool
 	codecOptions     codec.Options
+	handlerWorkers   int
+	replayQueueLen   int
 }
 
 // ConnectOption is an optional argument to Instance.Connect which affects the
@@ -229,6 +231,26 @@ func CompatArgs(enable bool) ConnectOption {
 	}
 }
 
+// ReplayQueueLen sets the number of unanswered requests that are sent again
+// after the connection is re-established. Disabled by default: requests may then
+// be delivered to the device more than once, so only enable it for connections
+// that make idempotent calls.
+func ReplayQueueLen(n int) ConnectOption {
+	return func(c *connectOptions) error {
+		c.replayQueueLen = n
+		return nil
+	}
+}
+
+// HandlerWorkers sets the number of goroutines that run handlers for incoming requests.
+// Requests for the same method are always handled in order.
+func HandlerWorkers(n int) ConnectOption {
+	return func(c *connectOptions) error {
+		c.handlerWorkers = n
+		return nil
+	}
+}
+
 func badConnectOption(err error) ConnectOption {
 	return func(_ *connectOptions) error {
 		return err
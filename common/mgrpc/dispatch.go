@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package mgrpc
+
+import (
+	"context"
+	"hash/fnv"
+	"sort"
+	"strings"
+	"sync"
+
+	"github.com/mongoose-os/mos/common/mgrpc/codec"
+	"github.com/mongoose-os/mos/common/mgrpc/frame"
+)
+
+const (
+	numReqShards = 16
+
+	defaultHandlerWorkers = 4
+	// Number of frames that can be queued for each handler worker
+	// before the receive loop has to wait.
+	handlerQueueLen = 64
+)
+
+type reqShard struct {
+	sync.Mutex
+	reqs map[int64]req
+}
+
+// reqTable holds outgoing requests waiting for responses.
+// It is sharded by request ID so concurrent calls do not contend on a single lock.
+type reqTable struct {
+	shards [numReqShards]reqShard
+}
+
+func newReqTable() *reqTable {
+	t := &reqTable{}
+	for i := range t.shards {
+		t.shards[i].reqs = make(map[int64]req)
+	}
+	return t
+}
+
+func (t *reqTable) shard(id int64) *reqShard {
+	return &t.shards[uint64(id)%numReqShards]
+}
+
+func (t *reqTable) add(id int64, rq req) {
+	s := t.shard(id)
+	s.Lock()
+	s.reqs[id] = rq
+	s.Unlock()
+}
+
+// remove deletes and returns the request with the given id.
+func (t *reqTable) remove(id int64) (req, bool) {
+	s := t.shard(id)
+	s.Lock()
+	rq, ok := s.reqs[id]
+	if ok {
+		delete(s.reqs, id)
+	}
+	s.Unlock()
+	return rq, ok
+}
+
+// removeAll deletes all the requests, calling cb for each.
+func (t *reqTable) removeAll(cb func(rq req)) {
+	for i := range t.shards {
+		s := &t.shards[i]
+		s.Lock()
+		for id, rq := range s.reqs {
+			cb(rq)
+			delete(s.reqs, id)
+		}
+		s.Unlock()
+	}
+}
+
+type prefixHandler struct {
+	prefix  string
+	handler Handler
+}
+
+// handlerTable maps methods to handlers. Methods ending with "*" match by prefix,
+// the longest matching prefix wins. Exact matches take precedence over prefixes.
+type handlerTable struct {
+	lock     sync.RWMutex
+	exact    map[string]Handler
+	prefixes []prefixHandler
+}
+
+func newHandlerTable() *handlerTable {
+	return &handlerTable{exact: make(map[string]Handler)}
+}
+
+func (ht *handlerTable) add(method string, handler Handler) {
+	ht.lock.Lock()
+	defer ht.lock.Unlock()
+	if !strings.HasSuffix(method, "*") {
+		ht.exact[method] = handler
+		return
+	}
+	prefix := strings.TrimSuffix(method, "*")
+	for i, ph := range ht.prefixes {
+		if ph.prefix == prefix {
+			ht.prefixes[i].handler = handler
+			return
+		}
+	}
+	ht.prefixes = append(ht.prefixes, prefixHandler{prefix: prefix, handler: handler})
+	sort.Slice(ht.prefixes, func(i, j int) bool {
+		return len(ht.prefixes[i].prefix) > len(ht.prefixes[j].prefix)
+	})
+}
+
+func (ht *handlerTable) get(method string) Handler {
+	ht.lock.RLock()
+	defer ht.lock.RUnlock()
+	if h, ok := ht.exact[method]; ok {
+		return h
+	}
+	for _, ph := range ht.prefixes {
+		if strings.HasPrefix(method, ph.prefix) {
+			return ph.handler
+		}
+	}
+	return nil
+}
+
+type handlerJob struct {
+	ctx     context.Context
+	c       codec.Codec
+	f       *frame.Frame
+	handler Handler
+}
+
+// handlerPool runs handlers off the receive loop on a fixed number of workers.
+// Frames for the same method always go to the same worker, so they are handled in order.
+type handlerPool struct {
+	queues []chan handlerJob
+}
+
+func newHandlerPool(r *mgRPCImpl, numWorkers int) *handlerPool {
+	if numWorkers <= 0 {
+		numWorkers = defaultHandlerWorkers
+	}
+	hp := &handlerPool{queues: make([]chan handlerJob, numWorkers)}
+	for i := range hp.queues {
+		q := make(chan handlerJob, handlerQueueLen)
+		hp.queues[i] = q
+		go func() {
+			for j := range q {
+				resp := j.handler(r, j.f)
+				if !j.f.NoResponse && resp != nil {
+					j.c.Send(j.ctx, resp)
+				}
+			}
+		}()
+	}
+	return hp
+}
+
+func (hp *handlerPool) run(j handlerJob) {
+	h := fnv.New32a()
+	h.Write([]byte(j.f.Method))
+	hp.queues[h.Sum32()%uint32(len(hp.queues))] <- j
+}
+
+func (hp *handlerPool) stop() {
+	for _, q := range hp.queues {
+		close(q)
+	}
+}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package frame
+
+import (
+	"encoding/binary"
+	"encoding/json"
+
+	"github.com/juju/errors"
+)
+
+// MarshalBinary encodes the frame for binary framing:
+// uvarint length of the JSON envelope, the envelope and then the raw blob, if any.
+// Bulk data carried in the blob is not subject to base64 encoding or JSON escaping.
+func MarshalBinary(f *Frame) ([]byte, error) {
+	env, err := MarshalJSON(f)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	// Encoder adds a trailing newline, it is not needed here.
+	if n := len(env); n > 0 && env[n-1] == '\n' {
+		env = env[:n-1]
+	}
+	res := make([]byte, binary.MaxVarintLen64, binary.MaxVarintLen64+len(env)+len(f.Blob))
+	res = res[:binary.PutUvarint(res, uint64(len(env)))]
+	res = append(res, env...)
+	res = append(res, f.Blob...)
+	return res, nil
+}
+
+// UnmarshalBinary decodes a frame encoded by MarshalBinary.
+// The blob references data, it is not copied.
+func UnmarshalBinary(data []byte) (*Frame, error) {
+	envLen, n := binary.Uvarint(data)
+	if n <= 0 || envLen > uint64(len(data)-n) {
+		return nil, errors.Errorf("invalid binary frame header")
+	}
+	env := data[n : n+int(envLen)]
+	f := &Frame{SizeHint: len(data)}
+	if err := json.Unmarshal(env, f); err != nil {
+		return nil, errors.Annotatef(err, "invalid frame envelope")
+	}
+	if blob := data[n+int(envLen):]; len(blob) > 0 {
+		f.Blob = blob
+	}
+	return f, nil
+}
@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package frame
+
+import (
+	"bytes"
+	"testing"
+)
+
+func TestBinaryFrame(t *testing.T) {
+	blob := []byte("\x00\x01\"\n\"\"\"binary")
+	f := &Frame{ID: 123, Method: "FS.Put", Params: []byte(`{"filename":"foo"}`), Blob: blob}
+	data, err := MarshalBinary(f)
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	f2, err := UnmarshalBinary(data)
+	if err != nil {
+		t.Fatalf("%s", err)
+	}
+	if f2.ID != f.ID || f2.Method != f.Method || string(f2.Params) != string(f.Params) {
+		t.Errorf("got: %+v, want: %+v", f2, f)
+	}
+	if !bytes.Equal(f2.Blob, blob) {
+		t.Errorf("got: %q, want: %q", f2.Blob, blob)
+	}
+
+	f.Blob = nil
+	data, _ = MarshalBinary(f)
+	if f2, err = UnmarshalBinary(data); err != nil || f2.Blob != nil {
+		t.Errorf("got: %+v %v, want no blob", f2, err)
+	}
+
+	if _, err := UnmarshalBinary(data[:5]); err == nil {
+		t.Errorf("truncated frame must fail")
+	}
+}
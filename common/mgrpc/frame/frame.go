@@ -68,6 +68,9 @@ type Frame struct {
 	NoResponse bool `json:"nr,omitempty"`
 
 	DeprecatedArgs json.RawMessage `json:"args,omitempty"`
+
+	// Blob is a raw binary attachment. It can only be carried by codecs that use binary framing.
+	Blob []byte `json:"-"`
 }
 
 type Error struct {
@@ -89,6 +92,9 @@ type Command struct {
 	Timeout int64 `json:"timeout,omitempty"`
 
 	Trace *Trace `json:"trace,omitempty"`
+
+	// Raw binary attachment, see Frame.Blob.
+	Blob []byte `json:"-"`
 }
 
 type FrameAuth struct {
@@ -120,6 +126,9 @@ type Response struct {
 
 	// Application defined response payload
 	Response json.RawMessage `json:"resp,omitempty"`
+
+	// Raw binary attachment, see Frame.Blob.
+	Blob []byte `json:"-"`
 }
 
 // Auto-generated uids should be "large but not ginormous".
@@ -200,6 +209,7 @@ func NewRequestFrame(src string, dst string, key string, cmd *Command, compatArg
 			Deadline:       cmd.Deadline,
 			Timeout:        cmd.Timeout,
 			Trace:          cmd.Trace,
+			Blob:           cmd.Blob,
 		}
 	}
 	return &Frame{
@@ -213,6 +223,7 @@ func NewRequestFrame(src string, dst string, key string, cmd *Command, compatArg
 		Deadline: cmd.Deadline,
 		Timeout:  cmd.Timeout,
 		Trace:    cmd.Trace,
+		Blob:     cmd.Blob,
 	}
 }
 
@@ -224,6 +235,7 @@ func NewResponseFrame(src string, dst string, key string, resp *Response) *Frame
 		Key:     key,
 		ID:      resp.ID,
 		Result:  resp.Response,
+		Blob:    resp.Blob,
 	}
 	if resp.Status != 0 {
 		f.Error = &Error{Code: resp.Status, Message: resp.StatusMsg}
@@ -245,11 +257,12 @@ func NewCommandFromFrame(f *Frame) *Command {
 		Deadline: f.Deadline,
 		Timeout:  f.Timeout,
 		Trace:    f.Trace,
+		Blob:     f.Blob,
 	}
 }
 
 func NewResponseFromFrame(f *Frame) *Response {
-	r := &Response{ID: f.ID, Response: f.Result}
+	r := &Response{ID: f.ID, Response: f.Result, Blob: f.Blob}
 	if f.Error != nil {
 		r.Status = f.Error.Code
 		r.StatusMsg = f.Error.Message
@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package frame
+
+import (
+	"fmt"
+	"strings"
+	"testing"
+)
+
+func BenchmarkMarshalJSON(b *testing.B) {
+	params := fmt.Sprintf(`{"filename":"fs.bin","offset":0,"data":%q}`, strings.Repeat("QUJDRA==", 512))
+	f := NewRequestFrame("mos", "dev", "", &Command{Cmd: "FS.Put", ID: 123, Args: []byte(params)}, false)
+	data, err := MarshalJSON(f)
+	if err != nil {
+		b.Fatal(err)
+	}
+	b.SetBytes(int64(len(data)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := MarshalJSON(f); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -28,7 +28,6 @@ import (
 	"io"
 	"math/big"
 	"net"
-	"sync"
 	"time"
 
 	"golang.org/x/net/websocket"
@@ -36,11 +35,15 @@ import (
 	"github.com/juju/errors"
 	"github.com/mongoose-os/mos/common/mgrpc/codec"
 	"github.com/mongoose-os/mos/common/mgrpc/frame"
+	"github.com/mongoose-os/mos/common/mgrpc/stats"
 	glog "k8s.io/klog/v2"
 )
 
 const (
 	authTypeDigest = "digest"
+
+	// Number of requests CallBatch keeps in flight if not specified.
+	DefaultCallWindow = 4
 )
 
 type GetCredsCallback func() (username, passwd string, err error)
@@ -50,22 +53,36 @@ type MgRPC interface {
 	Call(
 		ctx context.Context, dst string, cmd *frame.Command, getCreds GetCredsCallback,
 	) (*frame.Response, error)
+	// CallAsync sends the command and returns without waiting for the response.
+	CallAsync(
+		ctx context.Context, dst string, cmd *frame.Command, getCreds GetCredsCallback,
+	) *PendingCall
+	// CallBatch sends commands in order, keeping up to window of them in flight
+	// (further limited by the codec). Responses are returned in the same order.
+	// On error, no more commands are sent and the first error is returned.
+	CallBatch(
+		ctx context.Context, dst string, cmds []*frame.Command, window int, getCreds GetCredsCallback,
+	) ([]*frame.Response, error)
+	// CallWindow returns the number of requests that can be in flight at the same time,
+	// given the desired window (<= 0 means default), taking into account the codec limit.
+	CallWindow(window int) int
 	AddHandler(method string, handler Handler)
 	Disconnect(ctx context.Context) error
 	IsConnected() bool
+	// BinaryFrames returns true if commands can carry raw binary attachments (frame.Command.Blob).
+	BinaryFrames() bool
 	SetCodecOptions(opts *codec.Options) error
 }
 
 type mgRPCImpl struct {
 	codec codec.Codec
 
-	// Map of outgoing requests, and its lock
-	reqs     map[int64]req
-	reqsLock sync.Mutex
+	// Outgoing requests waiting for responses.
+	reqs *reqTable
 
-	// Map of handlers, and its lock
-	handlers     map[string]Handler
-	handlersLock sync.Mutex
+	// Handlers for incoming requests, and the pool they run on.
+	handlers    *handlerTable
+	handlerPool *handlerPool
 
 	opts *connectOptions
 
@@ -75,6 +92,7 @@ type mgRPCImpl struct {
 type req struct {
 	respChan chan *frame.Response
 	errChan  chan error
+	start    time.Time
 }
 
 type authErrorMsg struct {
@@ -106,12 +124,13 @@ func New(ctx context.Context, connectAddr string, opts ...ConnectOption) (MgRPC,
 	opts = append(opts, connectTo(connectAddr))
 
 	rpc := mgRPCImpl{
-		reqs:     make(map[int64]req),
-		handlers: make(map[string]Handler),
+		reqs:     newReqTable(),
+		handlers: newHandlerTable(),
 	}
 	if err := rpc.connect(ctx, opts...); err != nil {
 		return nil, errors.Trace(err)
 	}
+	rpc.handlerPool = newHandlerPool(&rpc, rpc.opts.handlerWorkers)
 
 	go rpc.recvLoop(ctx, rpc.codec)
 
@@ -120,11 +139,12 @@ func New(ctx context.Context, connectAddr string, opts ...ConnectOption) (MgRPC,
 
 func Serve(ctx context.Context, c codec.Codec) MgRPC {
 	rpc := mgRPCImpl{
-		reqs:     make(map[int64]req),
-		handlers: make(map[string]Handler),
+		reqs:     newReqTable(),
+		handlers: newHandlerTable(),
 		codec:    c,
 		opts:     &connectOptions{localID: ""},
 	}
+	rpc.handlerPool = newHandlerPool(&rpc, rpc.opts.handlerWorkers)
 	go rpc.recvLoop(ctx, rpc.codec)
 	return &rpc
 }
@@ -175,8 +195,10 @@ func wsDialConfig(config *websocket.Config) (*websocket.Conn, error) {
 	return conn, errors.Trace(err)
 }
 
+// AddHandler registers handler for the method. If method ends with "*",
+// the handler is used for all the methods starting with the prefix, e.g. "Foo.*".
 func (r *mgRPCImpl) AddHandler(method string, handler Handler) {
-	r.handlers[method] = handler
+	r.handlers.add(method, handler)
 }
 
 func (r *mgRPCImpl) mqttConnect(dst string, opts *connectOptions) (codec.Codec, error) {
@@ -239,31 +261,45 @@ func (r *mgRPCImpl) connect(ctx context.Context, opts ...ConnectOption) error {
 
 	glog.V(1).Infof("Connecting to %s over %s", r.opts.connectAddress, r.opts.proto)
 
+	if r.opts.tlsConfig != nil && r.opts.tlsConfig.ClientSessionCache == nil {
+		// Resume TLS sessions when reconnecting, saves a round trip and a full handshake.
+		r.opts.tlsConfig = r.opts.tlsConfig.Clone()
+		r.opts.tlsConfig.ClientSessionCache = tls.NewLRUClientSessionCache(0)
+	}
+	if co := &r.opts.codecOptions; co.Compression.Threshold > 0 {
+		co.GCP.Compression = co.Compression
+		co.MQTT.Compression = co.Compression
+		co.Watson.Compression = co.Compression
+	}
+	if r.opts.replayQueueLen < 0 {
+		r.opts.replayQueueLen = 0
+	}
+
 	switch r.opts.proto {
 
 	case tHTTP_POST:
-		r.codec = codec.OutboundHTTP(r.opts.connectAddress, r.opts.tlsConfig)
+		r.codec = codec.OutboundHTTP(r.opts.connectAddress, r.opts.tlsConfig, r.opts.codecOptions.Compression)
 	case tWebSocket:
 		r.codec = codec.NewReconnectWrapperCodec(
 			r.opts.connectAddress,
 			func(wsURL string) (codec.Codec, error) {
 				c, err := r.wsConnect(wsURL, r.opts)
 				return c, errors.Trace(err)
-			})
+			}, r.opts.replayQueueLen)
 	case tMQTT:
 		r.codec = codec.NewReconnectWrapperCodec(
 			r.opts.connectAddress,
 			func(mqttURL string) (codec.Codec, error) {
 				c, err := r.mqttConnect(mqttURL, r.opts)
 				return c, errors.Trace(err)
-			})
+			}, r.opts.replayQueueLen)
 	case tPlainTCP:
 		r.codec = codec.NewReconnectWrapperCodec(
 			r.opts.connectAddress,
 			func(tcpAddress string) (codec.Codec, error) {
 				c, err := r.tcpConnect(tcpAddress, r.opts)
 				return c, errors.Trace(err)
-			})
+			}, r.opts.replayQueueLen)
 	case tUDP:
 		r.codec = codec.UDP(r.opts.connectAddress)
 	case tSerial:
@@ -273,7 +309,7 @@ func (r *mgRPCImpl) connect(ctx context.Context, opts ...ConnectOption) error {
 				func(serialAddress string) (codec.Codec, error) {
 					c, err := r.serialConnect(ctx, serialAddress, r.opts)
 					return c, errors.Trace(err)
-				})
+				}, 0 /* replayQueueLen */)
 		} else {
 			serialCodec, err := r.serialConnect(ctx, r.opts.connectAddress, r.opts)
 			if err != nil {
@@ -297,7 +333,7 @@ func (r *mgRPCImpl) connect(ctx context.Context, opts ...ConnectOption) error {
 			func(url string) (codec.Codec, error) {
 				c, err := r.watsonConnect(url, r.opts)
 				return c, errors.Trace(err)
-			})
+			}, r.opts.replayQueueLen)
 
 	default:
 		return fmt.Errorf("unknown transport %q", r.opts.proto)
@@ -327,17 +363,15 @@ func (r *mgRPCImpl) recvLoop(ctx context.Context, c codec.Codec) {
 		glog.V(2).Infof("done, %v", err)
 		if r.closing {
 			glog.Infof("devConn is disconnected, breaking out of the recvLoop (%s)", err)
-			r.reqsLock.Lock()
-			for k, v := range r.reqs {
+			r.reqs.removeAll(func(rq req) {
 				// Use non-blocking send, otherwise we can block and lock this rpc
 				select {
-				case v.errChan <- io.EOF:
+				case rq.errChan <- io.EOF:
 				default:
 				}
-				delete(r.reqs, k)
-			}
-			r.reqsLock.Unlock()
+			})
 			r.Disconnect(ctx)
+			r.handlerPool.stop()
 			return
 		}
 		if err != nil {
@@ -355,59 +389,84 @@ func (r *mgRPCImpl) recvLoop(ctx context.Context, c codec.Codec) {
 		}
 
 		if f.Method != "" {
-			callback := sendErrorResponse
-			for k, v := range r.handlers {
-				if k == f.Method {
-					callback = v
-					break
-				}
-			}
-			resp := callback(r, f)
-			if !f.NoResponse && resp != nil {
-				c.Send(ctx, resp)
+			callback := r.handlers.get(f.Method)
+			if callback == nil {
+				callback = sendErrorResponse
 			}
+			r.handlerPool.run(handlerJob{ctx: ctx, c: c, f: f, handler: callback})
 			continue
 		}
 
 		resp := frame.NewResponseFromFrame(f)
-		r.reqsLock.Lock()
-		if req, ok := r.reqs[resp.ID]; ok {
+		if req, ok := r.reqs.remove(resp.ID); ok {
 			req.respChan <- resp
-			delete(r.reqs, resp.ID)
 		} else {
 			glog.Infof("ignoring unsolicited response: %v", resp)
+			stats.AddLateResponse()
 		}
-		r.reqsLock.Unlock()
 	}
 }
 
 func (r *mgRPCImpl) Call(
 	ctx context.Context, dst string, cmd *frame.Command, getCreds GetCredsCallback,
 ) (*frame.Response, error) {
+	rq, err := r.sendRequest(ctx, dst, cmd)
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return r.waitResponse(ctx, dst, cmd, rq, getCreds)
+}
+
+// sendRequest registers the request and sends the command frame.
+func (r *mgRPCImpl) sendRequest(ctx context.Context, dst string, cmd *frame.Command) (req, error) {
 	if cmd.ID == 0 {
 		cmd.ID = frame.CreateCommandUID()
 	}
 
-	respChan := make(chan *frame.Response)
-	errChan := make(chan error)
-
-	r.reqsLock.Lock()
-	r.reqs[cmd.ID] = req{
-		respChan: respChan,
-		errChan:  errChan,
+	// Channels are buffered so that recvLoop never blocks on a request
+	// whose waiter has already given up.
+	rq := req{
+		respChan: make(chan *frame.Response, 1),
+		errChan:  make(chan error, 1),
+		start:    time.Now(),
 	}
-	r.reqsLock.Unlock()
+
+	r.reqs.add(cmd.ID, rq)
 	glog.V(2).Infof("created a request with id %d", cmd.ID)
 
-	f := frame.NewRequestFrame(r.opts.localID, dst, "", cmd, r.opts.enableCompatArgs)
+	f := frame.NewRequestFrame(r.opts.localID, dst, r.opts.psk, cmd, r.opts.enableCompatArgs)
 	if err := r.codec.Send(ctx, f); err != nil {
-		return nil, errors.Trace(err)
+		r.reqs.remove(cmd.ID)
+		return rq, errors.Trace(err)
 	}
+	return rq, nil
+}
 
+// waitResponse waits for the response to the request and records call stats.
+func (r *mgRPCImpl) waitResponse(
+	ctx context.Context, dst string, cmd *frame.Command, rq req, getCreds GetCredsCallback,
+) (*frame.Response, error) {
+	resp, err := r.awaitResponse(ctx, dst, cmd, rq, getCreds)
+	d := time.Since(rq.start)
+	failed := err
+	if err == nil && resp.Status != 0 {
+		failed = errors.Errorf("%d %s", resp.Status, resp.StatusMsg)
+	}
+	stats.ObserveCall(cmd.Cmd, d, failed, errors.Cause(err) == context.DeadlineExceeded)
+	if r.opts.enableTracing {
+		glog.Infof("%s (%d): %s, err: %v", cmd.Cmd, cmd.ID, d, failed)
+	}
+	return resp, err
+}
+
+func (r *mgRPCImpl) awaitResponse(
+	ctx context.Context, dst string, cmd *frame.Command, rq req, getCreds GetCredsCallback,
+) (*frame.Response, error) {
 	select {
-	case resp := <-respChan:
+	case resp := <-rq.respChan:
 		glog.V(2).Infof("got response to request %d: [%v] (%v)", cmd.ID, resp, resp.StatusMsg)
-		if resp.Status == 401 && cmd.Auth == nil {
+		// Without a credentials callback, authentication is left to the caller.
+		if resp.Status == 401 && cmd.Auth == nil && getCreds != nil {
 			var authMsg authErrorMsg
 			if err := json.Unmarshal([]byte(resp.StatusMsg), &authMsg); err == nil {
 				// Succeed in parsing error message, let's check auth type
@@ -447,7 +506,12 @@ func (r *mgRPCImpl) Call(
 						Opaque:    authMsg.Opaque,
 					}
 					glog.V(2).Infof("resending cmd %d with auth added: %+v", cmd.ID, cmdWithAuth)
-					return r.Call(ctx, dst, &cmdWithAuth, getCreds)
+					stats.AddRetry(cmd.Cmd)
+					arq, err := r.sendRequest(ctx, dst, &cmdWithAuth)
+					if err != nil {
+						return nil, errors.Trace(err)
+					}
+					return r.awaitResponse(ctx, dst, &cmdWithAuth, arq, getCreds)
 
 				default:
 					glog.Warningf("got 401 with an unknown auth_type: %v", authMsg.AuthType)
@@ -457,18 +521,103 @@ func (r *mgRPCImpl) Call(
 			}
 		}
 		return resp, nil
-	case err := <-errChan:
+	case err := <-rq.errChan:
 		glog.V(2).Infof("got err on request %d: [%v]", cmd.ID, err)
 		return nil, errors.Trace(err)
 	case <-ctx.Done():
 		glog.V(2).Infof("context for the request %d is done: %v", cmd.ID, ctx.Err())
-		r.reqsLock.Lock()
-		delete(r.reqs, cmd.ID)
-		r.reqsLock.Unlock()
+		r.reqs.remove(cmd.ID)
 		return nil, errors.Trace(ctx.Err())
 	}
 }
 
+// PendingCall is a request that has been sent but may not have completed yet.
+type PendingCall struct {
+	Cmd *frame.Command
+
+	done chan struct{}
+	resp *frame.Response
+	err  error
+}
+
+// Done returns a channel that is closed when the call completes.
+func (pc *PendingCall) Done() <-chan struct{} {
+	return pc.done
+}
+
+// Wait waits for the call to complete and returns its result.
+func (pc *PendingCall) Wait() (*frame.Response, error) {
+	<-pc.done
+	return pc.resp, pc.err
+}
+
+func (r *mgRPCImpl) CallAsync(
+	ctx context.Context, dst string, cmd *frame.Command, getCreds GetCredsCallback,
+) *PendingCall {
+	pc := &PendingCall{Cmd: cmd, done: make(chan struct{})}
+	// Frame is sent synchronously, so requests go out in the order of calls.
+	rq, err := r.sendRequest(ctx, dst, cmd)
+	if err != nil {
+		pc.err = errors.Trace(err)
+		close(pc.done)
+		return pc
+	}
+	go func() {
+		pc.resp, pc.err = r.waitResponse(ctx, dst, cmd, rq, getCreds)
+		close(pc.done)
+	}()
+	return pc
+}
+
+func (r *mgRPCImpl) CallWindow(window int) int {
+	if window <= 0 {
+		window = DefaultCallWindow
+	}
+	if n := r.codec.MaxNumFrames(); n > 0 && n < window {
+		window = n
+	}
+	return window
+}
+
+func (r *mgRPCImpl) CallBatch(
+	ctx context.Context, dst string, cmds []*frame.Command, window int, getCreds GetCredsCallback,
+) ([]*frame.Response, error) {
+	window = r.CallWindow(window)
+	glog.V(2).Infof("sending %d requests, window %d", len(cmds), window)
+	resps := make([]*frame.Response, len(cmds))
+	type inFlightCall struct {
+		i  int
+		pc *PendingCall
+	}
+	inFlight := make([]inFlightCall, 0, window)
+	var firstErr error
+	wait := func() {
+		c := inFlight[0]
+		inFlight = inFlight[1:]
+		resp, err := c.pc.Wait()
+		if err != nil {
+			if firstErr == nil {
+				firstErr = errors.Annotatef(err, "%s (%d)", c.pc.Cmd.Cmd, c.pc.Cmd.ID)
+			}
+			return
+		}
+		resps[c.i] = resp
+	}
+	for i, cmd := range cmds {
+		if len(inFlight) == window {
+			wait()
+		}
+		if firstErr != nil {
+			break
+		}
+		inFlight = append(inFlight, inFlightCall{i, r.CallAsync(ctx, dst, cmd, getCreds)})
+	}
+	for len(inFlight) > 0 {
+		wait()
+	}
+	return resps, firstErr
+}
+
 func (r *mgRPCImpl) SendHello(dst string) {
 	hello := &frame.Command{
 		Cmd: "/v1/Hello",
@@ -483,6 +632,10 @@ func (r *mgRPCImpl) IsConnected() bool {
 	return info.IsConnected
 }
 
+func (r *mgRPCImpl) BinaryFrames() bool {
+	return r.codec.Info().BinaryFrames
+}
+
 func (r *mgRPCImpl) SetCodecOptions(opts *codec.Options) error {
 	return r.codec.SetOptions(opts)
 }
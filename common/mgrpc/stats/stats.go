@@ -0,0 +1,249 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package stats
+
+import (
+	"fmt"
+	"io"
+	"net/http"
+	"sort"
+	"sync"
+	"text/tabwriter"
+	"time"
+)
+
+// Upper bounds of latency histogram buckets, in seconds.
+var latencyBuckets = []float64{0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30}
+
+type histogram struct {
+	// One count per bucket plus the overflow bucket, not cumulative.
+	counts []uint64
+	count  uint64
+	sum    float64
+	max    float64
+}
+
+func (h *histogram) observe(v float64) {
+	if h.counts == nil {
+		h.counts = make([]uint64, len(latencyBuckets)+1)
+	}
+	i := sort.SearchFloat64s(latencyBuckets, v)
+	h.counts[i]++
+	h.count++
+	h.sum += v
+	if v > h.max {
+		h.max = v
+	}
+}
+
+// quantile returns the upper bound of the bucket containing the q-th quantile.
+func (h *histogram) quantile(q float64) float64 {
+	target := uint64(q * float64(h.count))
+	var n uint64
+	for i, c := range h.counts {
+		n += c
+		if n > target {
+			if i < len(latencyBuckets) {
+				return latencyBuckets[i]
+			}
+			break
+		}
+	}
+	return h.max
+}
+
+type methodStats struct {
+	latency  histogram
+	errors   uint64
+	timeouts uint64
+	retries  uint64
+}
+
+type wireStats struct {
+	txBytes, rxBytes   uint64
+	txFrames, rxFrames uint64
+}
+
+// RPC call latencies and wire traffic counters, collected for the whole process.
+// They can be printed as a summary or exported in Prometheus text format.
+var (
+	lock    sync.Mutex
+	methods = make(map[string]*methodStats)
+	wire    = make(map[string]*wireStats)
+	// Responses that arrived after the caller had given up.
+	lateResponses uint64
+)
+
+func getMethodLocked(method string) *methodStats {
+	ms := methods[method]
+	if ms == nil {
+		ms = &methodStats{}
+		methods[method] = ms
+	}
+	return ms
+}
+
+// ObserveCall records the outcome of a call.
+func ObserveCall(method string, d time.Duration, err error, timedOut bool) {
+	lock.Lock()
+	defer lock.Unlock()
+	ms := getMethodLocked(method)
+	ms.latency.observe(d.Seconds())
+	switch {
+	case timedOut:
+		ms.timeouts++
+	case err != nil:
+		ms.errors++
+	}
+}
+
+// AddRetry counts a call that had to be sent again, e.g. with authentication.
+func AddRetry(method string) {
+	lock.Lock()
+	defer lock.Unlock()
+	getMethodLocked(method).retries++
+}
+
+// AddLateResponse counts a response that did not match any pending call.
+func AddLateResponse() {
+	lock.Lock()
+	defer lock.Unlock()
+	lateResponses++
+}
+
+// AddWire counts bytes of a frame sent (tx) or received by the codec of the given kind.
+func AddWire(codec string, tx bool, n int) {
+	lock.Lock()
+	defer lock.Unlock()
+	ws := wire[codec]
+	if ws == nil {
+		ws = &wireStats{}
+		wire[codec] = ws
+	}
+	if tx {
+		ws.txBytes += uint64(n)
+		ws.txFrames++
+	} else {
+		ws.rxBytes += uint64(n)
+		ws.rxFrames++
+	}
+}
+
+func methodNamesLocked() []string {
+	var names []string
+	for m := range methods {
+		names = append(names, m)
+	}
+	sort.Strings(names)
+	return names
+}
+
+func codecNamesLocked() []string {
+	var names []string
+	for c := range wire {
+		names = append(names, c)
+	}
+	sort.Strings(names)
+	return names
+}
+
+func fmtSeconds(v float64) string {
+	return time.Duration(v * float64(time.Second)).Round(100 * time.Microsecond).String()
+}
+
+// WriteSummary writes a human-readable summary of the collected stats.
+func WriteSummary(w io.Writer) {
+	lock.Lock()
+	defer lock.Unlock()
+	tw := tabwriter.NewWriter(w, 0, 8, 2, ' ', 0)
+	fmt.Fprintf(tw, "METHOD\tCALLS\tERRORS\tTIMEOUTS\tRETRIES\tAVG\tP50\tP90\tP99\tMAX\n")
+	for _, m := range methodNamesLocked() {
+		ms := methods[m]
+		h := &ms.latency
+		avg := 0.0
+		if h.count > 0 {
+			avg = h.sum / float64(h.count)
+		}
+		fmt.Fprintf(tw, "%s\t%d\t%d\t%d\t%d\t%s\t<%s\t<%s\t<%s\t%s\n", m, h.count, ms.errors, ms.timeouts, ms.retries,
+			fmtSeconds(avg), fmtSeconds(h.quantile(0.5)), fmtSeconds(h.quantile(0.9)), fmtSeconds(h.quantile(0.99)), fmtSeconds(h.max))
+	}
+	fmt.Fprintf(tw, "\nCODEC\tTX FRAMES\tTX BYTES\tRX FRAMES\tRX BYTES\n")
+	for _, c := range codecNamesLocked() {
+		ws := wire[c]
+		fmt.Fprintf(tw, "%s\t%d\t%d\t%d\t%d\n", c, ws.txFrames, ws.txBytes, ws.rxFrames, ws.rxBytes)
+	}
+	if lateResponses > 0 {
+		fmt.Fprintf(tw, "\nLate responses: %d\n", lateResponses)
+	}
+	tw.Flush()
+}
+
+// WritePrometheus writes the collected stats in Prometheus text exposition format.
+func WritePrometheus(w io.Writer) {
+	lock.Lock()
+	defer lock.Unlock()
+	fmt.Fprintf(w, "# HELP mgrpc_call_duration_seconds RPC call latency.\n")
+	fmt.Fprintf(w, "# TYPE mgrpc_call_duration_seconds histogram\n")
+	for _, m := range methodNamesLocked() {
+		h := &methods[m].latency
+		var n uint64
+		for i, b := range latencyBuckets {
+			n += h.counts[i]
+			fmt.Fprintf(w, "mgrpc_call_duration_seconds_bucket{method=%q,le=\"%g\"} %d\n", m, b, n)
+		}
+		fmt.Fprintf(w, "mgrpc_call_duration_seconds_bucket{method=%q,le=\"+Inf\"} %d\n", m, h.count)
+		fmt.Fprintf(w, "mgrpc_call_duration_seconds_sum{method=%q} %g\n", m, h.sum)
+		fmt.Fprintf(w, "mgrpc_call_duration_seconds_count{method=%q} %d\n", m, h.count)
+	}
+	counters := []struct {
+		name, help string
+		get        func(ms *methodStats) uint64
+	}{
+		{"mgrpc_call_errors_total", "Calls that returned an error.", func(ms *methodStats) uint64 { return ms.errors }},
+		{"mgrpc_call_timeouts_total", "Calls that timed out.", func(ms *methodStats) uint64 { return ms.timeouts }},
+		{"mgrpc_call_retries_total", "Calls that were sent again.", func(ms *methodStats) uint64 { return ms.retries }},
+	}
+	for _, c := range counters {
+		fmt.Fprintf(w, "# HELP %s %s\n# TYPE %s counter\n", c.name, c.help, c.name)
+		for _, m := range methodNamesLocked() {
+			fmt.Fprintf(w, "%s{method=%q} %d\n", c.name, m, c.get(methods[m]))
+		}
+	}
+	fmt.Fprintf(w, "# HELP mgrpc_wire_bytes_total Bytes of frames sent and received.\n")
+	fmt.Fprintf(w, "# TYPE mgrpc_wire_bytes_total counter\n")
+	for _, c := range codecNamesLocked() {
+		fmt.Fprintf(w, "mgrpc_wire_bytes_total{codec=%q,dir=\"tx\"} %d\n", c, wire[c].txBytes)
+		fmt.Fprintf(w, "mgrpc_wire_bytes_total{codec=%q,dir=\"rx\"} %d\n", c, wire[c].rxBytes)
+	}
+	fmt.Fprintf(w, "# HELP mgrpc_wire_frames_total Frames sent and received.\n")
+	fmt.Fprintf(w, "# TYPE mgrpc_wire_frames_total counter\n")
+	for _, c := range codecNamesLocked() {
+		fmt.Fprintf(w, "mgrpc_wire_frames_total{codec=%q,dir=\"tx\"} %d\n", c, wire[c].txFrames)
+		fmt.Fprintf(w, "mgrpc_wire_frames_total{codec=%q,dir=\"rx\"} %d\n", c, wire[c].rxFrames)
+	}
+	fmt.Fprintf(w, "# HELP mgrpc_late_responses_total Responses that arrived after the call was abandoned.\n")
+	fmt.Fprintf(w, "# TYPE mgrpc_late_responses_total counter\n")
+	fmt.Fprintf(w, "mgrpc_late_responses_total %d\n", lateResponses)
+}
+
+// Handler serves the stats in Prometheus format.
+func Handler() http.Handler {
+	return http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		w.Header().Set("Content-Type", "text/plain; version=0.0.4")
+		WritePrometheus(w)
+	})
+}
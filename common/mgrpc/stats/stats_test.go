@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package stats
+
+import (
+	"bytes"
+	"errors"
+	"strings"
+	"testing"
+	"time"
+)
+
+func TestStats(t *testing.T) {
+	ObserveCall("Sys.GetInfo", 3*time.Millisecond, nil, false)
+	ObserveCall("Sys.GetInfo", 70*time.Millisecond, nil, false)
+	ObserveCall("Sys.GetInfo", time.Minute, errors.New("timeout"), true)
+	ObserveCall("FS.Put", 20*time.Millisecond, errors.New("500 failed"), false)
+	AddRetry("FS.Put")
+	AddWire("serial", true, 100)
+	AddWire("serial", false, 50)
+
+	var buf bytes.Buffer
+	WritePrometheus(&buf)
+	out := buf.String()
+	for _, want := range []string{
+		`mgrpc_call_duration_seconds_bucket{method="Sys.GetInfo",le="0.005"} 1`,
+		`mgrpc_call_duration_seconds_bucket{method="Sys.GetInfo",le="0.1"} 2`,
+		`mgrpc_call_duration_seconds_bucket{method="Sys.GetInfo",le="30"} 2`,
+		`mgrpc_call_duration_seconds_bucket{method="Sys.GetInfo",le="+Inf"} 3`,
+		`mgrpc_call_timeouts_total{method="Sys.GetInfo"} 1`,
+		`mgrpc_call_errors_total{method="Sys.GetInfo"} 0`,
+		`mgrpc_call_errors_total{method="FS.Put"} 1`,
+		`mgrpc_call_retries_total{method="FS.Put"} 1`,
+		`mgrpc_wire_bytes_total{codec="serial",dir="tx"} 100`,
+		`mgrpc_wire_frames_total{codec="serial",dir="rx"} 1`,
+	} {
+		if !strings.Contains(out, want) {
+			t.Errorf("%q not found in:\n%s", want, out)
+		}
+	}
+
+	buf.Reset()
+	WriteSummary(&buf)
+	if !strings.Contains(buf.String(), "Sys.GetInfo") {
+		t.Errorf("bad summary:\n%s", buf.String())
+	}
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2014-2017 Cesanta Software Limited
+// All rights reserved
+
+package ourgit
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"fmt"
+	"hash"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"time"
+
+	"github.com/go-git/go-git/v5/plumbing/format/index"
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+)
+
+const (
+	// Name of the file in the .git dir that holds the fingerprint of the last clean state.
+	cleanFingerprintFile = "mos_clean_fingerprint"
+
+	// Files modified less than this long ago may be modified again without
+	// changing their mtime, the fingerprint is not saved until they settle.
+	racyInterval = 2 * time.Second
+)
+
+// isCleanCached returns true without calling check if the working tree has not changed
+// since the last time check found it clean.
+//
+// The fingerprint covers the stat data of HEAD, refs, the index, every tracked file and
+// every directory containing tracked files. Modifying or deleting a tracked file changes
+// its mtime or size, creating an untracked file changes the mtime of its directory,
+// moving HEAD or fetching changes the refs. Untracked files under ignored or untracked
+// directories are not noticed, but those directories do not make the repo dirty
+// when looked at by git either, unless their contents are ignored individually.
+func isCleanCached(localDir, version string, excludeGlobs []string, check func() (bool, error)) (bool, error) {
+	gitDir := filepath.Join(localDir, ".git")
+	fpFile := filepath.Join(gitDir, cleanFingerprintFile)
+	fp, newest, err := cleanFingerprint(localDir, gitDir, version, excludeGlobs)
+	if err != nil {
+		// Worktrees, submodules, unknown index versions are not handled, do the full check.
+		glog.V(1).Infof("%s: no clean fingerprint: %s", localDir, err)
+		return check()
+	}
+	if data, err := ioutil.ReadFile(fpFile); err == nil && string(data) == fp {
+		glog.V(1).Infof("%s: clean (unchanged since the last check)", localDir)
+		return true, nil
+	}
+	clean, err := check()
+	if err != nil {
+		return false, errors.Trace(err)
+	}
+	switch {
+	case !clean:
+		os.Remove(fpFile)
+	case time.Since(newest) < racyInterval:
+		glog.V(1).Infof("%s: recently modified, not saving the clean fingerprint", localDir)
+	default:
+		if err := ioutil.WriteFile(fpFile, []byte(fp), 0644); err != nil {
+			glog.Warningf("%s: failed to save the clean fingerprint: %s", localDir, err)
+		}
+	}
+	return clean, nil
+}
+
+type fingerprinter struct {
+	h      hash.Hash
+	newest time.Time
+}
+
+func (fpr *fingerprinter) add(name string) {
+	fi, err := os.Lstat(name)
+	if err != nil {
+		fmt.Fprintf(fpr.h, "%s -\n", name)
+		return
+	}
+	mt := fi.ModTime()
+	if mt.After(fpr.newest) {
+		fpr.newest = mt
+	}
+	fmt.Fprintf(fpr.h, "%s %o %d %d\n", name, fi.Mode(), fi.Size(), mt.UnixNano())
+}
+
+// cleanFingerprint returns the fingerprint of the working tree state and the newest mtime seen.
+func cleanFingerprint(localDir, gitDir, version string, excludeGlobs []string) (string, time.Time, error) {
+	localDir = filepath.Clean(localDir)
+	if fi, err := os.Stat(gitDir); err != nil || !fi.IsDir() {
+		return "", time.Time{}, errors.Errorf("%s is not a directory", gitDir)
+	}
+	f, err := os.Open(filepath.Join(gitDir, "index"))
+	if err != nil {
+		return "", time.Time{}, errors.Trace(err)
+	}
+	defer f.Close()
+	var idx index.Index
+	if err := index.NewDecoder(f).Decode(&idx); err != nil {
+		return "", time.Time{}, errors.Annotatef(err, "failed to read index")
+	}
+	fpr := &fingerprinter{h: sha256.New()}
+	fmt.Fprintf(fpr.h, "%s\n%s\n", version, strings.Join(excludeGlobs, "\n"))
+	for _, n := range []string{"HEAD", "index", "packed-refs"} {
+		fpr.add(filepath.Join(gitDir, n))
+	}
+	err = filepath.Walk(filepath.Join(gitDir, "refs"), func(p string, fi os.FileInfo, err error) error {
+		if err == nil {
+			fpr.add(p)
+		}
+		return nil
+	})
+	if err != nil {
+		return "", time.Time{}, errors.Trace(err)
+	}
+	dirs := map[string]bool{localDir: true}
+	for _, e := range idx.Entries {
+		p := filepath.Join(localDir, filepath.FromSlash(e.Name))
+		fpr.add(p)
+		for d := filepath.Dir(p); len(d) > len(localDir) && !dirs[d]; d = filepath.Dir(d) {
+			dirs[d] = true
+		}
+	}
+	var dirNames []string
+	for d := range dirs {
+		dirNames = append(dirNames, d)
+	}
+	sort.Strings(dirNames)
+	for _, d := range dirNames {
+		fpr.add(d)
+	}
+	return hex.EncodeToString(fpr.h.Sum(nil)), fpr.newest, nil
+}
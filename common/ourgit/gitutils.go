@@ -21,7 +21,7 @@ type RefType string
 
 type CloneOptions struct {
 	// Path to a local repo which should be used as a reference for a new clone.
-	// Equivalent of the --reference CLI flag.
+	// Equivalent of the --reference --dissociate CLI flags.
 	ReferenceDir string
 	// How many commits to fetch. Equivalent of the --depth CLI flag.
 	Depth int
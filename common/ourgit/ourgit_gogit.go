@@ -8,7 +8,6 @@ import (
 	"fmt"
 	"io/ioutil"
 	"os"
-	"path"
 	"path/filepath"
 
 	git "github.com/go-git/go-git/v5"
@@ -19,6 +18,8 @@ import (
 	"github.com/go-git/go-git/v5/plumbing/transport/http"
 	"github.com/juju/errors"
 	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/common/ourglob"
 )
 
 // NewOurGit returns a go-git-based implementation of OurGit
@@ -250,6 +251,16 @@ func (m *ourGitGoGit) Fetch(localDir string, what string, opts FetchOptions) err
 // IsClean returns true if there are no modified, deleted or untracked files,
 // and no non-pushed commits since the given version.
 func (m *ourGitGoGit) IsClean(localDir, version string, excludeGlobs []string) (bool, error) {
+	return isCleanCached(localDir, version, excludeGlobs, func() (bool, error) {
+		return m.isClean(localDir, version, excludeGlobs)
+	})
+}
+
+func (m *ourGitGoGit) isClean(localDir, version string, excludeGlobs []string) (bool, error) {
+	excl, err := ourglob.NewPatternSet(excludeGlobs, ourglob.SetOptions{WholeOrBase: true})
+	if err != nil {
+		return false, errors.Trace(err)
+	}
 	repo, err := git.PlainOpen(localDir)
 	if err != nil {
 		return false, errors.Trace(err)
@@ -266,14 +277,9 @@ func (m *ourGitGoGit) IsClean(localDir, version string, excludeGlobs []string) (
 	}
 
 	r := true
-s:
 	for fn, fs := range status {
-		for _, g := range excludeGlobs {
-			m1, _ := path.Match(g, fn)
-			m2, _ := path.Match(g, path.Base(fn))
-			if m1 || m2 {
-				continue s
-			}
+		if excl.MatchAny(fn) >= 0 {
+			continue
 		}
 		if fs.Worktree != git.Unmodified || fs.Staging != git.Unmodified {
 			glog.Errorf("%s: dirty: %s %c %c", localDir, fn, fs.Worktree, fs.Staging)
@@ -9,11 +9,12 @@ import (
 	"fmt"
 	"os"
 	"os/exec"
-	"path"
 	"strings"
 
 	"github.com/juju/errors"
 	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/common/ourglob"
 )
 
 const (
@@ -32,6 +33,12 @@ type ourGitShell struct {
 	creds *Credentials
 }
 
+// IsShellGit returns true if gitinst is the shell-based implementation.
+func IsShellGit(gitinst OurGit) bool {
+	_, ok := gitinst.(*ourGitShell)
+	return ok
+}
+
 func (m *ourGitShell) GetCurrentHash(localDir string) (string, error) {
 	resp, err := m.shellGit(localDir, "rev-parse", "HEAD")
 	if err != nil {
@@ -102,6 +109,16 @@ func (m *ourGitShell) Fetch(localDir string, what string, opts FetchOptions) err
 // IsClean returns true if there are no modified, deleted or untracked files,
 // and no non-pushed commits since the given version.
 func (m *ourGitShell) IsClean(localDir, version string, excludeGlobs []string) (bool, error) {
+	return isCleanCached(localDir, version, excludeGlobs, func() (bool, error) {
+		return m.isClean(localDir, version, excludeGlobs)
+	})
+}
+
+func (m *ourGitShell) isClean(localDir, version string, excludeGlobs []string) (bool, error) {
+	excl, err := ourglob.NewPatternSet(excludeGlobs, ourglob.SetOptions{WholeOrBase: true})
+	if err != nil {
+		return false, errors.Trace(err)
+	}
 	// First, check if there are modified, deleted or untracked files
 	flags := []string{"--exclude-standard", "--modified", "--others", "--deleted"}
 	for _, g := range excludeGlobs {
@@ -127,15 +144,10 @@ func (m *ourGitShell) IsClean(localDir, version string, excludeGlobs []string) (
 	}
 
 	s := bufio.NewScanner(bytes.NewBuffer([]byte(resp)))
-scan:
 	for s.Scan() {
 		fn := s.Text()
-		for _, g := range excludeGlobs {
-			m1, _ := path.Match(g, fn)
-			m2, _ := path.Match(g, path.Base(fn))
-			if m1 || m2 {
-				continue scan
-			}
+		if excl.MatchAny(fn) >= 0 {
+			continue
 		}
 		glog.Errorf("%s: dirty (untracked files or uncommitted changes)", localDir)
 		return false, nil
@@ -193,7 +205,9 @@ func (m *ourGitShell) Clone(srcURL, targetDir string, opts CloneOptions) error {
 	var args []string
 
 	if opts.ReferenceDir != "" {
-		args = append(args, "--reference", opts.ReferenceDir)
+		// Copy the borrowed objects so the clone does not depend on the reference repo,
+		// which may get pruned, removed or not be available inside a build container.
+		args = append(args, "--reference", opts.ReferenceDir, "--dissociate")
 	}
 
 	if opts.Depth > 0 {
@@ -211,6 +225,23 @@ func (m *ourGitShell) Clone(srcURL, targetDir string, opts CloneOptions) error {
 	return errors.Trace(err)
 }
 
+// UpdateMirrorShell creates or updates a bare mirror of the srcURL repo in mirrorDir.
+// Mirrors are used as a local object source for clones (see CloneOptions.ReferenceDir).
+func UpdateMirrorShell(creds *Credentials, srcURL, mirrorDir string) error {
+	m := &ourGitShell{creds: creds}
+	if _, err := os.Stat(mirrorDir); err != nil {
+		if _, err := m.shellGit("", "clone", "--mirror", srcURL, mirrorDir); err != nil {
+			os.RemoveAll(mirrorDir)
+			return errors.Annotatef(err, "failed to create mirror of %s", srcURL)
+		}
+		return nil
+	}
+	if _, err := m.shellGit(mirrorDir, "fetch", "--prune", "origin"); err != nil {
+		return errors.Annotatef(err, "failed to update mirror of %s", srcURL)
+	}
+	return nil
+}
+
 func (m *ourGitShell) GetOriginURL(localDir string) (string, error) {
 	resp, err := m.shellGit(localDir, "remote", "get-url", "origin")
 	if err != nil {
@@ -16,7 +16,10 @@
 //
 package ourglob
 
-import "testing"
+import (
+	"fmt"
+	"testing"
+)
 
 type expect struct {
 	matcher Matcher
@@ -75,3 +78,93 @@ func TestGlobmatcher(t *testing.T) {
 		}
 	}
 }
+
+func benchItems() ([]Item, []string) {
+	var items []Item
+	for i := 0; i < 50; i++ {
+		items = append(items, Item{fmt.Sprintf("src/mod%d/*.c", i), i%2 == 0})
+	}
+	items = append(items, Item{"*", false})
+	var paths []string
+	for i := 0; i < 100; i++ {
+		paths = append(paths, fmt.Sprintf("src/mod%d/file%d.c", i, i))
+	}
+	return items, paths
+}
+
+func benchMatcher(b *testing.B, m Matcher, paths []string) {
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		for _, s := range paths {
+			if _, err := m.Match(s); err != nil {
+				b.Fatal(err)
+			}
+		}
+	}
+}
+
+func BenchmarkMatch(b *testing.B) {
+	items, paths := benchItems()
+	benchMatcher(b, &Pat{Items: items}, paths)
+}
+
+func BenchmarkCompiledMatch(b *testing.B) {
+	items, paths := benchItems()
+	cp, err := PatItems(items).Compile()
+	if err != nil {
+		b.Fatal(err)
+	}
+	benchMatcher(b, cp, paths)
+}
+
+func TestCompiledMatchesPat(t *testing.T) {
+	items := PatItems{
+		{"build/objs/*.elf", true},
+		{"build/objs/*", false},
+		{"src", false},
+		{"*.c", true},
+		{"docs/README.md", false},
+		{"docs/*.md", true},
+		{"lib/*/*.a", false},
+		{"[a-c]*", true},
+		{"*", false},
+	}
+	cp, err := items.Compile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, s := range []string{
+		"", "build", "build/objs/fw.elf", "build/objs/fw.bin", "build/objs/x/y.elf",
+		"src", "src/main.c", "main.c", "main.h", "docs/README.md", "docs/x.md", "docs/x/y.md",
+		"lib/foo/libfoo.a", "lib/foo/x/libfoo.a", "apple", "zzz",
+	} {
+		want, _ := items.Match(s)
+		got, _ := cp.Match(s)
+		if got != want {
+			t.Errorf("%q: want %v, got %v", s, want, got)
+		}
+	}
+}
+
+func TestPatternSetWholeOrBase(t *testing.T) {
+	ps, err := NewPatternSet([]string{"lib/*/*.a", "*.pl", "rom.elf", "user.h"}, SetOptions{WholeOrBase: true})
+	if err != nil {
+		t.Fatal(err)
+	}
+	for s, want := range map[string]int{
+		"lib/foo/libfoo.a":   0,
+		"lib/foo/x/libfoo.a": -1,
+		"tools/gen.pl":       1,
+		"rom.elf":            2,
+		"esp32/rom.elf":      2,
+		"src/user.h":         3,
+		"src/user.c":         -1,
+	} {
+		if got := ps.MatchAny(s); got != want {
+			t.Errorf("%q: want %d, got %d", s, want, got)
+		}
+	}
+	if _, err := NewPatternSet([]string{"[a-"}, SetOptions{}); err == nil {
+		t.Errorf("invalid pattern accepted")
+	}
+}
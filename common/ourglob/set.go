@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2014-2019 Cesanta Software Limited
+// All rights reserved
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+package ourglob
+
+import (
+	"path"
+	"path/filepath"
+	"runtime"
+	"strings"
+
+	"github.com/juju/errors"
+)
+
+type SetOptions struct {
+	// Match patterns against the whole path or its last element, like git excludes,
+	// instead of the leading elements of the path. Paths are slash-separated.
+	WholeOrBase bool
+}
+
+// PatternSet is a list of patterns compiled for matching many paths.
+// Patterns without wildcards are looked up in a map, patterns of the form
+// "*.ext" are looked up by extension and the rest are only tried on paths
+// that start with their literal prefix, so every path is checked against
+// all the patterns in a single pass.
+type PatternSet struct {
+	opts  SetOptions
+	sep   byte
+	match func(pattern, name string) (bool, error)
+	// Patterns without wildcards, mapped to the index of their first occurrence.
+	literals map[string]int
+	// Patterns of the form "*<literal>", by extension of the literal.
+	suffixes map[string][]suffixPat
+	// All the other patterns, in order.
+	general []generalPat
+	// Maximum number of path elements in a pattern and in a literal.
+	maxElems, maxLiteralElems int
+}
+
+type suffixPat struct {
+	idx    int
+	suffix string
+}
+
+type generalPat struct {
+	idx     int
+	pattern string
+	// Literal part of the pattern before the first wildcard.
+	prefix string
+	elems  int
+}
+
+// NewPatternSet compiles the patterns. By default, pattern matching semantics
+// are the same as with Pat: a pattern of N elements is matched against the
+// first N elements of the path.
+func NewPatternSet(patterns []string, opts SetOptions) (*PatternSet, error) {
+	ps := &PatternSet{
+		opts:     opts,
+		sep:      filepath.Separator,
+		match:    filepath.Match,
+		literals: make(map[string]int),
+		suffixes: make(map[string][]suffixPat),
+	}
+	metaChars := `*?[`
+	if runtime.GOOS != "windows" {
+		metaChars = `*?[\`
+	}
+	if opts.WholeOrBase {
+		ps.sep, ps.match, metaChars = '/', path.Match, `*?[\`
+	}
+	for i, p := range patterns {
+		// Check pattern is well-formed.
+		if _, err := ps.match(p, ""); err != nil {
+			return nil, errors.Annotatef(err, "invalid pattern %q", p)
+		}
+		elems := strings.Count(p, string(ps.sep)) + 1
+		if elems > ps.maxElems {
+			ps.maxElems = elems
+		}
+		mi := strings.IndexAny(p, metaChars)
+		switch {
+		case mi < 0:
+			if _, ok := ps.literals[p]; !ok {
+				ps.literals[p] = i
+			}
+			if elems > ps.maxLiteralElems {
+				ps.maxLiteralElems = elems
+			}
+		case mi == 0 && p[0] == '*' && len(p) > 1 && !strings.ContainsAny(p[1:], metaChars) &&
+			strings.IndexByte(p, ps.sep) < 0 && strings.IndexByte(p, '.') >= 0:
+			ext := p[strings.LastIndexByte(p, '.'):]
+			ps.suffixes[ext] = append(ps.suffixes[ext], suffixPat{idx: i, suffix: p[1:]})
+		default:
+			ps.general = append(ps.general, generalPat{idx: i, pattern: p, prefix: p[:mi], elems: elems})
+		}
+	}
+	return ps, nil
+}
+
+// better returns true if the pattern with index i should be returned instead of best.
+func better(i, best int) bool {
+	return best < 0 || i < best
+}
+
+// firstSuffix returns the index of the first "*.ext" pattern matching the path element s
+// if it precedes best, otherwise best.
+func (ps *PatternSet) firstSuffix(s string, best int) int {
+	di := strings.LastIndexByte(s, '.')
+	if di < 0 {
+		return best
+	}
+	for _, sp := range ps.suffixes[s[di:]] {
+		if !better(sp.idx, best) {
+			break
+		}
+		if strings.HasSuffix(s, sp.suffix) {
+			return sp.idx
+		}
+	}
+	return best
+}
+
+// MatchAny returns the index of the first pattern that matches s, or -1 if none do.
+func (ps *PatternSet) MatchAny(s string) int {
+	if ps.opts.WholeOrBase {
+		return ps.matchAnyWholeOrBase(s)
+	}
+	// Offsets of separators that end the leading elements of s.
+	var endsBuf [16]int
+	ends := endsBuf[:0]
+	for i := 0; i < len(s) && len(ends) < ps.maxElems; i++ {
+		if s[i] == ps.sep {
+			ends = append(ends, i)
+		}
+	}
+	leading := func(n int) string {
+		if n <= len(ends) {
+			return s[:ends[n-1]]
+		}
+		return s
+	}
+	best := -1
+	for n := 1; n <= ps.maxLiteralElems; n++ {
+		if i, ok := ps.literals[leading(n)]; ok && better(i, best) {
+			best = i
+		}
+		if n > len(ends) {
+			break
+		}
+	}
+	if len(ps.suffixes) > 0 {
+		best = ps.firstSuffix(leading(1), best)
+	}
+	for _, gp := range ps.general {
+		if !better(gp.idx, best) {
+			break
+		}
+		t := leading(gp.elems)
+		if !strings.HasPrefix(t, gp.prefix) {
+			continue
+		}
+		if matched, _ := ps.match(gp.pattern, t); matched {
+			return gp.idx
+		}
+	}
+	return best
+}
+
+func (ps *PatternSet) matchAnyWholeOrBase(s string) int {
+	base := path.Base(s)
+	best := -1
+	for _, t := range []string{s, base} {
+		if i, ok := ps.literals[t]; ok && better(i, best) {
+			best = i
+		}
+	}
+	if len(ps.suffixes) > 0 {
+		best = ps.firstSuffix(base, best)
+	}
+	for _, gp := range ps.general {
+		if !better(gp.idx, best) {
+			break
+		}
+		for _, t := range []string{s, base} {
+			if !strings.HasPrefix(t, gp.prefix) {
+				continue
+			}
+			if matched, _ := ps.match(gp.pattern, t); matched {
+				return gp.idx
+			}
+		}
+	}
+	return best
+}
+
+// CompiledPat is Pat with the patterns compiled into a PatternSet.
+type CompiledPat struct {
+	set   *PatternSet
+	items PatItems
+}
+
+// Compile returns a matcher that gives the same results as Pat.Match,
+// use it when matching many paths against the same patterns.
+func (items PatItems) Compile() (*CompiledPat, error) {
+	var patterns []string
+	for _, item := range items {
+		patterns = append(patterns, item.Pattern)
+	}
+	set, err := NewPatternSet(patterns, SetOptions{})
+	if err != nil {
+		return nil, errors.Trace(err)
+	}
+	return &CompiledPat{set: set, items: items}, nil
+}
+
+func (m *CompiledPat) Match(s string) (bool, error) {
+	i := m.set.MatchAny(s)
+	if i < 0 {
+		return false, nil
+	}
+	return m.items[i].Match, nil
+}
@@ -22,6 +22,8 @@ import (
 	"io/ioutil"
 	"os"
 	"path/filepath"
+	"runtime"
+	"sync"
 
 	"github.com/juju/errors"
 	glog "k8s.io/klog/v2"
@@ -35,14 +37,24 @@ import (
 // If src is a symlink, dst will be a symlink with the same target as src.
 func CopyFile(src, dst string) (err error) {
 	glog.Infof("CopyFile %q -> %q", src, dst)
+	return copyFile(src, dst, false)
+}
 
+// copyFile is CopyFile without logging. If linkReadOnly is true, read-only
+// files are hard linked instead of copied if possible: since nobody can change
+// them, it's safe to share. Not done for root, who could write through the link.
+func copyFile(src, dst string, linkReadOnly bool) (err error) {
 	var si os.FileInfo
 	si, err = os.Lstat(src)
 	if err != nil {
 		err = errors.Trace(err)
 		return
 	}
+	return copyFileWithInfo(src, dst, si, linkReadOnly)
+}
 
+// copyFileWithInfo is copyFile with the result of os.Lstat(src) already known.
+func copyFileWithInfo(src, dst string, si os.FileInfo, linkReadOnly bool) (err error) {
 	if si.Mode()&os.ModeSymlink != 0 {
 		// Source file is a symlink
 		var linkTgt string
@@ -60,6 +72,12 @@ func CopyFile(src, dst string) (err error) {
 	} else {
 		// Source file is not a symlink
 
+		if linkReadOnly && si.Mode().IsRegular() && si.Mode().Perm()&0222 == 0 && os.Geteuid() != 0 {
+			if err = os.Link(src, dst); err == nil {
+				return
+			}
+		}
+
 		var in *os.File
 		in, err = os.Open(src)
 		if err != nil {
@@ -86,6 +104,10 @@ func CopyFile(src, dst string) (err error) {
 			return
 		}
 
+		if cloneFile(in, out) == nil {
+			return
+		}
+
 		_, err = io.Copy(out, in)
 		if err != nil {
 			err = errors.Trace(err)
@@ -130,9 +152,58 @@ func LinkOrCopyFile(src, dst string) (err error) {
 
 // CopyDir recursively copies a directory tree, attempting to preserve permissions.
 // Source directory must exist, destination must either not exist or be a
-// directory.
+// directory. Directories are created first, files are then copied in parallel,
+// cloned if the filesystem supports it. Read-only files are hard linked if possible.
 func CopyDir(src, dst string, blacklist []string) (err error) {
 	glog.Infof("CopyDir %q -> %q (blacklist %s)", src, dst, blacklist)
+
+	type copyJob struct {
+		src, dst string
+		si       os.FileInfo
+	}
+	numWorkers := 2 * runtime.NumCPU()
+	jobs := make(chan copyJob)
+	errCh := make(chan error, numWorkers)
+	// Closed when a worker fails, to stop the walk.
+	failed := make(chan struct{})
+	var failOnce sync.Once
+	for i := 0; i < numWorkers; i++ {
+		go func() {
+			var err error
+			for j := range jobs {
+				if err != nil {
+					continue
+				}
+				if err = copyFileWithInfo(j.src, j.dst, j.si, true); err != nil {
+					err = errors.Annotatef(err, "failed to copy %s", j.src)
+					failOnce.Do(func() { close(failed) })
+				}
+			}
+			errCh <- err
+		}()
+	}
+
+	err = copyDirTree(src, dst, blacklist, func(srcPath, dstPath string, si os.FileInfo) bool {
+		select {
+		case jobs <- copyJob{srcPath, dstPath, si}:
+			return true
+		case <-failed:
+			return false
+		}
+	})
+	close(jobs)
+	for i := 0; i < numWorkers; i++ {
+		if e := <-errCh; e != nil && err == nil {
+			err = e
+		}
+	}
+	return
+}
+
+// copyDirTree creates the directory tree of src under dst and calls copy for
+// each regular file, passing the file info obtained while listing the directory.
+// If copyFn returns false, the walk is stopped.
+func copyDirTree(src, dst string, blacklist []string, copyFn func(srcPath, dstPath string, si os.FileInfo) bool) (err error) {
 	src = filepath.Clean(src)
 	dst = filepath.Clean(dst)
 
@@ -181,15 +252,13 @@ entriesLoop:
 		dstPath := filepath.Join(dst, entry.Name())
 
 		if entry.IsDir() {
-			err = CopyDir(srcPath, dstPath, blacklist)
+			err = copyDirTree(srcPath, dstPath, blacklist, copyFn)
 			if err != nil {
 				err = errors.Trace(err)
 				return
 			}
 		} else if entry.Mode().IsRegular() {
-			err = CopyFile(srcPath, dstPath)
-			if err != nil {
-				err = errors.Trace(err)
+			if !copyFn(srcPath, dstPath, entry) {
 				return
 			}
 		} else {
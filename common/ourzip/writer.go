@@ -297,14 +297,67 @@ func (w *Writer) CreateHeader(fh *FileHeader) (io.Writer, error) {
 }
 
 func (w *Writer) createHeaderCommon(fh *FileHeader, cw io.Writer, writeDesc bool) (*fileWriter, error) {
+	if err := w.prepareHeader(fh, writeDesc); err != nil {
+		return nil, err
+	}
+
+	fw := &fileWriter{
+		zipw:      cw,
+		compCount: &countWriter{w: cw},
+		crc32:     crc32.NewIEEE(),
+		writeDesc: writeDesc,
+	}
+	comp := w.compressor(fh.Method)
+	if comp == nil {
+		return nil, ErrAlgorithm
+	}
+	var err error
+	fw.comp, err = comp(fw.compCount)
+	if err != nil {
+		return nil, err
+	}
+	fw.rawCount = &countWriter{w: fw.comp}
+
+	h := &header{
+		FileHeader: fh,
+		offset:     uint64(w.cw.count),
+	}
+	w.dir = append(w.dir, h)
+	fw.header = h
+	w.last = fw
+	return fw, nil
+}
+
+// AddRaw adds a file with data that is already compressed using fh.Method.
+// fh.CRC32 must be set to the checksum of the uncompressed data.
+// This allows files to be compressed concurrently and then written out in order.
+func (w *Writer) AddRaw(fh *FileHeader, compressed []byte, uncompressedSize uint64) error {
+	if err := w.prepareHeader(fh, false); err != nil {
+		return err
+	}
+	setSizes(fh, uint64(len(compressed)), uncompressedSize)
+	w.dir = append(w.dir, &header{
+		FileHeader: fh,
+		offset:     uint64(w.cw.count),
+	})
+	w.last = nil
+	if err := writeHeader(w.cw, fh); err != nil {
+		return err
+	}
+	_, err := w.cw.Write(compressed)
+	return err
+}
+
+// prepareHeader closes the previous file and fills in fh fields that do not depend on the data.
+func (w *Writer) prepareHeader(fh *FileHeader, writeDesc bool) error {
 	if w.last != nil && !w.last.closed {
 		if err := w.last.close(); err != nil {
-			return nil, err
+			return err
 		}
 	}
 	if len(w.dir) > 0 && w.dir[len(w.dir)-1].FileHeader == fh {
 		// See https://golang.org/issue/11144 confusion.
-		return nil, errors.New("archive/zip: invalid duplicate FileHeader")
+		return errors.New("archive/zip: invalid duplicate FileHeader")
 	}
 
 	if writeDesc {
@@ -366,32 +419,7 @@ func (w *Writer) createHeaderCommon(fh *FileHeader, cw io.Writer, writeDesc bool
 		eb.uint32(mt) // ModTime
 		fh.Extra = append(fh.Extra, mbuf[:]...)
 	}
-
-	fw := &fileWriter{
-		zipw:      cw,
-		compCount: &countWriter{w: cw},
-		crc32:     crc32.NewIEEE(),
-		writeDesc: writeDesc,
-	}
-	comp := w.compressor(fh.Method)
-	if comp == nil {
-		return nil, ErrAlgorithm
-	}
-	var err error
-	fw.comp, err = comp(fw.compCount)
-	if err != nil {
-		return nil, err
-	}
-	fw.rawCount = &countWriter{w: fw.comp}
-
-	h := &header{
-		FileHeader: fh,
-		offset:     uint64(w.cw.count),
-	}
-	w.dir = append(w.dir, h)
-	fw.header = h
-	w.last = fw
-	return fw, nil
+	return nil
 }
 
 func writeHeader(w io.Writer, h *FileHeader) error {
@@ -475,17 +503,7 @@ func (w *fileWriter) close() error {
 	// update FileHeader
 	fh := w.header.FileHeader
 	fh.CRC32 = w.crc32.Sum32()
-	fh.CompressedSize64 = uint64(w.compCount.count)
-	fh.UncompressedSize64 = uint64(w.rawCount.count)
-
-	if fh.isZip64() {
-		fh.CompressedSize = uint32max
-		fh.UncompressedSize = uint32max
-		fh.ReaderVersion = zipVersion45 // requires 4.5 - File uses ZIP64 format extensions
-	} else {
-		fh.CompressedSize = uint32(fh.CompressedSize64)
-		fh.UncompressedSize = uint32(fh.UncompressedSize64)
-	}
+	setSizes(fh, uint64(w.compCount.count), uint64(w.rawCount.count))
 
 	if w.writeDesc {
 		// Write data descriptor. This is more complicated than one would
@@ -515,6 +533,20 @@ func (w *fileWriter) close() error {
 	return nil
 }
 
+func setSizes(fh *FileHeader, compressedSize, uncompressedSize uint64) {
+	fh.CompressedSize64 = compressedSize
+	fh.UncompressedSize64 = uncompressedSize
+
+	if fh.isZip64() {
+		fh.CompressedSize = uint32max
+		fh.UncompressedSize = uint32max
+		fh.ReaderVersion = zipVersion45 // requires 4.5 - File uses ZIP64 format extensions
+	} else {
+		fh.CompressedSize = uint32(fh.CompressedSize64)
+		fh.UncompressedSize = uint32(fh.UncompressedSize64)
+	}
+}
+
 type countWriter struct {
 	w     io.Writer
 	count int64
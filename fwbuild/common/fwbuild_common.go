@@ -21,4 +21,26 @@ const (
 	// The code which is returned by the fwbuild-instance binary in case of
 	// build failure
 	FwbuildExitCodeBuildFailed = 200
+
+	// Layout of the volumes dir: apps/<app>/<platform>/build_contexts/<build_ctx>
+	AppsRootName     = "apps"
+	BuildCtxRootName = "build_contexts"
+
+	// Metadata of the uploaded files, stored in each build context
+	BuildCtxInfoFilename = "build_ctx_info.json"
 )
+
+// WarmJob is sent by the manager to a warm instance (started with the "serve"
+// action) over its socket, one JSON object per line. Fields correspond to the
+// --req-params and --output-zip flags of the "build" action.
+type WarmJob struct {
+	ReqParams string `json:"req_params"`
+	OutputZip string `json:"output_zip"`
+}
+
+// WarmJobResult is sent back when the job is done. ExitCode is what the "build"
+// action would exit with.
+type WarmJobResult struct {
+	ExitCode int    `json:"exit_code"`
+	Error    string `json:"error,omitempty"`
+}
@@ -24,6 +24,7 @@ import (
 	"io/ioutil"
 	"os"
 	"path/filepath"
+	"runtime"
 
 	"github.com/juju/errors"
 )
@@ -41,64 +42,101 @@ type BuildCtxInfoFile struct {
 	IsDir bool   `json:"is_dir,omitempty"`
 
 	// Relevant if IsDir is false
-	Size int    `json:"size,omitempty"`
-	Hash string `json:"hash,omitempty"`
+	Size    int    `json:"size,omitempty"`
+	ModTime int64  `json:"mtime,omitempty"`
+	Hash    string `json:"hash,omitempty"`
 }
 
 // GetBuildCtxInfo treats src as *clean* uploaded sources (meaning, src should
-// contain only uploaded sources, and nothing else), and calculates metadata
-func GetBuildCtxInfo(src string) (*BuildCtxInfo, error) {
+// contain only uploaded sources, and nothing else), and calculates metadata.
+// If prev is not nil, hashes of files with the same path, size and
+// modification time are taken from it instead of being calculated.
+func GetBuildCtxInfo(src string, prev *BuildCtxInfo) (*BuildCtxInfo, error) {
 	bctxInfo := BuildCtxInfo{
 		Files: BuildCtxInfoDir(map[string]*BuildCtxInfoFile{}),
 	}
 
-	if err := addBuildCtxInfoDir(&bctxInfo, src, src); err != nil {
+	var toHash []string
+	if err := addBuildCtxInfoDir(&bctxInfo, src, src, prev, &toHash); err != nil {
+		return nil, errors.Trace(err)
+	}
+
+	if err := hashBuildCtxFiles(&bctxInfo, src, toHash); err != nil {
 		return nil, errors.Trace(err)
 	}
 
 	return &bctxInfo, nil
 }
 
-func addBuildCtxInfoDir(bctxInfo *BuildCtxInfo, src, cut string) error {
+func addBuildCtxInfoDir(bctxInfo *BuildCtxInfo, src, cut string, prev *BuildCtxInfo, toHash *[]string) error {
 	entries, err := ioutil.ReadDir(src)
 	if err != nil {
 		return errors.Trace(err)
 	}
 
 	for _, entry := range entries {
-		var err error
 		curPath := filepath.Join(src, entry.Name())
-		bctxInfo.Files[curPath[len(cut)+1:]], err = getBuildCtxInfoFile(curPath, entry)
-		if err != nil {
-			return errors.Trace(err)
+		relPath := curPath[len(cut)+1:]
+		cur := &BuildCtxInfoFile{
+			Name:  entry.Name(),
+			IsDir: entry.IsDir(),
 		}
+		bctxInfo.Files[relPath] = cur
 
 		if entry.IsDir() {
-			if err := addBuildCtxInfoDir(bctxInfo, curPath, cut); err != nil {
+			if err := addBuildCtxInfoDir(bctxInfo, curPath, cut, prev, toHash); err != nil {
 				return errors.Trace(err)
 			}
+			continue
+		}
+
+		cur.Size = int(entry.Size())
+		cur.ModTime = entry.ModTime().UnixNano()
+		if prev != nil {
+			if pf := prev.Files[relPath]; pf != nil && !pf.IsDir && pf.Hash != "" &&
+				pf.Size == cur.Size && pf.ModTime == cur.ModTime {
+				cur.Hash = pf.Hash
+				continue
+			}
 		}
+		*toHash = append(*toHash, relPath)
 	}
 
 	return nil
 }
 
-func getBuildCtxInfoFile(src string, entry os.FileInfo) (*BuildCtxInfoFile, error) {
-	cur := BuildCtxInfoFile{
-		Name:  entry.Name(),
-		IsDir: entry.IsDir(),
+// hashBuildCtxFiles calculates hashes of the files in parallel.
+func hashBuildCtxFiles(bctxInfo *BuildCtxInfo, src string, files []string) error {
+	numWorkers := runtime.NumCPU()
+	if numWorkers > len(files) {
+		numWorkers = len(files)
 	}
-
-	if !entry.IsDir() {
-		var err error
-		cur.Size = int(entry.Size())
-		cur.Hash, err = getFileHash(src)
-		if err != nil {
-			return nil, errors.Trace(err)
+	fileCh := make(chan string)
+	errCh := make(chan error, numWorkers)
+	for i := 0; i < numWorkers; i++ {
+		go func() {
+			var err error
+			for relPath := range fileCh {
+				if err != nil {
+					continue
+				}
+				// Each worker writes to its own entries only.
+				bctxInfo.Files[relPath].Hash, err = getFileHash(filepath.Join(src, relPath))
+			}
+			errCh <- err
+		}()
+	}
+	for _, f := range files {
+		fileCh <- f
+	}
+	close(fileCh)
+	var err error
+	for i := 0; i < numWorkers; i++ {
+		if e := <-errCh; e != nil && err == nil {
+			err = e
 		}
 	}
-
-	return &cur, nil
+	return errors.Trace(err)
 }
 
 func getFileHash(src string) (string, error) {
@@ -55,6 +55,7 @@ var (
 	reqParFileName    = flag.String("req-params", "", "Request params filename")
 	outputZipFileName = flag.String("output-zip", "", "Output zip filename")
 	timeoutFlag       = flag.Duration("timeout", 15*time.Minute, "Timeout for builds")
+	compileCacheDir   = flag.String("compile-cache-dir", "", "If set, compiled objects are shared between builds through this dir")
 
 	locks = &locksStruct{
 		flockByPath: map[string]*flock.Flock{},
@@ -66,11 +67,7 @@ var (
 const (
 	payloadLimit = 2 * 1024 * 1024
 
-	appsRootName = "apps"
-
 	updateSharedReposInterval = time.Minute * 30
-
-	buildCtxInfoFilename = "build_ctx_info.json"
 )
 
 // buildCtxItem represents a file which is present in at least source or
@@ -128,7 +125,11 @@ func updateBuildCtx(src, tgt string) error {
 
 	sort.Strings(keys)
 
-	// Iterate over all items (which are present in either src or tgt)
+	// Dirs removed from the target, along with all their contents
+	removedDirs := map[string]bool{}
+
+	// Iterate over all items (which are present in either src or tgt).
+	// Parents are sorted before their children.
 	for _, k := range keys {
 		v := m[k]
 		equal := false
@@ -150,8 +151,21 @@ func updateBuildCtx(src, tgt string) error {
 				glog.Infof("UPDATE %q", k)
 			}
 			updatedCnt++
-			// Remove the target item, ignoring any error (at least it might not even exist)
-			os.RemoveAll(tgtItemPath)
+			if v.TgtItem != nil {
+				if removedDirs[filepath.Dir(k)] {
+					// Already removed with the parent dir.
+					if v.TgtItem.IsDir {
+						removedDirs[k] = true
+					}
+				} else if v.SrcItem == nil || v.TgtItem.IsDir || v.SrcItem.IsDir {
+					// Files are replaced by rename below, everything else has to be removed.
+					// Ignore errors, target might not even exist.
+					os.RemoveAll(tgtItemPath)
+					if v.TgtItem.IsDir {
+						removedDirs[k] = true
+					}
+				}
+			}
 
 			// If source is present, rename it as a target (or create an empty dir
 			// if source is a dir)
@@ -168,17 +182,20 @@ func updateBuildCtx(src, tgt string) error {
 			}
 		} else {
 			// Items are equal, leaving target intact
-			glog.Infof("EQ     %q", k)
+			glog.V(1).Infof("EQ     %q", k)
+			// The target file is kept, remember its mtime for the next update.
+			if !v.SrcItem.IsDir {
+				if fi, err := os.Lstat(tgtItemPath); err == nil {
+					v.SrcItem.ModTime = fi.ModTime().UnixNano()
+				}
+			}
 		}
 	}
 
-	srcInfoFilename := filepath.Join(src, buildCtxInfoFilename)
-	tgtInfoFilename := filepath.Join(tgt, buildCtxInfoFilename)
-
-	os.RemoveAll(tgtInfoFilename)
-	if err := os.Rename(srcInfoFilename, tgtInfoFilename); err != nil {
+	if err := writeBuildCtxInfo(tgt, srcInfo); err != nil {
 		return errors.Trace(err)
 	}
+	os.Remove(filepath.Join(src, fwbuildcommon.BuildCtxInfoFilename))
 
 	// TODO(dfrank): make sure the new build context info file is in sync with
 	// the actual files; if not, return an error, so that the build will be
@@ -191,7 +208,7 @@ func updateBuildCtx(src, tgt string) error {
 }
 
 func readBuildCtxInfo(src string) (*BuildCtxInfo, error) {
-	data, err := ioutil.ReadFile(filepath.Join(src, buildCtxInfoFilename))
+	data, err := ioutil.ReadFile(filepath.Join(src, fwbuildcommon.BuildCtxInfoFilename))
 	if err != nil {
 		return nil, errors.Trace(err)
 	}
@@ -205,24 +222,96 @@ func readBuildCtxInfo(src string) (*BuildCtxInfo, error) {
 	return &bctxInfo, nil
 }
 
-func saveBuildCtxInfo(src string) error {
-	bctxInfo, err := GetBuildCtxInfo(src)
+// saveBuildCtxInfo calculates and saves build context info of src. Hashes of
+// files which have not changed since the info of prevDir was saved are reused.
+func saveBuildCtxInfo(src, prevDir string) error {
+	prev, _ := readBuildCtxInfo(prevDir)
+	bctxInfo, err := GetBuildCtxInfo(src, prev)
 	if err != nil {
 		return errors.Trace(err)
 	}
 
+	return errors.Trace(writeBuildCtxInfo(src, bctxInfo))
+}
+
+func writeBuildCtxInfo(dir string, bctxInfo *BuildCtxInfo) error {
 	data, err := json.MarshalIndent(bctxInfo, "", "  ")
 	if err != nil {
 		return errors.Trace(err)
 	}
 
-	if err := ioutil.WriteFile(filepath.Join(src, buildCtxInfoFilename), data, 0666); err != nil {
+	if err := ioutil.WriteFile(filepath.Join(dir, fwbuildcommon.BuildCtxInfoFilename), data, 0666); err != nil {
 		return errors.Trace(err)
 	}
 
 	return nil
 }
 
+// unpackUploadedFiles puts files of the incremental upload to dst, and returns
+// the files whose contents were not uploaded because the build context has them.
+// Uploaded contents are form files named after their hashes.
+func unpackUploadedFiles(reqPar *reqpar.RequestParams, fileList moscommon.SourceFileList, dst string) (moscommon.SourceFileList, error) {
+	uploaded := map[string]string{}
+	for _, rf := range reqPar.Files[moscommon.FormSourceFileName] {
+		uploaded[rf.OrigFilename] = rf.Filename
+	}
+	glog.Infof("files: %d, uploaded: %d", len(fileList), len(uploaded))
+	fromBuildCtx := moscommon.SourceFileList{}
+	for p, hash := range fileList {
+		fp := filepath.FromSlash(p)
+		if filepath.IsAbs(fp) || filepath.Clean(fp) != fp || strings.HasPrefix(fp, "..") {
+			return nil, errors.Errorf("invalid file name %q", p)
+		}
+		src, ok := uploaded[hash]
+		if !ok {
+			fromBuildCtx[p] = hash
+			continue
+		}
+		tgt := filepath.Join(dst, fp)
+		if err := os.MkdirAll(filepath.Dir(tgt), 0777); err != nil {
+			return nil, errors.Trace(err)
+		}
+		if err := ourio.LinkOrCopyFile(src, tgt); err != nil {
+			return nil, errors.Trace(err)
+		}
+	}
+	return fromBuildCtx, nil
+}
+
+// copyFromBuildCtx links or copies files which were not uploaded from the existing
+// build context bctxDir to dst. Files are looked up by hash, so renamed files
+// do not have to be uploaded either.
+func copyFromBuildCtx(bctxDir, dst string, files moscommon.SourceFileList) error {
+	if len(files) == 0 {
+		return nil
+	}
+	bctxInfo, err := readBuildCtxInfo(bctxDir)
+	if err != nil {
+		return errors.Annotatef(err, "files were not uploaded and there is no build context to take them from")
+	}
+	byHash := map[string]string{}
+	for p, f := range bctxInfo.Files {
+		if !f.IsDir {
+			byHash[f.Hash] = p
+		}
+	}
+	for p, hash := range files {
+		src, ok := byHash[hash]
+		if !ok {
+			return errors.Errorf("%s was not uploaded and is not in the build context", p)
+		}
+		tgt := filepath.Join(dst, filepath.FromSlash(p))
+		if err := os.MkdirAll(filepath.Dir(tgt), 0777); err != nil {
+			return errors.Trace(err)
+		}
+		// Linked files keep size and mtime, so their hashes are not calculated again.
+		if err := ourio.LinkOrCopyFile(filepath.Join(bctxDir, src), tgt); err != nil {
+			return errors.Trace(err)
+		}
+	}
+	return nil
+}
+
 // buildFirmware expects a ZIP file in sources and a user/group name in account
 // it will unpack the sources in a per-account directory, parse the mg-app yaml file
 // in order to figure out the architecture and invokes the docker build image for that
@@ -285,21 +374,19 @@ func buildFirmware() error {
 		return errors.Trace(err)
 	}
 
+	// Sources are either uploaded as a zip file, or as a list of files and
+	// contents of the files the build context does not have.
 	sourcesFilename := reqPar.FormFileName(moscommon.FormSourcesZipName)
-	if sourcesFilename == "" {
+	fileListData := reqPar.FormValue(moscommon.FormFileListName)
+	if sourcesFilename == "" && fileListData == "" {
 		return errors.Errorf("%s is missing from the request", moscommon.FormSourcesZipName)
 	}
 
-	sources, err := ioutil.ReadFile(sourcesFilename)
-	if err != nil {
-		return errors.Trace(err)
-	}
-	glog.Infof("body size: %d", len(sources))
-
 	w, err := os.Create(*outputZipFileName)
 	if err != nil {
 		return errors.Trace(err)
 	}
+	defer w.Close()
 
 	// Log build stat of the latest build
 	buildStatData := reqPar.FormValue(moscommon.FormBuildStatName)
@@ -323,15 +410,28 @@ func buildFirmware() error {
 	}
 	defer os.RemoveAll(tmpCodeDir)
 
-	// unzip sources
-	bytesReader := bytes.NewReader(sources)
-	if err := archive.UnzipInto(bytesReader, bytesReader.Size(), tmpCodeDir, 0); err != nil {
-		return errors.Trace(err)
-	}
+	// Files which were not uploaded and should be taken from the build context
+	var filesFromBuildCtx moscommon.SourceFileList
+	if sourcesFilename != "" {
+		fi, err := os.Stat(sourcesFilename)
+		if err != nil {
+			return errors.Trace(err)
+		}
+		glog.Infof("body size: %d", fi.Size())
 
-	// Calculate newly received build context info
-	if err := saveBuildCtxInfo(tmpCodeDir); err != nil {
-		return errors.Trace(err)
+		// unzip sources
+		if err := archive.UnzipFileInto(sourcesFilename, tmpCodeDir, 0); err != nil {
+			return errors.Trace(err)
+		}
+	} else {
+		var fileList moscommon.SourceFileList
+		if err := json.Unmarshal([]byte(fileListData), &fileList); err != nil {
+			return errors.Annotatef(err, "invalid %s", moscommon.FormFileListName)
+		}
+		filesFromBuildCtx, err = unpackUploadedFiles(&reqPar, fileList, tmpCodeDir)
+		if err != nil {
+			return errors.Trace(err)
+		}
 	}
 
 	manifestPath := moscommon.GetManifestFilePath(tmpCodeDir)
@@ -347,13 +447,13 @@ func buildFirmware() error {
 		return errors.Trace(err)
 	}
 
-	appsRoot := filepath.Join(*volumesDir, appsRootName)
+	appsRoot := filepath.Join(*volumesDir, fwbuildcommon.AppsRootName)
 	appRoot := filepath.Join(appsRoot, manifest.Name)
 	appArchRoot := filepath.Join(appRoot, manifest.Platform)
 	if manifest.Platform == "" && manifest.ArchOld != "" {
 		appArchRoot = filepath.Join(appRoot, manifest.ArchOld)
 	}
-	appBuildCtxRoot := filepath.Join(appArchRoot, "build_contexts")
+	appBuildCtxRoot := filepath.Join(appArchRoot, fwbuildcommon.BuildCtxRootName)
 
 	if err := os.MkdirAll(appBuildCtxRoot, 0777); err != nil {
 		return errors.Trace(err)
@@ -414,6 +514,15 @@ func buildFirmware() error {
 	// Remember the actual build context name
 	_, buildCtxName = filepath.Split(codeDir)
 
+	if err := copyFromBuildCtx(codeDir, tmpCodeDir, filesFromBuildCtx); err != nil {
+		return errors.Trace(err)
+	}
+
+	// Calculate newly received build context info
+	if err := saveBuildCtxInfo(tmpCodeDir, codeDir); err != nil {
+		return errors.Trace(err)
+	}
+
 	if !clean {
 		if err := updateBuildCtx(tmpCodeDir, codeDir); err != nil {
 			glog.Infof("Couldn't update build context incrementally: %s, resort to clean build", err)
@@ -456,10 +565,15 @@ func buildFirmware() error {
 	ctx, cancel := context.WithTimeout(context.Background(), *timeoutFlag)
 	defer cancel()
 
-	// Run cloud-mos docker container which will do the build {{{
-	success := true
-	err = docker.Run(
-		ctx, *mosImage, out,
+	mosArgs := []string{
+		"build", "-C", codeDir, "--local", "--verbose",
+		"--migrate=false",
+		"--save-build-stat=false",
+		fmt.Sprintf("--build-params=%s", bpFile),
+		"--temp-dir", codeTmpDir,
+		fmt.Sprintf("--prefer-prebuilt-libs=%v", preferPrebuildLibs),
+	}
+	runOpts := []docker.RunOption{
 		// Mgos container should be able to spawn other containers
 		// (read about the "sibling containers" "approach:
 		// https://jpetazzo.github.io/2015/09/03/do-not-use-docker-in-docker-for-ci/)
@@ -472,17 +586,21 @@ func buildFirmware() error {
 		// shared repos of app-dependent modules, and private clones in codeDir
 		// reference them.
 		docker.Bind(appRoot, appRoot, "rw"),
-		// We also need to bind the shared mongoose-os repo, because the one
-		// in the build directory references it. We mount it in read-only mode.
-		docker.Cmd([]string{
-			"build", "-C", codeDir, "--local", "--verbose",
-			"--migrate=false",
-			"--save-build-stat=false",
-			fmt.Sprintf("--build-params=%s", bpFile),
-			"--temp-dir", codeTmpDir,
-			fmt.Sprintf("--prefer-prebuilt-libs=%v", preferPrebuildLibs),
-		}),
-	)
+	}
+	if *compileCacheDir != "" {
+		// Shared by all apps and build contexts, mounted at the same path for the
+		// same reason as appRoot.
+		if err := os.MkdirAll(*compileCacheDir, 0777); err != nil {
+			return errors.Trace(err)
+		}
+		mosArgs = append(mosArgs, fmt.Sprintf("--compile-cache-dir=%s", *compileCacheDir))
+		runOpts = append(runOpts, docker.Bind(*compileCacheDir, *compileCacheDir, "rw"))
+	}
+	runOpts = append(runOpts, docker.Cmd(mosArgs))
+
+	// Run cloud-mos docker container which will do the build {{{
+	success := true
+	err = docker.Run(ctx, *mosImage, out, runOpts...)
 	if err != nil {
 		if _, ok := errors.Cause(err).(*docker.ExitError); ok {
 			success = false
@@ -511,10 +629,13 @@ func buildFirmware() error {
 	}
 
 	// Pack build directory ignoring build/objs/* except build/objs/*.elf
-	matcher := ourglob.PatItems{
+	matcher, err := ourglob.PatItems{
 		{"build/objs/*.elf", true},
 		{"build/objs/*", false},
 		{"*", true},
+	}.Compile()
+	if err != nil {
+		return errors.Trace(err)
 	}
 	var archiveData bytes.Buffer
 	if err := ourio.Archive(
@@ -558,7 +679,7 @@ func sendData(w http.ResponseWriter, status int, data []byte) error {
 
 func usage() {
 	fmt.Printf("Fwbuilder. Usage: %s [flags] <action>\n", os.Args[0])
-	fmt.Printf("Action can be: %q\n", "build")
+	fmt.Printf("Action can be: %q, %q\n", "build", "serve")
 }
 
 func main() {
@@ -588,6 +709,11 @@ func main() {
 			fmt.Println(err)
 			os.Exit(1)
 		}
+	case "serve":
+		if err := serveBuilds(); err != nil {
+			fmt.Println(err)
+			os.Exit(1)
+		}
 	default:
 		fmt.Println("Invalid action")
 		usage()
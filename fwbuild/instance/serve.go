@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package main
+
+import (
+	"bufio"
+	"encoding/json"
+	"flag"
+	"net"
+	"os"
+
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	fwbuildcommon "github.com/mongoose-os/mos/fwbuild/common"
+)
+
+var (
+	socketFlag = flag.String("socket", "", "Unix socket to accept build jobs on, for the serve action")
+)
+
+// serveBuilds keeps the instance running and performs builds sent by the
+// manager over the socket, so they don't pay for starting a container.
+// Jobs are performed one at a time.
+func serveBuilds() error {
+	if *socketFlag == "" {
+		return errors.Errorf("--socket is missing")
+	}
+	os.Remove(*socketFlag)
+	l, err := net.Listen("unix", *socketFlag)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	defer l.Close()
+	glog.Infof("Accepting builds on %s", *socketFlag)
+	for {
+		conn, err := l.Accept()
+		if err != nil {
+			return errors.Trace(err)
+		}
+		if err := serveConn(conn); err != nil {
+			glog.Errorf("%s", err)
+		}
+		conn.Close()
+	}
+}
+
+func serveConn(conn net.Conn) error {
+	scanner := bufio.NewScanner(conn)
+	enc := json.NewEncoder(conn)
+	for scanner.Scan() {
+		var job fwbuildcommon.WarmJob
+		if err := json.Unmarshal(scanner.Bytes(), &job); err != nil {
+			return errors.Annotatef(err, "invalid job")
+		}
+		*reqParFileName = job.ReqParams
+		*outputZipFileName = job.OutputZip
+		var res fwbuildcommon.WarmJobResult
+		if err := buildFirmware(); err != nil {
+			if errors.Cause(err) == errBuildFailure {
+				res.ExitCode = fwbuildcommon.FwbuildExitCodeBuildFailed
+			} else {
+				glog.Errorf("Build error: %s", err)
+				res.ExitCode = 1
+				res.Error = err.Error()
+			}
+		}
+		if err := enc.Encode(&res); err != nil {
+			return errors.Trace(err)
+		}
+	}
+	return errors.Trace(scanner.Err())
+}
@@ -25,12 +25,16 @@ import (
 	"encoding/json"
 	"flag"
 	"fmt"
+	"io"
 	"io/ioutil"
 	"net/http"
+	"net/http/pprof"
 	"os"
 	"os/exec"
 	"path"
 	"path/filepath"
+	"runtime/trace"
+	"strings"
 	"sync"
 	"time"
 
@@ -40,6 +44,7 @@ import (
 	"goji.io/pat"
 	glog "k8s.io/klog/v2"
 
+	moscommon "github.com/mongoose-os/mos/cli/common"
 	"github.com/mongoose-os/mos/common/docker"
 	fwbuildcommon "github.com/mongoose-os/mos/fwbuild/common"
 	"github.com/mongoose-os/mos/fwbuild/common/reqpar"
@@ -52,6 +57,7 @@ var (
 	mosImage            = flag.String("mos-image", "docker.io/mgos/mos", "Mos tool docker image, without a tag")
 	volumesDir          = flag.String("volumes-dir", "/var/tmp/fwbuild-volumes", "")
 	acmeChallengeDir    = flag.String("acme-challenge-dir", "", "Directory to map /.well-known/acme-challenge to")
+	compileCacheDir     = flag.String("compile-cache-dir", "", "If set, compiled objects are shared between all builds through this dir, can be on a volume shared by hosts")
 
 	port              = flag.String("port", "80", "HTTP port to listen at.")
 	portTLS           = flag.String("port-tls", "443", "HTTPS port to listen at.")
@@ -59,6 +65,7 @@ var (
 	keyFile           = flag.String("key-file", "", "TLS key file")
 	payloadLimit      = flag.Int64("payload-size-limit", 5*1024*1024, "Max upload size")
 	imagePullInterval = flag.Duration("image-pull-interval", 1*time.Hour, "Pull images at this interval")
+	debugAddr         = flag.String("debug-addr", "", "If set, serve /debug/pprof/ at this address, e.g. localhost:6060. Do not expose it publicly.")
 
 	errBuildFailure = errors.New("build failure")
 
@@ -82,6 +89,10 @@ func main() {
 		glog.Fatal(err)
 	}
 
+	if *debugAddr != "" {
+		go serveDebug(*debugAddr)
+	}
+
 	var tlsConfig *tls.Config
 	if *certFile != "" || *keyFile != "" {
 		// Check for partial configuration.
@@ -136,6 +147,19 @@ func main() {
 	glog.Fatal(hs.ListenAndServe())
 }
 
+// serveDebug serves profiles on a separate listener, so they are not reachable
+// through the public ports.
+func serveDebug(addr string) {
+	mux := http.NewServeMux()
+	mux.HandleFunc("/debug/pprof/", pprof.Index)
+	mux.HandleFunc("/debug/pprof/cmdline", pprof.Cmdline)
+	mux.HandleFunc("/debug/pprof/profile", pprof.Profile)
+	mux.HandleFunc("/debug/pprof/symbol", pprof.Symbol)
+	mux.HandleFunc("/debug/pprof/trace", pprof.Trace)
+	glog.Infof("Serving debug endpoints at %s ...", addr)
+	glog.Errorf("debug server: %s", http.ListenAndServe(addr, mux))
+}
+
 func CreateHandler() (http.Handler, error) {
 	rRoot := goji.NewMux()
 	rRoot.Use(middleware.MakeLogger())
@@ -143,6 +167,7 @@ func CreateHandler() (http.Handler, error) {
 	rAPI := goji.SubMux()
 	rRoot.Handle(pat.New("/api/*"), rAPI)
 	rAPI.HandleFunc(pat.New("/fwbuild/:version/:action"), handleFwbuildAction)
+	rRoot.HandleFunc(pat.Get("/metrics"), handleMetrics)
 
 	if *acmeChallengeDir != "" {
 		rRoot.HandleFunc(pat.New("/.well-known/acme-challenge/:file"), handleACMEChallenge)
@@ -179,21 +204,45 @@ func doPull(ctx context.Context, version string) error {
 			return errors.Annotatef(err, "error pulling %s", image)
 		}
 	}
+	warmPools.refresh(version)
 	return nil
 }
 
-// runBuild runs fwbuild-instance container with the params reqPar. Returns
-// zip data with the build output files; in case of build failure returned
-// error is errBuildFailure; this can be used to distinguish build failures
-// from other kinds of errors.
-func runBuild(ctx context.Context, version string, reqPar *reqpar.RequestParams) ([]byte, error) {
+// instanceRunOptions returns options to run the fwbuild-instance container with the args.
+func instanceRunOptions(version string, args []string) []docker.RunOption {
 	cmdArgs := []string{
 		"--alsologtostderr",
 		"--v", flag.Lookup("v").Value.String(),
 		"--volumes-dir", path.Join(*volumesDir, version),
 		"--mos-image", fmt.Sprintf("%s:%s", *mosImage, version),
 	}
+	if *compileCacheDir != "" {
+		cmdArgs = append(cmdArgs, "--compile-cache-dir", *compileCacheDir)
+	}
+	cmdArgs = append(cmdArgs, args...)
+
+	runOpts := []docker.RunOption{
+		// Mgos container should be able to spawn other containers
+		// (read about the "sibling containers" "approach:
+		// https://jpetazzo.github.io/2015/09/03/do-not-use-docker-in-docker-for-ci/)
+		docker.Bind("/var/run/docker.sock", "/var/run/docker.sock", "rw"),
+	}
+	// This is no longer necessary post-2.6 but is preserved for backward compatibility.
+	if dockerBin, err := exec.LookPath("docker"); err == nil {
+		runOpts = append(runOpts, docker.Bind(dockerBin, "/usr/bin/docker", "ro"))
+	}
+	runOpts = append(runOpts, docker.Bind(*volumesDir, *volumesDir, "rw"))
+	if *compileCacheDir != "" {
+		runOpts = append(runOpts, docker.Bind(*compileCacheDir, *compileCacheDir, "rw"))
+	}
+	return append(runOpts, docker.Cmd(cmdArgs))
+}
 
+// runBuild runs fwbuild-instance container with the params reqPar. Returns
+// zip data with the build output files; in case of build failure returned
+// error is errBuildFailure; this can be used to distinguish build failures
+// from other kinds of errors.
+func runBuild(ctx context.Context, version string, reqPar *reqpar.RequestParams) ([]byte, error) {
 	// Create request params json file {{{
 	reqParFile, err := ioutil.TempFile(*volumesDir, "req_par_")
 	if err != nil {
@@ -246,33 +295,34 @@ func runBuild(ctx context.Context, version string, reqPar *reqpar.RequestParams)
 		}
 	}
 
-	cmdArgs = append(cmdArgs, "--req-params", reqParFile.Name())
-	cmdArgs = append(cmdArgs, "--output-zip", outputFile.Name())
-
-	cmdArgs = append(cmdArgs, "build")
-
-	runOpts := []docker.RunOption{
-		// Mgos container should be able to spawn other containers
-		// (read about the "sibling containers" "approach:
-		// https://jpetazzo.github.io/2015/09/03/do-not-use-docker-in-docker-for-ci/)
-		docker.Bind("/var/run/docker.sock", "/var/run/docker.sock", "rw"),
+	// Use a warm instance if there is one idle, otherwise start a new container.
+	buildErr := errNoWarmInstance
+	if wp := warmPools.get(version); wp != nil {
+		trace.WithRegion(ctx, "warm-instance-run", func() {
+			buildErr = wp.run(ctx, fwbuildcommon.WarmJob{
+				ReqParams: reqParFile.Name(),
+				OutputZip: outputFile.Name(),
+			})
+		})
 	}
-	// This is no longer necessary post-2.6 but is preserved for backward compatibility.
-	if dockerBin, err := exec.LookPath("docker"); err == nil {
-		runOpts = append(runOpts, docker.Bind(dockerBin, "/usr/bin/docker", "ro"))
+	if c := errors.Cause(buildErr); c == errNoWarmInstance || c == errWarmInstanceGone {
+		trace.WithRegion(ctx, "docker-run", func() {
+			buildErr = docker.Run(ctx, imageName, os.Stdout, instanceRunOptions(version, []string{
+				"--req-params", reqParFile.Name(),
+				"--output-zip", outputFile.Name(),
+				"build",
+			})...)
+		})
 	}
-	runOpts = append(runOpts,
-		docker.Bind(*volumesDir, *volumesDir, "rw"),
-		docker.Cmd(cmdArgs),
-	)
-
-	buildErr := docker.Run(ctx, imageName, os.Stdout, runOpts...)
 
 	// Read zip data from output file
 	data, err := ioutil.ReadAll(outputFile)
 
 	// Return data and a proper error (if any)
 	if buildErr != nil {
+		if errors.Cause(buildErr) == errBuildFailure {
+			return data, errBuildFailure
+		}
 		glog.Errorf("Build error: %+v", errors.ErrorStack(buildErr))
 		exitError, ok := errors.Cause(buildErr).(*docker.ExitError)
 		if ok && exitError.Code() == fwbuildcommon.FwbuildExitCodeBuildFailed {
@@ -285,6 +335,50 @@ func runBuild(ctx context.Context, version string, reqPar *reqpar.RequestParams)
 	return data, nil
 }
 
+// isValidPathComponent returns true if s can be used as a single path component.
+func isValidPathComponent(s string) bool {
+	return s != "" && s != "." && s != ".." && !strings.ContainsAny(s, "/\\")
+}
+
+// getMissingFiles handles the request of the client which wants to upload only
+// the files the build context does not have and returns the JSON response.
+// It is answered by the manager directly from the build context info because
+// it is cheap, and the instance only gets involved for the actual build.
+func getMissingFiles(version string, r *http.Request) ([]byte, error) {
+	var req moscommon.MissingFilesRequest
+	if err := json.NewDecoder(io.LimitReader(r.Body, *payloadLimit)).Decode(&req); err != nil {
+		return nil, errors.Annotatef(err, "invalid request")
+	}
+	have := map[string]bool{}
+	if isValidPathComponent(req.App) && isValidPathComponent(req.Platform) && isValidPathComponent(req.BuildCtx) {
+		bctxDir := filepath.Join(*volumesDir, version, fwbuildcommon.AppsRootName,
+			req.App, req.Platform, fwbuildcommon.BuildCtxRootName, req.BuildCtx)
+		// The format is BuildCtxInfo of fwbuild instance, we only need the hashes.
+		var bctxInfo struct {
+			Files map[string]struct {
+				Hash string `json:"hash"`
+			} `json:"files"`
+		}
+		if data, err := ioutil.ReadFile(filepath.Join(bctxDir, fwbuildcommon.BuildCtxInfoFilename)); err == nil {
+			if err := json.Unmarshal(data, &bctxInfo); err != nil {
+				glog.Errorf("%s: invalid build context info: %s", bctxDir, err)
+			}
+		}
+		for _, f := range bctxInfo.Files {
+			if f.Hash != "" {
+				have[f.Hash] = true
+			}
+		}
+	}
+	resp := moscommon.MissingFilesResponse{Missing: []string{}}
+	for _, h := range req.Hashes {
+		if !have[h] {
+			resp.Missing = append(resp.Missing, h)
+		}
+	}
+	return json.Marshal(&resp)
+}
+
 func handleFwbuildAction(w http.ResponseWriter, r *http.Request) {
 	ctx := r.Context()
 	version := pat.Param(r, "version")
@@ -305,8 +399,19 @@ func handleFwbuildAction(w http.ResponseWriter, r *http.Request) {
 			reqPar.RemoveFiles()
 		}()
 
+		release, err := builds.acquire(ctx)
+		if err != nil {
+			glog.Infof("Request error: %s", err)
+			w.WriteHeader(http.StatusServiceUnavailable)
+			w.Write([]byte(err.Error() + "\n"))
+			return
+		}
+		defer release()
+
 		// Perform the build
-		data, err := runBuild(ctx, version, reqPar)
+		tctx, task := trace.NewTask(ctx, "fwbuild-build")
+		data, err := runBuild(tctx, version, reqPar)
+		task.End()
 		if err != nil {
 			if errors.Cause(err) == errBuildFailure {
 				w.WriteHeader(http.StatusTeapot)
@@ -319,6 +424,17 @@ func handleFwbuildAction(w http.ResponseWriter, r *http.Request) {
 
 		w.Write(data)
 
+	case moscommon.MissingFilesAction:
+		data, err := getMissingFiles(version, r)
+		if err != nil {
+			glog.Infof("Request error: %s", err)
+			w.WriteHeader(http.StatusBadRequest)
+			w.Write([]byte(err.Error() + "\n"))
+			return
+		}
+		w.Header().Set("Content-Type", "application/json")
+		w.Write(data)
+
 	case "pull":
 		if err := doPull(ctx, version); err != nil {
 			glog.Infof("Request error: %s", err)
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package main
+
+import (
+	"container/list"
+	"context"
+	"flag"
+	"fmt"
+	"net/http"
+	"runtime"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+)
+
+var (
+	maxConcurrentBuilds = flag.Int("max-concurrent-builds", runtime.NumCPU(), "Max number of builds to run at the same time")
+	maxQueuedBuilds     = flag.Int("max-queued-builds", 100, "Max number of builds waiting to run, further requests are rejected")
+
+	errQueueFull = errors.New("too many builds queued, try again later")
+)
+
+// buildQueue admits builds in FIFO order, at most maxConcurrentBuilds at a time.
+type buildQueue struct {
+	lock    sync.Mutex
+	running int
+	// Elements are chan struct{} which is closed when the build is admitted.
+	waiting *list.List
+
+	// Stats
+	admitted     uint64
+	rejected     uint64
+	waitTimeSum  float64
+	maxQueueSeen int
+}
+
+var builds = &buildQueue{waiting: list.New()}
+
+// acquire waits for the build to be admitted. The returned function must
+// be called when the build is done.
+func (q *buildQueue) acquire(ctx context.Context) (func(), error) {
+	start := time.Now()
+	q.lock.Lock()
+	if q.running < *maxConcurrentBuilds && q.waiting.Len() == 0 {
+		q.running++
+		q.admitted++
+		q.lock.Unlock()
+		return q.release, nil
+	}
+	if q.waiting.Len() >= *maxQueuedBuilds {
+		q.rejected++
+		q.lock.Unlock()
+		return nil, errQueueFull
+	}
+	ch := make(chan struct{})
+	e := q.waiting.PushBack(ch)
+	if q.waiting.Len() > q.maxQueueSeen {
+		q.maxQueueSeen = q.waiting.Len()
+	}
+	q.lock.Unlock()
+	select {
+	case <-ch:
+		q.lock.Lock()
+		q.waitTimeSum += time.Since(start).Seconds()
+		q.lock.Unlock()
+		return q.release, nil
+	case <-ctx.Done():
+		q.lock.Lock()
+		defer q.lock.Unlock()
+		select {
+		case <-ch:
+			// Admitted at the same time, pass the slot on.
+			q.releaseLocked()
+		default:
+			q.waiting.Remove(e)
+		}
+		return nil, errors.Trace(ctx.Err())
+	}
+}
+
+func (q *buildQueue) release() {
+	q.lock.Lock()
+	defer q.lock.Unlock()
+	q.releaseLocked()
+}
+
+func (q *buildQueue) releaseLocked() {
+	q.running--
+	for q.running < *maxConcurrentBuilds && q.waiting.Len() > 0 {
+		ch := q.waiting.Remove(q.waiting.Front()).(chan struct{})
+		q.running++
+		q.admitted++
+		close(ch)
+	}
+}
+
+// handleMetrics serves queue stats in Prometheus text format.
+func handleMetrics(w http.ResponseWriter, r *http.Request) {
+	q := builds
+	q.lock.Lock()
+	defer q.lock.Unlock()
+	w.Header().Set("Content-Type", "text/plain; version=0.0.4")
+	fmt.Fprintf(w, "# HELP fwbuild_queue_depth Builds waiting to run.\n# TYPE fwbuild_queue_depth gauge\n")
+	fmt.Fprintf(w, "fwbuild_queue_depth %d\n", q.waiting.Len())
+	fmt.Fprintf(w, "# HELP fwbuild_queue_depth_max Max number of builds waiting to run since start.\n# TYPE fwbuild_queue_depth_max gauge\n")
+	fmt.Fprintf(w, "fwbuild_queue_depth_max %d\n", q.maxQueueSeen)
+	fmt.Fprintf(w, "# HELP fwbuild_running_builds Builds running now.\n# TYPE fwbuild_running_builds gauge\n")
+	fmt.Fprintf(w, "fwbuild_running_builds %d\n", q.running)
+	fmt.Fprintf(w, "# HELP fwbuild_builds_admitted_total Builds admitted to run.\n# TYPE fwbuild_builds_admitted_total counter\n")
+	fmt.Fprintf(w, "fwbuild_builds_admitted_total %d\n", q.admitted)
+	fmt.Fprintf(w, "# HELP fwbuild_builds_rejected_total Builds rejected because the queue was full.\n# TYPE fwbuild_builds_rejected_total counter\n")
+	fmt.Fprintf(w, "fwbuild_builds_rejected_total %d\n", q.rejected)
+	fmt.Fprintf(w, "# HELP fwbuild_queue_wait_seconds_sum Total time builds spent in the queue.\n# TYPE fwbuild_queue_wait_seconds_sum counter\n")
+	fmt.Fprintf(w, "fwbuild_queue_wait_seconds_sum %g\n", q.waitTimeSum)
+	warmPools.writeMetrics(w)
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package main
+
+import (
+	"bufio"
+	"context"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"path/filepath"
+	"sort"
+	"sync"
+	"time"
+
+	"github.com/juju/errors"
+	glog "k8s.io/klog/v2"
+
+	"github.com/mongoose-os/mos/common/docker"
+	fwbuildcommon "github.com/mongoose-os/mos/fwbuild/common"
+)
+
+var (
+	warmInstances = flag.Int("warm-instances", 0,
+		"Number of instance containers per mos version kept running and accepting builds. "+
+			"0 - start a new container for each build")
+
+	errNoWarmInstance   = errors.New("no idle warm instance")
+	errWarmInstanceGone = errors.New("warm instance exited")
+)
+
+const (
+	warmSocketDirName      = "warm"
+	warmInstanceStartWait  = 2 * time.Minute
+	warmInstanceMaxBackoff = 5 * time.Minute
+)
+
+type warmJob struct {
+	job fwbuildcommon.WarmJob
+	// The instance is killed if this is cancelled before the job is finished.
+	ctx context.Context
+	// Receives nil, errBuildFailure or another error.
+	result chan error
+}
+
+// warmInstance is a running instance container that performs builds sent over its socket.
+type warmInstance struct {
+	jobs chan *warmJob
+}
+
+// warmPool keeps instance containers of one mos version running.
+type warmPool struct {
+	version string
+
+	lock sync.Mutex
+	idle []*warmInstance
+	// Closed when the image is updated, instances are restarted then.
+	refresh chan struct{}
+	starts  uint64
+}
+
+type warmPoolSet struct {
+	lock  sync.Mutex
+	pools map[string]*warmPool
+}
+
+var warmPools = &warmPoolSet{pools: map[string]*warmPool{}}
+
+// get returns the pool for the version, starting it if necessary.
+// Returns nil if warm instances are disabled.
+func (ps *warmPoolSet) get(version string) *warmPool {
+	if *warmInstances <= 0 {
+		return nil
+	}
+	ps.lock.Lock()
+	defer ps.lock.Unlock()
+	p := ps.pools[version]
+	if p == nil {
+		p = &warmPool{version: version, refresh: make(chan struct{})}
+		ps.pools[version] = p
+		for i := 0; i < *warmInstances; i++ {
+			go p.runInstance(i)
+		}
+	}
+	return p
+}
+
+// refresh restarts warm instances of the version, to pick up an updated image.
+func (ps *warmPoolSet) refresh(version string) {
+	ps.lock.Lock()
+	p := ps.pools[version]
+	ps.lock.Unlock()
+	if p == nil {
+		return
+	}
+	p.lock.Lock()
+	close(p.refresh)
+	p.refresh = make(chan struct{})
+	p.lock.Unlock()
+}
+
+func (ps *warmPoolSet) writeMetrics(w io.Writer) {
+	ps.lock.Lock()
+	defer ps.lock.Unlock()
+	var versions []string
+	for v := range ps.pools {
+		versions = append(versions, v)
+	}
+	sort.Strings(versions)
+	idle := map[string]int{}
+	starts := map[string]uint64{}
+	for _, v := range versions {
+		p := ps.pools[v]
+		p.lock.Lock()
+		idle[v], starts[v] = len(p.idle), p.starts
+		p.lock.Unlock()
+	}
+	fmt.Fprintf(w, "# HELP fwbuild_warm_instances_idle Warm instances waiting for builds.\n# TYPE fwbuild_warm_instances_idle gauge\n")
+	for _, v := range versions {
+		fmt.Fprintf(w, "fwbuild_warm_instances_idle{version=%q} %d\n", v, idle[v])
+	}
+	fmt.Fprintf(w, "# HELP fwbuild_warm_instance_starts_total Warm instance containers started.\n# TYPE fwbuild_warm_instance_starts_total counter\n")
+	for _, v := range versions {
+		fmt.Fprintf(w, "fwbuild_warm_instance_starts_total{version=%q} %d\n", v, starts[v])
+	}
+}
+
+// run performs the build on an idle warm instance. Returns errNoWarmInstance
+// or errWarmInstanceGone if the build should be performed in a new container instead.
+func (p *warmPool) run(ctx context.Context, job fwbuildcommon.WarmJob) error {
+	p.lock.Lock()
+	if len(p.idle) == 0 {
+		p.lock.Unlock()
+		return errNoWarmInstance
+	}
+	wi := p.idle[len(p.idle)-1]
+	p.idle = p.idle[:len(p.idle)-1]
+	p.lock.Unlock()
+	j := &warmJob{job: job, ctx: ctx, result: make(chan error, 1)}
+	wi.jobs <- j
+	// Even if ctx is done, wait for the instance to stop using the job's files
+	// and the build slot: it is killed then and reports back once it is gone.
+	err := <-j.result
+	if ctx.Err() != nil {
+		return errors.Trace(ctx.Err())
+	}
+	return err
+}
+
+// removeIdle returns false if wi is not idle, i.e. it has been picked for a job.
+func (p *warmPool) removeIdle(wi *warmInstance) bool {
+	p.lock.Lock()
+	defer p.lock.Unlock()
+	for i, e := range p.idle {
+		if e == wi {
+			p.idle = append(p.idle[:i], p.idle[i+1:]...)
+			return true
+		}
+	}
+	return false
+}
+
+func (p *warmPool) runInstance(i int) {
+	sockDir := filepath.Join(*volumesDir, warmSocketDirName)
+	if err := os.MkdirAll(sockDir, 0777); err != nil {
+		glog.Errorf("%s", err)
+		return
+	}
+	sock := filepath.Join(sockDir, fmt.Sprintf("%s-%d.sock", p.version, i))
+	backoff := time.Second
+	for {
+		start := time.Now()
+		if err := p.serveInstance(sock); err != nil {
+			glog.Errorf("%s warm instance %d: %s", p.version, i, err)
+		}
+		// Back off if the instance does not stay up, e.g. there is no such image.
+		if time.Since(start) > warmInstanceMaxBackoff {
+			backoff = time.Second
+		} else if backoff *= 2; backoff > warmInstanceMaxBackoff {
+			backoff = warmInstanceMaxBackoff
+		}
+		time.Sleep(backoff)
+	}
+}
+
+// serveInstance starts the instance container and feeds jobs to it until
+// it exits or the image is updated.
+func (p *warmPool) serveInstance(sock string) error {
+	p.lock.Lock()
+	refresh := p.refresh
+	p.starts++
+	p.lock.Unlock()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	os.Remove(sock)
+	exited := make(chan error, 1)
+	go func() {
+		exited <- docker.Run(ctx, getImageName(p.version), os.Stdout, instanceRunOptions(p.version, []string{
+			"--socket", sock, "serve",
+		})...)
+	}()
+
+	conn, err := waitForSocket(sock, exited)
+	if err != nil {
+		return errors.Trace(err)
+	}
+	defer conn.Close()
+
+	wi := &warmInstance{jobs: make(chan *warmJob, 1)}
+	scanner := bufio.NewScanner(conn)
+	enc := json.NewEncoder(conn)
+	for {
+		p.lock.Lock()
+		p.idle = append(p.idle, wi)
+		p.lock.Unlock()
+		var j *warmJob
+		select {
+		case j = <-wi.jobs:
+		case err := <-exited:
+			if !p.removeIdle(wi) {
+				(<-wi.jobs).result <- errWarmInstanceGone
+			}
+			return errors.Errorf("exited: %v", err)
+		case <-refresh:
+			if !p.removeIdle(wi) {
+				j = <-wi.jobs
+				// Let it finish the job it has been given.
+				refresh = nil
+				break
+			}
+			return nil
+		}
+		if err := enc.Encode(&j.job); err != nil {
+			j.result <- errWarmInstanceGone
+			return errors.Trace(err)
+		}
+		// A job cannot be aborted, so if the build is cancelled the instance is killed.
+		scanned := make(chan bool, 1)
+		go func() {
+			scanned <- scanner.Scan()
+		}()
+		var ok bool
+		select {
+		case ok = <-scanned:
+		case <-j.ctx.Done():
+			cancel()
+			conn.Close()
+			<-exited
+			j.result <- errors.Trace(j.ctx.Err())
+			return errors.Errorf("killed, build cancelled")
+		}
+		if !ok {
+			j.result <- errWarmInstanceGone
+			return errors.Errorf("no result: %v", scanner.Err())
+		}
+		var res fwbuildcommon.WarmJobResult
+		if err := json.Unmarshal(scanner.Bytes(), &res); err != nil {
+			j.result <- errors.Annotatef(err, "invalid result")
+			return errors.Trace(err)
+		}
+		switch res.ExitCode {
+		case 0:
+			j.result <- nil
+		case fwbuildcommon.FwbuildExitCodeBuildFailed:
+			j.result <- errBuildFailure
+		default:
+			j.result <- errors.Errorf("build error: %s", res.Error)
+		}
+		if refresh == nil {
+			return nil
+		}
+	}
+}
+
+// waitForSocket connects to the socket of the instance once it starts accepting jobs.
+func waitForSocket(sock string, exited chan error) (net.Conn, error) {
+	deadline := time.Now().Add(warmInstanceStartWait)
+	for {
+		conn, err := net.Dial("unix", sock)
+		if err == nil {
+			return conn, nil
+		}
+		if time.Now().After(deadline) {
+			return nil, errors.Annotatef(err, "instance did not start")
+		}
+		select {
+		case err := <-exited:
+			return nil, errors.Errorf("instance exited: %v", err)
+		case <-time.After(200 * time.Millisecond):
+		}
+	}
+}